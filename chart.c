@@ -1,5 +1,5 @@
 /*
- * chart.c: P4 Charting Client
+ * chart.c: P4 Charting Client and Export
  *
  * See the README file for copyright information and how to reach the author.
  *
@@ -7,8 +7,16 @@
 
 #include <errno.h>
 #include <signal.h>
+#include <math.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include <atomic>
+#include <algorithm>
 
 #include "lib/db.h"
+#include "lib/dbpool.h"
+#include "lib/gorilla.h"
 #include "lib/common.h"
 
 //***************************************************************************
@@ -26,7 +34,24 @@ const char* filter = "";
 
 int intervall = na;
 int dbport = 3306;
-int shutdown;
+volatile int shutdown;
+
+// export
+
+enum ExportFormat
+{
+   efNone,
+   efCsv,
+   efNdJson,
+   efBinary
+};
+
+ExportFormat exportFormat = efNone;
+const char* exportSensors = "";
+const char* checkpointFile = 0;
+time_t exportFrom = 0;
+time_t exportTo = 0;
+int exportJobs = 1;
 
 void downF(int aSignal)
 {
@@ -91,7 +116,7 @@ int exitDb()
 
 void showUsage(const char* name)
 {
-   printf("Usage: %s [options] - dump actual data to ascii file\n"
+   printf("Usage: %s [options] - dump actual data to ascii file or export the samples\n"
           "    -f <file>      - output file\n"
           "    -h <host>      - database host\n"
           "    -P <port>      - database port\n"
@@ -101,7 +126,15 @@ void showUsage(const char* name)
           "    -l <logvel>    - log level {0-4}\n"
           "    -i <intervall> - intervall in seconds\n"
           "    -t             - log to console\n"
-          "    -F <filter>    - get only parameter which match name eg. 'Time, Kesseltemperatur, Abgastemperatur'\n",
+          "    -F <filter>    - get only parameter which match name eg. 'Time, Kesseltemperatur, Abgastemperatur'\n"
+          "\n"
+          "  export:\n"
+          "    -x <format>    - export the samples as 'csv', 'ndjson' or 'bin' (columnar binary)\n"
+          "    -s <sensors>   - sensors to export eg. 'VA:0x01,VA:0x02' (default all recorded)\n"
+          "    -b <time>      - begin of range 'YYYY-MM-DD[ HH:MM[:SS]]' or unix time (default one day ago)\n"
+          "    -e <time>      - end of range (default now)\n"
+          "    -j <count>     - number of sensors exported in parallel (default 1)\n"
+          "    -c <file>      - checkpoint file, resume an aborted export (the output is continued at the checkpoint)\n",
           name);
 }
 
@@ -273,6 +306,7 @@ int actualAscii(const char* file)
    s->setBindPrefix("s.");
    s->bind(sDb->getValue("TIME"), cDBS::bndIn | cDBS::bndSet, "and ");
    s->build(";");
+   s->setStreaming();
    s->prepare();
 
    shutdown = no;
@@ -330,6 +364,548 @@ int actualAscii(const char* file)
    return 0;
 }
 
+//***************************************************************************
+// Export
+//   streams the samples and the archived days of each sensor in chunks of
+//   one day, a chunk is streamed unbuffered (index addr_type_time) without
+//   holding the table, written at once and then noted in the checkpoint
+//***************************************************************************
+
+cDbFieldDef exportFromDef("EXPORT_FROM", "efrom", cDBS::ffDateTime, 0, cDBS::ftData);
+cDbFieldDef exportToDef("EXPORT_TO", "eto", cDBS::ffDateTime, 0, cDBS::ftData);
+
+struct ExportSensor
+{
+   std::string type;
+   uint address;
+   std::string key;              // 'VA:0x01'
+   time_t from;
+};
+
+struct ExportRow
+{
+   time_t time;
+   char aggregate;               // ' ' for archived samples
+   bool isNull;
+   double value;
+   int samples;
+   std::string text;
+};
+
+FILE* exportFp = 0;
+cMyMutex exportMutex;                       // output and checkpoint
+std::map<std::string,time_t> checkpoints;   // key -> exported until
+off_t checkpointOffset {na};                // size of the output at the checkpoint
+std::atomic<int> exportPending {0};
+std::atomic<int> exportFailed {0};          // sensors
+std::atomic<long> exportedRows {0};
+
+//***************************************************************************
+// Parse Time - 'YYYY-MM-DD[ HH:MM[:SS]]' or unix time
+//***************************************************************************
+
+time_t parseTime(const char* str)
+{
+   const char* formats[] = { "%Y-%m-%d %H:%M:%S", "%Y-%m-%d %H:%M", "%Y-%m-%d", 0 };
+
+   if (strspn(str, "0123456789") == strlen(str))
+      return atol(str);
+
+   for (int i = 0; formats[i]; i++)
+   {
+      struct tm tm;
+      memset(&tm, 0, sizeof(tm));
+
+      const char* end = strptime(str, formats[i], &tm);
+
+      if (end && !*end)
+      {
+         tm.tm_isdst = -1;
+         return mktime(&tm);
+      }
+   }
+
+   return na;
+}
+
+//***************************************************************************
+// Checkpoint
+//   one line per sensor '<key> <exported until>' and the line '@output <size>'
+//   with the size of the output, replaced atomically. A resumed export
+//   truncates the output to this size, chunks written after the last
+//   checkpoint would be written twice otherwise.
+//   loadCheckpoint() returns yes if an export is resumed
+//***************************************************************************
+
+int loadCheckpoint()
+{
+   FILE* fp = fopen(checkpointFile, "r");
+   char key[50+TB];
+   long until;
+
+   if (!fp)
+      return no;
+
+   while (fscanf(fp, "%50s %ld", key, &until) == 2)
+   {
+      if (strcmp(key, "@output") == 0)
+         checkpointOffset = until;
+      else
+         checkpoints[key] = until;
+   }
+
+   fclose(fp);
+   tell(eloAlways, "Resuming export of %zu sensors from checkpoint '%s'", checkpoints.size(), checkpointFile);
+
+   return yes;
+}
+
+int storeCheckpoint()                        // exportMutex locked
+{
+   std::string tmp = std::string(checkpointFile) + ".tmp";
+   FILE* fp = fopen(tmp.c_str(), "w");
+
+   if (!fp)
+   {
+      tell(eloAlways, "Error: Can't write checkpoint '%s', error was '%s'", tmp.c_str(), strerror(errno));
+      return fail;
+   }
+
+   fprintf(fp, "@output %ld\n", (long)checkpointOffset);
+
+   for (const auto& cp : checkpoints)
+      fprintf(fp, "%s %ld\n", cp.first.c_str(), (long)cp.second);
+
+   fclose(fp);
+
+   return rename(tmp.c_str(), checkpointFile) == 0 ? success : fail;
+}
+
+//***************************************************************************
+// Format Chunk
+//***************************************************************************
+
+void formatValue(std::string& out, const ExportRow& row)
+{
+   char buf[50+TB];
+
+   if (row.isNull)
+      return;
+
+   snprintf(buf, sizeof(buf), "%.7g", row.value);     // float precision of the column
+   out += buf;
+}
+
+void formatCsvText(std::string& out, const std::string& text)
+{
+   if (text.find_first_of(",\"\n\r") == std::string::npos)
+   {
+      out += text;
+      return;
+   }
+
+   out += '"';
+
+   for (char c : text)
+   {
+      if (c == '"')
+         out += '"';
+
+      out += c;
+   }
+
+   out += '"';
+}
+
+void formatJsonText(std::string& out, const std::string& text)
+{
+   char buf[10+TB];
+
+   out += '"';
+
+   for (unsigned char c : text)
+   {
+      if (c == '"' || c == '\\')
+      {
+         out += '\\';
+         out += c;
+      }
+      else if (c < 0x20)
+      {
+         snprintf(buf, sizeof(buf), "\\u%04x", c);
+         out += buf;
+      }
+      else
+         out += c;
+   }
+
+   out += '"';
+}
+
+int formatChunk(std::string& out, const ExportSensor* sensor, const std::vector<ExportRow>& rows)
+{
+   char buf[100+TB];
+
+   if (exportFormat == efBinary)
+   {
+      // block: type[8], address, count, time[count], value[count], aggregate[count]
+      //   little endian as the host, NaN for rows without value
+
+      char type[8] {};
+      uint32_t address = sensor->address;
+      uint32_t count = rows.size();
+
+      strncpy(type, sensor->type.c_str(), sizeof(type));
+      out.append(type, sizeof(type));
+      out.append((const char*)&address, sizeof(address));
+      out.append((const char*)&count, sizeof(count));
+
+      for (const auto& row : rows)
+      {
+         int64_t time = row.time;
+         out.append((const char*)&time, sizeof(time));
+      }
+
+      for (const auto& row : rows)
+      {
+         double value = row.isNull ? NAN : row.value;
+         out.append((const char*)&value, sizeof(value));
+      }
+
+      for (const auto& row : rows)
+         out += row.aggregate;
+
+      return done;
+   }
+
+   for (const auto& row : rows)
+   {
+      if (exportFormat == efCsv)
+      {
+         snprintf(buf, sizeof(buf), "%s,%u,%ld,%c,", sensor->type.c_str(), sensor->address, (long)row.time, row.aggregate);
+         out += buf;
+         formatValue(out, row);
+         out += ',';
+         formatCsvText(out, row.text);
+         snprintf(buf, sizeof(buf), ",%d\n", row.samples);
+         out += buf;
+      }
+      else
+      {
+         snprintf(buf, sizeof(buf), "{\"type\":\"%s\",\"address\":%u,\"time\":%ld,\"aggregate\":\"%c\",\"value\":",
+                  sensor->type.c_str(), sensor->address, (long)row.time, row.aggregate);
+         out += buf;
+
+         if (row.isNull)
+            out += "null";
+         else
+            formatValue(out, row);
+
+         out += ",\"text\":";
+
+         if (row.text.empty())
+            out += "null";
+         else
+            formatJsonText(out, row.text);
+
+         snprintf(buf, sizeof(buf), ",\"samples\":%d}\n", row.samples);
+         out += buf;
+      }
+   }
+
+   return done;
+}
+
+//***************************************************************************
+// Write Chunk - output and checkpoint in one step
+//***************************************************************************
+
+int writeChunk(const ExportSensor* sensor, const std::string& data, time_t until)
+{
+   cMyMutexLock lock(&exportMutex);
+
+   if (!data.empty() && fwrite(data.c_str(), 1, data.size(), exportFp) != data.size())
+   {
+      tell(eloAlways, "Error: Writing export failed, error was '%s'", strerror(errno));
+      shutdown = yes;
+      return fail;
+   }
+
+   if (!checkpointFile)
+      return success;
+
+   // the chunk has to be on the disk before it is noted in the checkpoint
+
+   if (fflush(exportFp) != 0)
+      return fail;
+
+   checkpoints[sensor->key] = until;
+   checkpointOffset = ftello(exportFp);
+
+   return storeCheckpoint();
+}
+
+//***************************************************************************
+// Export Sensor - job of a db worker
+//***************************************************************************
+
+int exportSensor(cDbWorker* worker, const ExportSensor* sensor)
+{
+   cDbTable* samples = worker->getTable("samples");
+   cDbTable* archive = worker->getTable("samplearchive");
+   cDbValue from(&exportFromDef);
+   cDbValue to(&exportToDef);
+   std::vector<ExportRow> rows;
+   std::string data;
+   long count {0};
+
+   if (!worker->getConnection())
+   {
+      tell(eloAlways, "Error: Export of '%s' failed, database not available", sensor->key.c_str());
+      return fail;
+   }
+
+   if (!samples)
+      return fail;
+
+   cDbStatement select(samples);
+
+   select.build("select ");
+   select.bind("TIME", cDBS::bndOut);
+   select.bind("AGGREGATE", cDBS::bndOut, ", ");
+   select.bind("VALUE", cDBS::bndOut, ", ");
+   select.bind("TEXT", cDBS::bndOut, ", ");
+   select.bind("SAMPLES", cDBS::bndOut, ", ");
+   select.build(" from %s where ", samples->TableName());
+   select.bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
+   select.bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
+   select.bindCmp(0, "TIME", &from, ">=", " and ");
+   select.bindCmp(0, "TIME", &to, "<", " and ");
+   select.build(" order by time");
+   select.setStreaming();
+
+   if (select.prepare() != success)
+      return fail;
+
+   for (time_t day = sensor->from; day < exportTo && !shutdown; )
+   {
+      time_t next = std::min(midnightOf(day + tmeSecondsPerDay + 2*tmeSecondsPerHour), exportTo);  // DST safe
+      bool archived {false};
+
+      rows.clear();
+      data.clear();
+
+      // the closed days are (mostly) in the archive
+
+      if (archive)
+      {
+         cSampleArchive(archive).read(sensor->address, sensor->type.c_str(), day, next-1, [&](time_t time, double value)
+         {
+            rows.push_back({ time, ' ', false, value, 1, "" });
+            archived = true;
+         });
+      }
+
+      samples->clear();
+      samples->setValue("ADDRESS", (long)sensor->address);
+      samples->setValue("TYPE", sensor->type.c_str());
+      from.setValue(day);
+      to.setValue(next);
+
+      for (int f = select.find(); f; f = select.fetch())
+      {
+         const char* aggregate = samples->getStrValue("AGGREGATE");
+
+         rows.push_back({ samples->getTimeValue("TIME"),
+                          !isEmpty(aggregate) ? *aggregate : ' ',
+                          samples->getValue("VALUE")->isNull() != 0,
+                          samples->getFloatValue("VALUE"),
+                          (int)samples->getIntValue("SAMPLES"),
+                          samples->getStrValue("TEXT") });
+      }
+
+      select.freeResult();
+
+      if (archived)
+         std::stable_sort(rows.begin(), rows.end(), [](const ExportRow& a, const ExportRow& b) { return a.time < b.time; });
+
+      formatChunk(data, sensor, rows);
+
+      if (writeChunk(sensor, data, next) != success)
+         return fail;
+
+      count += rows.size();
+      day = next;
+   }
+
+   exportedRows += count;
+   tell(eloDetail, "Exported %ld rows of '%s'", count, sensor->key.c_str());
+
+   return success;
+}
+
+//***************************************************************************
+// Export Data
+//***************************************************************************
+
+int exportData(const char* file)
+{
+   std::vector<ExportSensor*> sensors;
+   bool append {false};
+   double start = usNow();
+
+   if (!exportFrom)
+      exportFrom = time(0) - tmeSecondsPerDay;
+
+   if (!exportTo)
+      exportTo = time(0);
+
+   if (checkpointFile)
+      append = loadCheckpoint() == yes;
+
+   // the sensors
+
+   if (!isEmpty(exportSensors))
+   {
+      for (const auto& key : split(exportSensors, ','))
+      {
+         size_t pos = key.find(':');
+
+         if (pos == std::string::npos)
+         {
+            tell(eloAlways, "Error: Ignoring sensor '%s', expected '<type>:<address>'", key.c_str());
+            continue;
+         }
+
+         sensors.push_back(new ExportSensor { key.substr(0, pos), (uint)strtoul(key.c_str()+pos+1, 0, 0), "", 0 });
+      }
+   }
+   else
+   {
+      cDbStatement selectRecorded(sfDb);
+
+      selectRecorded.build("select ");
+      selectRecorded.bind("ADDRESS", cDBS::bndOut);
+      selectRecorded.bind("TYPE", cDBS::bndOut, ", ");
+      selectRecorded.build(" from %s where %s = 'A'", sfDb->TableName(), sfDb->getField("RECORD")->getDbName());
+
+      if (selectRecorded.prepare() != success)
+         return fail;
+
+      for (int f = selectRecorded.find(); f; f = selectRecorded.fetch())
+         sensors.push_back(new ExportSensor { sfDb->getStrValue("TYPE"), (uint)sfDb->getIntValue("ADDRESS"), "", 0 });
+
+      selectRecorded.freeResult();
+   }
+
+   for (auto sensor : sensors)
+   {
+      char* key {nullptr};
+      asprintf(&key, "%s:0x%02x", sensor->type.c_str(), sensor->address);
+      sensor->key = key;
+      free(key);
+
+      auto it = checkpoints.find(sensor->key);
+      sensor->from = it != checkpoints.end() ? std::max(it->second, exportFrom) : exportFrom;
+   }
+
+   // the output
+
+   if (isEmpty(file) || strcmp(file, "-") == 0)
+      exportFp = stdout;
+   else
+      exportFp = fopen(file, append ? "a" : "w");
+
+   if (!exportFp)
+   {
+      tell(eloAlways, "Error: Can't open file '%s' for writing, error was '%s'", file, strerror(errno));
+      return fail;
+   }
+
+   // drop what was written behind the checkpoint
+
+   if (append && exportFp != stdout && checkpointOffset != na)
+   {
+      if (ftruncate(fileno(exportFp), checkpointOffset) != 0)
+      {
+         tell(eloAlways, "Error: Can't truncate '%s' to the checkpoint, error was '%s'", file, strerror(errno));
+         fclose(exportFp);
+         return fail;
+      }
+
+      tell(eloAlways, "Truncated '%s' to %ld bytes of the checkpoint", file, (long)checkpointOffset);
+   }
+
+   setvbuf(exportFp, 0, _IOFBF, 1024*1024);
+
+   if (!append && exportFormat == efCsv)
+      fputs("type,address,time,aggregate,value,text,samples\n", exportFp);
+   else if (!append && exportFormat == efBinary)
+   {
+      uint32_t version = 1;
+      fwrite("P4EX", 1, 4, exportFp);
+      fwrite(&version, sizeof(version), 1, exportFp);
+   }
+
+   // export in the background of the daemon, each worker has its own connection
+
+   setpriority(PRIO_PROCESS, 0, 19);
+   syscall(SYS_ioprio_set, 1, 0, 7 | (3 << 13));   // idle class, inherited by the workers
+
+   tell(eloAlways, "Exporting %zu sensors from '%s' to '%s' by %d worker",
+        sensors.size(), l2pTime(exportFrom).c_str(), l2pTime(exportTo).c_str(), exportJobs);
+
+   cDbPool pool(exportJobs);
+   pool.start();
+
+   for (auto sensor : sensors)
+   {
+      exportPending++;
+
+      // the pool executes each job, also if the worker can't connect
+
+      int status = pool.post([sensor](cDbWorker* worker)
+      {
+         int status = exportSensor(worker, sensor);
+
+         if (status != success)
+            exportFailed++;
+
+         exportPending--;
+         return status;
+      });
+
+      if (status != success)
+      {
+         exportFailed++;
+         exportPending--;
+      }
+   }
+
+   while (exportPending > 0)
+      usleep(100000);
+
+   pool.stop();
+
+   if (exportFp != stdout)
+      fclose(exportFp);
+   else
+      fflush(exportFp);
+
+   for (auto sensor : sensors)
+      delete sensor;
+
+   double seconds = (usNow() - start) / 1000000;
+
+   tell(eloAlways, "Exported %ld rows in %.1f seconds (%.0f rows/s)%s", (long)exportedRows, seconds,
+        seconds > 0 ? exportedRows / seconds : 0, shutdown ? ", aborted" : "");
+
+   if (exportFailed)
+      tell(eloAlways, "Error: Export of %d sensor(s) failed", (int)exportFailed);
+
+   return shutdown || exportFailed ? fail : success;
+}
+
 //***************************************************************************
 // Main
 //***************************************************************************
@@ -366,9 +942,41 @@ int main(int argc, char** argv)
          case 'F': if (argv[i+1]) filter = argv[++i];          break;
          case 'i': if (argv[i+1]) intervall = atoi(argv[++i]); break;
          case 't': logstdout = yes;                            break;
+         case 's': if (argv[i+1]) exportSensors = argv[++i];   break;
+         case 'c': if (argv[i+1]) checkpointFile = argv[++i];  break;
+         case 'j': if (argv[i+1]) exportJobs = std::max(atoi(argv[++i]), 1); break;
+         case 'b': if (argv[i+1]) exportFrom = parseTime(argv[++i]); break;
+         case 'e': if (argv[i+1]) exportTo = parseTime(argv[++i]);   break;
+         case 'x':
+         {
+            if (!argv[i+1])
+               break;
+
+            i++;
+
+            if (strcmp(argv[i], "csv") == 0)
+               exportFormat = efCsv;
+            else if (strcmp(argv[i], "ndjson") == 0)
+               exportFormat = efNdJson;
+            else if (strcmp(argv[i], "bin") == 0)
+               exportFormat = efBinary;
+            else
+            {
+               printf("Unknown export format '%s'\n", argv[i]);
+               return 1;
+            }
+
+            break;
+         }
       }
    }
 
+   if (exportFrom == na || exportTo == na)
+   {
+      printf("Invalid time range, expected 'YYYY-MM-DD[ HH:MM[:SS]]' or unix time\n");
+      return 1;
+   }
+
    // init database connection
 
    if (initDb() != success)
@@ -379,12 +987,17 @@ int main(int argc, char** argv)
    ::signal(SIGINT, downF);
    ::signal(SIGTERM, downF);
 
-   actualAscii(file);
+   int result {0};
+
+   if (exportFormat != efNone)
+      result = exportData(file) == success ? 0 : 1;
+   else
+      actualAscii(file);
 
    // exit
 
    exitDb();
    cDbConnection::exit();
 
-   return 0;
+   return result;
 }
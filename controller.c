@@ -0,0 +1,260 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File controller.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 04.11.2010 - 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#include "controller.h"
+
+//***************************************************************************
+// Class P4Controller
+//***************************************************************************
+
+P4Controller::P4Controller(uint aId)
+   : cThread("p4-controller")
+{
+   id = aId;
+
+   SetDescription("p4-controller-%u", id);
+
+   sem = new Sem(0x3da00001 + id);
+   serial = new Serial;
+   request = new P4Request(serial);
+}
+
+P4Controller::~P4Controller()
+{
+   stop();
+
+   delete request;
+   delete serial;
+   delete sem;
+}
+
+int P4Controller::stop()
+{
+   Cancel(5);
+
+   return done;
+}
+
+void P4Controller::setDevice(const char* aDevice)
+{
+   cMyMutexLock lock(&mutex);
+   device = aDevice;
+}
+
+//***************************************************************************
+// Get State
+//   a copy of the state polled by the last cycle (if requested)
+//***************************************************************************
+
+int P4Controller::getState(Fs::Status* aState)
+{
+   cMyMutexLock lock(&mutex);
+
+   if (stateStatus != success)
+      return fail;
+
+   copyState(aState, &state);
+
+   return success;
+}
+
+void P4Controller::copyState(Fs::Status* to, const Fs::Status* from)
+{
+   to->time = from->time;
+   to->mode = from->mode;
+   to->state = from->state;
+   free(to->modeinfo);  to->modeinfo = strdup(from->modeinfo);
+   free(to->stateinfo); to->stateinfo = strdup(from->stateinfo);
+   sstrcpy(to->version, from->version, sizeof(to->version));
+}
+
+//***************************************************************************
+// Open / Close
+//***************************************************************************
+
+int P4Controller::open()
+{
+   std::string dev;
+
+   {
+      cMyMutexLock lock(&mutex);
+      dev = device;
+   }
+
+   sem->p();
+   int status = serial->open(dev.c_str());
+   sem->v();
+
+   return status;
+}
+
+int P4Controller::close()
+{
+   sem->p();
+   serial->close();
+   sem->v();
+
+   return done;
+}
+
+//***************************************************************************
+// Start Cycle
+//   hand over the values to poll, fail if the last cycle is still running
+//***************************************************************************
+
+int P4Controller::startCycle(std::vector<Item>& aItems, bool aWithState)
+{
+   cMyMutexLock lock(&mutex);
+
+   if (cyclePending)
+   {
+      tell(eloAlways, "Warning: Controller %u still busy with the last cycle", id);
+      cycleExpected = 0;
+      return fail;
+   }
+
+   items.swap(aItems);
+   withState = aWithState;
+   cyclePending = true;
+   cycleExpected = ++cycleCount;
+   waitCondition.Broadcast();
+
+   return success;
+}
+
+//***************************************************************************
+// Wait Cycle
+//   take back the polled values, fail on timeout or if the S-3200 don't answer,
+//   the values of a timed out cycle arrive late and are dropped by its number
+//***************************************************************************
+
+int P4Controller::waitCycle(std::vector<Item>& aItems, int timeoutMs)
+{
+   cMyMutexLock lock(&mutex);
+
+   if (!cycleExpected)
+      return fail;                      // the start of this cycle failed
+
+   cMyTimeMs timer(timeoutMs);
+
+   while (cyclePolled != cycleExpected && Running() && !timer.TimedOut())
+      cycleDone.TimedWait(mutex, 100);
+
+   if (cyclePolled != cycleExpected)
+   {
+      tell(eloAlways, "Error: Timeout waiting for controller %u", id);
+      cycleExpected = 0;
+      return fail;
+   }
+
+   cycleExpected = 0;
+   aItems.swap(items);
+   items.clear();
+
+   return cycleStatus;
+}
+
+//***************************************************************************
+// Action
+//***************************************************************************
+
+void P4Controller::action()
+{
+   cMyMutexLock lock(&mutex);
+
+   while (Running())
+   {
+      if (!cyclePending)
+      {
+         waitCondition.TimedWait(mutex, 1000);
+         continue;
+      }
+
+      // the items are not touched by the daemon while the cycle is pending
+
+      ulong cycle = cycleCount;
+      std::string pollDevice = device;
+
+      mutex.Unlock();
+      int status = poll(pollDevice);
+      mutex.Lock();
+
+      cycleStatus = status;
+      cyclePolled = cycle;
+      cyclePending = false;
+      cycleDone.Broadcast();
+   }
+}
+
+//***************************************************************************
+// Poll
+//***************************************************************************
+
+int P4Controller::poll(const std::string& pollDevice)
+{
+   cMetricTimer timer("controller_poll_seconds", pollDevice.c_str());
+
+   sem->p();
+
+   // check serial connection
+
+   if (request->check() != success)
+   {
+      serial->close();
+      tell(eloAlways, "Error reading serial interface '%s', reopen now", pollDevice.c_str());
+      serial->open(pollDevice.c_str());
+
+      if (request->check() != success)
+      {
+         sem->v();
+         return fail;
+      }
+   }
+
+   for (auto& item : items)
+   {
+      if (item.type == "VA")
+      {
+         Fs::Value v(deviceAddressOf(item.key));
+
+         if ((item.status = request->getValue(&v)) == success)
+            item.value = v.value;
+      }
+      else
+      {
+         Fs::IoValue v(deviceAddressOf(item.key));
+
+         if (item.type == "DO")
+            item.status = request->getDigitalOut(&v);
+         else if (item.type == "DI")
+            item.status = request->getDigitalIn(&v);
+         else if (item.type == "AO")
+            item.status = request->getAnalogOut(&v);
+
+         if (item.status == success)
+            item.value = v.state;
+      }
+   }
+
+   Fs::Status polled;
+   int polledStatus = withState ? request->getStatus(&polled) : fail;
+
+   sem->v();
+
+   // the state is read by the daemon, set it under the mutex
+
+   if (withState)
+   {
+      cMyMutexLock lock(&mutex);
+
+      if ((stateStatus = polledStatus) == success)
+         copyState(&state, &polled);
+   }
+
+   return success;
+}
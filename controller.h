@@ -0,0 +1,86 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File controller.h
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 04.11.2010 - 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "lib/thread.h"
+#include "p4io.h"
+
+//***************************************************************************
+// Class P4Controller
+//   one S-3200 of a cascade with its own serial line, the values are polled
+//   by the thread of the controller -> all controllers in parallel.
+//   The sensors of controller n are stored with address (n << 16 | address),
+//   the first controller therefore keeps the plain addresses
+//***************************************************************************
+
+class P4Controller : public cThread
+{
+   public:
+
+      struct Item                   // one value to poll
+      {
+         std::string type;          // VA, DO, DI or AO
+         uint key {0};              // address of the sensor (with controller)
+         int dataType {0};          // SUBTYPE of the VA value fact
+         int status {fail};
+         int value {0};             // raw value or state
+      };
+
+      P4Controller(uint aId);
+      virtual ~P4Controller();
+
+      int open();
+      int close();
+      int stop();
+
+      uint getId() const                 { return id; }
+      const char* getDevice() const      { return device.c_str(); }
+      void setDevice(const char* aDevice);
+
+      Serial* getSerial()                { return serial; }
+      P4Request* getRequest()            { return request; }
+      Sem* getSem()                      { return sem; }
+      int getState(Fs::Status* aState);
+
+      int startCycle(std::vector<Item>& aItems, bool aWithState);
+      int waitCycle(std::vector<Item>& aItems, int timeoutMs);
+
+      static uint toAddress(uint id, word address)  { return id << 16 | address; }
+      static uint controllerOf(uint address)        { return address >> 16; }
+      static word deviceAddressOf(uint address)     { return address & 0xffff; }
+
+   protected:
+
+      void action() override;
+      int poll(const std::string& pollDevice);
+
+      static void copyState(Fs::Status* to, const Fs::Status* from);
+
+      uint id {0};
+      std::string device;           // set by the daemon, copied for each cycle
+      Sem* sem {nullptr};
+      Serial* serial {nullptr};
+      P4Request* request {nullptr};
+
+      // protected by cThread::mutex
+
+      std::vector<Item> items;
+      bool withState {false};
+      bool cyclePending {false};
+      ulong cycleCount {0};         // number of the last started cycle
+      ulong cycleExpected {0};      // cycle waitCycle() takes the values of, 0 if none
+      ulong cyclePolled {0};        // cycle of the values in items
+      int cycleStatus {success};
+      int stateStatus {fail};
+      Fs::Status state;
+      cCondVar cycleDone;
+};
@@ -168,17 +168,15 @@ Daemon::DefaultWidgetProperty* Daemon::getDefalutProperty(const char* type, cons
 // Widget Defaults 2 Json
 //***************************************************************************
 
-int Daemon::widgetDefaults2Json(json_t* jDefaults, const char* type, const char* unit, const char* name, int address)
+static void widgetSymbols(const char* type, const std::string& unit,
+                          const char*& symbol, const char*& symbolOn, const char*& color, const char*& colorOn)
 {
-   std::string result;
-   DefaultWidgetProperty* defProperty = getDefalutProperty(type, unit, address);
-
-   const char* color {"rgb(255, 255, 255)"};
-   const char* colorOn {"rgb(235, 197, 5)"};
-   const char* symbol {""};
-   const char* symbolOn {""};
+   color = "rgb(255, 255, 255)";
+   colorOn = "rgb(235, 197, 5)";
+   symbol = "";
+   symbolOn = "";
 
-   if (defProperty->unit == "mov")
+   if (unit == "mov")
    {
       symbol = "mdi:mdi-walk";
    }
@@ -196,6 +194,14 @@ int Daemon::widgetDefaults2Json(json_t* jDefaults, const char* type, const char*
       color = "rgb(255, 255, 255)";
       colorOn = "rgb(235, 197, 5)";
    }
+}
+
+int Daemon::widgetDefaults2Json(json_t* jDefaults, const char* type, const char* unit, const char* name, int address)
+{
+   DefaultWidgetProperty* defProperty = getDefalutProperty(type, unit, address);
+   const char *symbol, *symbolOn, *color, *colorOn;
+
+   widgetSymbols(type, defProperty->unit, symbol, symbolOn, color, colorOn);
 
    json_object_set_new(jDefaults, "widgettype", json_integer(defProperty->widgetType));
    json_object_set_new(jDefaults, "unit", json_string(unit));
@@ -213,6 +219,29 @@ int Daemon::widgetDefaults2Json(json_t* jDefaults, const char* type, const char*
    return done;
 }
 
+int Daemon::widgetDefaults2Json(cJsonWriter* json, const char* type, const char* unit, const char* name, int address)
+{
+   DefaultWidgetProperty* defProperty = getDefalutProperty(type, unit, address);
+   const char *symbol, *symbolOn, *color, *colorOn;
+
+   widgetSymbols(type, defProperty->unit, symbol, symbolOn, color, colorOn);
+
+   json->add("widgettype", defProperty->widgetType);
+   json->add("unit", unit);
+   json->add("scalemax", defProperty->maxScale);
+   json->add("scalemin", defProperty->minScale);
+   json->add("scalestep", defProperty->scaleStep);
+   json->add("showpeak", defProperty->showPeak);
+   json->add("imgon", getImageFor(type, name, unit, true));
+   json->add("imgoff", getImageFor(type, name, unit, false));
+   json->add("symbol", symbol);
+   json->add("symbolOn", symbolOn);
+   json->add("color", color);
+   json->add("colorOn", colorOn);
+
+   return done;
+}
+
 //***************************************************************************
 // Get Image For
 //***************************************************************************
@@ -275,7 +304,11 @@ Daemon::~Daemon()
 
    delete webSock;
 
+   for (auto& f : logFollowers)
+      delete f.second;
+
    free(mailScript);
+   free(w1Resolution);
    free(stateMailTo);
    free(errorMailTo);
 
@@ -295,12 +328,131 @@ int Daemon::pushInMessage(const char* data)
    return success;
 }
 
+//***************************************************************************
+// Post Async
+//   the job is executed by a db worker in its own thread and connection,
+//   the result is queued and pushed to the client by dispatchAsyncResults(),
+//   onPushed (if given) is called by the main thread afterwards
+//***************************************************************************
+
+int Daemon::postAsync(const char* event, long client, AsyncJob job, AsyncDone onPushed)
+{
+   if (!dbPool)
+      return fail;
+
+   std::string ev = event;
+
+   return dbPool->post([this, ev, client, job, onPushed](cDbWorker* worker) -> int
+   {
+      json_t* oJson = job(worker);
+
+      if (!oJson)
+         return asyncFailed(worker, client, ev);
+
+      cMyMutexLock lock(&asyncResultsMutex);
+      asyncResults.push({client, ev, oJson, "", onPushed});
+
+      return success;
+   });
+}
+
+//***************************************************************************
+// Post Async Json
+//   like postAsync() but the job streams the 'object' of the message
+//   with the writer, the serialized message is passed as it is to the WS
+//***************************************************************************
+
+int Daemon::postAsyncJson(const char* event, long client, AsyncJsonJob job)
+{
+   if (!dbPool)
+      return fail;
+
+   std::string ev = event;
+
+   return dbPool->post([this, ev, client, job](cDbWorker* worker) -> int
+   {
+      cJsonWriter json(cWebSock::sizeLwsPreFrame);
+
+      beginMessage(&json, ev.c_str());
+
+      if (job(worker, &json) != success || !json.endObject().isComplete())
+         return asyncFailed(worker, client, ev);
+
+      cMyMutexLock lock(&asyncResultsMutex);
+      asyncResults.push({client, ev, nullptr, std::move(json.buffer())});
+
+      return success;
+   });
+}
+
+//***************************************************************************
+// Async Failed
+//   called by the worker, the client gets a error 'result' instead of
+//   the requested event (a HTTP data request a error status)
+//***************************************************************************
+
+int Daemon::asyncFailed(cDbWorker* worker, long client, const std::string& event)
+{
+   const char* error = worker->getConnection() ? "request failed" : "database not available";
+
+   tell(eloAlways, "Error: Async request '%s' failed, %s", event.c_str(), error);
+
+   cMyMutexLock lock(&asyncResultsMutex);
+   asyncResults.push({client, event, nullptr, "", nullptr, error});
+
+   return fail;
+}
+
+int Daemon::dispatchAsyncResults()
+{
+   cMyMutexLock lock(&asyncResultsMutex);
+
+   while (!asyncResults.empty())
+   {
+      AsyncResult& result = asyncResults.front();
+
+      // the client may be gone meanwhile
+
+      if (wsClients.find((void*)result.client) == wsClients.end() && !webSock->isHttpRequest((lws*)result.client))
+         json_decref(result.oJson);
+      else if (!result.error.empty())
+      {
+         if (!webSock->failHttpRequest((lws*)result.client, result.error.c_str()))
+         {
+            json_t* oJson = json_object();
+            json_object_set_new(oJson, "status", json_integer(fail));
+            json_object_set_new(oJson, "message", json_string(result.error.c_str()));
+            pushOutMessage(oJson, "result", result.client);
+         }
+      }
+      else
+      {
+         if (result.oJson)
+            pushOutMessage(result.oJson, result.event.c_str(), result.client);
+         else
+         {
+            webSock->pushOutFrame(std::move(result.frame), (lws*)result.client, result.event.c_str());
+            webSock->performData(cWebSock::mtData);
+         }
+
+         if (result.onPushed)
+            result.onPushed();
+      }
+
+      asyncResults.pop();
+   }
+
+   return done;
+}
+
 //***************************************************************************
 // Push Out Message (from daemon to WS)
 //***************************************************************************
 
 int Daemon::pushOutMessage(json_t* oContents, const char* event, long client)
 {
+   cMetricTimer timer("loop_phase_seconds", "wsFanOut");
+
    json_t* obj = json_object();
 
    addToJson(obj, "event", event);
@@ -315,7 +467,7 @@ int Daemon::pushOutMessage(json_t* oContents, const char* event, long client)
       return fail;
    }
 
-   webSock->pushOutMessage(p, (lws*)client);
+   webSock->pushOutMessage(p, (lws*)client, event);
    free(p);
 
    webSock->performData(cWebSock::mtData);
@@ -323,32 +475,67 @@ int Daemon::pushOutMessage(json_t* oContents, const char* event, long client)
    return done;
 }
 
+//***************************************************************************
+// Push Out Message - streamed by the writer
+//   the writer has to be created with cWebSock::sizeLwsPreFrame and the
+//   message started by beginMessage(), the buffer is taken over by the WS
+//***************************************************************************
+
+cJsonWriter& Daemon::beginMessage(cJsonWriter* json, const char* event)
+{
+   return json->beginObject().add("event", event).key("object");
+}
+
+int Daemon::pushOutMessage(cJsonWriter* json, const char* event, long client)
+{
+   cMetricTimer timer("loop_phase_seconds", "wsFanOut");
+
+   if (!json->endObject().isComplete())
+   {
+      tell(eloAlways, "Error: Incomplete json message for event '%s'", event);
+      return fail;
+   }
+
+   webSock->pushOutFrame(std::move(json->buffer()), (lws*)client, event);
+   json->clear();
+
+   webSock->performData(cWebSock::mtData);
+
+   return done;
+}
+
 int Daemon::pushDataUpdate(const char* event, long client)
 {
-   // push all in the jsonSensorList to the 'interested' clients
+   // push all in the jsonSensorList to the 'interested' clients,
+   //   'update' only with the sensors the client subscribed to
+
+   bool filter = strcmp(event, "update") == 0;
+
+   // keep the snapshot of the HTTP data api up to date
 
-   if (client)
+   for (auto& sj : jsonSensorList)
+      webSock->setSensorSnapshot(sj.first.c_str(), sj.second);
+
+   for (const auto& cl : wsClients)
    {
-      auto cl = wsClients[(void*)client];
+      if (client && (long)cl.first != client)
+         continue;
 
       json_t* oJson = json_object();
 
       for (auto& sj : jsonSensorList)
-         json_object_set(oJson, sj.first.c_str(), sj.second);
-
-      pushOutMessage(oJson, event, client);
-   }
-   else
-   {
-      for (const auto& cl : wsClients)
       {
-         json_t* oJson = json_object();
-
-         for (auto& sj : jsonSensorList)
+         if (!filter || cl.second.isSubscribed(sj.first))
             json_object_set(oJson, sj.first.c_str(), sj.second);
+      }
 
-         pushOutMessage(oJson, event, (long)cl.first);
+      if (filter && !json_object_size(oJson))
+      {
+         json_decref(oJson);
+         continue;
       }
+
+      pushOutMessage(oJson, event, (long)cl.first);
    }
 
    // cleanup
@@ -375,6 +562,9 @@ int Daemon::init()
 
    initLocale();
 
+   cMetrics::describe("loop_phase_seconds", "phase", "Duration of the phases of the main loop");
+   cMetrics::describe("db_statement_seconds", "statement", "Execution time of the prepared statements");
+
    // initialize the dictionary
 
    char* dictPath {nullptr};
@@ -395,6 +585,11 @@ int Daemon::init()
       return status;
    }
 
+   // shared HTTP client (deCONZ, openweathermap, ...)
+
+   cCurl::create();
+   httpClient.start();
+
    deconz.init(this, connection);
 
    // ---------------------------------
@@ -457,7 +652,7 @@ int Daemon::init()
       if (mqttCheckConnection() == success && !isEmpty(mqttUrl))
       {
          const char* request = "{ \"method\" : \"listDevices\" }";
-         mqttWriter->write(TARGET "2mqtt/homematic/rpccall", request);
+         mqttClient->write(TARGET "2mqtt/homematic/rpccall", request);
          tell(eloHomeMatic, "-> (home-matic) '%s' to '%s'", TARGET "2mqtt/homematic/rpccall", request);
       }
       else
@@ -468,13 +663,25 @@ int Daemon::init()
 
    // init web socket ...
 
+   webSock->setCompression(webCompression, webCompressionMemLevel, webCompressionWindowBits);
+   webSock->setDataApi(webDataApi);
+   webSock->setMetricsApi(webMetricsApi);
+
    while (webSock->init(webPort, webSocketPingTime, confDir, webSsl) != success)
    {
       tell(eloAlways, "Retrying in 2 seconds");
       sleep(2);
    }
 
+   // worker for the (read only) database requests of the web interface
+
+   dbPool = new cDbPool(dbWorkers);
+   dbPool->start();
+   verifySchema();
+
    initArduino();
+   initW1Reader();
+   initMqttRoutes();
    performMqttRequests();
    initScripts();
    loadStates();           // load states of outputs on last exit
@@ -536,8 +743,27 @@ int Daemon::exit()
    for (auto it = sensors["DO"].begin(); it != sensors["DO"].end(); ++it)
       gpioWrite(it->first, false, false);
 
+   httpClient.stop();
    deconz.exit();
+   cCurl::destroy();
    mqttDisconnect();
+
+   delete w1Reader;
+   w1Reader = nullptr;
+
+   delete dbPool;
+   dbPool = nullptr;
+
+   {
+      cMyMutexLock lock(&asyncResultsMutex);
+
+      while (!asyncResults.empty())
+      {
+         json_decref(asyncResults.front().oJson);
+         asyncResults.pop();
+      }
+   }
+
    exitDb();
 
    return success;
@@ -657,6 +883,7 @@ int Daemon::initScripts()
                   tableValueFacts->getField("TYPE")->getDbName());
          tableValueFacts->deleteWhere("%s", stmt);
          free(stmt);
+         invalidateInitPayload("valuefacts");
          tell(eloAlways, "Removed valuefact 'SC/%ld'", tableValueFacts->getIntValue("ADDRESS"));
       }
    }
@@ -953,49 +1180,46 @@ int Daemon::initDb()
          return fail;
       }
 
-      tell(eloDb, "Checking table structure and indices ...");
+      // skip the (slow) structure check if dictionary and version are unchanged,
+      //   the full check is done in background by a db worker
 
-      for (auto t = dbDict.getFirstTableIterator(); t != dbDict.getTableEndIterator(); t++)
-      {
-         cDbTable* table = new cDbTable(connection, t->first.c_str());
+      std::string fingerprint = schemaFingerprint();
 
-         if (strstr(table->TableName(), "information_schema"))
-         {
-            tell(eloAlways, "Skipping check of table '%s'", t->first.c_str());
-            continue;
-         }
+      if (!fingerprint.empty() && fingerprint == readSchemaFingerprint(connection))
+      {
+         tell(eloAlways, "Database schema unchanged, skipping structure check");
+         connection->detachConnection();
+         verifySchema();         // on reconnect, at startup the pool isn't up yet
+      }
+      else
+      {
+         tell(eloDb, "Checking table structure and indices ...");
 
-         tell(eloDb, "Checking table '%s'", t->first.c_str());
+         status = checkTables(connection);
 
-         if (!table->exist())
+         if (status == success)
          {
-            if ((status += table->createTable()) != success)
-               continue;
+            storeSchemaFingerprint(connection, fingerprint.c_str());
+            schemaChecked = true;
          }
-         else
-         {
-            status += table->validateStructure();
-         }
-
-         status += table->createIndices();
 
-         delete table;
-      }
+         connection->detachConnection();
 
-      connection->detachConnection();
+         if (status != success)
+            return abrt;
 
-      if (status != success)
-         return abrt;
-
-      tell(eloDb, "Checking table structure and indices succeeded");
+         tell(eloDb, "Checking table structure and indices succeeded");
+      }
    }
 
    // ------------------------
    // create/open tables
    // ------------------------
 
+#ifndef USESQLITE
    tableTableStatistics = new cDbTable(connection, "information_schema.TABLES", true /*read-only*/);
    if (tableTableStatistics->open() != success) return fail;
+#endif
 
    tableValueFacts = new cDbTable(connection, "valuefacts");
    if (tableValueFacts->open() != success) return fail;
@@ -1006,6 +1230,9 @@ int Daemon::initDb()
    tableSamples = new cDbTable(connection, "samples");
    if (tableSamples->open() != success) return fail;
 
+   tableSampleArchive = new cDbTable(connection, "samplearchive");
+   if (tableSampleArchive->open() != success) return fail;
+
    tablePeaks = new cDbTable(connection, "peaks");
    if (tablePeaks->open() != success) return fail;
 
@@ -1038,6 +1265,7 @@ int Daemon::initDb()
 
    // prepare statements
 
+#ifndef USESQLITE
    selectTableStatistic = new cDbStatement(tableTableStatistics);
 
    selectTableStatistic->build("select ");
@@ -1047,6 +1275,7 @@ int Daemon::initDb()
    selectTableStatistic->build(" order by (data_length + index_length) desc");
 
    status += selectTableStatistic->prepare();
+#endif
 
    // ------------------
 
@@ -1135,55 +1364,6 @@ int Daemon::initDb()
 
    status += selectMaxTime->prepare();
 
-   // ------------------
-   // select samples for chart data
-   // ein sample avg / 5 Minuten
-
-   rangeFrom.setField(&rangeFromDef);
-   rangeTo.setField(&rangeToDef);
-   xmlTime.setField(&xmlTimeDef);
-   avgValue.setField(&avgValueDef);
-   maxValue.setField(&maxValueDef);
-   selectSamplesRange = new cDbStatement(tableSamples);
-
-   selectSamplesRange->build("select ");
-   selectSamplesRange->bind("ADDRESS", cDBS::bndOut);
-   selectSamplesRange->bind("TYPE", cDBS::bndOut, ", ");
-   selectSamplesRange->bindTextFree("date_format(time, '%Y-%m-%dT%H:%i')", &xmlTime, ", ", cDBS::bndOut);
-   selectSamplesRange->bindTextFree("avg(value)", &avgValue, ", ", cDBS::bndOut);
-   selectSamplesRange->bindTextFree("max(value)", &maxValue, ", ", cDBS::bndOut);
-   selectSamplesRange->build(" from %s where ", tableSamples->TableName());
-   selectSamplesRange->bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
-   selectSamplesRange->bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
-   selectSamplesRange->bindCmp(0, "TIME", &rangeFrom, ">=", " and ");
-   selectSamplesRange->bindCmp(0, "TIME", &rangeTo, "<=", " and ");
-   selectSamplesRange->build(" group by date(time), ((60/5) * hour(time) + floor(minute(time)/5))");
-   selectSamplesRange->build(" order by time");
-
-   status += selectSamplesRange->prepare();
-
-   // ------------------
-   // select samples for chart data (for dashboard widget and rage > 15)
-   // ein sample avg / 60 Minuten
-
-   selectSamplesRange60 = new cDbStatement(tableSamples);
-
-   selectSamplesRange60->build("select ");
-   selectSamplesRange60->bind("ADDRESS", cDBS::bndOut);
-   selectSamplesRange60->bind("TYPE", cDBS::bndOut, ", ");
-   selectSamplesRange60->bindTextFree("date_format(time, '%Y-%m-%dT%H:%i')", &xmlTime, ", ", cDBS::bndOut);
-   selectSamplesRange60->bindTextFree("avg(value)", &avgValue, ", ", cDBS::bndOut);
-   selectSamplesRange60->bindTextFree("max(value)", &maxValue, ", ", cDBS::bndOut);
-   selectSamplesRange60->build(" from %s where ", tableSamples->TableName());
-   selectSamplesRange60->bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
-   selectSamplesRange60->bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
-   selectSamplesRange60->bindCmp(0, "TIME", &rangeFrom, ">=", " and ");
-   selectSamplesRange60->bindCmp(0, "TIME", &rangeTo, "<=", " and ");
-   selectSamplesRange60->build(" group by date(time), ((60/60) * hour(time) + floor(minute(time)/60))");
-   selectSamplesRange60->build(" order by time");
-
-   status += selectSamplesRange60->prepare();
-
    // ------------------
    // select all scripts
 
@@ -1317,7 +1497,7 @@ int Daemon::initDb()
    {
       if (!gCount)
       {
-         connection->query("insert into groups set name='Heizung'");
+         connection->query("insert into groups (name) values ('Heizung')");
          connection->query("update valuefacts set groupid = 1 where groupid is null or groupid = 0");
       }
    }
@@ -1412,13 +1592,21 @@ int Daemon::initDb()
       tableDashboards->store();
    }
 
+   // (re)connected, the cached init payloads may be outdated
+
+   for (const auto& payload : initPayloads)
+      invalidateInitPayload(payload.first.c_str());
+
    return status;
 }
 
 int Daemon::exitDb()
 {
+   flushConfigItems(true);
+
    delete tableTableStatistics;    tableTableStatistics = nullptr;
    delete tableSamples;            tableSamples = nullptr;
+   delete tableSampleArchive;      tableSampleArchive = nullptr;
    delete tablePeaks;              tablePeaks = nullptr;
    delete tableValueFacts;         tableValueFacts = nullptr;
    delete tableValueTypes;         tableValueTypes = nullptr;
@@ -1441,8 +1629,6 @@ int Daemon::exitDb()
    delete selectAllConfig;         selectAllConfig = nullptr;
    delete selectAllUser;           selectAllUser = nullptr;
    delete selectMaxTime;           selectMaxTime = nullptr;
-   delete selectSamplesRange;      selectSamplesRange = nullptr;
-   delete selectSamplesRange60;    selectSamplesRange60 = nullptr;
    delete selectSampleInRange;     selectSampleInRange = nullptr;
    delete selectScriptByPath;      selectScriptByPath = nullptr;
    delete selectScripts;           selectScripts = nullptr;
@@ -1460,6 +1646,139 @@ int Daemon::exitDb()
    return done;
 }
 
+//***************************************************************************
+// Check Tables - create/alter tables and indices
+//***************************************************************************
+
+int Daemon::checkTables(cDbConnection* conn)
+{
+   int status {success};
+
+   for (auto t = dbDict.getFirstTableIterator(); t != dbDict.getTableEndIterator(); t++)
+   {
+      cDbTable* table = new cDbTable(conn, t->first.c_str());
+
+      if (strstr(table->TableName(), "information_schema"))
+      {
+         tell(eloAlways, "Skipping check of table '%s'", t->first.c_str());
+         delete table;
+         continue;
+      }
+
+      tell(eloDb, "Checking table '%s'", t->first.c_str());
+
+      if (!table->exist())
+      {
+         if ((status += table->createTable()) != success)
+         {
+            delete table;
+            continue;
+         }
+      }
+      else
+      {
+         status += table->validateStructure();
+      }
+
+      status += table->createIndices();
+
+      delete table;
+   }
+
+   return status;
+}
+
+//***************************************************************************
+// Schema Fingerprint
+//   md5 of the dictionary plus the program version, stored in the config
+//   table of the database it was checked against
+//***************************************************************************
+
+std::string Daemon::schemaFingerprint()
+{
+   md5Buf md5 {};
+
+   if (createMd5OfFile(confDir, "database.dat", md5) != success)
+      return "";
+
+   return std::string(md5) + ":" + VERSION;
+}
+
+std::string Daemon::readSchemaFingerprint(cDbConnection* conn)
+{
+   std::string fingerprint;
+   cDbTable config(conn, "config");
+
+   if (config.exist() && config.open() == success)
+   {
+      config.clear();
+      config.setValue("OWNER", myName());
+      config.setValue("NAME", "schemaFingerprint");
+
+      if (config.find())
+         fingerprint = config.getStrValue("VALUE");
+
+      config.close();
+   }
+
+   return fingerprint;
+}
+
+int Daemon::storeSchemaFingerprint(cDbConnection* conn, const char* fingerprint)
+{
+   cDbTable config(conn, "config");
+
+   if (config.open() != success)
+      return fail;
+
+   config.clear();
+   config.setValue("OWNER", myName());
+   config.setValue("NAME", "schemaFingerprint");
+   config.setValue("VALUE", fingerprint);
+   config.store();
+   config.close();
+
+   return success;
+}
+
+//***************************************************************************
+// Verify Schema
+//   full structure check by a db worker after a start with unchanged
+//   fingerprint, if it fails the fingerprint is dropped to force the
+//   check at the next start
+//***************************************************************************
+
+int Daemon::verifySchema()
+{
+   if (schemaChecked || !dbPool)
+      return done;
+
+   schemaChecked = true;
+
+   return dbPool->post([this](cDbWorker* worker) -> int
+   {
+      if (!worker->getConnection())
+      {
+         tell(eloAlways, "Error: Verify of table structure skipped, database not available");
+         schemaChecked = false;    // retry at the next connect
+         return fail;
+      }
+
+      tell(eloDb, "Verifying table structure and indices in background ...");
+
+      if (checkTables(worker->getConnection()) != success)
+      {
+         tell(eloAlways, "Error: Verify of table structure failed, forcing check at next start");
+         storeSchemaFingerprint(worker->getConnection(), "");
+         return fail;
+      }
+
+      tell(eloDb, "Verify of table structure and indices succeeded");
+
+      return success;
+   });
+}
+
 //***************************************************************************
 // Read Configuration
 //***************************************************************************
@@ -1489,6 +1808,11 @@ int Daemon::readConfiguration(bool initial)
    getConfigItem("webPort", webPort, webPort);
    getConfigItem("webUrl", webUrl);
    getConfigItem("webSsl", webSsl);
+   getConfigItem("webCompression", webCompression, webCompression);
+   getConfigItem("webCompressionMemLevel", webCompressionMemLevel, webCompressionMemLevel);
+   getConfigItem("webCompressionWindowBits", webCompressionWindowBits, webCompressionWindowBits);
+   getConfigItem("webDataApi", webDataApi, no);
+   getConfigItem("webMetricsApi", webMetricsApi, no);
    getConfigItem("iconSet", iconSet, "light");
 
    char* tmp {nullptr};
@@ -1518,6 +1842,10 @@ int Daemon::readConfiguration(bool initial)
 
    getConfigItem("aggregateInterval", aggregateInterval);
    getConfigItem("aggregateHistory", aggregateHistory);
+   getConfigItem("archiveAfter", archiveAfter);
+   getConfigItem("dbWorkers", dbWorkers, dbWorkers);
+   getConfigItem("w1Local", w1Local, false);
+   getConfigItem("w1Resolution", w1Resolution, "");
 
    // DECONZ
 
@@ -1541,6 +1869,11 @@ int Daemon::readConfiguration(bool initial)
    getConfigItem("latitude", latitude);
    getConfigItem("longitude", longitude);
 
+   // HTTP requests (deCONZ, OpenWeatherMap)
+
+   getConfigItem("httpProxy", httpProxy, "");
+   httpClient.setProxy(httpProxy);
+
    // OpenWeatherMap
 
    std::string apiKey = openWeatherApiKey ? openWeatherApiKey : "";
@@ -1641,6 +1974,11 @@ int Daemon::meanwhile()
    atMeanwhile();
 
    dispatchClientRequest();
+   dispatchAsyncResults();
+   flushConfigItems();
+   httpClient.dispatch();
+   performLogFollow();
+   dispatchW1Reader();
    dispatchDeconz();
    performMqttRequests();
    performJobs();
@@ -1677,8 +2015,12 @@ int Daemon::loop()
 
       standbyUntil();
 
-      if (doLoop() != success)
-         continue;
+      {
+         cMetricTimer timer("loop_phase_seconds", "doLoop");
+
+         if (doLoop() != success)
+            continue;
+      }
 
       // refresh expected?
 
@@ -1687,21 +2029,31 @@ int Daemon::loop()
 
       nextRefreshAt = time(0) + interval;
 
+      cMetricTimer cycleTimer("loop_phase_seconds", "cycle");
+
       // aggregate
 
-      if (aggregateHistory && nextAggregateAt <= time(0))
+      if ((aggregateHistory || archiveAfter) && nextAggregateAt <= time(0))
+      {
+         cMetricTimer timer("loop_phase_seconds", "aggregate");
          aggregate();
+      }
 
       // work
 
       updateWeather();
-      updateSensors();  // update some sensors for wich we get no trigger
+
+      {
+         cMetricTimer timer("loop_phase_seconds", "updateSensors");
+         updateSensors();  // update some sensors for wich we get no trigger
+      }
 
       performData(0L);
       updateScriptSensors();
       process();
       storeSamples();
       afterUpdate();
+      mqttPublishMetrics();
 
       initialRun = false;
    }
@@ -1715,6 +2067,7 @@ int Daemon::loop()
 
 int Daemon::storeSamples()
 {
+   cMetricTimer timer("loop_phase_seconds", "storeSamples");
    int count {0};
 
    lastSampleTime = time(0);
@@ -1874,6 +2227,8 @@ void Daemon::afterUpdate()
 
 void Daemon::sensorAlertCheck(time_t now)
 {
+   cMetricTimer timer("loop_phase_seconds", "alertCheck");
+
    tableSensorAlert->clear();
    tableSensorAlert->setValue("KIND", "M");
 
@@ -2239,7 +2594,7 @@ int Daemon::scheduleAggregate()
    struct tm tm = {0};
    time_t now {0};
 
-   if (!aggregateHistory)
+   if (!aggregateHistory && !archiveAfter)
    {
       tell(eloInfo, "NO aggregateHistory configured!");
       return done;
@@ -2278,6 +2633,26 @@ int Daemon::aggregate()
    time_t history = time(0) - (aggregateHistory * tmeSecondsPerDay);
    int aggCount {0};
 
+#ifdef USESQLITE
+   int interval = aggregateInterval * tmeSecondsPerMinute;
+
+   asprintf(&stmt,
+            "replace into samples "
+            "  select address, type, 'A' as aggregate, "
+            "    from_unixtime((unix_timestamp(time) / %d) * %d + %d) time, "
+            "    unix_timestamp(sysdate()) as inssp, unix_timestamp(sysdate()) as updsp, "
+            "    round(sum(value)/count(*), 2) as value, text, count(*) samples "
+            "  from "
+            "    samples "
+            "  where "
+            "    aggregate != 'A' and "
+            "    time <= from_unixtime(%ld) "
+            "  group by "
+            "    from_unixtime((unix_timestamp(time) / %d) * %d + %d), address, type;",
+            interval, interval, interval,
+            history,
+            interval, interval, interval);
+#else
    asprintf(&stmt,
             "replace into samples "
             "  select address, type, 'A' as aggregate, "
@@ -2294,10 +2669,11 @@ int Daemon::aggregate()
             aggregateInterval * tmeSecondsPerMinute, aggregateInterval * tmeSecondsPerMinute, aggregateInterval,
             history,
             aggregateInterval * tmeSecondsPerMinute, aggregateInterval * tmeSecondsPerMinute, aggregateInterval);
+#endif
 
    tell(eloAlways, "Starting aggregation ...");
 
-   if (connection->query(aggCount, "%s", stmt) == success)
+   if (aggregateHistory && connection->query(aggCount, "%s", stmt) == success)
    {
       tell(eloDebug, "Aggregation: [%s]", stmt);
       free(stmt);
@@ -2315,6 +2691,9 @@ int Daemon::aggregate()
 
    free(stmt);
 
+   if (archiveAfter)
+      archive();
+
    // schedule even in case of error!
 
    scheduleAggregate();
@@ -2322,6 +2701,151 @@ int Daemon::aggregate()
    return success;
 }
 
+//***************************************************************************
+// Archive
+//   pack the numeric samples of closed days into one gorilla compressed
+//   block per sensor and day, the archived rows are removed from 'samples'.
+//   Done by a db worker to keep the main loop responsive, each job packs up
+//   to maxDaysPerRun days and posts the next one for the rest
+//***************************************************************************
+
+int Daemon::archive()
+{
+   time_t until = midnightOf(time(0) - std::max(archiveAfter, aggregateHistory) * tmeSecondsPerDay);
+
+   if (!dbPool)
+      return fail;
+
+   tell(eloAlways, "Starting archive of samples before '%s' ...", l2pTime(until).c_str());
+
+   return dbPool->post([this, until](cDbWorker* worker) -> int
+   {
+      return archive(worker, until);
+   });
+}
+
+int Daemon::archive(cDbWorker* worker, time_t until)
+{
+   const int maxDaysPerRun {10};    // the rest is done by the next job
+   cDbConnection* db = worker->getConnection();
+   cDbTable* samples = worker->getTable("samples");
+   cDbTable* archiveTable = worker->getTable("samplearchive");
+   cDbValue minTime(&rangeFromDef);
+   cDbValue dayFrom(&rangeFromDef);
+   cDbValue dayTo(&rangeToDef);
+   int days {0};
+
+   if (!db || !samples || !archiveTable)
+   {
+      tell(eloAlways, "Error: Archive of samples skipped, %s", db ? "opening tables failed" : "database not available");
+      return fail;
+   }
+
+   cSampleArchive sampleArchive(archiveTable);
+
+   cDbStatement selectMinTime(samples);
+
+   selectMinTime.build("select ");
+   selectMinTime.bindTextFree("min(time)", &minTime, "", cDBS::bndOut);
+   selectMinTime.build(" from %s where value is not null and text is null", samples->TableName());
+
+   cDbStatement select(samples);
+
+   select.build("select ");
+   select.bind("ADDRESS", cDBS::bndOut);
+   select.bind("TYPE", cDBS::bndOut, ", ");
+   select.bind("TIME", cDBS::bndOut, ", ");
+   select.bind("VALUE", cDBS::bndOut, ", ");
+   select.build(" from %s where value is not null and text is null", samples->TableName());
+   select.bindCmp(0, "TIME", &dayFrom, ">=", " and ");
+   select.bindCmp(0, "TIME", &dayTo, "<", " and ");
+   select.build(" order by address, type, time");
+
+   if (selectMinTime.prepare() != success || select.prepare() != success)
+      return fail;
+
+   time_t first = selectMinTime.find() && !minTime.isNull() ? minTime.getTimeValue() : 0;
+   time_t day = midnightOf(first);
+   selectMinTime.freeResult();
+
+   for (; first && day < until && days < maxDaysPerRun; days++)
+   {
+      time_t nextDay = midnightOf(day + tmeSecondsPerDay + 2*tmeSecondsPerHour);  // DST safe
+      cGorillaEncoder encoder;
+      uint address {0};
+      std::string type;
+      int blocks {0};
+      int count {0};
+      int status {success};
+
+      dayFrom.setValue(day);
+      dayTo.setValue(nextDay);
+
+      db->startTransaction();
+
+      samples->clear();
+
+      for (int f = select.find(); f; f = select.fetch())
+      {
+         if (encoder.getCount() && (address != samples->getIntValue("ADDRESS") ||
+                                    type != samples->getStrValue("TYPE")))
+         {
+            if (sampleArchive.store(address, type.c_str(), day, &encoder) != success)
+               status = fail;
+
+            encoder.reset();
+            blocks++;
+         }
+
+         address = samples->getIntValue("ADDRESS");
+         type = samples->getStrValue("TYPE");
+
+         if (encoder.append(samples->getTimeValue("TIME"), samples->getFloatValue("VALUE")) == success)
+            count++;
+      }
+
+      select.freeResult();
+
+      if (encoder.getCount())
+      {
+         if (sampleArchive.store(address, type.c_str(), day, &encoder) != success)
+            status = fail;
+
+         blocks++;
+      }
+
+      // keep the samples if storing the blocks failed
+
+      if (status != success)
+      {
+         db->rollback();
+         tell(eloAlways, "Error: Archiving samples of '%s' failed, aborting", l2pTime(day, "%d.%m.%Y").c_str());
+         return fail;
+      }
+
+      samples->deleteWhere("value is not null and text is null and "
+                                "time >= from_unixtime(%ld) and time < from_unixtime(%ld)", day, nextDay);
+
+      db->commit();
+
+      tell(eloAlways, "Archived %d samples of '%s' in %d blocks", count, l2pTime(day, "%d.%m.%Y").c_str(), blocks);
+
+      day = nextDay;
+   }
+
+   // more days pending -> continue with the next job, requests queued meanwhile go first
+
+   if (first && day < until && !doShutDown())
+   {
+      return dbPool->post([this, until](cDbWorker* worker) -> int
+      {
+         return archive(worker, until);
+      });
+   }
+
+   return success;
+}
+
 int Daemon::sendMail(const char* receiver, const char* subject, const char* body, const char* mimeType)
 {
    char* command {nullptr};
@@ -2423,6 +2947,7 @@ int Daemon::addValueFact(int addr, const char* type, int factor, const char* nam
    {
       tableValueTypes->setValue("TITLE", getTitleOfType(type));
       tableValueTypes->store();
+      invalidateInitPayload("valuetypes");
    }
 
    tableValueFacts->clear();
@@ -2451,6 +2976,7 @@ int Daemon::addValueFact(int addr, const char* type, int factor, const char* nam
          tableValueFacts->setValue("CHOICES", choices);
 
       tableValueFacts->store();
+      invalidateInitPayload("valuefacts");
       initSensorByFact(type, addr);
       return 1;                               // 1 for 'added'
    }
@@ -2474,6 +3000,7 @@ int Daemon::addValueFact(int addr, const char* type, int factor, const char* nam
    if (tableValueFacts->getChanges())
    {
       tableValueFacts->store();
+      invalidateInitPayload("valuefacts");
       return 2;                                // 2 for 'modified'
    }
 
@@ -2487,9 +3014,9 @@ int Daemon::addValueFact(int addr, const char* type, int factor, const char* nam
 
 int Daemon::dispatchMqttHaCommandRequest(json_t* jData, const char* topic)
 {
-   auto it = hassCmdTopicMap.find(topic);
+   const cMqttTopicRouter::Route* route = mqttRouter.lookup(topic);
 
-   if (it != hassCmdTopicMap.end())
+   if (route && !route->binding.empty())
    {
       const char* state = getStringFromJson(jData, "state", "");
 
@@ -2500,7 +3027,7 @@ int Daemon::dispatchMqttHaCommandRequest(json_t* jData, const char* topic)
       {
          bool bState = strcmp(state, "ON") == 0;
 
-         if (it->second == itOutput->second.name)
+         if (route->binding == itOutput->second.name)
          {
             gpioWrite(itOutput->first, bState);
             break;
@@ -2593,30 +3120,36 @@ int Daemon::updateWeather()
 
    nextWeatherAt = time(0) + 30 * tmeSecondsPerMinute;
 
-   cCurl curl;
-   curl.init();
-
-   MemoryStruct data;
-   int size {0};
    char* url {nullptr};
 
    asprintf(&url, "http://api.openweathermap.org/data/2.5/forecast?appid=%s&units=metric&lang=de&lat=%f&lon=%f",
             openWeatherApiKey, latitude, longitude);
 
    tell(eloWeather, "-> (openweathermap) [%s]", url);
-   int status = curl.downloadFile(url, size, &data, 2);
 
-   if (status != success)
+   std::string sUrl = url;
+   free(url);
+
+   return httpClient.get(sUrl.c_str(), [this, sUrl](const cHttpClient::Response& response)
    {
-      tell(eloAlways, "Error: Requesting weather at '%s' failed", url);
-      free(url);
-      return fail;
-   }
+      if (!response.ok())
+      {
+         tell(eloAlways, "Error: Requesting weather at '%s' failed, http code was (%ld)", sUrl.c_str(), response.code);
+         return;
+      }
 
-   free(url);
-   tell(eloWeather, "<- (openweathermap) [%s]", data.memory);
+      tell(eloWeather, "<- (openweathermap) [%s]", response.data.c_str());
+      processWeather(response.data.c_str());
+   }, 10);
+}
 
-   json_t* jData = jsonLoad(data.memory);
+//***************************************************************************
+// Process Weather
+//***************************************************************************
+
+int Daemon::processWeather(const char* data)
+{
+   json_t* jData = jsonLoad(data);
 
    if (!jData)
       return fail;
@@ -2670,8 +3203,6 @@ int Daemon::updateWeather()
 
    json_decref(jData);
 
-   curl.exit();
-
    return done;
 }
 
@@ -3038,6 +3569,14 @@ int Daemon::getConfigItem(const char* name, char*& value, const char* def)
    free(value);
    value = nullptr;
 
+   auto pending = pendingConfigItems.find(name);
+
+   if (pending != pendingConfigItems.end())
+   {
+      value = strdup(pending->second.c_str());
+      return success;
+   }
+
    tableConfig->clear();
    tableConfig->setValue("OWNER", myName());
    tableConfig->setValue("NAME", name);
@@ -3060,10 +3599,12 @@ int Daemon::getConfigItem(const char* name, char*& value, const char* def)
 int Daemon::setConfigItem(const char* name, const char* value)
 {
    tell(eloDebug, "Debug: Storing '%s' with value '%s'", name, value);
+   pendingConfigItems.erase(name);   // stored now, a deferred value is outdated
    tableConfig->clear();
    tableConfig->setValue("OWNER", myName());
    tableConfig->setValue("NAME", name);
    tableConfig->setValue("VALUE", value);
+   invalidateInitPayload("config");
 
    return tableConfig->store();
 }
@@ -3160,6 +3701,104 @@ int Daemon::setConfigItem(const char* name, bool value)
    return setConfigItem(name, txt);
 }
 
+//***************************************************************************
+// Defer Config Item
+//   the value is visible for getConfigItem() at once, it's stored to the
+//   table by flushConfigItems() - after configFlushDelay seconds without
+//   a further change but at least each configFlushMaxDelay seconds
+//***************************************************************************
+
+int Daemon::deferConfigItem(const char* name, const char* value)
+{
+   auto it = pendingConfigItems.find(name);
+
+   if (it != pendingConfigItems.end() && it->second == value)
+      return done;
+
+   tell(eloDebug2, "Debug: Deferring '%s' with value '%s'", name, value);
+
+   if (pendingConfigItems.empty())
+      pendingConfigSince = time(0);
+
+   pendingConfigItems[name] = value;
+   pendingConfigChangedAt = time(0);
+   invalidateInitPayload("config");
+
+   return success;
+}
+
+int Daemon::deferConfigItem(const char* name, long value)
+{
+   char txt[16];
+
+   snprintf(txt, sizeof(txt), "%ld", value);
+
+   return deferConfigItem(name, txt);
+}
+
+int Daemon::deferConfigItem(const char* name, double value)
+{
+   char txt[16+TB];
+   snprintf(txt, sizeof(txt), "%.2f", value);
+   return deferConfigItem(name, txt);
+}
+
+//***************************************************************************
+// Flush Config Items
+//   store the pending items in one transaction, they are kept on error
+//   and retried with the next call
+//***************************************************************************
+
+int Daemon::flushConfigItems(bool force)
+{
+   if (pendingConfigItems.empty())
+      return done;
+
+   time_t now = time(0);
+
+   if (!force && now < pendingConfigChangedAt + configFlushDelay && now < pendingConfigSince + configFlushMaxDelay)
+      return done;
+
+   if (!connection || !connection->isConnected() || !tableConfig)
+      return fail;
+
+   cMetricTimer timer("loop_phase_seconds", "flushConfig");
+   int status {success};
+
+   connection->startTransaction();
+
+   for (const auto& item : pendingConfigItems)
+   {
+      tableConfig->clear();
+      tableConfig->setValue("OWNER", myName());
+      tableConfig->setValue("NAME", item.first.c_str());
+      tableConfig->setValue("VALUE", item.second.c_str());
+
+      if (tableConfig->store() != success)
+      {
+         status = fail;
+         break;
+      }
+   }
+
+   // all or nothing, the items stay pending for the next try
+
+   if (status != success)
+   {
+      connection->rollback();
+      tell(eloAlways, "Error: Storing %zu config items failed, retrying later", pendingConfigItems.size());
+      pendingConfigSince = now;
+      return fail;
+   }
+
+   connection->commit();
+
+   tell(eloDebug, "Debug: Stored %zu deferred config items", pendingConfigItems.size());
+   pendingConfigItems.clear();
+
+   return success;
+}
+
 //***************************************************************************
 // Get Config Time Range Item
 //***************************************************************************
@@ -3256,7 +3895,7 @@ int Daemon::toggleIo(uint addr, const char* type, int state, int bri, int transi
 
       /* char* request {nullptr};
       asprintf(&request, "{ \"method\" : \"getDeviceDescription\", \"parameters\" : [\"%s\"] }", uuid);
-      mqttWriter->write(TARGET "2mqtt/homematic/rpccall", request);
+      mqttClient->write(TARGET "2mqtt/homematic/rpccall", request);
       tell(eloHomeMatic, "-> (home-matic) '%s' to '%s'", TARGET "2mqtt/homematic/rpccall", request);
       free(request);*/
    }
@@ -3414,12 +4053,14 @@ int Daemon::storeStates()
       if (output.second.mode == omManual)
          mode += pow(2, output.first);
 
-      setConfigItem("ioStates", value);
-      setConfigItem("ioModes", mode);
-
       tell(eloDebug2, "Debug: Store-IO-States State bit (%d): %s: %d [%ld]", output.first, output.second.name.c_str(), output.second.state, value);
    }
 
+   // toggling outputs store it only once after a short delay
+
+   deferConfigItem("ioStates", value);
+   deferConfigItem("ioModes", mode);
+
    return done;
 }
 
@@ -3521,7 +4162,7 @@ int Daemon::initArduino()
 {
    mqttCheckConnection();
 
-   if (isEmpty(mqttUrl) || !mqttReader->isConnected())
+   if (isEmpty(mqttUrl) || !mqttClient->isConnected())
       return fail;
 
    json_t* oJson = json_object();
@@ -3538,9 +4179,9 @@ int Daemon::initArduino()
       return fail;
    }
 
-   if (mqttReader->isConnected())
+   if (mqttClient->isConnected())
    {
-      mqttReader->write(TARGET "2mqtt/arduino/in", p);
+      mqttClient->write(TARGET "2mqtt/arduino/in", p);
       tell(eloDebug, "DEBUG: PushMessage to arduino [%s]", p);
       free(p);
    }
@@ -3637,6 +4278,46 @@ int Daemon::dispatchW1Msg(const char* message)
    return success;
 }
 
+//***************************************************************************
+// In-Process W1 Reader
+//   alternative to w1mqtt for sensors attached to this host, the values
+//   are taken over from the reader thread without the MQTT round trip
+//***************************************************************************
+
+int Daemon::initW1Reader()
+{
+   if (!w1Local || w1Reader)
+      return done;
+
+   w1Reader = new cW1Reader(w1Resolution);
+
+   if (!w1Reader->Start())
+   {
+      tell(eloAlways, "Error: Starting one wire reader thread failed");
+      delete w1Reader;
+      w1Reader = nullptr;
+      return fail;
+   }
+
+   return success;
+}
+
+int Daemon::dispatchW1Reader()
+{
+   W1::SampleList samples;
+
+   if (!w1Reader || !w1Reader->fetch(samples))
+      return done;
+
+   for (const auto& sample : samples)
+      updateW1(sample.name.c_str(), sample.value, sample.time);
+
+   cleanupW1();
+   process();
+
+   return success;
+}
+
 void Daemon::updateW1(const char* id, double value, time_t stamp)
 {
    uint address = toW1Id(id);
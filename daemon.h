@@ -9,16 +9,23 @@
 #pragma once
 
 #include <queue>
+#include <set>
+#include <atomic>
 #include <jansson.h>
 
 #include "lib/common.h"
 #include "lib/db.h"
+#include "lib/dbpool.h"
+#include "lib/gorilla.h"
+#include "lib/json.h"
+#include "lib/metrics.h"
 #include "lib/mqtt.h"
 
 #include "HISTORY.h"
 
 #include "websock.h"
 #include "deconz.h"
+#include "w1.h"
 
 #define confDirDefault "/etc/" TARGET
 
@@ -249,6 +256,7 @@ class Daemon : public cWebInterface
       static DefaultWidgetProperty defaultWidgetProperties[];
       static DefaultWidgetProperty* getDefalutProperty(const char* type, const char* unit, int address = 0);
       int widgetDefaults2Json(json_t* jDefaults, const char* type, const char* unit, const char* name, int address = 0);
+      int widgetDefaults2Json(cJsonWriter* json, const char* type, const char* unit, const char* name, int address = 0);
 
       struct ValueTypes
       {
@@ -262,6 +270,11 @@ class Daemon : public cWebInterface
       virtual int exit();
       virtual int initLocale();
       virtual int initDb();
+      int checkTables(cDbConnection* conn);
+      std::string schemaFingerprint();
+      std::string readSchemaFingerprint(cDbConnection* conn);
+      int storeSchemaFingerprint(cDbConnection* conn, const char* fingerprint);
+      int verifySchema();
       virtual int exitDb();
       virtual int readConfiguration(bool initial);
       virtual int applyConfigurationSpecials() { return done; }
@@ -305,6 +318,7 @@ class Daemon : public cWebInterface
       bool isInTimeRange(const std::vector<Range>* ranges, time_t t);
 
       int updateWeather();
+      int processWeather(const char* data);
       int weather2json(json_t* jWeather, json_t* owmWeather);
 
       int store(time_t now, const SensorData* sensor);
@@ -313,6 +327,9 @@ class Daemon : public cWebInterface
       SensorData* getSensor(const char* type, int addr);
       void setSpecialValue(uint addr, double value, const std::string& text = "");
 
+      int initMqttRoutes();
+      int dispatchHaCommand(const char* topic, const char* message);
+      int dispatchNodeRedMsg(const char* topic, const char* message);
       int performMqttRequests();
       int mqttCheckConnection();
       int mqttDisconnect();
@@ -321,11 +338,14 @@ class Daemon : public cWebInterface
       int mqttNodeRedPublishSensor(SensorData& sensor);
       int mqttNodeRedPublishAction(SensorData& sensor, double value, bool publishOnly = false);
       int mqttHaWrite(json_t* obj, uint groupid);
+      int mqttPublishMetrics();
       int jsonAddValue(json_t* obj, SensorData& sensor, bool forceConfig = false);
       int updateSchemaConfTable();
 
       int scheduleAggregate();
       int aggregate();
+      int archive();
+      int archive(cDbWorker* worker, time_t until);
 
       int loadHtmlHeader();
       int sendMail(const char* receiver, const char* subject, const char* body, const char* mimeType);
@@ -340,6 +360,24 @@ class Daemon : public cWebInterface
       int getConfigItem(const char* name, bool& value, bool def = false);
       int setConfigItem(const char* name, bool value);
 
+      // config items which change often (IO states, chart settings) are kept
+      //   in memory and stored together by flushConfigItems()
+
+      enum ConfigFlush
+      {
+         configFlushDelay    = 2,           // [s] without a further change
+         configFlushMaxDelay = 10           // [s] since the oldest pending change
+      };
+
+      int deferConfigItem(const char* name, const char* value);
+      int deferConfigItem(const char* name, long value);
+      int deferConfigItem(const char* name, double value);
+      int flushConfigItems(bool force = false);
+
+      std::map<std::string,std::string> pendingConfigItems;
+      time_t pendingConfigSince {0};
+      time_t pendingConfigChangedAt {0};
+
       int getConfigTimeRangeItem(const char* name, std::vector<Range>& ranges);
 
       bool doShutDown() { return shutdown; }
@@ -351,20 +389,50 @@ class Daemon : public cWebInterface
       // web
 
       int pushOutMessage(json_t* obj, const char* event, long client = 0);
+      int pushOutMessage(cJsonWriter* json, const char* event, long client = 0);
+      static cJsonWriter& beginMessage(cJsonWriter* json, const char* event);
       int pushDataUpdate(const char* event, long client);
+      int pushInitPayload(const char* event, long client);
+      int invalidateInitPayload(const char* event);
 
       int pushInMessage(const char* data) override;
       std::queue<std::string> messagesIn;
       cMyMutex messagesInMutex;
 
+      // async requests - executed by a db worker, the result is pushed by the main thread
+
+      typedef std::function<json_t*(cDbWorker* worker)> AsyncJob;
+      typedef std::function<void()> AsyncDone;
+      typedef std::function<int(cDbWorker* worker, cJsonWriter* json)> AsyncJsonJob;
+
+      struct AsyncResult
+      {
+         long client {0};
+         std::string event;
+         json_t* oJson {nullptr};
+         std::string frame;                 // serialized by a AsyncJsonJob (if oJson is not set)
+         AsyncDone onPushed;                // called by the main thread after the push
+         std::string error;                 // the job failed, replied as 'result' (or HTTP error)
+      };
+
+      int postAsync(const char* event, long client, AsyncJob job, AsyncDone onPushed = nullptr);
+      int postAsyncJson(const char* event, long client, AsyncJsonJob job);
+      int asyncFailed(cDbWorker* worker, long client, const std::string& event);
+      int dispatchAsyncResults();
+      int performLogFollow();
+      std::queue<AsyncResult> asyncResults;
+      cMyMutex asyncResultsMutex;
+
       int replyResult(int status, const char* message, long client);
       virtual int performLogin(json_t* oObject);
       int performLogout(json_t* oObject);
       int performTokenRequest(json_t* oObject, long client);
       int performPageChange(json_t* oObject, long client);
+      int performSubscribe(json_t* oObject, long client);
       int performToggleIo(json_t* oObject, long client);
       int performSystem(json_t* oObject, long client);
       int performSyslog(json_t* oObject, long client);
+      int performMetrics(long client);
       int performConfigDetails(long client);
       int performGroups(long client);
       int performTestMail(json_t* oObject, long client);
@@ -374,6 +442,7 @@ class Daemon : public cWebInterface
 
       int performData(long client, const char* event = nullptr);
       int performChartData(json_t* oObject, long client);
+      int chartData2Json(cDbWorker* worker, cJsonWriter* json, std::vector<std::string> sList, time_t rangeStart, double range, bool widget, int minutes, std::string id);
       int performUserDetails(long client);
       int storeUserConfig(json_t* oObject, long client);
       int performPasswChange(json_t* oObject, long client);
@@ -397,7 +466,7 @@ class Daemon : public cWebInterface
       virtual int configChoice2json(json_t* obj, const char* name);
 
       int valueTypes2Json(json_t* obj);
-      int valueFacts2Json(json_t* obj, bool filterActive);
+      int valueFacts2Json(cJsonWriter* json, bool filterActive);
       int dashboards2Json(json_t* obj);
       int groups2Json(json_t* obj);
       virtual int commands2Json(json_t* obj);
@@ -431,14 +500,20 @@ class Daemon : public cWebInterface
       uint toW1Id(const char* name);
       void updateW1(const char* id, double value, time_t stamp);
       void cleanupW1();
+      int initW1Reader();
+      int dispatchW1Reader();
 
       // data
 
       bool initialized {false};
-      cDbConnection* connection {nullptr};
+      cDbConnection* connection {nullptr};   // main thread - sampling and all writes
+      cDbPool* dbPool {nullptr};             // read only requests of the web interface
+      cW1Reader* w1Reader {nullptr};         // in-process one wire reader (optional)
+      std::atomic<bool> schemaChecked {false};   // structure check done (or scheduled) for this process
 
       cDbTable* tableTableStatistics {nullptr};
       cDbTable* tableSamples {nullptr};
+      cDbTable* tableSampleArchive {nullptr};
       cDbTable* tablePeaks {nullptr};
       cDbTable* tableValueFacts {nullptr};
       cDbTable* tableValueTypes {nullptr};
@@ -461,8 +536,6 @@ class Daemon : public cWebInterface
       cDbStatement* selectAllConfig {nullptr};
       cDbStatement* selectAllUser {nullptr};
       cDbStatement* selectMaxTime {nullptr};
-      cDbStatement* selectSamplesRange {nullptr};     // for chart
-      cDbStatement* selectSamplesRange60 {nullptr};   // for chart
       cDbStatement* selectScriptByPath {nullptr};
       cDbStatement* selectScripts {nullptr};
       cDbStatement* selectSensorAlerts {nullptr};
@@ -476,11 +549,6 @@ class Daemon : public cWebInterface
       cDbStatement* selectAllSchemaConf {nullptr};
       cDbStatement* selectHomeMaticByUuid {nullptr};
 
-      cDbValue xmlTime;
-      cDbValue rangeFrom;
-      cDbValue rangeTo;
-      cDbValue avgValue;
-      cDbValue maxValue;
       cDbValue rangeEnd;
 
       time_t nextRefreshAt {0};
@@ -506,9 +574,16 @@ class Daemon : public cWebInterface
          uint rights;                  // rights mask
          std::string page;
          ClientType type {ctActive};
+         bool subscribed {false};             // false -> all sensors
+         std::set<std::string> subscription;  // sensor keys like 'VA:0x01'
+
+         bool isSubscribed(const std::string& key) const { return !subscribed || subscription.count(key); }
+         std::string followLog;               // log file streamed to the client
+         bool followActive {false};           // tail is sent, stream the new lines
       };
 
       std::map<void*,WsClient> wsClients;
+      std::map<std::string,cFileFollower*> logFollowers;
 
       // MQTT stuff
 
@@ -535,12 +610,11 @@ class Daemon : public cWebInterface
       bool mqttHaveConfigTopic {true};
       MqttInterfaceStyle mqttInterfaceStyle {misNone};
 
-      Mqtt* mqttReader {nullptr};                // connection  to my own mqtt instance
-      Mqtt* mqttWriter {nullptr};                // connection to my own mqtt instance
+      Mqtt* mqttClient {nullptr};                // connection to my own mqtt instance (publish and subscribe)
       std::vector<std::string> mqttSensorTopics;
 
       time_t lastMqttConnectAt {0};
-      std::map<std::string,std::string> hassCmdTopicMap; // 'topic' to 'name' map
+      cMqttTopicRouter mqttRouter;               // inbound topics, HA command topics are bound to the sensor name
 
       json_t* oHaJson {nullptr};
       std::map<int,Group> groups;
@@ -550,15 +624,25 @@ class Daemon : public cWebInterface
       double latitude {50.30};
       double longitude {8.79};
       char* openWeatherApiKey {nullptr};
+      char* httpProxy {nullptr};
       int interval {60};
       int arduinoInterval {10};
 
       int webPort {0};
       char* webUrl {nullptr};
       bool webSsl {false};
+      int webCompression {1};             // permessage-deflate level (0 -> off)
+      int webCompressionMemLevel {8};
+      int webCompressionWindowBits {15};
+      bool webDataApi {false};            // serve the read only /data/ api without login
+      bool webMetricsApi {false};         // serve /metrics to local peers
       char* iconSet {nullptr};
       int aggregateInterval {15};         // aggregate interval in minutes
       int aggregateHistory {0};           // history in days
+      int archiveAfter {0};               // compress samples older than n days into the archive (0 -> off)
+      int dbWorkers {2};                  // number of db worker threads
+      bool w1Local {false};               // read the local one wire sensors in-process (instead of w1mqtt)
+      char* w1Resolution {nullptr};       // resolution spec for the in-process reader, see w1mqtt -r
 
       int mail {no};
       char* mailScript {nullptr};
@@ -596,6 +680,18 @@ class Daemon : public cWebInterface
 
       std::map<std::string,json_t*> jsonSensorList;
 
+      // serialized messages of the WS login, built on first use and
+      //   invalidated by the store actions of the underlying data
+
+      struct InitPayload
+      {
+         std::string message;
+         uint version {0};
+         bool valid {false};
+      };
+
+      std::map<std::string,InitPayload> initPayloads;
+
       // statics
 
       static bool shutdown;
@@ -0,0 +1,75 @@
+//
+// g++ -DUSESQLITE -DTARGET='"p4d"' -Ilib dbpooltest.c lib/dbpool.c lib/db.c lib/dbsqlite.c lib/dbdict.c lib/thread.c lib/common.c lib/metrics.c -lsqlite3 -ljansson -lpthread -lcrypto -luuid -lz -o dbpooltest
+//
+// checks that a db worker which can't connect still executes its jobs
+//   (with a null connection) instead of dropping them
+//
+
+#include <unistd.h>
+#include <atomic>
+
+#include "lib/common.h"
+#include "lib/dbpool.h"
+
+int main(int argc, const char** argv)
+{
+   std::atomic<int> executed {0};
+   std::atomic<int> withoutConnection {0};
+   int failed {0};
+
+   logstdout = yes;
+   eloquence = eloAlways;
+
+   // a database which can't be reached
+
+#ifdef USESQLITE
+   cDbConnection::setName("/nonexistent/dbpooltest.sqlite");
+#else
+   cDbConnection::setHost("127.0.0.1");
+   cDbConnection::setPort(1);
+   cDbConnection::setName("dbpooltest");
+#endif
+
+   cDbConnection::init();
+
+   cDbPool pool(2);
+   pool.start();
+
+   const int jobs {4};
+
+   for (int i = 0; i < jobs; i++)
+   {
+      pool.post([&](cDbWorker* worker)
+      {
+         if (!worker->getConnection() && !worker->getTable("samples"))
+            withoutConnection++;
+
+         executed++;
+
+         return fail;
+      });
+   }
+
+   for (int i = 0; i < 100 && executed < jobs; i++)
+      usleep(100000);
+
+   pool.stop();
+   cDbConnection::exit();
+
+   if (executed != jobs)
+   {
+      printf("FAILED: %d of %d jobs executed\n", (int)executed, jobs);
+      failed++;
+   }
+
+   if (withoutConnection != executed)
+   {
+      printf("FAILED: %d of %d jobs got a connection\n", executed - withoutConnection, (int)executed);
+      failed++;
+   }
+
+   if (!failed)
+      printf("OK: %d jobs executed without connection\n", (int)executed);
+
+   return failed ? 1 : 0;
+}
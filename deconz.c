@@ -52,8 +52,6 @@ int Deconz::init(Daemon* parent, cDbConnection* connection)
    int status {success};
 
    daemon = parent;
-   cCurl::create();      // create global cCurl instance
-   curl.init();
 
    tableDeconzLights = new cDbTable(connection, "deconzl");
    if (tableDeconzLights->open() != success) return fail;
@@ -88,9 +86,6 @@ int Deconz::init(Daemon* parent, cDbConnection* connection)
 
 int Deconz::exit()
 {
-   curl.exit();
-   cCurl::destroy();
-
    delete tableDeconzLights;   tableDeconzLights = nullptr;
    delete tableDeconzSensors;  tableDeconzSensors = nullptr;
    delete selectLightByUuid;   selectLightByUuid = nullptr;
@@ -335,8 +330,6 @@ int Deconz::processDevices(json_t* jData, std::string kind)
 
 int Deconz::toggle(const char* type, uint address, bool state, int bri, int transitiontime)
 {
-   json_t* jArray {nullptr};
-   std::string result;
    std::string uuid;
 
    {
@@ -367,17 +360,9 @@ int Deconz::toggle(const char* type, uint address, bool state, int bri, int tran
       json_object_set_new(jObj, "bri", json_integer(dim));
    }
 
-   int status {success};
-
-   if ((status = put(jArray, uuid.c_str(), jObj)) == success)
-      status = checkResult(jArray);
-
-   if (status == success)
-      tell(eloDeconz, "Toggled '%s' to %s", uuid.c_str(), state ? "on" : "off");
+   std::string info = "Toggled '" + uuid + "' to " + (state ? "on" : "off");
 
-   json_decref(jArray);
-
-   return status;
+   return put(uuid.c_str(), jObj, info);
 }
 
 //***************************************************************************
@@ -386,8 +371,6 @@ int Deconz::toggle(const char* type, uint address, bool state, int bri, int tran
 
 int Deconz::color(const char* type, uint address, int hue, int sat, int bri)
 {
-   json_t* jArray {nullptr};
-   std::string result;
    std::string uuid;
 
    {
@@ -413,15 +396,8 @@ int Deconz::color(const char* type, uint address, int hue, int sat, int bri)
    json_object_set_new(jObj, "sat", json_integer(sat));
    json_object_set_new(jObj, "bri", json_integer(bri));
 
-   int status {success};
-
-   if ((status = put(jArray, uuid.c_str(), jObj)) == success)
-      status = checkResult(jArray);
-
-   if (status == success)
-      tell(eloDeconz, "Changed color of %s to %d", uuid.c_str(), hue);
-
-   json_decref(jArray);
+   std::string info = "Changed color of " + uuid + " to " + std::to_string(hue);
+   put(uuid.c_str(), jObj, info);
 
    return success;
 }
@@ -453,13 +429,13 @@ int Deconz::checkResult(json_t* jArray)
 
 //***************************************************************************
 // Put
+//   asynchronous, the result is checked when the reply arrives
 //***************************************************************************
 
-int Deconz::put(json_t*& jResult, const char* uuid, json_t* jData)
+int Deconz::put(const char* uuid, json_t* jData, const std::string& info)
 {
    // /api/<apikey>/lights/<id>/state
 
-   std::string data;
    char* url {nullptr};
    asprintf(&url, "http://%s/api/%s/lights/%s/state", httpUrl.c_str(), apiKey.c_str(), uuid);
    tell(eloDebugDeconz, "DECONZ: REST call '%s'", url);
@@ -467,28 +443,40 @@ int Deconz::put(json_t*& jResult, const char* uuid, json_t* jData)
    char* payload = json_dumps(jData, JSON_REAL_PRECISION(4));
    json_decref(jData);
 
-   if (curl.put(url, payload, &data) != success)
+   std::string sUrl = url;
+   std::string sPayload = payload;
+
+   int status = httpClient.put(url, payload, [this, sUrl, sPayload, info](const cHttpClient::Response& response)
    {
-      tell(eloAlways, "DECONZ: REST call to '%s' failed", url);
-      free(url);
-      return fail;
-   }
+      if (!response.ok())
+      {
+         tell(eloAlways, "DECONZ: REST call to '%s' failed, http code was (%ld)", sUrl.c_str(), response.code);
+         return;
+      }
 
-   tell(eloDeconz, "-> (DECONZ) put '%s' '%s'; result [%s]", url, payload, data.c_str());
-   free(url);
+      tell(eloDeconz, "-> (DECONZ) put '%s' '%s'; result [%s]", sUrl.c_str(), sPayload.c_str(), response.data.c_str());
 
-   json_error_t error;
-   jResult = json_loads(data.c_str(), 0, &error);
+      json_error_t error;
+      json_t* jResult = json_loads(response.data.c_str(), 0, &error);
 
-   if (!jResult)
-   {
-      tell(eloAlways, "Error: Ignoring invalid script result [%s]", data.c_str());
-      tell(eloAlways, "Error decoding json: %s (%s, line %d column %d, position %d)",
-           error.text, error.source, error.line, error.column, error.position);
-      return fail;
-   }
+      if (!jResult)
+      {
+         tell(eloAlways, "Error: Ignoring invalid DECONZ result [%s]", response.data.c_str());
+         tell(eloAlways, "Error decoding json: %s (%s, line %d column %d, position %d)",
+              error.text, error.source, error.line, error.column, error.position);
+         return;
+      }
 
-   return success;
+      if (checkResult(jResult) == success)
+         tell(eloDeconz, "%s", info.c_str());
+
+      json_decref(jResult);
+   }, 5);
+
+   free(payload);
+   free(url);
+
+   return status;
 }
 
 //***************************************************************************
@@ -497,7 +485,7 @@ int Deconz::put(json_t*& jResult, const char* uuid, json_t* jData)
 
 int Deconz::post(json_t*& jResult, const char* method, const char* payload)
 {
-   std::string data;
+   cHttpClient::Response response;
 
    // http://192.168.200.101:8081/api/<method>
 
@@ -505,22 +493,22 @@ int Deconz::post(json_t*& jResult, const char* method, const char* payload)
    asprintf(&url, "http://%s/%s", httpUrl.c_str(), method);
    tell(eloDebugDeconz, "DECONZ: REST call '%s'", url);
 
-   if (curl.post(url, payload, &data) != success)
+   if (httpClient.perform("POST", url, payload, response) != success)
    {
       tell(eloAlways, "DECONZ: REST call to '%s' failed", url);
       free(url);
       return fail;
    }
 
-   tell(eloDeconz, "-> (DECONZ) '%s' '%s' [%s]", url, payload, data.c_str());
+   tell(eloDeconz, "-> (DECONZ) '%s' '%s' [%s]", url, payload, response.data.c_str());
    free(url);
 
    json_error_t error;
-   jResult = json_loads(data.c_str(), 0, &error);
+   jResult = json_loads(response.data.c_str(), 0, &error);
 
    if (!jResult)
    {
-      tell(eloAlways, "Error: Ignoring invalid DECONZ result [%s]", data.c_str());
+      tell(eloAlways, "Error: Ignoring invalid DECONZ result [%s]", response.data.c_str());
       tell(eloAlways, "Error decoding json: %s (%s, line %d column %d, position %d)",
            error.text, error.source, error.line, error.column, error.position);
       return fail;
@@ -535,8 +523,7 @@ int Deconz::post(json_t*& jResult, const char* method, const char* payload)
 
 int Deconz::query(json_t*& jResult, const char* method, const char* key)
 {
-   MemoryStruct data;
-   int size {0};
+   cHttpClient::Response response;
 
    // http://192.168.200.101:8081/api/<key>/<method>
 
@@ -544,23 +531,23 @@ int Deconz::query(json_t*& jResult, const char* method, const char* key)
    asprintf(&url, "http://%s/api/%s/%s", httpUrl.c_str(), apiKey.c_str(), method);
    tell(eloDebugDeconz, "DECONZ: REST call '%s'", url);
 
-   if (curl.downloadFile(url, size, &data, 5) != success)
+   if (httpClient.perform("GET", url, nullptr, response, 5) != success)
    {
       tell(eloAlways, "DECONZ: REST call to '%s' failed", url);
       free(url);
       return fail;
    }
 
-   tell(eloDeconz, "<- (DECONZ) '%s' [%s]", url, data.memory);
+   tell(eloDeconz, "<- (DECONZ) '%s' [%s]", url, response.data.c_str());
 
    free(url);
 
    json_error_t error;
-   jResult = json_loads(data.memory, 0, &error);
+   jResult = json_loads(response.data.c_str(), 0, &error);
 
    if (!jResult)
    {
-      tell(eloAlways, "Error: Ignoring invalid script result [%s]", data.memory);
+      tell(eloAlways, "Error: Ignoring invalid script result [%s]", response.data.c_str());
       tell(eloAlways, "Error decoding json: %s (%s, line %d column %d, position %d)",
            error.text, error.source, error.line, error.column, error.position);
       return fail;
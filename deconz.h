@@ -33,7 +33,7 @@ class Deconz
       const char* getApiKey() { return apiKey.c_str(); }
 
       int query(json_t*& jResult, const char* method, const char* apiKey);
-      int put(json_t*& jResult, const char* uuid, json_t* jData);
+      int put(const char* uuid, json_t* jData, const std::string& info);
       int post(json_t*& jResult, const char* method, const char* payload);
       int checkResult(json_t* jArray);
 
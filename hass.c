@@ -20,6 +20,8 @@ int Daemon::mqttHaPublish(SensorData& sensor, bool forceConfig)
    if (isEmpty(mqttUrl))
       return done;
 
+   cMetricTimer timer("loop_phase_seconds", "mqttPublish");
+
    if (mqttCheckConnection() != success)
       return fail;
 
@@ -91,15 +93,15 @@ int Daemon::mqttHaPublishSensor(SensorData& sensor, bool forceConfig)
 
    if (mqttHaveConfigTopic && !sensor.title.length())
    {
-      if (!mqttReader->isConnected())
+      if (!mqttClient->isConnected())
          return fail;
 
       // Interface description:
       //   https://www.home-assistant.io/docs/mqtt/discovery/
 
-      mqttReader->subscribe(sDataTopic.c_str());
-      status = mqttReader->read(&message, 100);
-      tp = mqttReader->getLastReadTopic();
+      mqttClient->subscribe(sDataTopic.c_str());
+      status = mqttClient->read(&message, 100, sDataTopic.c_str());
+      tp = mqttClient->getLastReadTopic();
 
       tell(eloMqtt, "Config topic '%s', state %d", tp.c_str(), status);
 
@@ -111,7 +113,7 @@ int Daemon::mqttHaPublishSensor(SensorData& sensor, bool forceConfig)
          char* configTopic {nullptr};
          char* configJson {nullptr};
 
-         if (!mqttWriter->isConnected())
+         if (!mqttClient->isConnected())
             return fail;
 
          // topic don't exists -> create sensor
@@ -144,7 +146,8 @@ int Daemon::mqttHaPublishSensor(SensorData& sensor, bool forceConfig)
                      "}",
                      sName.c_str(), cmdTopic, myTitle(), sensor.title.c_str(), sName.c_str());
 
-            hassCmdTopicMap[cmdTopic] = sensor.name;
+            mqttRouter.add(cmdTopic, [this](const char* topic, const char* message)
+               { return dispatchHaCommand(topic, message); }, sensor.name.c_str());
             free(cmdTopic);
          }
          else
@@ -159,18 +162,18 @@ int Daemon::mqttHaPublishSensor(SensorData& sensor, bool forceConfig)
                      sensor.unit.c_str(), sName.c_str(), sensor.title.c_str(), myTitle(), sName.c_str());
          }
 
-         mqttWriter->writeRetained(configTopic, configJson);
+         mqttClient->writeRetained(configTopic, configJson);
 
          free(configTopic);
          free(configJson);
       }
 
-      mqttReader->unsubscribe(sDataTopic.c_str());
+      mqttClient->unsubscribe(sDataTopic.c_str());
    }
 
    // publish actual value
 
-   if (!mqttWriter->isConnected())
+   if (!mqttClient->isConnected())
       return fail;
 
    json_t* oValue = json_object();
@@ -186,7 +189,7 @@ int Daemon::mqttHaPublishSensor(SensorData& sensor, bool forceConfig)
       json_object_set_new(oValue, "value", json_real(sensor.value));
 
    char* j = json_dumps(oValue, JSON_PRESERVE_ORDER); // |JSON_REAL_PRECISION(5));
-   mqttWriter->writeRetained(sDataTopic.c_str(), j);
+   mqttClient->writeRetained(sDataTopic.c_str(), j);
    free(j);
    json_decref(oValue);
 
@@ -211,16 +214,99 @@ int Daemon::mqttHaWrite(json_t* obj, uint groupid)
    if (mqttInterfaceStyle == misGroupedTopic)
       sDataTopic = strReplace("<GROUP>", groups[groupid].name, sDataTopic);
 
-   int status = mqttWriter->write(sDataTopic.c_str(), message);
+   int status = mqttClient->write(sDataTopic.c_str(), message);
+   free(message);
+
+   return status;
+}
+
+//***************************************************************************
+// MQTT Publish Metrics
+//***************************************************************************
+
+int Daemon::mqttPublishMetrics()
+{
+   if (isEmpty(mqttUrl))
+      return done;
+
+   if (mqttCheckConnection() != success)
+      return fail;
+
+   json_t* oJson = json_object();
+   cMetrics::toJson(oJson);
+
+   char* message = json_dumps(oJson, JSON_REAL_PRECISION(4));
+   json_decref(oJson);
+
+   int status = mqttClient->write(TARGET "2mqtt/metrics", message);
    free(message);
 
    return status;
 }
 
+//***************************************************************************
+// Init MQTT Routes
+//   the first level is the '<target>2mqtt' prefix of the sender, topics of
+//   other first levels are left to dispatchOther(). The command topics of
+//   the HA lights are added by mqttHaPublishSensor()
+//***************************************************************************
+
+int Daemon::initMqttRoutes()
+{
+   auto ignoreMsg = [](const char* topic, const char* message) { return done; };
+
+   mqttRouter.clear();
+
+   mqttRouter.addSender("+/ping", ignoreMsg);
+   mqttRouter.addSender("+/w1/ping", ignoreMsg);
+   mqttRouter.addSender("+/w1/#", [this](const char* topic, const char* message)
+      { return dispatchW1Msg(message); });
+   mqttRouter.addSender("+/arduino/out", [this](const char* topic, const char* message)
+      { return dispatchArduinoMsg(message); });
+   mqttRouter.addSender("+/homematic/rpcresult", [this](const char* topic, const char* message)
+      { return dispatchHomematicRpcResult(message); });
+   mqttRouter.addSender("+/homematic/events", [this](const char* topic, const char* message)
+      { return dispatchHomematicEvents(message); });
+   mqttRouter.addSender("+/light/#", [this](const char* topic, const char* message)
+      { return dispatchHaCommand(topic, message); });
+   mqttRouter.addSender("+/command/#", [this](const char* topic, const char* message)
+      { return dispatchNodeRedMsg(topic, message); });
+   mqttRouter.addSender("+/nodered/#", [this](const char* topic, const char* message)
+      { return dispatchNodeRedMsg(topic, message); });
+
+   return success;
+}
+
+int Daemon::dispatchHaCommand(const char* topic, const char* message)
+{
+   json_t* jData = jsonLoad(message);
+
+   if (!jData)
+      return fail;
+
+   int status = dispatchMqttHaCommandRequest(jData, topic);
+   json_decref(jData);
+
+   return status;
+}
+
+int Daemon::dispatchNodeRedMsg(const char* topic, const char* message)
+{
+   json_t* jData = jsonLoad(message);
+
+   if (!jData)
+      return fail;
+
+   int status = dispatchNodeRedCommands(topic, jData);
+   json_decref(jData);
+
+   return status;
+}
+
 //***************************************************************************
 // Perform MQTT Requests
 //   - check 'mqttHassCommandReader' for commands of a home automation
-//   - check 'mqttReader' for data from the W1 service and the arduino, etc ...
+//   - check 'mqttClient' for data from the W1 service and the arduino, etc ...
 //      -> w1mqtt (W1 service) is running localy and provide data of the W1 sensors
 //      -> the arduino provide the values of his analog inputs
 //***************************************************************************
@@ -237,56 +323,24 @@ int Daemon::performMqttRequests()
 
    MemoryStruct message;
 
-   if (!isEmpty(mqttUrl) && mqttReader->isConnected())
+   if (!isEmpty(mqttUrl) && mqttClient->isConnected())
    {
-      // tell(eloMqtt, "Try reading topic '%s'", mqttReader->getTopic());
+      // tell(eloMqtt, "Try reading topic '%s'", mqttClient->getTopic());
 
-      while (mqttReader->read(&message, 10) == success)
+      while (mqttClient->read(&message, 10) == success)
       {
          if (isEmpty(message.memory))
             continue;
 
          lastMqttRead = time(0);
 
-         std::string tp = mqttReader->getLastReadTopic();
-         tell(eloMqtt, "<- (%s) [%s] retained %d", tp.c_str(), message.memory, mqttReader->isRetained());
-
-         if (strstr(tp.c_str(), "2mqtt/ping"))
-            ;
-         else if (strstr(tp.c_str(), "2mqtt/w1"))
-            dispatchW1Msg(message.memory);
-         else if (strstr(tp.c_str(), "2mqtt/arduino/out"))
-            dispatchArduinoMsg(message.memory);
-         else if (strstr(tp.c_str(), "2mqtt/homematic/rpcresult"))
-            dispatchHomematicRpcResult(message.memory);
-         else if (strstr(tp.c_str(), "2mqtt/homematic/events"))
-            dispatchHomematicEvents(message.memory);
-
-         else if (strstr(tp.c_str(), "2mqtt/light/"))
-         {
-            json_t* jData = jsonLoad(message.memory);
-
-            if (jData)
-            {
-               dispatchMqttHaCommandRequest(jData, tp.c_str());
-               json_decref(jData);
-            }
-         }
+         std::string tp = mqttClient->getLastReadTopic();
+         tell(eloMqtt, "<- (%s) [%s] retained %d", tp.c_str(), message.memory, mqttClient->isRetained());
 
-         else if (strstr(tp.c_str(), "2mqtt/command") || strstr(tp.c_str(), "2mqtt/nodered"))
-         {
-            json_t* jData = jsonLoad(message.memory);
+         // not consumed by a route -> sensor of a foreign sender
 
-            if (jData)
-            {
-               dispatchNodeRedCommands(tp.c_str(), jData);
-               json_decref(jData);
-            }
-         }
-         else
-         {
+         if (mqttRouter.dispatch(tp.c_str(), message.memory) == ignore)
             dispatchOther(tp.c_str(), message.memory);
-         }
       }
    }
 
@@ -308,11 +362,9 @@ int Daemon::performMqttRequests()
 
 int Daemon::mqttDisconnect()
 {
-   if (mqttReader)               mqttReader->disconnect();
-   if (mqttWriter)               mqttWriter->disconnect();
+   if (mqttClient)               mqttClient->disconnect();
 
-   delete mqttReader;            mqttReader = nullptr;
-   delete mqttWriter;            mqttWriter = nullptr;
+   delete mqttClient;            mqttClient = nullptr;
 
    tell(eloMqtt, "Disconnected from MQTT");
 
@@ -328,13 +380,10 @@ int Daemon::mqttCheckConnection()
    if (isEmpty(mqttUrl))
       return done;
 
-   if (!mqttReader)
-      mqttReader = new Mqtt();
+   if (!mqttClient)
+      mqttClient = new Mqtt();
 
-   if (!mqttWriter)
-      mqttWriter = new Mqtt();
-
-   if (mqttReader->isConnected() && mqttWriter->isConnected())
+   if (mqttClient->isConnected())
       return success;
 
    // retry connect all 20 seconds
@@ -347,36 +396,20 @@ int Daemon::mqttCheckConnection()
 
    lastMqttConnectAt = time(0);
 
-   // connect reader
+   // one connection for publish and subscribe
 
-   if (!mqttWriter->isConnected())
+   if (mqttClient->connect(mqttUrl, mqttUser, mqttPassword) != success)
    {
-      if (mqttWriter->connect(mqttUrl, mqttUser, mqttPassword) != success)
-      {
-         tell(eloAlways, "Error: MQTT: Connecting publisher to '%s' failed", mqttUrl);
-         return fail;
-      }
-
-      tell(eloMqtt, "MQTT: Connecting publisher to '%s' succeeded", mqttUrl);
+      tell(eloAlways, "Error: MQTT: Connecting to '%s' failed", mqttUrl);
+      return fail;
    }
 
-   // connect writer
+   tell(eloMqtt, "MQTT: Connecting to '%s' succeeded", mqttUrl);
 
-   if (!mqttReader->isConnected())
+   for (const auto& t : mqttSensorTopics)
    {
-      if (mqttReader->connect(mqttUrl, mqttUser, mqttPassword) != success)
-      {
-         tell(eloAlways, "Error: MQTT: Connecting subscriber to '%s' failed", mqttUrl);
-         return fail;
-      }
-
-      tell(eloMqtt, "MQTT: Connecting subscriber to '%s' succeeded", mqttUrl);
-
-      for (const auto& t : mqttSensorTopics)
-      {
-         mqttReader->subscribe(t.c_str());
-         tell(eloMqtt, "MQTT: Connecting subscriber to '%s' - '%s' succeeded", mqttUrl, t.c_str());
-      }
+      mqttClient->subscribe(t.c_str());
+      tell(eloMqtt, "MQTT: Subscribing '%s' - '%s' succeeded", mqttUrl, t.c_str());
    }
 
    return success;
@@ -393,9 +426,11 @@ int Daemon::mqttNodeRedPublishSensor(SensorData& sensor)
 
 int Daemon::mqttNodeRedPublishAction(SensorData& sensor, double value, bool publishOnly)
 {
-   if (!mqttWriter || !mqttWriter->isConnected())
+   if (!mqttClient || !mqttClient->isConnected())
        return done;
 
+   cMetricTimer timer("loop_phase_seconds", "mqttPublish");
+
    json_t* oJson = json_object();
    char* key {nullptr};
 
@@ -426,7 +461,7 @@ int Daemon::mqttNodeRedPublishAction(SensorData& sensor, double value, bool publ
    json_decref(oJson);
    tell(eloNodeRed, "-> (node-red) (%s) [%s]", TARGET "2mqtt/changes", message);
 
-   int status = mqttWriter->write(TARGET "2mqtt/changes", message);
+   int status = mqttClient->write(TARGET "2mqtt/changes", message);
    free(message);
 
    return status;
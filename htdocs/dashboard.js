@@ -136,6 +136,15 @@ function initDashboard(update = false)
          initWidget(key, dashboards[actDashboard].widgets[key]);
          updateWidget(allSensors[key], true, dashboards[actDashboard].widgets[key]);
       }
+
+      // only the sensors of this dashboard are of interest for the updates,
+      //   in setup mode we need all of them to add new widgets
+
+      if (setupMode)
+         socket.send({ "event" : "subscribe", "object" : {} });
+      else
+         socket.send({ "event" : "subscribe", "object" :
+                       { "sensors" : Object.keys(dashboards[actDashboard].widgets) }});
    }
 
    initLightColorDialog();
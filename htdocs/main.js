@@ -588,6 +588,7 @@ function mainMenuSel(what)
    else if (currentPage == "syslog") {
       showProgressDialog();
       event = "syslog";
+      jsonRequest["follow"] = true;
    }
    else if (currentPage == "system")
       event = "system";
@@ -667,6 +668,19 @@ function initLogin()
 
 function showSyslog(log)
 {
+   if (log.append) {
+      // new lines of the followed log, the newest is on top
+
+      var root = document.getElementById("syslogContainer");
+
+      if (root != null && currentPage == "syslog") {
+         var lines = log.lines.split('\n').filter(function(l) { return l != ''; }).reverse();
+         root.innerHTML = lines.join('<br/>') + '<br/>' + root.innerHTML;
+      }
+
+      return;
+   }
+
    $('#container').removeClass('hidden');
    document.getElementById("container").innerHTML = '<div id="syslogContainer" class="log"></div>';
 
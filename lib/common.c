@@ -7,6 +7,7 @@
 
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <fcntl.h>
 #include <math.h>
 
 #ifdef USEUUID
@@ -92,27 +93,49 @@ int Elo::toEloquence(const char* str)
    return na;
 }
 
-void tell(Eloquence elo, const char* format, ...)
-{
-   if (elo && !(eloquence & elo))
-      return ;
+//***************************************************************************
+// Log Ring
+//   bounded lock-free MPSC queue (sequence per slot), the producers format
+//   direct into the slot, the timestamp is formatted by the writer thread
+//***************************************************************************
 
-   const int sizeBuffer = 100000;
-   char t[sizeBuffer+100]; *t = 0;
-   va_list ap;
+#include <atomic>
+#include <pthread.h>
+#include <semaphore.h>
 
-#ifdef VDR_PLUGIN
-   cMutexLock lock(&logMutex);
-#endif
+enum LogRing
+{
+   sizeLogRing = 1024,                // slots, power of 2
+   sizeLogText = 480,                 // inline text, longer messages go to the heap
+   logRepeatFlush = 10,               // [s] report suppressed repeats at least every n seconds
+   logPollInterval = 1000             // [us] poll interval of the writer while busy
+};
 
-   va_start(ap, format);
+struct LogSlot
+{
+   std::atomic<size_t> sequence {0};
+   Eloquence elo {eloAlways};
+   timeval time {};
+   char* heap {nullptr};
+   char text[sizeLogText];
+};
 
-#ifdef VDR_PLUGIN
-   snprintf(t, sizeBuffer, "EPG2VDR: ");
-#endif
+static LogSlot logRing[sizeLogRing];
+static std::atomic<size_t> logEnqueuePos {0};
+static size_t logDequeuePos {0};
+static std::atomic<unsigned long> logDropped {0};
+static std::atomic<bool> logThreadActive {false};
+static std::atomic<bool> logWriterWaiting {false};
+static std::atomic<bool> logThreadClose {false};
+static pthread_t logThread {0};
+static sem_t logSem;
 
-   vsnprintf(t+strlen(t), sizeBuffer-strlen(t), format, ap);
+//***************************************************************************
+// Write Log Line
+//***************************************************************************
 
+static void writeLogLine(Eloquence elo, const timeval* tp, const char* text)
+{
    if (logstdout)
    {
       char buf[50+TB];
@@ -120,25 +143,286 @@ void tell(Eloquence elo, const char* format, ...)
 
       if (logstamp)
       {
-         timeval tp;
-         tm* tm;
+         tm tm;
 
-         gettimeofday(&tp, 0);
-         tm = localtime(&tp.tv_sec);
+         localtime_r(&tp->tv_sec, &tm);
 
          sprintf(buf, "%2.2d:%2.2d:%2.2d,%3.3ld ",
-                 tm->tm_hour, tm->tm_min, tm->tm_sec,
-                 tp.tv_usec / 1000);
+                 tm.tm_hour, tm.tm_min, tm.tm_sec,
+                 tp->tv_usec / 1000);
       }
 
-      printf("%s%s\n", buf, t);
+      printf("%s%s\n", buf, text);
    }
    else
    {
       int prio = elo == eloAlways ? LOG_ERR : LOG_NOTICE;
-      syslog(prio, "%s", t);
+      syslog(prio, "%s", text);
+   }
+}
+
+//***************************************************************************
+// Log Writer Thread
+//   suppresses repeated messages like syslogd ('last message repeated ...')
+//***************************************************************************
+
+static void* logWriter(void*)
+{
+   std::string last;
+   Eloquence lastElo {eloAlways};
+   timeval lastTime {};
+   int repeated {0};
+   bool idle {true};
+
+   auto flushRepeated = [&]()
+   {
+      if (!repeated)
+         return;
+
+      char msg[100];
+      sprintf(msg, "last message repeated %d times", repeated);
+      writeLogLine(lastElo, &lastTime, msg);
+      repeated = 0;
+   };
+
+   while (true)
+   {
+      // the producers only wake us if we are waiting, while messages are
+      //   coming in we poll in short intervals to save them the syscall
+
+      if (!idle)
+      {
+         usleep(logPollInterval);
+         idle = true;
+      }
+      else
+      {
+         logWriterWaiting.store(true);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+
+         if (logRing[logDequeuePos & (sizeLogRing-1)].sequence.load(std::memory_order_acquire) != logDequeuePos + 1)
+         {
+            timespec timeout;
+            clock_gettime(CLOCK_REALTIME, &timeout);
+            timeout.tv_sec += 1;
+
+            sem_timedwait(&logSem, &timeout);
+         }
+
+         logWriterWaiting.store(false);
+      }
+
+      while (true)
+      {
+         LogSlot* slot = &logRing[logDequeuePos & (sizeLogRing-1)];
+
+         if (slot->sequence.load(std::memory_order_acquire) != logDequeuePos + 1)
+            break;
+
+         const char* text = slot->heap ? slot->heap : slot->text;
+         idle = false;
+
+         if (slot->elo == lastElo && last == text)
+         {
+            repeated++;
+            lastTime = slot->time;
+         }
+         else
+         {
+            flushRepeated();
+            writeLogLine(slot->elo, &slot->time, text);
+            last = text;
+            lastElo = slot->elo;
+            lastTime = slot->time;
+         }
+
+         free(slot->heap);
+         slot->heap = nullptr;
+         slot->sequence.store(logDequeuePos + sizeLogRing, std::memory_order_release);
+         logDequeuePos++;
+      }
+
+      unsigned long dropped = logDropped.exchange(0);
+
+      if (dropped)
+      {
+         char msg[100];
+         timeval now;
+         gettimeofday(&now, 0);
+         flushRepeated();
+         sprintf(msg, "Warning: Log ring overflow, %lu messages dropped", dropped);
+         writeLogLine(eloAlways, &now, msg);
+      }
+
+      if (repeated && lastTime.tv_sec < time(0) - logRepeatFlush)
+         flushRepeated();
+
+      if (logThreadClose)
+         break;
+
+      if (logstdout)
+         fflush(stdout);
+   }
+
+   flushRepeated();
+
+   return nullptr;
+}
+
+int startLogThread()
+{
+   if (logThreadActive)
+      return done;
+
+   for (size_t i = 0; i < sizeLogRing; i++)
+      logRing[i].sequence.store(i, std::memory_order_relaxed);
+
+   logEnqueuePos = 0;
+   logDequeuePos = 0;
+   logThreadClose = false;
+   sem_init(&logSem, 0, 0);
+
+   if (pthread_create(&logThread, nullptr, logWriter, nullptr))
+   {
+      sem_destroy(&logSem);
+      return fail;
+   }
+
+   logThreadActive = true;
+   atexit([]() { stopLogThread(); });
+
+   return success;
+}
+
+int stopLogThread()
+{
+   if (!logThreadActive)
+      return done;
+
+   logThreadActive = false;                  // new messages are written synchronous
+   logThreadClose = true;
+   sem_post(&logSem);
+   pthread_join(logThread, nullptr);
+   sem_destroy(&logSem);
+   logThread = 0;
+
+   // drain the messages of producers which reserved their slot before they
+   //   saw the stop, wait a moment for the ones still formatting
+
+   for (int i = 0; i < 100 && logDequeuePos != logEnqueuePos.load(); )
+   {
+      LogSlot* slot = &logRing[logDequeuePos & (sizeLogRing-1)];
+
+      if (slot->sequence.load(std::memory_order_acquire) != logDequeuePos + 1)
+      {
+         usleep(logPollInterval);
+         i++;
+         continue;
+      }
+
+      writeLogLine(slot->elo, &slot->time, slot->heap ? slot->heap : slot->text);
+      free(slot->heap);
+      slot->heap = nullptr;
+      slot->sequence.store(logDequeuePos + sizeLogRing, std::memory_order_release);
+      logDequeuePos++;
    }
 
+   if (logstdout)
+      fflush(stdout);
+
+   return success;
+}
+
+//***************************************************************************
+// Tell
+//   use it by the macro tell() which skips disabled levels
+//***************************************************************************
+
+void tellImpl(Eloquence elo, const char* format, ...)
+{
+   if (elo && !(eloquence & elo))
+      return ;
+
+   va_list ap;
+
+   if (logThreadActive)
+   {
+      // reserve a slot
+
+      size_t pos = logEnqueuePos.load(std::memory_order_relaxed);
+      LogSlot* slot {nullptr};
+
+      while (true)
+      {
+         slot = &logRing[pos & (sizeLogRing-1)];
+         intptr_t dif = (intptr_t)slot->sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+
+         if (dif == 0)
+         {
+            if (logEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+               break;
+         }
+         else if (dif < 0)
+         {
+            slot = nullptr;                  // ring is full
+            break;
+         }
+         else
+            pos = logEnqueuePos.load(std::memory_order_relaxed);
+      }
+
+      if (slot)
+      {
+         slot->elo = elo;
+         gettimeofday(&slot->time, 0);
+
+         va_start(ap, format);
+         int len = vsnprintf(slot->text, sizeLogText, format, ap);
+         va_end(ap);
+
+         if (len >= sizeLogText && (slot->heap = (char*)malloc(len+TB)))
+         {
+            va_start(ap, format);
+            vsnprintf(slot->heap, len+TB, format, ap);
+            va_end(ap);
+         }
+
+         slot->sequence.store(pos + 1, std::memory_order_release);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+
+         if (logWriterWaiting.load())
+            sem_post(&logSem);
+
+         return;
+      }
+
+      // don't lose the errors, the debug messages are only counted
+
+      if (elo != eloAlways)
+      {
+         logDropped++;
+         return;
+      }
+   }
+
+   const int sizeBuffer = 100000;
+   char t[sizeBuffer+100]; *t = 0;
+   timeval tp;
+
+#ifdef VDR_PLUGIN
+   cMutexLock lock(&logMutex);
+#endif
+
+   va_start(ap, format);
+
+#ifdef VDR_PLUGIN
+   snprintf(t, sizeBuffer, "EPG2VDR: ");
+#endif
+
+   vsnprintf(t+strlen(t), sizeBuffer-strlen(t), format, ap);
+   gettimeofday(&tp, 0);
+   writeLogLine(elo, &tp, t);
+
    va_end(ap);
 }
 
@@ -1073,6 +1357,221 @@ int loadLinesFromFile(const char* infile, std::vector<std::string>& lines, bool
    return success;
 }
 
+//***************************************************************************
+// Load Tail From File
+//   the last maxLines lines (with LF) in file order, reading backwards in
+//   blocks - independent of the file size
+//***************************************************************************
+
+int loadTailFromFile(const char* infile, size_t maxLines, std::vector<std::string>& lines, off_t until)
+{
+   const off_t sizeBlock {64*1024};
+   struct stat st;
+   int fd {na};
+
+   if ((fd = open(infile, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+   {
+      tell(eloAlways, "Error, can't open '%s' for reading, error was '%s'", infile, strerror(errno));
+
+      if (fd >= 0)
+         close(fd);
+
+      return fail;
+   }
+
+   // read only up to 'until' if given, the rest is delivered by a follower
+
+   off_t fileSize = until >= 0 && until < st.st_size ? until : st.st_size;
+   std::string tail;
+   off_t pos = fileSize;
+   size_t count {0};
+   bool complete {false};
+
+   while (pos > 0 && !complete)
+   {
+      off_t size = std::min(pos, sizeBlock);
+      std::string block(size, '\0');
+
+      pos -= size;
+
+      if (pread(fd, &block[0], size, pos) != size)
+         break;
+
+      // count the line ends backwards, the LF at the end of the file doesn't start a line
+
+      for (off_t i = size-1; i >= 0; i--)
+      {
+         if (block[i] != '\n' || pos + i == fileSize - 1)
+            continue;
+
+         if (++count == maxLines)
+         {
+            block.erase(0, i+1);
+            complete = true;
+            break;
+         }
+      }
+
+      tail.insert(0, block);
+   }
+
+   close(fd);
+
+   size_t start {0};
+
+   while (start < tail.length())
+   {
+      size_t end = tail.find('\n', start);
+
+      if (end == std::string::npos)
+         end = tail.length() - 1;
+
+      lines.push_back(tail.substr(start, end - start + 1));
+      start = end + 1;
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// File Follower
+//***************************************************************************
+
+#include <sys/inotify.h>
+
+int cFileFollower::start()
+{
+   struct stat st;
+
+   if (fd < 0 && (fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+   {
+      tell(eloAlways, "Error: inotify_init failed, %s", strerror(errno));
+      return fail;
+   }
+
+   offset = stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+   partial.clear();
+
+   return watch();
+}
+
+int cFileFollower::watch()
+{
+   if (wd >= 0)
+      inotify_rm_watch(fd, wd);
+
+   wd = inotify_add_watch(fd, path.c_str(), IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF | IN_ATTRIB);
+
+   return wd < 0 ? fail : success;
+}
+
+void cFileFollower::stop()
+{
+   if (fd >= 0)
+      close(fd);
+
+   fd = na;
+   wd = na;
+}
+
+int cFileFollower::read(std::string& lines)
+{
+   char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+   bool modified {false};
+   bool rotated {false};
+   ssize_t len {0};
+
+   if (fd < 0)
+      return no;
+
+   while ((len = ::read(fd, events, sizeof(events))) > 0)
+   {
+      for (char* p = events; p < events + len; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len)
+      {
+         const struct inotify_event* event = (const struct inotify_event*)p;
+
+         if (event->wd != wd)
+            continue;                    // of a previous watch
+
+         if (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED))
+            rotated = true;
+         else
+            modified = true;
+      }
+   }
+
+   // the file was rotated -> follow the new one (retry until it exists)
+
+   if (rotated || wd < 0)
+   {
+      if (watch() != success)
+         return no;
+
+      offset = 0;
+      partial.clear();
+      modified = true;
+   }
+
+   if (!modified)
+      return no;
+
+   int file = open(path.c_str(), O_RDONLY);
+   struct stat st;
+
+   if (file < 0)
+      return no;
+
+   if (fstat(file, &st) == 0 && st.st_size < offset)
+   {
+      offset = 0;                        // truncated
+      partial.clear();
+   }
+
+   char buffer[16*1024];
+
+   while ((len = pread(file, buffer, sizeof(buffer), offset)) > 0)
+   {
+      partial.append(buffer, len);
+      offset += len;
+   }
+
+   close(file);
+
+   size_t end = partial.rfind('\n');
+
+   if (end == std::string::npos)
+      return no;
+
+   lines = partial.substr(0, end+1);
+   partial.erase(0, end+1);
+
+   return yes;
+}
+
+int cFileFollower::readFrom(off_t from, std::string& lines)
+{
+   off_t end = linesEnd();
+
+   if (from < 0 || from >= end)
+      return no;
+
+   int file = open(path.c_str(), O_RDONLY);
+
+   if (file < 0)
+      return no;
+
+   lines.assign(end - from, '\0');
+   ssize_t len = pread(file, &lines[0], end - from, from);
+   close(file);
+
+   if (len <= 0)
+      return no;
+
+   lines.resize(len);
+
+   return yes;
+}
+
 bool fctImageSort(FileInfo& v1, FileInfo& v2)
 {
    return v1.name < v2.name;
@@ -127,7 +127,27 @@ extern Eloquence argEloquence;
 extern bool logstdout;
 extern bool logstamp;
 
-void __attribute__ ((format(printf, 2, 3))) tell(Eloquence eloquence, const char* format, ...);
+// build with NO_DEBUG_LOG to compile out the debug levels completely
+
+#ifdef NO_DEBUG_LOG
+  const int eloCompiled = ~(eloDebug | eloDebug2 | eloDebugWebSock | eloDebugDb | eloDebugDeconz | eloDebugHomeMatic);
+#else
+  const int eloCompiled = ~0;
+#endif
+
+inline bool tellEnabled(int elo) { return !elo || ((elo & eloCompiled) && (eloquence & elo)); }
+
+void __attribute__ ((format(printf, 2, 3))) tellImpl(Eloquence eloquence, const char* format, ...);
+
+// the arguments are only evaluated if the level is enabled
+
+#define tell(elo, ...) do { if (tellEnabled(elo)) tellImpl(elo, __VA_ARGS__); } while (0)
+
+// asynchronous logging - the messages are queued in a ring buffer and
+//   written by a dedicated thread, start it after fork() !
+
+int startLogThread();
+int stopLogThread();
 
 //***************************************************************************
 //
@@ -389,8 +409,40 @@ int removeFile(const char* filename);
 int chkDir(const char* path);
 int loadFromFile(const char* infile, MemoryStruct* data);
 int loadLinesFromFile(const char* infile, std::vector<std::string>& lines, bool removeLF = true);
+int loadTailFromFile(const char* infile, size_t maxLines, std::vector<std::string>& lines, off_t until = na);
 int storeToFile(const char* filename, const char* data, int size = 0);
 
+//***************************************************************************
+// File Follower
+//   new lines appended to a (log) file, notified by inotify, survives
+//   rotation and truncation of the file
+//***************************************************************************
+
+class cFileFollower
+{
+   public:
+
+      cFileFollower(const char* aPath)  { path = aPath; }
+      ~cFileFollower()                  { stop(); }
+
+      int start();
+      void stop();
+      int read(std::string& lines);      // yes if new complete lines are available
+      int readFrom(off_t from, std::string& lines);   // the lines [from, linesEnd()) again
+      off_t linesEnd() const            { return offset - partial.length(); }
+      const char* getPath()             { return path.c_str(); }
+
+   private:
+
+      int watch();
+
+      std::string path;
+      int fd {na};
+      int wd {na};
+      off_t offset {0};
+      std::string partial;               // incomplete last line
+};
+
 struct FsStat
 {
    double total;
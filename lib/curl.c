@@ -5,6 +5,9 @@
  *
  */
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "curl.h"
 
 //***************************************************************************
@@ -12,6 +15,7 @@
 //***************************************************************************
 
 cCurl curl;
+cHttpClient httpClient;
 
 std::string cCurl::sBuf = "";
 int cCurl::curlInitialized = no;
@@ -579,3 +583,402 @@ int cCurl::put(const char* url, const std::string& sPost, std::string* sOutput)
 
    return res;
 }
+
+//***************************************************************************
+// Class cHttpClient
+//***************************************************************************
+
+cHttpClient::cHttpClient()
+   : cThread("http-client", true)
+{
+}
+
+cHttpClient::~cHttpClient()
+{
+   stop();
+}
+
+//***************************************************************************
+// Start / Stop
+//   cCurl::create() has to be called before!
+//***************************************************************************
+
+int cHttpClient::start()
+{
+   if (multi)
+      return done;
+
+   if (!(multi = curl_multi_init()))
+   {
+      tell(eloAlways, "Error: Could not create curl multi handle");
+      return fail;
+   }
+
+   curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)maxHostConnections);
+   curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)maxCachedConnections);
+   curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+#if LIBCURL_VERSION_NUM < 0x074400
+   if (pipe2(wakeupPipe, O_NONBLOCK | O_CLOEXEC) != 0)
+   {
+      tell(eloAlways, "Error: Could not create wakeup pipe, %s", strerror(errno));
+      curl_multi_cleanup(multi);
+      multi = nullptr;
+      return fail;
+   }
+#endif
+
+   if (!Start())
+   {
+      curl_multi_cleanup(multi);
+      multi = nullptr;
+      return fail;
+   }
+
+   return success;
+}
+
+int cHttpClient::stop()
+{
+   if (!multi)
+      return done;
+
+   running = false;
+   wakeup();
+   Cancel(5);
+
+#if LIBCURL_VERSION_NUM < 0x074400
+   close(wakeupPipe[0]);
+   close(wakeupPipe[1]);
+   wakeupPipe[0] = wakeupPipe[1] = na;
+#endif
+
+   // the thread is gone, cleanup without lock
+
+   for (auto handle : idleHandles)
+      curl_easy_cleanup(handle);
+
+   idleHandles.clear();
+
+   for (auto q : { &pending, &finished })
+   {
+      while (!q->empty())
+      {
+         Request* request = q->front();
+         q->pop();
+
+         if (request->waiter)
+            request->waiter->Signal();
+         else
+            delete request;
+      }
+   }
+
+   curl_multi_cleanup(multi);
+   multi = nullptr;
+
+   return done;
+}
+
+//***************************************************************************
+// Get / Put / Post
+//***************************************************************************
+
+int cHttpClient::get(const char* url, cCallback callback, int timeout)
+{
+   return enqueue(new Request{"GET", url, "", timeout, callback});
+}
+
+int cHttpClient::put(const char* url, const char* payload, cCallback callback, int timeout)
+{
+   return enqueue(new Request{"PUT", url, payload ? payload : "", timeout, callback});
+}
+
+int cHttpClient::post(const char* url, const char* payload, cCallback callback, int timeout)
+{
+   return enqueue(new Request{"POST", url, payload ? payload : "", timeout, callback});
+}
+
+//***************************************************************************
+// Perform - synchronous request, don't call it from a callback!
+//***************************************************************************
+
+int cHttpClient::perform(const char* method, const char* url, const char* payload, Response& response, int timeout)
+{
+   cCondWait waiter;
+   Request request {method, url, payload ? payload : "", timeout};
+
+   request.waiter = &waiter;
+
+   if (enqueue(&request) != success)
+      return fail;
+
+   waiter.Wait();                  // the request is finished or dropped by stop()
+   response = request.response;
+
+   return response.ok() ? success : fail;
+}
+
+//***************************************************************************
+// Enqueue
+//***************************************************************************
+
+int cHttpClient::enqueue(Request* request)
+{
+   if (!multi || !Running())
+   {
+      tell(eloAlways, "Error: HTTP client not running, dropping request to '%s'", request->url.c_str());
+
+      if (!request->waiter)
+         delete request;
+
+      return fail;
+   }
+
+   {
+      cMyMutexLock lock(&mutex);
+      request->proxy = proxy;
+      pending.push(request);
+   }
+
+   wakeup();
+
+   return success;
+}
+
+//***************************************************************************
+// Set Proxy
+//   like cCurl::init(), applied to the requests enqueued afterwards
+//***************************************************************************
+
+void cHttpClient::setProxy(const char* httpproxy)
+{
+   cMyMutexLock lock(&mutex);
+   proxy = !isEmpty(httpproxy) ? httpproxy : "";
+}
+
+//***************************************************************************
+// Wakeup / Wait For Activity
+//   before libcurl 7.68.0 there is no curl_multi_wakeup(), the client thread
+//   waits with curl_multi_wait() for the transfers and a wakeup pipe instead
+//***************************************************************************
+
+void cHttpClient::wakeup()
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+   curl_multi_wakeup(multi);
+#else
+   char c {0};
+
+   if (write(wakeupPipe[1], &c, 1) < 0 && errno != EAGAIN)
+      tell(eloAlways, "Error: Wakeup of HTTP client failed, %s", strerror(errno));
+#endif
+}
+
+void cHttpClient::waitForActivity(int timeoutMs)
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+   curl_multi_poll(multi, nullptr, 0, timeoutMs, nullptr);
+#else
+   curl_waitfd waitFd {};
+   char buf[64];
+
+   waitFd.fd = wakeupPipe[0];
+   waitFd.events = CURL_WAIT_POLLIN;
+
+   curl_multi_wait(multi, &waitFd, 1, timeoutMs, nullptr);
+
+   while (read(wakeupPipe[0], buf, sizeof(buf)) > 0)
+      ;
+#endif
+}
+
+//***************************************************************************
+// Dispatch - call the callbacks of the finished requests
+//***************************************************************************
+
+int cHttpClient::dispatch()
+{
+   std::queue<Request*> ready;
+
+   {
+      cMyMutexLock lock(&mutex);
+
+      if (finished.empty())
+         return done;
+
+      ready.swap(finished);
+   }
+
+   while (!ready.empty())
+   {
+      Request* request = ready.front();
+      ready.pop();
+
+      if (request->callback)
+         request->callback(request->response);
+
+      delete request;
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Setup - only called in context of the client thread
+//***************************************************************************
+
+int cHttpClient::setup(Request* request)
+{
+   if (idleHandles.size())
+   {
+      request->handle = idleHandles.back();
+      idleHandles.pop_back();
+      curl_easy_reset(request->handle);
+   }
+   else if (!(request->handle = curl_easy_init()))
+   {
+      tell(eloAlways, "Could not create new curl instance");
+      return fail;
+   }
+
+   CURL* handle = request->handle;
+
+   curl_easy_setopt(handle, CURLOPT_URL, request->url.c_str());
+   curl_easy_setopt(handle, CURLOPT_PRIVATE, request);
+   curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, writeCallback);
+   curl_easy_setopt(handle, CURLOPT_WRITEDATA, &request->response.data);
+   curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, yes);
+   curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 1);
+   curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1);
+   curl_easy_setopt(handle, CURLOPT_TIMEOUT, (long)request->timeout);
+   curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, (long)connectTimeout);
+   curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+   curl_easy_setopt(handle, CURLOPT_USERAGENT, CURL_USERAGENT);
+   curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, "");
+
+   if (!request->proxy.empty())
+   {
+      curl_easy_setopt(handle, CURLOPT_PROXYTYPE, CURLPROXY_HTTP);
+      curl_easy_setopt(handle, CURLOPT_PROXY, request->proxy.c_str());   // Specify HTTP proxy
+   }
+
+   if (request->method != "GET")
+   {
+      request->headers = curl_slist_append(request->headers, "Accept: application/json");
+      request->headers = curl_slist_append(request->headers, "Content-Type: application/json; charset=utf-8");
+
+      curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, request->method.c_str());
+      curl_easy_setopt(handle, CURLOPT_HTTPHEADER, request->headers);
+      curl_easy_setopt(handle, CURLOPT_POSTFIELDS, request->payload.c_str());
+      curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, (long)request->payload.length());
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Finish - only called in context of the client thread
+//***************************************************************************
+
+void cHttpClient::finish(Request* request)
+{
+   if (request->handle)
+   {
+      curl_easy_getinfo(request->handle, CURLINFO_RESPONSE_CODE, &request->response.code);
+      idleHandles.push_back(request->handle);
+      request->handle = nullptr;
+   }
+
+   curl_slist_free_all(request->headers);
+   request->headers = nullptr;
+
+   if (request->response.result != CURLE_OK)
+      tell(eloAlways, "Error: %s '%s' failed; %s (%d)", request->method.c_str(), request->url.c_str(),
+           curl_easy_strerror(request->response.result), request->response.result);
+
+   if (request->waiter)
+   {
+      request->waiter->Signal();
+      return;
+   }
+
+   cMyMutexLock lock(&mutex);
+   finished.push(request);
+}
+
+//***************************************************************************
+// Action
+//***************************************************************************
+
+void cHttpClient::action()
+{
+   while (Running())
+   {
+      std::queue<Request*> requests;
+
+      {
+         cMyMutexLock lock(&mutex);
+         requests.swap(pending);
+      }
+
+      while (!requests.empty())
+      {
+         Request* request = requests.front();
+         requests.pop();
+
+         if (setup(request) != success)
+         {
+            request->response.result = CURLE_FAILED_INIT;
+            finish(request);
+            continue;
+         }
+
+         curl_multi_add_handle(multi, request->handle);
+         inFlight.insert(request);
+      }
+
+      int active {0};
+      curl_multi_perform(multi, &active);
+
+      int left {0};
+      CURLMsg* msg {nullptr};
+
+      while ((msg = curl_multi_info_read(multi, &left)))
+      {
+         if (msg->msg != CURLMSG_DONE)
+            continue;
+
+         Request* request {nullptr};
+         curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&request);
+         curl_multi_remove_handle(multi, msg->easy_handle);
+         inFlight.erase(request);
+
+         request->response.result = msg->data.result;
+         finish(request);
+      }
+
+      waitForActivity(1000);
+   }
+
+   // abort the requests in flight, they are dropped by stop()
+
+   for (auto request : inFlight)
+   {
+      curl_multi_remove_handle(multi, request->handle);
+      request->response.result = CURLE_ABORTED_BY_CALLBACK;
+      finish(request);
+   }
+
+   inFlight.clear();
+}
+
+//***************************************************************************
+// Write Callback
+//***************************************************************************
+
+size_t cHttpClient::writeCallback(void* ptr, size_t size, size_t nmemb, void* data)
+{
+   ((std::string*)data)->append((const char*)ptr, size * nmemb);
+   return size * nmemb;
+}
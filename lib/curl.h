@@ -12,8 +12,13 @@
 #include <curl/easy.h>
 
 #include <string>
+#include <queue>
+#include <set>
+#include <vector>
+#include <functional>
 
 #include "common.h"
+#include "thread.h"
 //#include "config.h"
 //#include "configuration.h"
 
@@ -75,5 +80,89 @@ class cCurl
 
 extern cCurl curl;
 
+//***************************************************************************
+// HTTP Client
+//   shared client on a curl multi handle, the requests are performed in
+//   parallel by the client thread and the connections are kept alive and
+//   reused by following requests to the same host.
+//   The callbacks are called by dispatch() in context of the caller
+//   (the main loop of the daemon)
+//***************************************************************************
+
+class cHttpClient : public cThread
+{
+   public:
+
+      struct Response
+      {
+         CURLcode result {CURLE_OK};
+         long code {0};                  // HTTP status code
+         std::string data;
+
+         bool ok() const  { return result == CURLE_OK && code >= 200 && code < 300; }
+      };
+
+      typedef std::function<void(const Response& response)> cCallback;
+
+      enum Misc
+      {
+         maxHostConnections = 10,        // parallel connections to the same host
+         maxCachedConnections = 20,
+         connectTimeout = 5              // seconds
+      };
+
+      cHttpClient();
+      virtual ~cHttpClient();
+
+      int start();
+      int stop();
+      void setProxy(const char* httpproxy);
+
+      int get(const char* url, cCallback callback, int timeout = 30);
+      int put(const char* url, const char* payload, cCallback callback, int timeout = 30);
+      int post(const char* url, const char* payload, cCallback callback, int timeout = 30);
+      int perform(const char* method, const char* url, const char* payload, Response& response, int timeout = 30);
+      int dispatch();
+
+   protected:
+
+      struct Request
+      {
+         std::string method;
+         std::string url;
+         std::string payload;
+         int timeout {30};
+         cCallback callback;
+         cCondWait* waiter {nullptr};    // set for synchronous requests
+         Response response;
+         CURL* handle {nullptr};
+         struct curl_slist* headers {nullptr};
+         std::string proxy;              // set by enqueue()
+      };
+
+      void action() override;
+
+      void wakeup();
+      void waitForActivity(int timeoutMs);
+      int enqueue(Request* request);
+      int setup(Request* request);
+      void finish(Request* request);
+
+      static size_t writeCallback(void* ptr, size_t size, size_t nmemb, void* data);
+
+      CURLM* multi {nullptr};
+      std::string proxy;                  // HTTP proxy of all requests, protected by cThread::mutex
+      std::queue<Request*> pending;       // not yet added to the multi handle, protected by cThread::mutex
+      std::queue<Request*> finished;      // waiting for dispatch(), protected by cThread::mutex
+      std::set<Request*> inFlight;        // only accessed by the client thread
+      std::vector<CURL*> idleHandles;     // only accessed by the client thread
+
+#if LIBCURL_VERSION_NUM < 0x074400        // no curl_multi_poll() and curl_multi_wakeup() before 7.68.0
+      int wakeupPipe[2] {na, na};
+#endif
+};
+
+extern cHttpClient httpClient;
+
 //***************************************************************************
 #endif // __LIB_CURL__
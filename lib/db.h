@@ -15,16 +15,55 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <errno.h>
-
-#include <mysql.h>
+#include <time.h>
 
 #include <list>
 
 #include "common.h"
 #include "dbdict.h"
+#include "metrics.h"
 
 class cDbTable;
 class cDbConnection;
+class cDbValue;
+
+//***************************************************************************
+// Backend
+//   selected at build time, MySQL/MariaDB (default) or embedded SQLite
+//   (USESQLITE), the backend specific parts are implemented in
+//   dbmysql.c / dbsqlite.c
+//***************************************************************************
+
+#ifdef USESQLITE
+
+#include <sqlite3.h>
+
+typedef sqlite3 cDbHandle;
+typedef sqlite3_stmt cDbStmtHandle;
+typedef cDbValue* cDbBind;            // the values are bound/read on execute() and fetch()
+typedef char cDbBool;
+
+struct cDbTime
+{
+   unsigned int year;
+   unsigned int month;
+   unsigned int day;
+   unsigned int hour;
+   unsigned int minute;
+   unsigned int second;
+};
+
+#else
+
+#include <mysql.h>
+
+typedef MYSQL cDbHandle;
+typedef MYSQL_STMT cDbStmtHandle;
+typedef MYSQL_BIND cDbBind;
+typedef MYSQL_TIME cDbTime;
+typedef my_bool cDbBool;
+
+#endif
 
 //***************************************************************************
 // cDbValue
@@ -414,9 +453,9 @@ class cDbValue : public cDbService
       char* getStrValueRef()               { return strValue; }
       long* getIntValueRef()               { return &numValue; }
       int64_t* getBigIntValueRef()         { return &longlongValue; }
-      MYSQL_TIME* getTimeValueRef()        { return &timeValue; }
+      cDbTime* getTimeValueRef()           { return &timeValue; }
       float* getFloatValueRef()            { return &floatValue; }
-      my_bool* getNullRef()                { return &nullValue; }
+      cDbBool* getNullRef()                { return &nullValue; }
 
    private:
 
@@ -425,10 +464,10 @@ class cDbValue : public cDbService
       long numValue;
       int64_t longlongValue;
       float floatValue;
-      MYSQL_TIME timeValue;
+      cDbTime timeValue;
       char* strValue;
       unsigned long strValueSize;
-      my_bool nullValue;
+      cDbBool nullValue;
       int changed;
 };
 
@@ -483,6 +522,17 @@ class cDbStatement : public cDbService
       cDbTable* getTable() { return table; }
       void showStat();
 
+      // streaming mode - call before prepare(), the rows are read one by one
+      //   from the connection instead of buffering the whole result on client
+      //   side (MySQL: no mysql_stmt_store_result() and no server side cursor,
+      //   which MariaDB would materialize in a temporary table). Until the
+      //   last row is fetched or freeResult() is called the connection can't
+      //   execute other statements! getAffected() only reports if a first row
+      //   was found (1) or not (0) in this mode.
+
+      int setStreaming();
+      int isStreaming()    { return streaming; }
+
       // data
 
       static int explain;         // debug explain
@@ -490,22 +540,24 @@ class cDbStatement : public cDbService
    private:
 
       std::string stmtTxt;
-      MYSQL_STMT* stmt;
+      cDbStmtHandle* stmt;
       int affected;
       cDbConnection* connection;
       cDbTable* table;
       int inCount;
-      MYSQL_BIND* inBind;         // to db
+      cDbBind* inBind;            // to db
       int outCount;
-      MYSQL_BIND* outBind;        // from db (result)
-      MYSQL_RES* metaResult;
+      cDbBind* outBind;           // from db (result)
       const char* bindPrefix;
       int firstExec;              // debug explain
       int buildErrors;
+      int streaming;              // unbuffered, rows are fetched from the connection
+      int rowPending;             // SQLite - the next row is already stepped (look ahead)
 
       unsigned long callsPeriod;
       unsigned long callsTotal;
       double duration;
+      cMetricHistogram* histogram;  // 'db_statement_seconds' of this statement text, looked up on first execute
 };
 
 //***************************************************************************
@@ -704,10 +756,11 @@ class cDbConnection
 
       cDbConnection()
       {
-         mysql = 0;
+         handle = 0;
          attached = 0;
          inTact = no;
          connectDropped = yes;
+         streamingStatement = 0;
       }
 
       virtual ~cDbConnection()
@@ -715,50 +768,9 @@ class cDbConnection
          close();
       }
 
-      int isConnected() { return getMySql() != 0; }
-
-      int attachConnection()
-      {
-         static int first = yes;
-
-         if (!mysql)
-         {
-            connectDropped = yes;
-
-            tell(eloDb, "Calling mysql_init(%ld)", syscall(__NR_gettid));
+      int isConnected() { return getHandle() != 0; }
 
-            if (!(mysql = mysql_init(0)))
-               return errorSql(this, "attachConnection(init)");
-
-            if (!mysql_real_connect(mysql, dbHost, dbUser, dbPass, dbName, dbPort, 0, 0))
-            {
-               errorSql(this, "connecting to database");
-               tell(eloAlways, "Error, connecting to database at '%s' on port (%d) failed", dbHost, dbPort);
-               close();
-               return fail;
-            }
-
-            connectDropped = no;
-
-            // init encoding
-
-            if (encoding && *encoding)
-            {
-               if (mysql_set_character_set(mysql, encoding))
-                  errorSql(this, "init(character_set)");
-
-               if (first)
-               {
-                  tell(eloAlways, "SQL client character now '%s'", mysql_character_set_name(mysql));
-                  first = no;
-               }
-            }
-         }
-
-         attached++;
-
-         return success;
-      }
+      int attachConnection();
 
       void detachConnection()
       {
@@ -768,18 +780,7 @@ class cDbConnection
             close();
       }
 
-      void close()
-      {
-         if (mysql)
-         {
-            tell(eloDb, "Closing mysql connection and calling mysql_thread_end(%ld)", syscall(__NR_gettid));
-
-            mysql_close(mysql);
-            mysql_thread_end();
-            mysql = 0;
-            attached = 0;
-         }
-      }
+      void close();
 
       int check()
       {
@@ -804,87 +805,13 @@ class cDbConnection
          return vquery(format, more);
       }
 
-      virtual int __attribute__ ((format(printf, 3, 4))) query(int& count, const char* format, ...)
-      {
-         int status;
-         va_list more;
-
-         count = 0;
-
-         if (!format)
-            return fail;
-
-         va_start(more, format);
-
-         if ((status = vquery(format, more)) == success)
-         {
-            MYSQL_RES* res;
-            MYSQL_ROW data;
-
-            // get affected rows ..
-
-            if ((res = mysql_store_result(getMySql())))
-            {
-               data = mysql_fetch_row(res);
-
-               if (data)
-                  count = atoi(data[0]);
-
-               mysql_free_result(res);
-            }
-         }
-
-         return status;
-      }
-
-      virtual int vquery(const char* format, va_list more)
-      {
-         int status = 1;
-         MYSQL* h = getMySql();
-
-         if (h && format)
-         {
-            char* stmt;
-
-            vasprintf(&stmt, format, more);
-
-            if ((status = mysql_query(h, stmt)))
-               errorSql(this, stmt);
-
-            free(stmt);
-         }
-
-         return status ? fail : success;
-      }
-
-      virtual void queryReset()
-      {
-         if (getMySql())
-         {
-            MYSQL_RES* result = mysql_use_result(getMySql());
-            mysql_free_result(result);
-         }
-      }
+      virtual int __attribute__ ((format(printf, 3, 4))) query(int& count, const char* format, ...);
+      virtual int vquery(const char* format, va_list more);
+      virtual void queryReset();
 
       // escapeSqlString - only need to be used in string statements not in bind values!!
 
-      virtual std::string escapeSqlString(const char* str)
-      {
-         std::string result = "";
-
-         if (!isConnected())
-            return result;
-
-         int length = strlen(str);
-         int bufferSize = length*2 + TB;
-
-         char* buffer = (char*)malloc(bufferSize);
-         mysql_real_escape_string(getMySql(), buffer, str, length);
-         result = buffer;
-         free(buffer);
-
-         return result;
-      }
+      virtual std::string escapeSqlString(const char* str);
 
       virtual int executeSqlFile(const char* file)
       {
@@ -894,7 +821,7 @@ class cDbConnection
          int size = 1000;
          int nread = 0;
 
-         if (!getMySql())
+         if (!getHandle())
             return fail;
 
          if (!(f = fopen(file, "r")))
@@ -930,11 +857,7 @@ class cDbConnection
          return success;
       }
 
-      virtual int startTransaction()
-      {
-         inTact = yes;
-         return query("START TRANSACTION");
-      }
+      virtual int startTransaction();
 
       virtual int commit()
       {
@@ -950,17 +873,24 @@ class cDbConnection
 
       virtual int inTransaction() { return inTact; }
 
-      MYSQL* getMySql()
+      int tableExists(const char* name);
+
+      cDbHandle* getHandle()
       {
          if (connectDropped)
             close();
 
-         return mysql;
+         return handle;
       }
 
       int getAttachedCount()                         { return attached; }
+
+      // the statement with a not yet drained streaming result (blocks the connection)
+
+      void setStreamingStatement(cDbStatement* s)    { streamingStatement = s; }
+      cDbStatement* getStreamingStatement()          { return streamingStatement; }
       void showStat(const char* name = "")           { statements.showStat(name); }
-      int errorSql(cDbConnection* mysql, const char* prefix, MYSQL_STMT* stmt = 0, const char* stmtTxt = 0);
+      int errorSql(cDbConnection* connection, const char* prefix, cDbStmtHandle* stmt = 0, const char* stmtTxt = 0);
 
       // data
 
@@ -989,69 +919,18 @@ class cDbConnection
       // -----------------------------------------------------------
       // init() and exit() must exactly called 'once' per process
 
-      static int init()
-      {
-         int status = success;
-
-         initMutex.Lock();
-
-         if (!initThreads)
-         {
-            tell(eloDebugDb, "Info: Calling mysql_library_init()");
-
-            if (mysql_library_init(0, 0, 0))
-            {
-               tell(eloAlways, "Error: mysql_library_init() failed");
-               status = fail;
-            }
-         }
-         else
-         {
-            tell(eloDebugDb, "Info: Skipping calling mysql_library_init(), it's already done!");
-         }
-
-         initThreads++;
-         initMutex.Unlock();
-
-         return status;
-      }
-
-      static int exit()
-      {
-         initMutex.Lock();
-
-         initThreads--;
-
-         if (!initThreads)
-         {
-            tell(eloDetail, "Info: Released the last usage of mysql_lib, calling mysql_library_end() now");
-            mysql_library_end();
-
-            free(dbHost);
-            free(dbUser);
-            free(dbPass);
-            free(dbName);
-            free(encoding);
-            free(confPath);
-         }
-         else
-         {
-            tell(eloDetail, "Info: The mysql_lib is still in use, skipping mysql_library_end() call");
-         }
-
-         initMutex.Unlock();
-
-         return done;
-      }
+      static int init();
+      static int exit();
 
    private:
 
-      MYSQL* mysql;
+      cDbHandle* handle;
 
       // int initialized;
       int attached;
       int inTact;
       int connectDropped;
+      cDbStatement* streamingStatement;
 
       static cMyMutex initMutex;
       static int initThreads;
@@ -1158,8 +1037,7 @@ class cDbTable : public cDbService
 
       cDbTableDef* getTableDef()                                      { return tableDef; }
       cDbConnection* getConnection()                                  { return connection; }
-      MYSQL* getMySql()                                               { return connection->getMySql(); }
-      int isConnected()                                               { return connection && connection->getMySql(); }
+      int isConnected()                                               { return connection && connection->isConnected(); }
 
       int getLastInsertId()                                           { return lastInsertId; }
 
@@ -1212,16 +1090,7 @@ class cDbView : public cDbService
 
       int exist()
       {
-         if (connection->getMySql())
-         {
-            MYSQL_RES* result = mysql_list_tables(connection->getMySql(), name);
-            MYSQL_ROW tabRow = mysql_fetch_row(result);
-            mysql_free_result(result);
-
-            return tabRow ? yes : no;
-         }
-
-         return no;
+         return connection->tableExists(name) == yes ? yes : no;
       }
 
       int create(const char* path, const char* sqlFile)
@@ -1275,7 +1144,7 @@ class cDbProcedure : public cDbService
 
       int call(int ll = 1)
       {
-         if (!connection || !connection->getMySql())
+         if (!connection || !connection->isConnected())
             return fail;
 
          cDbStatement stmt(connection);
@@ -1294,7 +1163,7 @@ class cDbProcedure : public cDbService
 
       int created()
       {
-         if (!connection || !connection->getMySql())
+         if (!connection || !connection->isConnected())
             return no;
 
          cDbStatement stmt(connection);
@@ -0,0 +1,1120 @@
+/*
+ * dbmysql.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <errmsg.h>
+
+#include <map>
+
+#include "db.h"
+
+//***************************************************************************
+// MySQL / MariaDB Backend
+//***************************************************************************
+
+//***************************************************************************
+// Class cDbStatement
+//***************************************************************************
+
+//***************************************************************************
+// Execute
+//***************************************************************************
+
+int cDbStatement::execute(int noResult)
+{
+   affected = 0;
+
+   if (!connection || !connection->getHandle())
+      return fail;
+
+   if (!stmt)
+      return connection->errorSql(connection, "execute(missing statement)");
+
+   // a streaming result blocks the connection until it's drained
+
+   if (connection->getStreamingStatement() == this)
+      freeResult();
+   else if (connection->getStreamingStatement())
+   {
+      tell(eloAlways, "Error: Connection busy by the streaming result of '%s', can't execute '%s'",
+           connection->getStreamingStatement()->asText(), stmtTxt.c_str());
+      return fail;
+   }
+
+//    if (explain && firstExec)
+//    {
+//       firstExec = no;
+
+//       if (strstr(stmtTxt.c_str(), "select "))
+//       {
+//          MYSQL_RES* result;
+//          MYSQL_ROW row;
+//          string q = "explain " + stmtTxt;
+
+//          if (connection->query(q.c_str()) != success)
+//             connection->errorSql(connection, "explain ", 0);
+//          else if ((result = mysql_store_result(connection->getHandle())))
+//          {
+//             while ((row = mysql_fetch_row(result)))
+//             {
+//                tell(eloAlways, "EXPLAIN: %s) %s %s %s %s %s %s %s %s %s",
+//                     row[0], row[1], row[2], row[3],
+//                     row[4], row[5], row[6], row[7], row[8], row[9]);
+//             }
+
+//             mysql_free_result(result);
+//          }
+//       }
+//    }
+
+   // tell(eloAlways, "execute %d [%s]", stmt, stmtTxt.c_str());
+
+   double start = usNow();
+
+   if (mysql_stmt_execute(stmt))
+      return connection->errorSql(connection, "execute(stmt_execute)", stmt, stmtTxt.c_str());
+
+   double elapsed = usNow() - start;
+
+   if (!histogram)
+      histogram = cMetrics::histogram("db_statement_seconds", stmtTxt.c_str());
+
+   histogram->record(elapsed);
+   duration += elapsed;
+   callsPeriod++;
+   callsTotal++;
+
+   // out binding - if needed
+
+   if (outCount && !noResult && streaming)
+   {
+      // fetch the first row, the result isn't stored so we can only tell
+      //   if there is a row at all. The remaining rows are read by fetch()
+
+      int res = mysql_stmt_fetch(stmt);
+
+      if (res == 1)
+         return connection->errorSql(connection, "execute(fetch)", stmt, stmtTxt.c_str());
+
+      affected = res == MYSQL_NO_DATA ? 0 : 1;
+
+      if (affected)
+         connection->setStreamingStatement(this);
+
+      return success;
+   }
+   else if (outCount && !noResult)
+   {
+      if (mysql_stmt_store_result(stmt))
+         return connection->errorSql(connection, "execute(store_result)", stmt, stmtTxt.c_str());
+
+      // fetch the first result - if any
+
+      if (mysql_stmt_affected_rows(stmt) > 0)
+         mysql_stmt_fetch(stmt);
+   }
+   else if (outCount)
+   {
+      mysql_stmt_store_result(stmt);
+   }
+
+   // result was stored (above) only if output (outCound) is expected,
+   // therefore we don't need to call freeResult() after insert() or update()
+
+   affected = mysql_stmt_affected_rows(stmt);
+
+   return success;
+}
+
+//***************************************************************************
+//
+//***************************************************************************
+
+int cDbStatement::getLastInsertId()
+{
+   MYSQL_RES* result = 0;
+   int insertId = na;
+
+   if ((result = mysql_store_result(connection->getHandle())) == 0 &&
+       mysql_field_count(connection->getHandle()) == 0 &&
+       mysql_insert_id(connection->getHandle()) != 0)
+   {
+      insertId = mysql_insert_id(connection->getHandle());
+   }
+
+   mysql_free_result(result);
+
+   return insertId;
+}
+
+int cDbStatement::getResultCount()
+{
+   mysql_stmt_store_result(stmt);
+
+   return mysql_stmt_affected_rows(stmt);
+}
+
+int cDbStatement::fetch()
+{
+   if (!mysql_stmt_fetch(stmt))
+      return yes;
+
+   // streaming result drained (or broken)
+
+   if (connection->getStreamingStatement() == this)
+      connection->setStreamingStatement(0);
+
+   return no;
+}
+
+int cDbStatement::freeResult()
+{
+   if (stmt)
+   {
+      mysql_stmt_free_result(stmt);
+
+      // read and drop the rows not fetched of a streaming result
+
+      if (streaming)
+         mysql_stmt_reset(stmt);
+   }
+
+   if (connection && connection->getStreamingStatement() == this)
+      connection->setStreamingStatement(0);
+
+   return success;
+}
+
+//***************************************************************************
+// Set Streaming
+//   no server side cursor (CURSOR_TYPE_READ_ONLY), MariaDB materializes its
+//   result in a temporary table before the first row is sent. Without
+//   mysql_stmt_store_result() the rows are read from the connection by
+//   mysql_stmt_fetch() while the server sends them
+//***************************************************************************
+
+int cDbStatement::setStreaming()
+{
+   streaming = yes;
+
+   return success;
+}
+
+//***************************************************************************
+// Clear
+//***************************************************************************
+
+void cDbStatement::clear()
+{
+   stmtTxt = "";
+   affected = 0;
+
+   if (inCount)
+   {
+      free(inBind);
+      inCount = 0;
+      inBind = 0;
+   }
+
+   if (outCount)
+   {
+      free(outBind);
+      outCount = 0;
+      outBind = 0;
+   }
+
+   if (stmt)
+   {
+      if (connection && connection->getStreamingStatement() == this)
+         connection->setStreamingStatement(0);
+
+      mysql_stmt_free_result(stmt);
+      mysql_stmt_close(stmt);
+      stmt = 0;
+   }
+}
+
+//***************************************************************************
+// Append Binding
+//***************************************************************************
+
+int cDbStatement::appendBinding(cDbValue* value, BindType bt)
+{
+   int count = 0;
+   MYSQL_BIND** bindings = 0;
+   MYSQL_BIND* newBinding;
+
+   if (bt & bndIn)
+   {
+      count = ++inCount;
+      bindings = &inBind;
+   }
+   else if (bt & bndOut)
+   {
+      count = ++outCount;
+      bindings = &outBind;
+   }
+   else
+      return 0;
+
+   if (!*bindings)
+      *bindings = (MYSQL_BIND*)malloc(count * sizeof(MYSQL_BIND));
+   else
+      *bindings = (MYSQL_BIND*)srealloc(*bindings, count * sizeof(MYSQL_BIND));
+
+   newBinding = &((*bindings)[count-1]);
+
+   memset(newBinding, 0, sizeof(MYSQL_BIND));
+
+   if (value->getField()->getFormat() == ffAscii || value->getField()->getFormat() == ffText || value->getField()->getFormat() == ffMText)
+   {
+      newBinding->buffer_type = MYSQL_TYPE_STRING;
+      newBinding->buffer = value->getStrValueRef();
+      newBinding->buffer_length = value->getField()->getSize();
+      newBinding->length = value->getStrValueSizeRef();
+
+      newBinding->is_null = value->getNullRef();
+      newBinding->error = 0;            // #TODO
+   }
+   else if (value->getField()->getFormat() == ffMlob)
+   {
+      newBinding->buffer_type = MYSQL_TYPE_BLOB;
+      newBinding->buffer = value->getStrValueRef();
+      newBinding->buffer_length = value->getField()->getSize();
+      newBinding->length = value->getStrValueSizeRef();
+
+      newBinding->is_null = value->getNullRef();
+      newBinding->error = 0;            // #TODO
+   }
+   else if (value->getField()->getFormat() == ffFloat)
+   {
+      newBinding->buffer_type = MYSQL_TYPE_FLOAT;
+      newBinding->buffer = value->getFloatValueRef();
+
+      newBinding->length = 0;            // #TODO
+      newBinding->is_null =  value->getNullRef();
+      newBinding->error = 0;             // #TODO
+   }
+   else if (value->getField()->getFormat() == ffDateTime)
+   {
+      newBinding->buffer_type = MYSQL_TYPE_DATETIME;
+      newBinding->buffer = value->getTimeValueRef();
+
+      newBinding->length = 0;            // #TODO
+      newBinding->is_null =  value->getNullRef();
+      newBinding->error = 0;             // #TODO
+   }
+   else if (value->getField()->getFormat() == ffBigInt || value->getField()->getFormat() == ffUBigInt)
+   {
+      newBinding->buffer_type = MYSQL_TYPE_LONGLONG;
+      newBinding->buffer = value->getBigIntValueRef();
+      newBinding->is_unsigned = (value->getField()->getFormat() == ffUBigInt);
+
+      newBinding->length = 0;
+      newBinding->is_null =  value->getNullRef();
+      newBinding->error = 0;             // #TODO
+   }
+   else  // ffInt, ffUInt
+   {
+      newBinding->buffer_type = MYSQL_TYPE_LONG;
+      newBinding->buffer = value->getIntValueRef();
+      newBinding->is_unsigned = (value->getField()->getFormat() == ffUInt);
+
+      newBinding->length = 0;
+      newBinding->is_null =  value->getNullRef();
+      newBinding->error = 0;             // #TODO
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Prepare Statement
+//***************************************************************************
+
+int cDbStatement::prepare()
+{
+   if (!connection->getHandle())
+   {
+      tell(eloAlways, "Error: Lost connection, can't prepare statement");
+      return fail;
+   }
+
+   if (!stmtTxt.length())
+      return fail;
+
+   if (buildErrors)
+      return fail;
+
+   stmt = mysql_stmt_init(connection->getHandle());
+
+   // prepare statement
+
+   if (mysql_stmt_prepare(stmt, stmtTxt.c_str(), stmtTxt.length()))
+      return connection->errorSql(connection, "prepare(stmt_prepare)", stmt, stmtTxt.c_str());
+
+   if (outBind)
+   {
+      if (mysql_stmt_bind_result(stmt, outBind))
+         return connection->errorSql(connection, "execute(bind_result)", stmt);
+   }
+
+   if (inBind)
+   {
+      if (mysql_stmt_bind_param(stmt, inBind))
+         return connection->errorSql(connection, "buildPrimarySelect(bind_param)", stmt);
+   }
+
+   tell(eloDebugDb, "Statement '%s' with (%ld) in parameters and (%d) out bindings prepared",
+        stmtTxt.c_str(), mysql_stmt_param_count(stmt), outCount);
+
+   return success;
+}
+
+//***************************************************************************
+// Class cDbConnection
+//***************************************************************************
+
+//***************************************************************************
+// Init / Exit - must exactly called 'once' per process
+//***************************************************************************
+
+int cDbConnection::init()
+{
+   int status = success;
+
+   initMutex.Lock();
+
+   if (!initThreads)
+   {
+      tell(eloDebugDb, "Info: Calling mysql_library_init()");
+
+      if (mysql_library_init(0, 0, 0))
+      {
+         tell(eloAlways, "Error: mysql_library_init() failed");
+         status = fail;
+      }
+   }
+   else
+   {
+      tell(eloDebugDb, "Info: Skipping calling mysql_library_init(), it's already done!");
+   }
+
+   initThreads++;
+   initMutex.Unlock();
+
+   return status;
+}
+
+int cDbConnection::exit()
+{
+   initMutex.Lock();
+
+   initThreads--;
+
+   if (!initThreads)
+   {
+      tell(eloDetail, "Info: Released the last usage of mysql_lib, calling mysql_library_end() now");
+      mysql_library_end();
+
+      free(dbHost);
+      free(dbUser);
+      free(dbPass);
+      free(dbName);
+      free(encoding);
+      free(confPath);
+   }
+   else
+   {
+      tell(eloDetail, "Info: The mysql_lib is still in use, skipping mysql_library_end() call");
+   }
+
+   initMutex.Unlock();
+
+   return done;
+}
+
+//***************************************************************************
+// Attach / Close
+//***************************************************************************
+
+int cDbConnection::attachConnection()
+{
+   static int first = yes;
+
+   if (!handle)
+   {
+      connectDropped = yes;
+
+      tell(eloDb, "Calling mysql_init(%ld)", syscall(__NR_gettid));
+
+      if (!(handle = mysql_init(0)))
+         return errorSql(this, "attachConnection(init)");
+
+      if (!mysql_real_connect(handle, dbHost, dbUser, dbPass, dbName, dbPort, 0, 0))
+      {
+         errorSql(this, "connecting to database");
+         tell(eloAlways, "Error, connecting to database at '%s' on port (%d) failed", dbHost, dbPort);
+         close();
+         return fail;
+      }
+
+      connectDropped = no;
+
+      // init encoding
+
+      if (encoding && *encoding)
+      {
+         if (mysql_set_character_set(handle, encoding))
+            errorSql(this, "init(character_set)");
+
+         if (first)
+         {
+            tell(eloAlways, "SQL client character now '%s'", mysql_character_set_name(handle));
+            first = no;
+         }
+      }
+   }
+
+   attached++;
+
+   return success;
+}
+
+void cDbConnection::close()
+{
+   if (handle)
+   {
+      tell(eloDb, "Closing mysql connection and calling mysql_thread_end(%ld)", syscall(__NR_gettid));
+
+      mysql_close(handle);
+      mysql_thread_end();
+      handle = 0;
+      attached = 0;
+   }
+}
+
+//***************************************************************************
+// Query
+//***************************************************************************
+
+int cDbConnection::query(int& count, const char* format, ...)
+{
+   int status;
+   va_list more;
+
+   count = 0;
+
+   if (!format)
+      return fail;
+
+   va_start(more, format);
+
+   if ((status = vquery(format, more)) == success)
+   {
+      MYSQL_RES* res;
+      MYSQL_ROW data;
+
+      // get affected rows ..
+
+      if ((res = mysql_store_result(getHandle())))
+      {
+         data = mysql_fetch_row(res);
+
+         if (data)
+            count = atoi(data[0]);
+
+         mysql_free_result(res);
+      }
+   }
+
+   return status;
+}
+
+int cDbConnection::vquery(const char* format, va_list more)
+{
+   int status = 1;
+   MYSQL* h = getHandle();
+
+   if (h && format && streamingStatement)
+   {
+      tell(eloAlways, "Error: Connection busy by the streaming result of '%s', query refused",
+           streamingStatement->asText());
+      return fail;
+   }
+
+   if (h && format)
+   {
+      char* stmt;
+
+      vasprintf(&stmt, format, more);
+
+      if ((status = mysql_query(h, stmt)))
+         errorSql(this, stmt);
+
+      free(stmt);
+   }
+
+   return status ? fail : success;
+}
+
+void cDbConnection::queryReset()
+{
+   if (getHandle())
+   {
+      MYSQL_RES* result = mysql_use_result(getHandle());
+      mysql_free_result(result);
+   }
+}
+
+//***************************************************************************
+// Escape SQL String
+//***************************************************************************
+
+std::string cDbConnection::escapeSqlString(const char* str)
+{
+   std::string result = "";
+
+   if (!isConnected())
+      return result;
+
+   int length = strlen(str);
+   int bufferSize = length*2 + TB;
+
+   char* buffer = (char*)malloc(bufferSize);
+   mysql_real_escape_string(getHandle(), buffer, str, length);
+   result = buffer;
+   free(buffer);
+
+   return result;
+}
+
+//***************************************************************************
+// Start Transaction
+//***************************************************************************
+
+int cDbConnection::startTransaction()
+{
+   inTact = yes;
+   return query("START TRANSACTION");
+}
+
+//***************************************************************************
+// Table Exists
+//***************************************************************************
+
+int cDbConnection::tableExists(const char* name)
+{
+   if (!getHandle())
+      return fail;
+
+   MYSQL_RES* result = mysql_list_tables(getHandle(), name);
+   MYSQL_ROW tabRow = mysql_fetch_row(result);
+   mysql_free_result(result);
+
+   return tabRow ? yes : no;
+}
+
+//***************************************************************************
+// SQL Error
+//***************************************************************************
+
+int cDbConnection::errorSql(cDbConnection* connection, const char* prefix,
+                            cDbStmtHandle* stmt, const char* stmtTxt)
+{
+   if (!connection || !connection->handle)
+   {
+      tell(eloAlways, "SQL-Error in '%s'", prefix);
+      return fail;
+   }
+
+   int error = mysql_errno(connection->handle);
+   char* conErr = 0;
+   char* stmtErr = 0;
+
+   if (error == CR_SERVER_LOST ||
+       error == CR_SERVER_GONE_ERROR ||
+// for compatibility with newer versions of MariaDB library
+#ifdef CR_INVALID_CONN_HANDLE
+       error == CR_INVALID_CONN_HANDLE ||
+#endif
+       error == CR_COMMANDS_OUT_OF_SYNC ||
+       error == CR_SERVER_LOST_EXTENDED ||
+#ifdef CR_STMT_CLOSED
+       error == CR_STMT_CLOSED ||
+#endif
+// for compatibility with newer versions of MariaDB library
+#ifdef CR_CONN_UNKNOW_PROTOCOL
+       error == CR_CONN_UNKNOW_PROTOCOL ||
+#else
+# ifdef CR_CONN_UNKNOWN_PROTOCOL
+       error == CR_CONN_UNKNOWN_PROTOCOL ||
+# endif
+#endif
+       error == CR_UNSUPPORTED_PARAM_TYPE ||
+       error == CR_NO_PREPARE_STMT ||
+       error == CR_SERVER_HANDSHAKE_ERR ||
+       error == CR_WRONG_HOST_INFO ||
+       error == CR_OUT_OF_MEMORY ||
+       error == CR_IPSOCK_ERROR ||
+       error == CR_SOCKET_CREATE_ERROR ||
+       error == CR_CONNECTION_ERROR ||
+       error == CR_TCP_CONNECTION ||
+       error == CR_PARAMS_NOT_BOUND ||
+       error == CR_CONN_HOST_ERROR ||
+       error == CR_SSL_CONNECTION_ERROR
+
+       // to be continued - not all errors should result in a reconnect ...
+
+      )
+   {
+      connectDropped = yes;
+   }
+
+   if (error)
+      asprintf(&conErr, "%s (%d) ", mysql_error(connection->handle), error);
+
+   if (stmt || stmtTxt)
+      asprintf(&stmtErr, "'%s' [%s]",
+               stmt ? mysql_stmt_error(stmt) : "",
+               stmtTxt ? stmtTxt : "");
+
+   tell(eloAlways, "SQL-Error in '%s' - %s%s", prefix,
+        conErr ? conErr : "", stmtErr ? stmtErr : "");
+
+   free(conErr);
+   free(stmtErr);
+
+   if (connectDropped)
+      tell(eloAlways, "Fatal, lost connection to mysql server, aborting pending actions");
+
+   return fail;
+}
+
+//***************************************************************************
+// Class cDbTable
+//***************************************************************************
+
+//***************************************************************************
+// Validate Structure
+//***************************************************************************
+
+struct FieldInfo
+{
+   std::string columnFormat;
+   std::string description;
+   std::string defaulValue;
+};
+
+int cDbTable::validateStructure(int allowAlter)
+{
+   std::map<std::string, FieldInfo, _casecmp_> fields;
+   MYSQL_RES* result;
+   MYSQL_ROW row;
+   std::map<std::string, FieldInfo, _casecmp_>::iterator it;
+   int needDetach = no;
+
+   if (!allowAlter)
+      return done;
+
+   const char* select = "select column_name, column_type, column_comment, data_type, is_nullable, "
+      " character_maximum_length, column_default, numeric_precision "
+      " from information_schema.columns "
+      " where table_name = '%s' and table_schema= '%s'";
+
+   if (!isAttached())
+   {
+      needDetach = yes;
+
+   if (attach() != success)
+      return fail;
+   }
+
+   // ------------------------
+   // execute query
+
+   if (connection->query(select, TableName(), connection->getName()) != success)
+   {
+      connection->errorSql(getConnection(), "validateStructure()", 0);
+      if (needDetach) detach();
+      return fail;
+   }
+
+   // ------------------------
+   // process the result
+
+   if (!(result = mysql_store_result(connection->getHandle())))
+   {
+      connection->errorSql(getConnection(), "validateStructure()");
+      if (needDetach) detach();
+      return fail;
+   }
+
+   while ((row = mysql_fetch_row(result)))
+   {
+      fields[row[0]].columnFormat = row[1];
+      fields[row[0]].description = row[2] ? row[2] : "";
+      fields[row[0]].defaulValue = row[6] ? strcasecmp(row[6], "NULL") == 0 ? "" : row[6] : "";
+
+      if (fields[row[0]].defaulValue.length() > 2 &&
+          fields[row[0]].defaulValue.back() == '\'' &&
+          fields[row[0]].defaulValue.front() == '\'')
+      {
+         fields[row[0]].defaulValue.pop_back();
+         fields[row[0]].defaulValue.erase(0, 1);
+      }
+   }
+
+   mysql_free_result(result);
+
+   // --------------------------------------
+   // validate if all fields of dict are in
+   //   table and check their format, ...
+
+   for (int i = 0; i < fieldCount(); i++)
+   {
+      char colType[100];
+
+      tell(eloDebugDb, "Check field '%s'", getField(i)->getName());
+
+      if (fields.find(getField(i)->getDbName()) == fields.end())
+         alterAddField(getField(i));
+
+      else
+      {
+         FieldInfo* fieldInfo = &fields[getField(i)->getDbName()];
+
+         getField(i)->toColumnFormat(colType);
+
+         if (strcasecmp(fieldInfo->columnFormat.c_str(), colType) != 0 ||
+             strcasecmp(fieldInfo->description.c_str(), getField(i)->getDescription()) != 0 ||
+             (strcasecmp(fieldInfo->defaulValue.c_str(), getField(i)->getDefault()) != 0 && !(getField(i)->getType() & ftPrimary)))
+         {
+            if (strcasecmp(fieldInfo->columnFormat.c_str(), colType) != 0)
+               tell(eloDebugDb, "Debug: Format of '%s' changed from '%s' to '%s'", getField(i)->getDbName(),
+                    fieldInfo->columnFormat.c_str(), colType);
+
+            if (strcasecmp(fieldInfo->description.c_str(), getField(i)->getDescription()) != 0)
+               tell(eloDebugDb, "Debug: Description of '%s' changed from '%s' to '%s'", getField(i)->getDbName(),
+                    fieldInfo->description.c_str(), getField(i)->getDescription());
+
+            if (strcasecmp(fieldInfo->defaulValue.c_str(), getField(i)->getDefault()) != 0 && !(getField(i)->getType() & ftPrimary))
+               tell(eloDebugDb, "Debug: Default value of '%s' changed from from '%s' to '%s'", getField(i)->getDbName(),
+                    fieldInfo->defaulValue.c_str(), getField(i)->getDefault());
+
+            alterModifyField(getField(i));
+         }
+      }
+   }
+
+   // --------------------------------------
+   // check if table contains unused fields
+   //   and report them
+
+   for (it = fields.begin(); it != fields.end(); it++)
+   {
+      if (!getRow()->getFieldByDbName(it->first.c_str()))
+      {
+         if (allowAlter == 2)
+            alterDropField(it->first.c_str());
+         else
+            tell(eloAlways, "Info: Field '%s' not used anymore, "
+                 "to remove it call 'ALTER TABLE %s DROP COLUMN %s;' manually",
+                 it->first.c_str(), TableName(), it->first.c_str());
+      }
+   }
+
+   if (needDetach) detach();
+
+   return success;
+}
+
+//***************************************************************************
+// Alter 'Modify Field'
+//***************************************************************************
+
+int cDbTable::alterModifyField(cDbFieldDef* def)
+{
+   char* statement;
+   char colType[100];
+
+   tell(eloAlways, "  Info: Definition of field '%s.%s' modified, try to alter table",
+        TableName(), def->getName());
+
+   // alter table events modify column guest varchar(50)
+
+   asprintf(&statement, "alter table %s modify column %s %s comment '%s' %s%s%s",
+            TableName(),
+            def->getDbName(),
+            def->toColumnFormat(colType),
+            def->getDbDescription(),
+            !isEmpty(def->getDefault()) ? "default '" : "",
+            !isEmpty(def->getDefault()) ? def->getDefault() : "",
+            !isEmpty(def->getDefault()) ? "'" : ""
+      );
+
+   tell(eloDetail, "Execute [%s]", statement);
+
+   if (connection->query("%s", statement))
+      return connection->errorSql(getConnection(), "alterAddField()",
+                                  0, statement);
+
+   free(statement);
+
+   return done;
+}
+
+//***************************************************************************
+// Alter 'Add Field'
+//***************************************************************************
+
+int cDbTable::alterAddField(cDbFieldDef* def)
+{
+   std::string statement;
+   char colType[100];
+
+   tell(eloAlways, "Info: Missing field '%s.%s', try to alter table",
+        TableName(), def->getName());
+
+   // alter table channelmap add column ord int(11) [after source]
+
+   statement = std::string("alter table ") + TableName() + std::string(" add column ")
+      + def->getDbName() + std::string(" ") + def->toColumnFormat(colType);
+
+   if (def->getFormat() != ffMlob)
+   {
+      if (def->getType() & ftAutoinc)
+         statement += " not null auto_increment";
+      else if (!isEmpty(def->getDefault()))
+         statement += " default '" + std::string(def->getDefault()) + "'";
+   }
+
+   if (!isEmpty(def->getDbDescription()))
+      statement += std::string(" comment '") + def->getDbDescription() + std::string("'");
+
+   if (def->getIndex() > 0)
+      statement += std::string(" after ") + getField(def->getIndex()-1)->getDbName();
+
+   tell(eloDetail, "Execute [%s]", statement.c_str());
+
+   if (connection->query("%s", statement.c_str()))
+      return connection->errorSql(getConnection(), "alterAddField()",
+                                  0, statement.c_str());
+
+   return done;
+}
+
+//***************************************************************************
+// Alter 'Drop Field'
+//***************************************************************************
+
+int cDbTable::alterDropField(const char* name)
+{
+   char* statement;
+
+   tell(eloAlways, "Info: Unused field '%s', try to drop it", name);
+
+   // alter table channelmap add column ord int(11) [after source]
+
+   asprintf(&statement, "alter table %s drop column %s", TableName(), name);
+
+   tell(eloDetail, "Execute [%s]", statement);
+
+   if (connection->query("%s", statement))
+      return connection->errorSql(getConnection(), "alterDropField()",
+                                  0, statement);
+
+   free(statement);
+
+   return done;
+}
+
+//***************************************************************************
+// Create Table
+//***************************************************************************
+
+int cDbTable::createTable()
+{
+   std::string statement;
+   std::string aKey;
+   int needDetach = no;
+
+   if (!tableDef || !row)
+      return abrt;
+
+   if (!isAttached())
+   {
+      needDetach = yes;
+
+   if (attach() != success)
+      return fail;
+   }
+
+   // table exists -> nothing to do
+
+   if (exist())
+   {
+      if (needDetach) detach();
+      return done;
+   }
+
+   tell(eloAlways, "Initialy creating table '%s'", TableName());
+
+   // build 'create' statement ...
+
+   statement = std::string("create table ") + TableName() + std::string("(");
+
+   for (int i = 0; i < fieldCount(); i++)
+   {
+      char colType[100];
+
+      if (i) statement += std::string(", ");
+
+      statement += std::string(getField(i)->getDbName()) + " " + std::string(getField(i)->toColumnFormat(colType));
+
+      if (getField(i)->getFormat() != ffMlob)
+      {
+         if (getField(i)->getType() & ftAutoinc)
+            statement += " not null auto_increment";
+         else if (!isEmpty(getField(i)->getDefault()))
+            statement += " default '" + std::string(getField(i)->getDefault()) + "'";
+      }
+
+      if (!isEmpty(getField(i)->getDbDescription()))
+         statement += std::string(" comment '") + getField(i)->getDbDescription() + std::string("'");
+   }
+
+   aKey = "";
+
+   for (int i = 0, n = 0; i < fieldCount(); i++)
+   {
+      if (getField(i)->getType() & ftPrimary)
+      {
+         if (n++) aKey += std::string(", ");
+         aKey += std::string(getField(i)->getDbName()) + " DESC";
+      }
+   }
+
+   if (aKey.length())
+   {
+      statement += std::string(", PRIMARY KEY(");
+      statement += aKey;
+      statement += ")";
+   }
+
+   aKey = "";
+
+   for (int i = 0, n = 0; i < fieldCount(); i++)
+   {
+      if (getField(i)->getType() & ftAutoinc && !(getField(i)->getType() & ftPrimary))
+      {
+         if (n++) aKey += std::string(", ");
+         aKey += std::string(getField(i)->getDbName()) + " DESC";
+      }
+   }
+
+   if (aKey.length())
+   {
+      statement += std::string(", KEY(");
+      statement += aKey;
+      statement += ")";
+   }
+
+   statement += std::string(") ENGINE=InnoDB ROW_FORMAT=DYNAMIC;");
+
+   tell(eloDetail, "%s", statement.c_str());
+
+   if (connection->query("%s", statement.c_str()))
+   {
+      if (needDetach) detach();
+      return connection->errorSql(getConnection(), "createTable()",
+                                  0, statement.c_str());
+   }
+
+   if (needDetach) detach();
+
+   return success;
+}
+
+//***************************************************************************
+// Check Index
+//***************************************************************************
+
+int cDbTable::checkIndex(const char* idxName, int& fieldCount)
+{
+   enum IndexQueryFields
+   {
+      idTable,
+      idNonUnique,
+      idKeyName,
+      idSeqInIndex,
+      idColumnName,
+      idCollation,
+      idCardinality,
+      idSubPart,
+      idPacked,
+      idNull,
+      idIndexType,
+      idComment,
+      idIndexComment,
+
+      idCount
+   };
+
+   MYSQL_RES* result;
+   MYSQL_ROW row;
+
+   fieldCount = 0;
+
+   if (connection->query("show index from %s", TableName()) != success)
+   {
+      connection->errorSql(getConnection(), "checkIndex()", 0);
+
+      return fail;
+   }
+
+   if ((result = mysql_store_result(connection->getHandle())))
+   {
+      while ((row = mysql_fetch_row(result)))
+      {
+         tell(eloDebugDb, "%s:  %-20s %s %s",
+              row[idTable], row[idKeyName],
+              row[idSeqInIndex], row[idColumnName]);
+
+         if (strcasecmp(row[idKeyName], idxName) == 0)
+            fieldCount++;
+      }
+
+      mysql_free_result(result);
+
+      return success;
+   }
+
+   connection->errorSql(getConnection(), "checkIndex()");
+
+   return fail;
+}
+
+//***************************************************************************
+// Truncate
+//***************************************************************************
+
+int cDbTable::truncate()
+{
+   std::string tmp;
+
+   tmp = "delete from " + std::string(TableName());
+
+   if (connection->query("%s", tmp.c_str()))
+      return connection->errorSql(connection, "truncate() 'delete from'", 0, tmp.c_str());
+
+   tmp = "truncate table " + std::string(TableName());
+
+   if (connection->query("%s", tmp.c_str()))
+      return connection->errorSql(connection, "truncate()", 0, tmp.c_str());
+
+   return success;
+}
@@ -0,0 +1,236 @@
+/*
+ * dbpool.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include "dbpool.h"
+
+//***************************************************************************
+// Class cDbWorker
+//***************************************************************************
+
+cDbWorker::cDbWorker(int aId)
+   : cThread()
+{
+   id = aId;
+   SetDescription("db-worker-%d", id);
+}
+
+cDbWorker::~cDbWorker()
+{
+   stop();
+}
+
+//***************************************************************************
+// Post / Stop
+//***************************************************************************
+
+int cDbWorker::post(cDbJob job)
+{
+   Lock();
+   jobs.push(job);
+   Unlock();
+
+   waitCondition.Broadcast();
+
+   return success;
+}
+
+int cDbWorker::stop()
+{
+   Cancel(5);
+
+   Lock();
+
+   while (!jobs.empty())
+      jobs.pop();
+
+   Unlock();
+
+   return done;
+}
+
+size_t cDbWorker::getPending()
+{
+   cMyMutexLock lock(&mutex);
+   return jobs.size() + (busy ? 1 : 0);
+}
+
+//***************************************************************************
+// Init / Exit - only called in context of the worker thread!
+//***************************************************************************
+
+int cDbWorker::initDb()
+{
+   connection = new cDbConnection();
+
+   if (connection->attachConnection() != success)
+   {
+      exitDb();
+      return fail;
+   }
+
+   tell(eloDb, "Worker %d connected to database", id);
+
+   return success;
+}
+
+int cDbWorker::exitDb()
+{
+   for (auto it = tables.begin(); it != tables.end(); ++it)
+   {
+      it->second->close();
+      delete it->second;
+   }
+
+   tables.clear();
+
+   if (connection)
+   {
+      connection->close();
+      delete connection;
+      connection = nullptr;
+   }
+
+   return done;
+}
+
+//***************************************************************************
+// Get Table - the table is opened on first use (without structure checks)
+//***************************************************************************
+
+cDbTable* cDbWorker::getTable(const char* name)
+{
+   if (!connection)
+      return nullptr;
+
+   auto it = tables.find(name);
+
+   if (it != tables.end())
+      return it->second;
+
+   cDbTable* table = new cDbTable(connection, name, true);
+
+   if (table->open() != success)
+   {
+      delete table;
+      return nullptr;
+   }
+
+   tables[name] = table;
+
+   return table;
+}
+
+//***************************************************************************
+// Action
+//***************************************************************************
+
+void cDbWorker::action()
+{
+   while (Running())
+   {
+      cDbJob job;
+
+      {
+         cMyMutexLock lock(&mutex);
+
+         while (Running() && jobs.empty())
+            waitCondition.TimedWait(mutex, 1000);
+
+         if (!Running())
+            break;
+
+         job = jobs.front();
+         jobs.pop();
+         busy = true;
+      }
+
+      if (!connection || !connection->isConnected())
+      {
+         exitDb();
+
+         if (initDb() != success)
+            tell(eloAlways, "Error: Worker %d can't connect to database", id);
+      }
+
+      // the job is executed even without a connection to reply the error
+
+      double start = usNow();
+
+      job(this);
+
+      tell(eloDebugDb, "Worker %d: job done in %.2fms", id, (usNow() - start) / 1000);
+
+      cMyMutexLock lock(&mutex);
+      busy = false;
+   }
+
+   exitDb();
+}
+
+//***************************************************************************
+// Class cDbPool
+//***************************************************************************
+
+cDbPool::cDbPool(int aSize)
+{
+   size = std::max(aSize, 1);
+}
+
+cDbPool::~cDbPool()
+{
+   stop();
+}
+
+int cDbPool::start()
+{
+   if (!workers.empty())
+      return done;
+
+   for (int i = 0; i < size; i++)
+   {
+      cDbWorker* worker = new cDbWorker(i);
+      workers.push_back(worker);
+      worker->Start(yes);
+   }
+
+   tell(eloAlways, "Started %d database worker", size);
+
+   return success;
+}
+
+int cDbPool::stop()
+{
+   for (auto worker : workers)
+   {
+      worker->stop();
+      delete worker;
+   }
+
+   workers.clear();
+
+   return done;
+}
+
+//***************************************************************************
+// Post - to the worker with the fewest pending jobs
+//***************************************************************************
+
+int cDbPool::post(cDbJob job)
+{
+   cDbWorker* best {nullptr};
+
+   for (auto worker : workers)
+   {
+      if (!best || worker->getPending() < best->getPending())
+         best = worker;
+   }
+
+   if (!best)
+      return fail;
+
+   return best->post(job);
+}
@@ -0,0 +1,88 @@
+/*
+ * dbpool.h
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __DBPOOL_H
+#define __DBPOOL_H
+
+#include <queue>
+#include <vector>
+#include <map>
+#include <functional>
+
+#include "db.h"
+#include "thread.h"
+
+class cDbWorker;
+
+//***************************************************************************
+// DB Job
+//   executed in the context of a worker thread, the worker supply
+//   it's own connection and tables. A job is always executed, if the worker
+//   can't connect getConnection() and getTable() return nullptr and the
+//   job has to reply its error
+//***************************************************************************
+
+typedef std::function<int(cDbWorker* worker)> cDbJob;
+
+//***************************************************************************
+// DB Worker - thread with it's own database connection
+//***************************************************************************
+
+class cDbWorker : public cThread
+{
+   public:
+
+      cDbWorker(int aId);
+      virtual ~cDbWorker();
+
+      int post(cDbJob job);
+      int stop();
+      size_t getPending();
+
+      int getId()                       { return id; }
+      cDbConnection* getConnection()    { return connection; }
+      cDbTable* getTable(const char* name);
+
+   protected:
+
+      void action() override;
+
+      int initDb();
+      int exitDb();
+
+      int id {0};
+      bool busy {false};
+      cDbConnection* connection {nullptr};
+      std::map<std::string,cDbTable*> tables;   // opened on first use
+      std::queue<cDbJob> jobs;                  // protected by cThread::mutex
+};
+
+//***************************************************************************
+// DB Pool - a worker (and connection) per thread
+//***************************************************************************
+
+class cDbPool
+{
+   public:
+
+      cDbPool(int aSize = 2);
+      virtual ~cDbPool();
+
+      int start();
+      int stop();
+      int post(cDbJob job);
+
+      int getSize()      { return workers.size(); }
+
+   private:
+
+      int size {2};
+      std::vector<cDbWorker*> workers;
+};
+
+//***************************************************************************
+#endif // __DBPOOL_H
@@ -0,0 +1,1160 @@
+/*
+ * dbsqlite.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <math.h>
+
+#include <map>
+
+#include "db.h"
+
+//***************************************************************************
+// SQLite Backend
+//   embedded database in WAL mode, one file per database name located
+//   in SQLITE_PATH (or the absolute path configured as database name)
+//***************************************************************************
+
+#ifndef SQLITE_PATH
+#  define SQLITE_PATH "/var/lib/" TARGET
+#endif
+
+static const int sqliteBusyTimeout = 5000;   // [ms]
+
+//***************************************************************************
+// Date/Time Helper
+//   DATETIME values are stored as local time text 'YYYY-MM-DD HH:MM:SS'
+//***************************************************************************
+
+static int toTm(sqlite3_value* value, struct tm* tm)
+{
+   memset(tm, 0, sizeof(struct tm));
+
+   if (sqlite3_value_type(value) == SQLITE_NULL)
+      return fail;
+
+   if (sqlite3_value_type(value) == SQLITE_INTEGER)
+   {
+      time_t t = sqlite3_value_int64(value);
+      localtime_r(&t, tm);
+      return success;
+   }
+
+   const char* text = (const char*)sqlite3_value_text(value);
+
+   if (!text || sscanf(text, "%d-%d-%d %d:%d:%d", &tm->tm_year, &tm->tm_mon, &tm->tm_mday,
+                       &tm->tm_hour, &tm->tm_min, &tm->tm_sec) < 3)
+      return fail;
+
+   tm->tm_year -= 1900;
+   tm->tm_mon--;
+   tm->tm_isdst = -1;
+
+   return success;
+}
+
+static void resultTime(sqlite3_context* context, time_t t, const char* format = "%Y-%m-%d %H:%M:%S")
+{
+   struct tm tm;
+   char buf[50+TB];
+
+   localtime_r(&t, &tm);
+   strftime(buf, sizeof(buf), format, &tm);
+   sqlite3_result_text(context, buf, -1, SQLITE_TRANSIENT);
+}
+
+//***************************************************************************
+// MySQL Compatible SQL Functions
+//   to keep the statements of the daemon backend independent
+//***************************************************************************
+
+static void fctSysdate(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+   resultTime(context, time(0));
+}
+
+static void fctCurdate(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+   resultTime(context, time(0), "%Y-%m-%d");
+}
+
+static void fctFromUnixtime(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+   if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+      return sqlite3_result_null(context);
+
+   resultTime(context, sqlite3_value_int64(argv[0]));
+}
+
+static void fctUnixTimestamp(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+   struct tm tm;
+
+   if (!argc)
+      return sqlite3_result_int64(context, time(0));
+
+   if (toTm(argv[0], &tm) != success)
+      return sqlite3_result_null(context);
+
+   sqlite3_result_int64(context, mktime(&tm));
+}
+
+static void fctHour(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+   struct tm tm;
+
+   if (toTm(argv[0], &tm) != success)
+      return sqlite3_result_null(context);
+
+   sqlite3_result_int(context, tm.tm_hour);
+}
+
+static void fctMinute(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+   struct tm tm;
+
+   if (toTm(argv[0], &tm) != success)
+      return sqlite3_result_null(context);
+
+   sqlite3_result_int(context, tm.tm_min);
+}
+
+static void fctFloor(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+   if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+      return sqlite3_result_null(context);
+
+   sqlite3_result_int64(context, (sqlite3_int64)floor(sqlite3_value_double(argv[0])));
+}
+
+//***************************************************************************
+// date_format() - supports the commonly used MySQL specifiers
+//***************************************************************************
+
+static void fctDateFormat(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+   struct tm tm;
+   std::string result;
+   const char* format = (const char*)sqlite3_value_text(argv[1]);
+
+   if (!format || toTm(argv[0], &tm) != success)
+      return sqlite3_result_null(context);
+
+   for (const char* p = format; *p; p++)
+   {
+      char buf[20+TB] = "";
+
+      if (*p != '%' || !*(p+1))
+      {
+         result += *p;
+         continue;
+      }
+
+      switch (*(++p))
+      {
+         case 'Y': sprintf(buf, "%04d", tm.tm_year + 1900);                   break;
+         case 'y': sprintf(buf, "%02d", tm.tm_year % 100);                    break;
+         case 'm': sprintf(buf, "%02d", tm.tm_mon + 1);                       break;
+         case 'c': sprintf(buf, "%d", tm.tm_mon + 1);                         break;
+         case 'd': sprintf(buf, "%02d", tm.tm_mday);                          break;
+         case 'e': sprintf(buf, "%d", tm.tm_mday);                            break;
+         case 'H': sprintf(buf, "%02d", tm.tm_hour);                          break;
+         case 'k': sprintf(buf, "%d", tm.tm_hour);                            break;
+         case 'i': sprintf(buf, "%02d", tm.tm_min);                           break;
+         case 's':
+         case 'S': sprintf(buf, "%02d", tm.tm_sec);                           break;
+         case 'T': sprintf(buf, "%02d:%02d:%02d", tm.tm_hour, tm.tm_min, tm.tm_sec); break;
+         default:  sprintf(buf, "%c", *p);                                    break;
+      }
+
+      result += buf;
+   }
+
+   sqlite3_result_text(context, result.c_str(), -1, SQLITE_TRANSIENT);
+}
+
+//***************************************************************************
+// Register Functions
+//***************************************************************************
+
+static int registerFunctions(sqlite3* db)
+{
+   struct Function
+   {
+      const char* name;
+      int argc;
+      int deterministic;
+      void (*fct)(sqlite3_context*, int, sqlite3_value**);
+   };
+
+   static Function functions[] =
+   {
+      { "sysdate",        0, no,  fctSysdate },
+      { "now",            0, no,  fctSysdate },
+      { "curdate",        0, no,  fctCurdate },
+      { "from_unixtime",  1, yes, fctFromUnixtime },
+      { "unix_timestamp", 0, no,  fctUnixTimestamp },
+      { "unix_timestamp", 1, yes, fctUnixTimestamp },
+      { "hour",           1, yes, fctHour },
+      { "minute",         1, yes, fctMinute },
+      { "floor",          1, yes, fctFloor },
+      { "date_format",    2, yes, fctDateFormat },
+      { 0, 0, 0, 0 }
+   };
+
+   for (int i = 0; functions[i].name; i++)
+   {
+      int flags = SQLITE_UTF8 | (functions[i].deterministic ? SQLITE_DETERMINISTIC : 0);
+
+      if (sqlite3_create_function(db, functions[i].name, functions[i].argc, flags,
+                                  0, functions[i].fct, 0, 0) != SQLITE_OK)
+      {
+         tell(eloAlways, "Error: Register of SQL function '%s' failed, %s",
+              functions[i].name, sqlite3_errmsg(db));
+         return fail;
+      }
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Column Type - the dictionary formats mapped to the SQLite storage classes
+//***************************************************************************
+
+static const char* toColumnType(cDbFieldDef* def)
+{
+   switch (def->getFormat())
+   {
+      case cDBS::ffInt:
+      case cDBS::ffUInt:
+      case cDBS::ffBigInt:
+      case cDBS::ffUBigInt:  return "INTEGER";
+      case cDBS::ffFloat:    return "REAL";
+      case cDBS::ffMlob:     return "BLOB";
+      default:               return "TEXT";   // ffAscii, ffText, ffMText and ffDateTime
+   }
+}
+
+//***************************************************************************
+// Class cDbStatement
+//***************************************************************************
+
+//***************************************************************************
+// Bind / Read Value
+//***************************************************************************
+
+static int bindValue(sqlite3_stmt* stmt, int pos, cDbValue* value)
+{
+   cDbFieldDef* field = value->getField();
+
+   if (*value->getNullRef())
+      return sqlite3_bind_null(stmt, pos);
+
+   // the values are copied (SQLITE_TRANSIENT) since the same cDbValue
+   //  may be bound as in and out parameter of a statement
+
+   switch (field->getFormat())
+   {
+      case cDBS::ffAscii:
+      case cDBS::ffText:
+      case cDBS::ffMText:
+         return sqlite3_bind_text(stmt, pos, value->getStrValueRef(), *value->getStrValueSizeRef(), SQLITE_TRANSIENT);
+
+      case cDBS::ffMlob:
+         return sqlite3_bind_blob(stmt, pos, value->getStrValueRef(), *value->getStrValueSizeRef(), SQLITE_TRANSIENT);
+
+      case cDBS::ffFloat:
+         return sqlite3_bind_double(stmt, pos, *value->getFloatValueRef());
+
+      case cDBS::ffDateTime:
+      {
+         char buf[50+TB];
+         cDbTime* t = value->getTimeValueRef();
+
+         sprintf(buf, "%04u-%02u-%02u %02u:%02u:%02u", t->year, t->month, t->day, t->hour, t->minute, t->second);
+
+         return sqlite3_bind_text(stmt, pos, buf, -1, SQLITE_TRANSIENT);
+      }
+
+      case cDBS::ffBigInt:
+      case cDBS::ffUBigInt:
+         return sqlite3_bind_int64(stmt, pos, *value->getBigIntValueRef());
+
+      default:  // ffInt, ffUInt
+         return sqlite3_bind_int64(stmt, pos, *value->getIntValueRef());
+   }
+}
+
+static void readValue(sqlite3_stmt* stmt, int col, cDbValue* value)
+{
+   cDbFieldDef* field = value->getField();
+
+   // like the MySQL binding write directly to the buffers of the value
+
+   *value->getNullRef() = sqlite3_column_type(stmt, col) == SQLITE_NULL;
+
+   if (*value->getNullRef())
+      return;
+
+   switch (field->getFormat())
+   {
+      case cDBS::ffAscii:
+      case cDBS::ffText:
+      case cDBS::ffMText:
+      case cDBS::ffMlob:
+      {
+         const void* data = field->getFormat() == cDBS::ffMlob ?
+            sqlite3_column_blob(stmt, col) : sqlite3_column_text(stmt, col);
+         int size = std::min(sqlite3_column_bytes(stmt, col), field->getSize());
+
+         memcpy(value->getStrValueRef(), data, size);
+         value->getStrValueRef()[size] = 0;
+         *value->getStrValueSizeRef() = size;
+         break;
+      }
+
+      case cDBS::ffFloat:
+         *value->getFloatValueRef() = sqlite3_column_double(stmt, col);
+         break;
+
+      case cDBS::ffDateTime:
+      {
+         struct tm tm;
+         cDbTime* t = value->getTimeValueRef();
+
+         memset(t, 0, sizeof(cDbTime));
+
+         if (toTm(sqlite3_column_value(stmt, col), &tm) == success)
+         {
+            t->year = tm.tm_year + 1900;
+            t->month = tm.tm_mon + 1;
+            t->day = tm.tm_mday;
+            t->hour = tm.tm_hour;
+            t->minute = tm.tm_min;
+            t->second = tm.tm_sec;
+         }
+
+         break;
+      }
+
+      case cDBS::ffBigInt:
+      case cDBS::ffUBigInt:
+         *value->getBigIntValueRef() = sqlite3_column_int64(stmt, col);
+         break;
+
+      default:  // ffInt, ffUInt
+         *value->getIntValueRef() = sqlite3_column_int64(stmt, col);
+         break;
+   }
+}
+
+//***************************************************************************
+// Execute
+//   on a select only the first row is read, therefore getAffected()
+//   reports if a row was found (1) or not (0) - like in streaming mode.
+//   The next row is stepped ahead, a single row result (the usual find())
+//   is reset at once and doesn't keep its read snapshot (WAL) open, a
+//   write of this connection would fail with SQLITE_BUSY_SNAPSHOT as soon
+//   as another connection committed
+//***************************************************************************
+
+int cDbStatement::execute(int noResult)
+{
+   affected = 0;
+   rowPending = no;
+
+   if (!connection || !connection->getHandle())
+      return fail;
+
+   if (!stmt)
+      return connection->errorSql(connection, "execute(missing statement)");
+
+   double start = usNow();
+
+   sqlite3_reset(stmt);
+
+   for (int i = 0; i < inCount; i++)
+   {
+      if (bindValue(stmt, i+1, inBind[i]) != SQLITE_OK)
+         return connection->errorSql(connection, "execute(bind)", stmt, stmtTxt.c_str());
+   }
+
+   int res = sqlite3_step(stmt);
+
+   double elapsed = usNow() - start;
+
+   if (!histogram)
+      histogram = cMetrics::histogram("db_statement_seconds", stmtTxt.c_str());
+
+   histogram->record(elapsed);
+   duration += elapsed;
+   callsPeriod++;
+   callsTotal++;
+
+   if (res != SQLITE_ROW && res != SQLITE_DONE)
+   {
+      connection->errorSql(connection, "execute(step)", stmt, stmtTxt.c_str());
+      sqlite3_reset(stmt);
+      return fail;
+   }
+
+   if (outCount)
+   {
+      affected = res == SQLITE_ROW ? 1 : 0;
+
+      if (res == SQLITE_ROW && !noResult)
+      {
+         for (int i = 0; i < outCount && i < sqlite3_column_count(stmt); i++)
+            readValue(stmt, i, outBind[i]);
+
+         rowPending = sqlite3_step(stmt) == SQLITE_ROW;
+      }
+
+      // the result is kept open until the last row is fetched or freeResult() is called
+
+      if (!rowPending)
+         sqlite3_reset(stmt);
+   }
+   else
+   {
+      affected = sqlite3_changes(connection->getHandle());
+      sqlite3_reset(stmt);
+   }
+
+   return success;
+}
+
+//***************************************************************************
+//
+//***************************************************************************
+
+int cDbStatement::getLastInsertId()
+{
+   if (!connection->getHandle() || !sqlite3_changes(connection->getHandle()))
+      return na;
+
+   return sqlite3_last_insert_rowid(connection->getHandle());
+}
+
+int cDbStatement::getResultCount()
+{
+   // count the pending rows, the result has to be read again after this!
+
+   int count = affected;
+
+   if (rowPending)
+   {
+      count++;
+
+      while (sqlite3_step(stmt) == SQLITE_ROW)
+         count++;
+   }
+
+   sqlite3_reset(stmt);
+   rowPending = no;
+   affected = count;
+
+   return count;
+}
+
+int cDbStatement::fetch()
+{
+   if (!stmt || !rowPending)
+      return no;
+
+   for (int i = 0; i < outCount && i < sqlite3_column_count(stmt); i++)
+      readValue(stmt, i, outBind[i]);
+
+   if (!(rowPending = sqlite3_step(stmt) == SQLITE_ROW))
+      sqlite3_reset(stmt);
+
+   return yes;
+}
+
+int cDbStatement::freeResult()
+{
+   // reset the statement, this ends the read transaction (WAL snapshot)
+
+   if (stmt)
+      sqlite3_reset(stmt);
+
+   rowPending = no;
+
+   return success;
+}
+
+//***************************************************************************
+// Set Streaming - SQLite always steps row by row
+//***************************************************************************
+
+int cDbStatement::setStreaming()
+{
+   streaming = yes;
+
+   return success;
+}
+
+//***************************************************************************
+// Clear
+//***************************************************************************
+
+void cDbStatement::clear()
+{
+   stmtTxt = "";
+   affected = 0;
+
+   if (inCount)
+   {
+      free(inBind);
+      inCount = 0;
+      inBind = 0;
+   }
+
+   if (outCount)
+   {
+      free(outBind);
+      outCount = 0;
+      outBind = 0;
+   }
+
+   if (stmt)
+   {
+      sqlite3_finalize(stmt);
+      stmt = 0;
+   }
+}
+
+//***************************************************************************
+// Append Binding
+//***************************************************************************
+
+int cDbStatement::appendBinding(cDbValue* value, BindType bt)
+{
+   int count = 0;
+   cDbBind** bindings = 0;
+
+   if (bt & bndIn)
+   {
+      count = ++inCount;
+      bindings = &inBind;
+   }
+   else if (bt & bndOut)
+   {
+      count = ++outCount;
+      bindings = &outBind;
+   }
+   else
+      return 0;
+
+   if (!*bindings)
+      *bindings = (cDbBind*)malloc(count * sizeof(cDbBind));
+   else
+      *bindings = (cDbBind*)srealloc(*bindings, count * sizeof(cDbBind));
+
+   (*bindings)[count-1] = value;
+
+   return success;
+}
+
+//***************************************************************************
+// Prepare Statement
+//***************************************************************************
+
+int cDbStatement::prepare()
+{
+   if (!connection->getHandle())
+   {
+      tell(eloAlways, "Error: Lost connection, can't prepare statement");
+      return fail;
+   }
+
+   if (!stmtTxt.length())
+      return fail;
+
+   if (buildErrors)
+      return fail;
+
+   if (sqlite3_prepare_v2(connection->getHandle(), stmtTxt.c_str(), stmtTxt.length(), &stmt, 0) != SQLITE_OK)
+      return connection->errorSql(connection, "prepare(prepare_v2)", stmt, stmtTxt.c_str());
+
+   if (sqlite3_bind_parameter_count(stmt) != inCount)
+      tell(eloAlways, "Warning: Statement '%s' expects (%d) parameters but (%d) are bound",
+           stmtTxt.c_str(), sqlite3_bind_parameter_count(stmt), inCount);
+
+   tell(eloDebugDb, "Statement '%s' with (%d) in parameters and (%d) out bindings prepared",
+        stmtTxt.c_str(), sqlite3_bind_parameter_count(stmt), outCount);
+
+   return success;
+}
+
+//***************************************************************************
+// Class cDbConnection
+//***************************************************************************
+
+//***************************************************************************
+// Init / Exit - must exactly called 'once' per process
+//***************************************************************************
+
+int cDbConnection::init()
+{
+   int status = success;
+
+   initMutex.Lock();
+
+   if (!initThreads)
+   {
+      // each connection is used by one thread only
+
+      tell(eloDebugDb, "Info: Calling sqlite3_initialize()");
+
+      sqlite3_config(SQLITE_CONFIG_MULTITHREAD);
+
+      if (sqlite3_initialize() != SQLITE_OK)
+      {
+         tell(eloAlways, "Error: sqlite3_initialize() failed");
+         status = fail;
+      }
+   }
+
+   initThreads++;
+   initMutex.Unlock();
+
+   return status;
+}
+
+int cDbConnection::exit()
+{
+   initMutex.Lock();
+
+   initThreads--;
+
+   if (!initThreads)
+   {
+      tell(eloDetail, "Info: Released the last usage of sqlite, calling sqlite3_shutdown() now");
+      sqlite3_shutdown();
+
+      free(dbHost);
+      free(dbUser);
+      free(dbPass);
+      free(dbName);
+      free(encoding);
+      free(confPath);
+   }
+
+   initMutex.Unlock();
+
+   return done;
+}
+
+//***************************************************************************
+// Attach / Close
+//***************************************************************************
+
+int cDbConnection::attachConnection()
+{
+   if (!handle)
+   {
+      std::string file;
+
+      connectDropped = yes;
+
+      if (dbName && *dbName == '/')
+         file = dbName;
+      else
+         file = SQLITE_PATH "/" + std::string(dbName ? dbName : TARGET) + ".sqlite";
+
+      tell(eloDb, "Opening sqlite database '%s' (%ld)", file.c_str(), syscall(__NR_gettid));
+
+      if (sqlite3_open_v2(file.c_str(), &handle, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0) != SQLITE_OK)
+      {
+         errorSql(this, "connecting to database");
+         tell(eloAlways, "Error, opening database '%s' failed", file.c_str());
+         close();
+         return fail;
+      }
+
+      connectDropped = no;
+
+      // WAL: readers don't block the writer and the commits are sequential
+      //   appends to the -wal file instead of rewriting the pages
+
+      sqlite3_busy_timeout(handle, sqliteBusyTimeout);
+
+      if (query("PRAGMA journal_mode = WAL") != success ||
+          query("PRAGMA synchronous = NORMAL") != success ||
+          registerFunctions(handle) != success)
+      {
+         close();
+         return fail;
+      }
+   }
+
+   attached++;
+
+   return success;
+}
+
+void cDbConnection::close()
+{
+   if (handle)
+   {
+      tell(eloDb, "Closing sqlite database (%ld)", syscall(__NR_gettid));
+
+      // the statements may be finalized later, close_v2() defers the close until then
+
+      sqlite3_close_v2(handle);
+      handle = 0;
+      attached = 0;
+   }
+}
+
+//***************************************************************************
+// Query
+//***************************************************************************
+
+struct FirstColumn
+{
+   int found {no};
+   int value {0};
+};
+
+static int firstColumn(void* arg, int argc, char** argv, char** colNames)
+{
+   FirstColumn* first = (FirstColumn*)arg;
+
+   first->found = yes;
+
+   if (argc && argv[0])
+      first->value = atoi(argv[0]);
+
+   return 1;   // we need only the first row -> abort
+}
+
+int cDbConnection::query(int& count, const char* format, ...)
+{
+   int status = SQLITE_ERROR;
+   FirstColumn first;
+   va_list more;
+
+   count = 0;
+
+   if (!format || !getHandle())
+      return fail;
+
+   va_start(more, format);
+
+   char* stmt;
+   int changes = sqlite3_total_changes(getHandle());
+
+   vasprintf(&stmt, format, more);
+   va_end(more);
+
+   status = sqlite3_exec(getHandle(), stmt, firstColumn, &first, 0);
+
+   if (status == SQLITE_ABORT && first.found)     // aborted by callback after the first row
+      status = SQLITE_OK;
+   else if (status != SQLITE_OK)
+      errorSql(this, stmt);
+
+   free(stmt);
+
+   // first column of the first row - or the affected rows if there is no result
+
+   if (status == SQLITE_OK)
+      count = first.found ? first.value : sqlite3_total_changes(getHandle()) - changes;
+
+   return status == SQLITE_OK ? success : fail;
+}
+
+int cDbConnection::vquery(const char* format, va_list more)
+{
+   int status = SQLITE_ERROR;
+   sqlite3* h = getHandle();
+
+   if (h && format)
+   {
+      char* stmt;
+
+      vasprintf(&stmt, format, more);
+
+      if ((status = sqlite3_exec(h, stmt, 0, 0, 0)) != SQLITE_OK)
+         errorSql(this, stmt);
+
+      free(stmt);
+   }
+
+   return status != SQLITE_OK ? fail : success;
+}
+
+void cDbConnection::queryReset()
+{
+   // sqlite3_exec() doesn't keep a result
+}
+
+//***************************************************************************
+// Escape SQL String
+//***************************************************************************
+
+std::string cDbConnection::escapeSqlString(const char* str)
+{
+   std::string result = "";
+
+   if (!isConnected())
+      return result;
+
+   char* buffer = sqlite3_mprintf("%q", str);
+   result = buffer;
+   sqlite3_free(buffer);
+
+   return result;
+}
+
+//***************************************************************************
+// Start Transaction
+//***************************************************************************
+
+int cDbConnection::startTransaction()
+{
+   // IMMEDIATE takes the write lock at once, a deferred transaction
+   //   which reads first can't upgrade from an outdated snapshot
+
+   inTact = yes;
+   return query("BEGIN IMMEDIATE");
+}
+
+//***************************************************************************
+// Table Exists
+//***************************************************************************
+
+int cDbConnection::tableExists(const char* name)
+{
+   int count = 0;
+
+   if (!getHandle())
+      return fail;
+
+   if (query(count, "select count(*) from sqlite_master where type in ('table', 'view') and name = '%s'",
+             escapeSqlString(name).c_str()) != success)
+      return fail;
+
+   return count > 0 ? yes : no;
+}
+
+//***************************************************************************
+// SQL Error
+//***************************************************************************
+
+int cDbConnection::errorSql(cDbConnection* connection, const char* prefix,
+                            cDbStmtHandle* stmt, const char* stmtTxt)
+{
+   if (!connection || !connection->handle)
+   {
+      tell(eloAlways, "SQL-Error in '%s'", prefix);
+      return fail;
+   }
+
+   int error = sqlite3_extended_errcode(connection->handle);
+   char* stmtErr = 0;
+
+   // only a broken database file needs a 'reconnect'
+
+   if ((error & 0xff) == SQLITE_CORRUPT ||
+       (error & 0xff) == SQLITE_NOTADB ||
+       (error & 0xff) == SQLITE_CANTOPEN ||
+       (error & 0xff) == SQLITE_IOERR)
+   {
+      connectDropped = yes;
+   }
+
+   if (stmtTxt)
+      asprintf(&stmtErr, "[%s]", stmtTxt);
+
+   tell(eloAlways, "SQL-Error in '%s' - %s (%d) %s", prefix,
+        sqlite3_errmsg(connection->handle), error, stmtErr ? stmtErr : "");
+
+   free(stmtErr);
+
+   if (connectDropped)
+      tell(eloAlways, "Fatal, database file not accessible, aborting pending actions");
+
+   return fail;
+}
+
+//***************************************************************************
+// Class cDbTable
+//***************************************************************************
+
+//***************************************************************************
+// Validate Structure
+//   SQLite can't modify columns, missing columns are added, changed ones
+//   only reported
+//***************************************************************************
+
+int cDbTable::validateStructure(int allowAlter)
+{
+   std::map<std::string, std::string, _casecmp_> fields;
+   sqlite3_stmt* stmt {nullptr};
+   std::string select;
+   int needDetach = no;
+
+   if (!allowAlter)
+      return done;
+
+   if (!isAttached())
+   {
+      needDetach = yes;
+
+      if (attach() != success)
+         return fail;
+   }
+
+   select = "pragma table_info(" + std::string(TableName()) + ")";
+
+   if (sqlite3_prepare_v2(connection->getHandle(), select.c_str(), -1, &stmt, 0) != SQLITE_OK)
+   {
+      connection->errorSql(getConnection(), "validateStructure()", 0, select.c_str());
+      if (needDetach) detach();
+      return fail;
+   }
+
+   // cid, name, type, notnull, dflt_value, pk
+
+   while (sqlite3_step(stmt) == SQLITE_ROW)
+      fields[(const char*)sqlite3_column_text(stmt, 1)] = (const char*)sqlite3_column_text(stmt, 2);
+
+   sqlite3_finalize(stmt);
+
+   for (int i = 0; i < fieldCount(); i++)
+   {
+      tell(eloDebugDb, "Check field '%s'", getField(i)->getName());
+
+      if (fields.find(getField(i)->getDbName()) == fields.end())
+         alterAddField(getField(i));
+
+      else if (strcasecmp(fields[getField(i)->getDbName()].c_str(), toColumnType(getField(i))) != 0)
+         alterModifyField(getField(i));
+   }
+
+   for (auto it = fields.begin(); it != fields.end(); it++)
+   {
+      if (!getRow()->getFieldByDbName(it->first.c_str()))
+      {
+         if (allowAlter == 2)
+            alterDropField(it->first.c_str());
+         else
+            tell(eloAlways, "Info: Field '%s' not used anymore, "
+                 "to remove it call 'ALTER TABLE %s DROP COLUMN %s;' manually",
+                 it->first.c_str(), TableName(), it->first.c_str());
+      }
+   }
+
+   if (needDetach) detach();
+
+   return success;
+}
+
+//***************************************************************************
+// Alter 'Modify Field'
+//***************************************************************************
+
+int cDbTable::alterModifyField(cDbFieldDef* def)
+{
+   // SQLite has no 'alter table ... modify column', due to the dynamic typing
+   //  the stored values are still readable
+
+   tell(eloAlways, "Info: Type of field '%s.%s' changed to '%s', SQLite can't alter it, ignoring",
+        TableName(), def->getName(), toColumnType(def));
+
+   return done;
+}
+
+//***************************************************************************
+// Alter 'Add Field'
+//***************************************************************************
+
+int cDbTable::alterAddField(cDbFieldDef* def)
+{
+   std::string statement;
+
+   tell(eloAlways, "Info: Missing field '%s.%s', try to alter table",
+        TableName(), def->getName());
+
+   statement = std::string("alter table ") + TableName() + std::string(" add column ")
+      + def->getDbName() + std::string(" ") + toColumnType(def);
+
+   if (def->getFormat() != ffMlob && !isEmpty(def->getDefault()))
+      statement += " default '" + std::string(def->getDefault()) + "'";
+
+   tell(eloDetail, "Execute [%s]", statement.c_str());
+
+   if (connection->query("%s", statement.c_str()))
+      return connection->errorSql(getConnection(), "alterAddField()",
+                                  0, statement.c_str());
+
+   return done;
+}
+
+//***************************************************************************
+// Alter 'Drop Field'
+//***************************************************************************
+
+int cDbTable::alterDropField(const char* name)
+{
+   char* statement;
+
+   tell(eloAlways, "Info: Unused field '%s', try to drop it", name);
+
+   asprintf(&statement, "alter table %s drop column %s", TableName(), name);
+
+   tell(eloDetail, "Execute [%s]", statement);
+
+   if (connection->query("%s", statement))
+   {
+      connection->errorSql(getConnection(), "alterDropField()", 0, statement);
+      free(statement);
+      return fail;
+   }
+
+   free(statement);
+
+   return done;
+}
+
+//***************************************************************************
+// Create Table
+//***************************************************************************
+
+int cDbTable::createTable()
+{
+   std::string statement;
+   std::string aKey;
+   int needDetach = no;
+   int primaryCount = 0;
+   int rowidKey = no;
+
+   if (!tableDef || !row)
+      return abrt;
+
+   if (!isAttached())
+   {
+      needDetach = yes;
+
+      if (attach() != success)
+         return fail;
+   }
+
+   // table exists -> nothing to do
+
+   if (exist())
+   {
+      if (needDetach) detach();
+      return done;
+   }
+
+   tell(eloAlways, "Initialy creating table '%s'", TableName());
+
+   // a single autoinc primary key is mapped to the rowid
+
+   for (int i = 0; i < fieldCount(); i++)
+   {
+      if (getField(i)->getType() & ftPrimary)
+      {
+         primaryCount++;
+         rowidKey = getField(i)->getType() & ftAutoinc ? yes : no;
+      }
+   }
+
+   rowidKey = rowidKey && primaryCount == 1;
+
+   // build 'create' statement ...
+
+   statement = std::string("create table ") + TableName() + std::string("(");
+
+   for (int i = 0; i < fieldCount(); i++)
+   {
+      if (i) statement += std::string(", ");
+
+      statement += std::string(getField(i)->getDbName()) + " " + toColumnType(getField(i));
+
+      if (getField(i)->getType() & ftAutoinc)
+      {
+         if (rowidKey)
+            statement += " primary key autoincrement";
+         else
+            tell(eloAlways, "Warning: Autoinc of '%s.%s' not supported by SQLite, ignoring",
+                 TableName(), getField(i)->getDbName());
+      }
+      else if (getField(i)->getFormat() != ffMlob && !isEmpty(getField(i)->getDefault()))
+         statement += " default '" + std::string(getField(i)->getDefault()) + "'";
+   }
+
+   if (!rowidKey)
+   {
+      for (int i = 0, n = 0; i < fieldCount(); i++)
+      {
+         if (getField(i)->getType() & ftPrimary)
+         {
+            if (n++) aKey += std::string(", ");
+            aKey += std::string(getField(i)->getDbName()) + " DESC";
+         }
+      }
+
+      if (aKey.length())
+         statement += std::string(", PRIMARY KEY(") + aKey + ")";
+   }
+
+   statement += std::string(");");
+
+   tell(eloDetail, "%s", statement.c_str());
+
+   if (connection->query("%s", statement.c_str()))
+   {
+      if (needDetach) detach();
+      return connection->errorSql(getConnection(), "createTable()",
+                                  0, statement.c_str());
+   }
+
+   if (needDetach) detach();
+
+   return success;
+}
+
+//***************************************************************************
+// Check Index
+//***************************************************************************
+
+int cDbTable::checkIndex(const char* idxName, int& fieldCount)
+{
+   fieldCount = 0;
+
+   if (connection->query(fieldCount, "select count(*) from sqlite_master m, pragma_index_info(m.name) "
+                         "where m.type = 'index' and m.tbl_name = '%s' and m.name = '%s'",
+                         TableName(), idxName) != success)
+   {
+      connection->errorSql(getConnection(), "checkIndex()", 0);
+      return fail;
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Truncate
+//***************************************************************************
+
+int cDbTable::truncate()
+{
+   std::string tmp;
+
+   // SQLite has no 'truncate', a unqualified delete is optimized to it
+
+   tmp = "delete from " + std::string(TableName());
+
+   if (connection->query("%s", tmp.c_str()))
+      return connection->errorSql(connection, "truncate() 'delete from'", 0, tmp.c_str());
+
+   return success;
+}
@@ -0,0 +1,460 @@
+/*
+ * gorilla.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <string.h>
+
+#include <map>
+
+#include "gorilla.h"
+
+//***************************************************************************
+// Helper
+//***************************************************************************
+
+static uint64_t double2Bits(double value)
+{
+   uint64_t bits {0};
+   memcpy(&bits, &value, sizeof(bits));
+   return bits;
+}
+
+static double bits2Double(uint64_t bits)
+{
+   double value {0};
+   memcpy(&value, &bits, sizeof(value));
+   return value;
+}
+
+static int leadingZeros(uint64_t value)  { return value ? __builtin_clzll(value) : 64; }
+static int trailingZeros(uint64_t value) { return value ? __builtin_ctzll(value) : 64; }
+
+//***************************************************************************
+// Class cGorillaEncoder
+//***************************************************************************
+
+void cGorillaEncoder::reset()
+{
+   block.clear();
+   bitPos = 0;
+   count = 0;
+   lastTime = 0;
+   lastDelta = 0;
+   lastValue = 0;
+   lastLeading = -1;
+   lastTrailing = 0;
+}
+
+//***************************************************************************
+// Write Bits
+//***************************************************************************
+
+void cGorillaEncoder::writeBits(uint64_t value, int bits)
+{
+   while (bits > 0)
+   {
+      if (!bitPos)
+         block.push_back(0);
+
+      int free = 8 - bitPos;
+      int n = std::min(free, bits);
+      unsigned char part = (value >> (bits - n)) & ((1 << n) - 1);
+
+      block.back() |= part << (free - n);
+      bitPos = (bitPos + n) % 8;
+      bits -= n;
+   }
+}
+
+//***************************************************************************
+// Append
+//***************************************************************************
+
+int cGorillaEncoder::append(time_t time, double value)
+{
+   uint64_t bits = double2Bits(value);
+
+   if (!count)
+   {
+      writeBits(version, 8);
+      writeBits(0, 32);                 // count, patched by finish()
+      writeBits((uint64_t)time, 64);
+      writeBits(bits, 64);
+
+      lastTime = time;
+      lastValue = bits;
+      count++;
+
+      return success;
+   }
+
+   if (time < lastTime)
+      return fail;
+
+   // time - delta of delta
+
+   int64_t delta = time - lastTime;
+   int64_t dod = delta - lastDelta;
+
+   if (dod == 0)
+      writeBits(0, 1);
+   else if (dod >= -64 && dod <= 63)
+   {
+      writeBits(0x02, 2);
+      writeBits((uint64_t)dod, 7);
+   }
+   else if (dod >= -256 && dod <= 255)
+   {
+      writeBits(0x06, 3);
+      writeBits((uint64_t)dod, 9);
+   }
+   else if (dod >= -2048 && dod <= 2047)
+   {
+      writeBits(0x0e, 4);
+      writeBits((uint64_t)dod, 12);
+   }
+   else if (dod >= INT32_MIN && dod <= INT32_MAX)
+   {
+      writeBits(0x1e, 5);
+      writeBits((uint64_t)dod, 32);
+   }
+   else
+   {
+      writeBits(0x1f, 5);
+      writeBits((uint64_t)time, 64);
+   }
+
+   lastDelta = delta;
+   lastTime = time;
+
+   // value - XOR to the previous one
+
+   uint64_t xr = bits ^ lastValue;
+
+   if (!xr)
+   {
+      writeBits(0, 1);
+   }
+   else
+   {
+      int leading = std::min(leadingZeros(xr), 31);
+      int trailing = trailingZeros(xr);
+
+      if (lastLeading >= 0 && leading >= lastLeading && trailing >= lastTrailing)
+      {
+         writeBits(0x02, 2);
+         writeBits(xr >> lastTrailing, 64 - lastLeading - lastTrailing);
+      }
+      else
+      {
+         int length = 64 - leading - trailing;
+
+         writeBits(0x03, 2);
+         writeBits(leading, 5);
+         writeBits(length == 64 ? 0 : length, 6);
+         writeBits(xr >> trailing, length);
+
+         lastLeading = leading;
+         lastTrailing = trailing;
+      }
+   }
+
+   lastValue = bits;
+   count++;
+
+   return success;
+}
+
+//***************************************************************************
+// Finish - patch the sample count into the header
+//***************************************************************************
+
+int cGorillaEncoder::finish()
+{
+   if (!count)
+      return done;
+
+   for (int i = 0; i < 4; i++)
+      block[1+i] = (count >> (24 - 8*i)) & 0xff;
+
+   return success;
+}
+
+//***************************************************************************
+// Class cGorillaDecoder
+//***************************************************************************
+
+cGorillaDecoder::cGorillaDecoder(const char* aData, size_t aSize)
+{
+   uint64_t value {0};
+
+   data = (const unsigned char*)aData;
+   size = aSize;
+
+   if (readBits(value, 8) != success || value < 1 || value > cGorillaEncoder::version)
+      return;
+
+   version = value;
+
+   if (readBits(value, 32) != success)
+      return;
+
+   count = value;
+}
+
+//***************************************************************************
+// Read Bits
+//***************************************************************************
+
+int cGorillaDecoder::readBits(uint64_t& value, int bits)
+{
+   if (bitOffset + bits > size * 8)
+      return fail;
+
+   value = 0;
+
+   while (bits > 0)
+   {
+      int pos = bitOffset % 8;
+      int n = std::min(8 - pos, bits);
+      unsigned char part = (data[bitOffset / 8] >> (8 - pos - n)) & ((1 << n) - 1);
+
+      value = (value << n) | part;
+      bitOffset += n;
+      bits -= n;
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Next - yes if a sample was decoded, no at the end of the block
+//***************************************************************************
+
+int cGorillaDecoder::next(time_t& time, double& value)
+{
+   uint64_t bits {0};
+
+   if (index >= count)
+      return no;
+
+   if (!index)
+   {
+      uint64_t t {0};
+
+      if (readBits(t, 64) != success || readBits(bits, 64) != success)
+         return no;
+
+      lastTime = (time_t)t;
+      lastValue = bits;
+   }
+   else
+   {
+      // time
+
+      int64_t dod {0};
+      int width {0};
+      int prefix {0};
+      int maxPrefix = version == 1 ? 4 : 5;
+
+      while (prefix < maxPrefix)
+      {
+         int bit = readBit();
+
+         if (bit == na)
+            return no;
+
+         if (!bit)
+            break;
+
+         prefix++;
+      }
+
+      switch (prefix)
+      {
+         case 0: width = 0;  break;
+         case 1: width = 7;  break;
+         case 2: width = 9;  break;
+         case 3: width = 12; break;
+         case 4: width = 32; break;
+         default: width = 64; break;
+      }
+
+      if (width == 64)
+      {
+         // the time itself
+
+         if (readBits(bits, 64) != success)
+            return no;
+
+         lastDelta = (time_t)bits - lastTime;
+         lastTime = (time_t)bits;
+      }
+      else
+      {
+         if (width)
+         {
+            if (readBits(bits, width) != success)
+               return no;
+
+            // sign extend
+
+            dod = (int64_t)(bits << (64 - width)) >> (64 - width);
+         }
+
+         lastDelta += dod;
+         lastTime += lastDelta;
+      }
+
+      // value
+
+      int bit = readBit();
+
+      if (bit == na)
+         return no;
+
+      if (bit)
+      {
+         if ((bit = readBit()) == na)
+            return no;
+
+         if (bit)
+         {
+            uint64_t leading {0}, length {0};
+
+            if (readBits(leading, 5) != success || readBits(length, 6) != success)
+               return no;
+
+            if (!length)
+               length = 64;
+
+            lastLeading = leading;
+            lastTrailing = 64 - leading - length;
+         }
+
+         if (readBits(bits, 64 - lastLeading - lastTrailing) != success)
+            return no;
+
+         lastValue ^= bits << lastTrailing;
+      }
+   }
+
+   time = lastTime;
+   value = bits2Double(lastValue);
+   index++;
+
+   return yes;
+}
+
+//***************************************************************************
+// Class cSampleArchive
+//***************************************************************************
+
+//***************************************************************************
+// Store
+//   an existing block of the day (e.g. samples which arrived after the day was
+//   archived) is merged, on equal times the new sample wins
+//***************************************************************************
+
+int cSampleArchive::store(uint address, const char* type, time_t day, cGorillaEncoder* encoder)
+{
+   cGorillaEncoder merged;
+
+   if (!encoder->getCount())
+      return done;
+
+   encoder->finish();
+
+   table->clear();
+   table->setValue("ADDRESS", (long)address);
+   table->setValue("TYPE", type);
+   table->setValue("DAY", day);
+
+   if (table->find())
+   {
+      std::map<time_t,double> samples;
+      cDbValue* existing = table->getValue("BLOCK");
+      cGorillaDecoder oldBlock(existing->getStrValue(), existing->getStrValueSize());
+      cGorillaDecoder newBlock(encoder->getBlock().c_str(), encoder->getBlock().size());
+      time_t time {0};
+      double value {0};
+
+      while (oldBlock.next(time, value))
+         samples[time] = value;
+
+      while (newBlock.next(time, value))
+         samples[time] = value;
+
+      for (const auto& s : samples)
+         merged.append(s.first, s.second);
+
+      merged.finish();
+      encoder = &merged;
+   }
+
+   const std::string& block = encoder->getBlock();
+
+   table->setValue("SAMPLES", (long)encoder->getCount());
+   table->getValue("BLOCK")->setValue(block.c_str(), block.size());
+
+   return table->store();
+}
+
+//***************************************************************************
+// Read - decode all archived samples of the sensor in [from, to]
+//***************************************************************************
+
+static cDbFieldDef archiveFromDef("ARCHIVE_FROM", "afrom", cDBS::ffDateTime, 0, cDBS::ftData);
+static cDbFieldDef archiveToDef("ARCHIVE_TO", "ato", cDBS::ffDateTime, 0, cDBS::ftData);
+
+int cSampleArchive::read(uint address, const char* type, time_t from, time_t to, cSampleCallback callback)
+{
+   cDbValue dayFrom(&archiveFromDef);
+   cDbValue dayTo(&archiveToDef);
+   cDbStatement select(table);
+   int count {0};
+
+   select.build("select ");
+   select.bind("DAY", cDBS::bndOut);
+   select.bind("SAMPLES", cDBS::bndOut, ", ");
+   select.bind("BLOCK", cDBS::bndOut, ", ");
+   select.build(" from %s where ", table->TableName());
+   select.bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
+   select.bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
+   select.bindCmp(0, "DAY", &dayFrom, ">", " and ");
+   select.bindCmp(0, "DAY", &dayTo, "<=", " and ");
+   select.build(" order by day");
+
+   if (select.prepare() != success)
+      return fail;
+
+   table->clear();
+   table->setValue("ADDRESS", (long)address);
+   table->setValue("TYPE", type);
+   dayFrom.setValue(from - tmeSecondsPerDay);   // the block of a day starts at midnight
+   dayTo.setValue(to);
+
+   for (int f = select.find(); f; f = select.fetch())
+   {
+      cDbValue* block = table->getValue("BLOCK");
+      cGorillaDecoder decoder(block->getStrValue(), block->getStrValueSize());
+      time_t time {0};
+      double value {0};
+
+      while (decoder.next(time, value))
+      {
+         if (time < from || time > to)
+            continue;
+
+         callback(time, value);
+         count++;
+      }
+   }
+
+   select.freeResult();
+
+   return count;
+}
@@ -0,0 +1,125 @@
+/*
+ * gorilla.h
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#pragma once
+
+//***************************************************************************
+// Include
+//***************************************************************************
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+#include <functional>
+
+#include "db.h"
+
+//***************************************************************************
+// Gorilla Time Series Compression
+//   (delta-of-delta encoded timestamps and XOR encoded float values)
+//
+// Block layout (bitstream, MSB first):
+//   version (8) | count (32) | first time (64) | first value (64)
+//   followed by count-1 entries of
+//     time:  '0'                  delta of delta is 0
+//            '10'   +  7 bit      -64 .. 63
+//            '110'  +  9 bit      -256 .. 255
+//            '1110' + 12 bit      -2048 .. 2047
+//            '11110' + 32 bit     -2^31 .. 2^31-1
+//            '11111' + 64 bit     everything else, the time itself
+//     value: '0'                  same value as before
+//            '10' + meaningful    XOR fits in the previous leading/trailing window
+//            '11' + 5 bit leading zeros + 6 bit length + meaningful bits
+//   version 1 blocks only know '1111' + 32 bit, they are still decoded
+//***************************************************************************
+
+class cGorillaEncoder
+{
+   public:
+
+      enum Misc
+      {
+         version = 2
+      };
+
+      cGorillaEncoder()  { reset(); }
+
+      void reset();
+      int append(time_t time, double value);
+      int finish();
+
+      uint getCount()                  { return count; }
+      const std::string& getBlock()    { return block; }
+
+   private:
+
+      void writeBits(uint64_t value, int bits);
+
+      std::string block;
+      int bitPos {0};                 // used bits in last byte of block
+      uint count {0};
+
+      time_t lastTime {0};
+      int64_t lastDelta {0};
+      uint64_t lastValue {0};
+      int lastLeading {-1};
+      int lastTrailing {0};
+};
+
+//***************************************************************************
+// Gorilla Decoder
+//***************************************************************************
+
+class cGorillaDecoder
+{
+   public:
+
+      cGorillaDecoder(const char* aData, size_t aSize);
+
+      int next(time_t& time, double& value);
+      uint getCount()                  { return count; }
+
+   private:
+
+      int readBits(uint64_t& value, int bits);
+      int readBit()                    { uint64_t b {0}; return readBits(b, 1) == success ? (int)b : na; }
+
+      const unsigned char* data {nullptr};
+      size_t size {0};
+      size_t bitOffset {0};
+      uint version {0};
+      uint count {0};
+      uint index {0};
+
+      time_t lastTime {0};
+      int64_t lastDelta {0};
+      uint64_t lastValue {0};
+      int lastLeading {0};
+      int lastTrailing {0};
+};
+
+//***************************************************************************
+// Sample Archive
+//   one compressed block per sensor and day in table 'samplearchive'
+//***************************************************************************
+
+class cSampleArchive
+{
+   public:
+
+      typedef std::function<void(time_t time, double value)> cSampleCallback;
+
+      cSampleArchive(cDbTable* aTable)  { table = aTable; }
+
+      int store(uint address, const char* type, time_t day, cGorillaEncoder* encoder);
+      int read(uint address, const char* type, time_t from, time_t to, cSampleCallback callback);
+
+   private:
+
+      cDbTable* table {nullptr};
+};
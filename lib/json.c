@@ -7,6 +7,8 @@
 
 #ifdef USEJSON
 
+#include <cmath>
+
 #include "json.h"
 
 const char* charset = "utf-8";  // #TODO, move to configuration?
@@ -362,4 +364,284 @@ int addToJson(json_t* obj, const char* name, json_t* o)
    return json_object_set_new(obj, name, o);
 }
 
+//***************************************************************************
+// UTF-8 Valid - same rules as jansson, which refuses other strings
+//***************************************************************************
+
+static bool utf8Valid(const char* s)
+{
+   for (const unsigned char* p = (const unsigned char*)s; *p; )
+   {
+      unsigned cp {0};
+      int n {0};
+
+      if (*p < 0x80)        { p++; continue; }
+      else if (*p < 0xc2)   return false;                     // continuation or overlong
+      else if (*p < 0xe0)   { cp = *p & 0x1f; n = 1; }
+      else if (*p < 0xf0)   { cp = *p & 0x0f; n = 2; }
+      else if (*p < 0xf5)   { cp = *p & 0x07; n = 3; }
+      else                  return false;
+
+      for (int i = 1; i <= n; i++)
+      {
+         if ((p[i] & 0xc0) != 0x80)
+            return false;
+
+         cp = cp << 6 | (p[i] & 0x3f);
+      }
+
+      if ((n == 2 && cp < 0x800) || (n == 3 && cp < 0x10000) || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+         return false;
+
+      p += n + 1;
+   }
+
+   return true;
+}
+
+//***************************************************************************
+// Class cJsonWriter
+//***************************************************************************
+
+cJsonWriter::cJsonWriter(size_t aPrefix, size_t aReserve)
+{
+   prefix = aPrefix;
+
+   if (aReserve)
+      data.reserve(prefix + aReserve);
+
+   clear();
+}
+
+void cJsonWriter::clear()
+{
+   data.assign(prefix, '\0');
+   depth = 0;
+   afterKey = false;
+   overflow = false;
+}
+
+//***************************************************************************
+// Separate - the comma in front of the next element
+//***************************************************************************
+
+void cJsonWriter::separate()
+{
+   if (afterKey)
+   {
+      afterKey = false;
+      return;
+   }
+
+   if (depth > 0 && depth <= maxDepth)
+   {
+      if (needComma[depth-1])
+         data += ',';
+
+      needComma[depth-1] = true;
+   }
+}
+
+//***************************************************************************
+// Object / Array
+//***************************************************************************
+
+cJsonWriter& cJsonWriter::beginObject(const char* name)
+{
+   if (name)
+      key(name);
+
+   separate();
+   data += '{';
+
+   if (++depth <= maxDepth)
+      needComma[depth-1] = false;
+   else
+      overflow = true;
+
+   return *this;
+}
+
+cJsonWriter& cJsonWriter::endObject()
+{
+   data += '}';
+   depth--;
+
+   return *this;
+}
+
+cJsonWriter& cJsonWriter::beginArray(const char* name)
+{
+   if (name)
+      key(name);
+
+   separate();
+   data += '[';
+
+   if (++depth <= maxDepth)
+      needComma[depth-1] = false;
+   else
+      overflow = true;
+
+   return *this;
+}
+
+cJsonWriter& cJsonWriter::endArray()
+{
+   data += ']';
+   depth--;
+
+   return *this;
+}
+
+cJsonWriter& cJsonWriter::key(const char* name)
+{
+   separate();
+   appendString(name);
+   data += ':';
+   afterKey = true;
+
+   return *this;
+}
+
+//***************************************************************************
+// Values
+//***************************************************************************
+
+cJsonWriter& cJsonWriter::null()
+{
+   separate();
+   data += "null";
+
+   return *this;
+}
+
+cJsonWriter& cJsonWriter::value(const char* v)
+{
+   if (!v || !utf8Valid(v))
+      return null();
+
+   separate();
+   appendString(v);
+
+   return *this;
+}
+
+cJsonWriter& cJsonWriter::value(bool v)
+{
+   separate();
+   data += v ? "true" : "false";
+
+   return *this;
+}
+
+cJsonWriter& cJsonWriter::value(long long v)
+{
+   char buf[30];
+
+   separate();
+   data.append(buf, snprintf(buf, sizeof(buf), "%lld", v));
+
+   return *this;
+}
+
+cJsonWriter& cJsonWriter::value(double v)
+{
+   if (!std::isfinite(v))
+      return null();
+
+   char buf[50];
+   int len = snprintf(buf, sizeof(buf), "%.*g", realPrecision, v);
+
+   // like jansson - keep it a real and strip '+' and leading zeros of the exponent
+
+   if (!strchr(buf, '.') && !strchr(buf, 'e'))
+   {
+      strcpy(buf + len, ".0");
+      len += 2;
+   }
+
+   if (char* start = strchr(buf, 'e'))
+   {
+      start++;
+
+      if (*start == '-')
+         start++;
+
+      char* end = start;
+
+      while (*end == '+' || *end == '0')
+         end++;
+
+      if (end != start)
+      {
+         memmove(start, end, buf + len + 1 - end);
+         len -= end - start;
+      }
+   }
+
+   separate();
+   data.append(buf, len);
+
+   return *this;
+}
+
+int cJsonWriter::dumpCallback(const char* buffer, size_t size, void* data)
+{
+   ((std::string*)data)->append(buffer, size);
+   return 0;
+}
+
+cJsonWriter& cJsonWriter::value(json_t* v)
+{
+   if (!v)
+      return null();
+
+   separate();
+   json_dump_callback(v, dumpCallback, &data, JSON_REAL_PRECISION(realPrecision) | JSON_ENCODE_ANY);
+
+   return *this;
+}
+
+//***************************************************************************
+// Append String - quoted and escaped like json_dumps()
+//***************************************************************************
+
+void cJsonWriter::appendString(const char* s)
+{
+   static const char hex[] = "0123456789abcdef";
+
+   data += '"';
+
+   for (const char* p = s; *p; p++)
+   {
+      unsigned char c = *p;
+
+      switch (c)
+      {
+         case '"':  data += "\\\""; break;
+         case '\\': data += "\\\\"; break;
+         case '\b': data += "\\b";  break;
+         case '\f': data += "\\f";  break;
+         case '\n': data += "\\n";  break;
+         case '\r': data += "\\r";  break;
+         case '\t': data += "\\t";  break;
+
+         default:
+         {
+            if (c < 0x20)
+            {
+               data += "\\u00";
+               data += hex[c >> 4];
+               data += hex[c & 0x0f];
+            }
+            else
+               data += (char)c;
+         }
+      }
+   }
+
+   data += '"';
+}
+
 #endif
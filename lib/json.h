@@ -51,3 +51,64 @@ const char* getStringByPath(json_t* jData, const char* aPath, const char* def =
 int addToJson(json_t* obj, const char* name, const char* value, const char* def = "");
 int addToJson(json_t* obj, const char* name, long value);
 int addToJson(json_t* obj, const char* name, json_t* o);
+
+//***************************************************************************
+// JSON Writer
+//   serializes while the data is collected, without building a jansson tree.
+//   The buffer starts with 'prefix' reserved bytes (the LWS_PRE padding of
+//   the websocket frame) therefore it can be queued and sent without a copy.
+//   Reals are formatted like json_dumps() with JSON_REAL_PRECISION(4)
+//***************************************************************************
+
+class cJsonWriter
+{
+   public:
+
+      enum Misc
+      {
+         maxDepth = 32,
+         realPrecision = 4
+      };
+
+      cJsonWriter(size_t aPrefix = 0, size_t aReserve = 0);
+
+      void clear();                                 // keeps the capacity
+      std::string& buffer()             { return data; }            // with the prefix
+      const char* payload() const       { return data.c_str() + prefix; }
+      size_t size() const               { return data.length() - prefix; }
+      bool isComplete() const           { return !depth && !afterKey && !overflow; }
+
+      cJsonWriter& beginObject(const char* name = nullptr);
+      cJsonWriter& endObject();
+      cJsonWriter& beginArray(const char* name = nullptr);
+      cJsonWriter& endArray();
+      cJsonWriter& key(const char* name);
+
+      cJsonWriter& null();
+      cJsonWriter& value(const char* v);            // null for nullptr or invalid UTF-8
+      cJsonWriter& value(const std::string& v)      { return value(v.c_str()); }
+      cJsonWriter& value(bool v);
+      cJsonWriter& value(int v)                     { return value((long long)v); }
+      cJsonWriter& value(unsigned v)                { return value((long long)v); }
+      cJsonWriter& value(long v)                    { return value((long long)v); }
+      cJsonWriter& value(unsigned long v)           { return value((long long)v); }
+      cJsonWriter& value(long long v);
+      cJsonWriter& value(double v);                 // null for nan and inf
+      cJsonWriter& value(json_t* v);                // embeds a jansson value
+
+      template <class T>
+      cJsonWriter& add(const char* name, T v)       { key(name); return value(v); }
+
+   private:
+
+      void separate();
+      void appendString(const char* s);
+      static int dumpCallback(const char* buffer, size_t size, void* data);
+
+      std::string data;
+      size_t prefix {0};
+      int depth {0};
+      bool afterKey {false};
+      bool overflow {false};
+      bool needComma[maxDepth] {};
+};
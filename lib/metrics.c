@@ -0,0 +1,260 @@
+/*
+ * metrics.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <time.h>
+#include <math.h>
+
+#include "metrics.h"
+
+//***************************************************************************
+// Class cMetricHistogram
+//***************************************************************************
+
+int cMetricHistogram::indexOf(uint64_t value)
+{
+   if (value < subBucketCount)
+      return value;
+
+   if (value >= (1ULL << maxValueBits))
+      value = (1ULL << maxValueBits) - 1;
+
+   int shift = (63 - __builtin_clzll(value)) - (subBucketBits - 1);
+
+   return subBucketCount + (shift - 1) * subBucketHalf + (int)((value >> shift) - subBucketHalf);
+}
+
+uint64_t cMetricHistogram::lowestOf(int index)
+{
+   if (index < subBucketCount)
+      return index;
+
+   int shift = (index - subBucketCount) / subBucketHalf + 1;
+   uint64_t top = (index - subBucketCount) % subBucketHalf + subBucketHalf;
+
+   return top << shift;
+}
+
+//***************************************************************************
+// Record
+//***************************************************************************
+
+void cMetricHistogram::record(double us)
+{
+   uint64_t value = us > 0 ? (uint64_t)(us + 0.5) : 0;
+   uint64_t last = max.load(std::memory_order_relaxed);
+
+   buckets[indexOf(value)].fetch_add(1, std::memory_order_relaxed);
+   sum.fetch_add(value, std::memory_order_relaxed);
+   count.fetch_add(1, std::memory_order_relaxed);
+
+   while (value > last && !max.compare_exchange_weak(last, value, std::memory_order_relaxed))
+      ;
+}
+
+//***************************************************************************
+// Percentile - middle of the bucket of the q-th value
+//***************************************************************************
+
+double cMetricHistogram::percentile(double q) const
+{
+   uint64_t total {0};
+
+   for (int i = 0; i < bucketCount; i++)
+      total += buckets[i].load(std::memory_order_relaxed);
+
+   if (!total)
+      return 0;
+
+   uint64_t target = std::max((uint64_t)ceil(q * total), (uint64_t)1);
+   uint64_t seen {0};
+
+   for (int i = 0; i < bucketCount; i++)
+   {
+      seen += buckets[i].load(std::memory_order_relaxed);
+
+      if (seen >= target)
+      {
+         double lowest = lowestOf(i);
+         double highest = i + 1 < bucketCount ? lowestOf(i + 1) - 1 : lowest;
+
+         return std::min((lowest + highest) / 2, getMax());
+      }
+   }
+
+   return getMax();
+}
+
+//***************************************************************************
+// Class cMetrics
+//***************************************************************************
+
+std::map<std::string,cMetrics::Family,std::less<>> cMetrics::families;
+cMyMutex cMetrics::mutex;
+
+double cMetrics::nowUs()
+{
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+//***************************************************************************
+// Family Of - to be called with locked mutex
+//***************************************************************************
+
+cMetrics::Family* cMetrics::familyOf(const char* name)
+{
+   auto it = families.find(name);
+
+   if (it == families.end())
+      it = families.try_emplace(name).first;
+
+   return &it->second;
+}
+
+void cMetrics::describe(const char* name, const char* labelName, const char* help)
+{
+   cMyMutexLock lock(&mutex);
+   Family* family = familyOf(name);
+
+   family->labelName = labelName;
+   family->help = help;
+}
+
+//***************************************************************************
+// Counter / Histogram - lookup, created on first use
+//***************************************************************************
+
+cMetricCounter* cMetrics::counter(const char* name, const char* label)
+{
+   cMyMutexLock lock(&mutex);
+   Family* family = familyOf(name);
+   auto it = family->counters.find(label);
+
+   if (it == family->counters.end())
+      it = family->counters.try_emplace(label).first;
+
+   return &it->second;
+}
+
+cMetricHistogram* cMetrics::histogram(const char* name, const char* label)
+{
+   cMyMutexLock lock(&mutex);
+   Family* family = familyOf(name);
+   auto it = family->histograms.find(label);
+
+   if (it == family->histograms.end())
+      it = family->histograms.try_emplace(label).first;
+
+   return &it->second;
+}
+
+//***************************************************************************
+// To Json
+//   { "<family>" : { "<label>" : value | { count, sum, mean, p50, p90, p99, max } } }
+//   the durations in milliseconds
+//***************************************************************************
+
+int cMetrics::toJson(json_t* obj)
+{
+   cMyMutexLock lock(&mutex);
+
+   for (const auto& f : families)
+   {
+      json_t* oFamily = json_object();
+      json_object_set_new(obj, f.first.c_str(), oFamily);
+
+      for (const auto& c : f.second.counters)
+         json_object_set_new(oFamily, c.first.c_str(), json_integer(c.second.get()));
+
+      for (const auto& h : f.second.histograms)
+      {
+         const cMetricHistogram* histogram = &h.second;
+         uint64_t count = histogram->getCount();
+         json_t* oHistogram = json_object();
+
+         json_object_set_new(oFamily, h.first.c_str(), oHistogram);
+         json_object_set_new(oHistogram, "count", json_integer(count));
+         json_object_set_new(oHistogram, "sum", json_real(histogram->getSum() / 1000));
+         json_object_set_new(oHistogram, "mean", json_real(count ? histogram->getSum() / count / 1000 : 0));
+         json_object_set_new(oHistogram, "p50", json_real(histogram->percentile(0.50) / 1000));
+         json_object_set_new(oHistogram, "p90", json_real(histogram->percentile(0.90) / 1000));
+         json_object_set_new(oHistogram, "p99", json_real(histogram->percentile(0.99) / 1000));
+         json_object_set_new(oHistogram, "max", json_real(histogram->getMax() / 1000));
+      }
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// To Prometheus
+//   text exposition format, the histograms as summary in seconds
+//***************************************************************************
+
+static std::string escapeLabel(const std::string& value)
+{
+   std::string result;
+
+   for (char c : value)
+   {
+      if (c == '\\')      result += "\\\\";
+      else if (c == '"')  result += "\\\"";
+      else if (c == '\n') result += "\\n";
+      else                result += c;
+   }
+
+   return result;
+}
+
+std::string cMetrics::toPrometheus(const char* prefix)
+{
+   static const double quantiles[] = { 0.5, 0.9, 0.99 };
+
+   cMyMutexLock lock(&mutex);
+   std::string result;
+   char buf[100+TB];
+
+   for (const auto& f : families)
+   {
+      std::string name = std::string(prefix) + f.first;
+      const char* type = f.second.histograms.empty() ? "counter" : "summary";
+
+      if (!f.second.help.empty())
+         result += "# HELP " + name + " " + f.second.help + "\n";
+
+      result += "# TYPE " + name + " " + type + "\n";
+
+      for (const auto& c : f.second.counters)
+      {
+         std::string label = c.first.empty() ? "" : "{" + f.second.labelName + "=\"" + escapeLabel(c.first) + "\"}";
+         snprintf(buf, sizeof(buf), " %llu\n", (unsigned long long)c.second.get());
+         result += name + label + buf;
+      }
+
+      for (const auto& h : f.second.histograms)
+      {
+         std::string label = h.first.empty() ? "" : f.second.labelName + "=\"" + escapeLabel(h.first) + "\"";
+
+         for (double q : quantiles)
+         {
+            snprintf(buf, sizeof(buf), "quantile=\"%g\"} %.6f\n", q, h.second.percentile(q) / 1000000);
+            result += name + "{" + label + (label.empty() ? "" : ",") + buf;
+         }
+
+         label = label.empty() ? "" : "{" + label + "}";
+
+         snprintf(buf, sizeof(buf), " %.6f\n", h.second.getSum() / 1000000);
+         result += name + "_sum" + label + buf;
+         snprintf(buf, sizeof(buf), " %llu\n", (unsigned long long)h.second.getCount());
+         result += name + "_count" + label + buf;
+      }
+   }
+
+   return result;
+}
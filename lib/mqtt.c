@@ -7,9 +7,12 @@
 //***************************************************************************
 
 #include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <unistd.h>
+#include <poll.h>
 
 #include <iostream>
 
@@ -30,10 +33,16 @@ Mqtt::Mqtt(int aHeartBeat)
    lastResult = MQTT_OK;
    mqttClient = new mqtt_client;
    memset(mqttClient, 0, sizeof(mqtt_client));
+   wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 }
 
 Mqtt::~Mqtt()
 {
+   disconnect();
+
+   if (wakeupFd != -1)
+      close(wakeupFd);
+
    delete[] sendbuf;
    delete[] recvbuf;
    delete mqttClient;
@@ -55,30 +64,211 @@ void Mqtt::publishCallback(void** user, mqtt_response_publish* published)
 #endif
 }
 
+//***************************************************************************
+// Refresh Thread
+//   sleeps until data arrives, outgoing data is queued (wakeup()) or the
+//   keep alive / acknowledge timeout is reached
+//***************************************************************************
+
 void* Mqtt::refreshFct(void* client)
 {
    int result;
    Mqtt* mqtt = (Mqtt*)client;
    mqtt_client* cl = mqtt->mqttClient; //(mqtt_client*)client;
 
+   pollfd fds[2];
+
+   fds[0].fd = mqtt->sockfd;
+   fds[0].events = POLLIN;
+   fds[1].fd = mqtt->wakeupFd;
+   fds[1].events = POLLIN;
+
    while (!cl->close_now)
    {
-      if ((result = mqtt_sync(cl)) != MQTT_OK)
+      if ((result = mqtt_sync(cl)) == MQTT_ERROR_RECV_BUFFER_TOO_SMALL && mqtt->growReceiveBuffer() == success)
+         continue;
+
+      if (result != MQTT_OK)
       {
          tell(eloAlways, "Error: mqtt_sync for connection '%s' failed, result was %d '%s'",
               mqtt->theTopic.c_str(), result, mqtt_error_str((MQTTErrors)result));
-         mqtt->disconnect();
+         break;
+      }
+
+      fds[0].revents = fds[1].revents = 0;
+
+      if (poll(fds, 2, mqtt->syncTimeout()) < 0 && errno != EINTR)
+      {
+         tell(eloAlways, "Error: MQTT: poll() failed, '%s'", strerror(errno));
+         break;
       }
 
-      cCondWait::SleepMs(10);
-      // tell(eloAlways, "refreshFct '%s' tid: %ld", mqtt->theTopic.c_str(), syscall(__NR_gettid));
+      if (fds[1].revents & POLLIN)
+      {
+         uint64_t count {0};
+         ::read(mqtt->wakeupFd, &count, sizeof(count));
+      }
+
+      // readable but nothing to read -> closed by the broker
+
+      char c;
+
+      if (fds[0].revents & (POLLHUP | POLLERR) ||
+          (fds[0].revents & POLLIN && ::recv(mqtt->sockfd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 0))
+      {
+         tell(eloAlways, "Error: MQTT: Connection closed by broker");
+         break;
+      }
    }
 
+   mqtt->connected = false;
    cl->close_now = 2;
 
    return nullptr;
 }
 
+//***************************************************************************
+// Wakeup - the refresh thread to send the queued data
+//***************************************************************************
+
+void Mqtt::wakeup()
+{
+   uint64_t one {1};
+
+   if (wakeupFd != -1)
+      ::write(wakeupFd, &one, sizeof(one));
+}
+
+//***************************************************************************
+// Sync Timeout
+//   0 if a message is unsent (like the keep alive ping queued by the last
+//   sync), short while waiting for a acknowledge, otherwise long
+//***************************************************************************
+
+int Mqtt::syncTimeout()
+{
+   int timeout {idleTimeout};
+
+   MQTT_PAL_MUTEX_LOCK(&mqttClient->mutex);
+
+   for (ssize_t i = 0; i < mqtt_mq_length(&mqttClient->mq); i++)
+   {
+      mqtt_queued_message* msg = mqtt_mq_get(&mqttClient->mq, i);
+
+      if (msg->state == MQTT_QUEUED_UNSENT)
+      {
+         timeout = 0;
+         break;
+      }
+
+      if (msg->state == MQTT_QUEUED_AWAITING_ACK)
+         timeout = ackTimeout;
+   }
+
+   MQTT_PAL_MUTEX_UNLOCK(&mqttClient->mutex);
+
+   return timeout;
+}
+
+//***************************************************************************
+// Grow Send Buffer
+//   ensure space for 'needed' bytes in the message queue, the queued
+//   messages are moved to the new buffer
+//***************************************************************************
+
+int Mqtt::growSendBuffer(size_t needed)
+{
+   mqtt_message_queue* mq = &mqttClient->mq;
+
+   MQTT_PAL_MUTEX_LOCK(&mqttClient->mutex);
+
+   if (mq->curr_sz < needed)
+      mqtt_mq_clean(mq);
+
+   if (mq->curr_sz >= needed)
+   {
+      MQTT_PAL_MUTEX_UNLOCK(&mqttClient->mutex);
+      return success;
+   }
+
+   size_t used = mq->curr - (uint8_t*)mq->mem_start;
+   size_t count = mqtt_mq_length(mq);
+   size_t size = std::max(sizeSendBuf * 2, used + (count + 1) * sizeof(mqtt_queued_message) + needed * 2);
+
+   size = (size + 63) & ~(size_t)63;     // keep the queue at the end aligned
+
+   if (size > maxBufferSize)
+   {
+      MQTT_PAL_MUTEX_UNLOCK(&mqttClient->mutex);
+      tell(eloAlways, "Error: MQTT: Message of %zu bytes exceeds the send buffer limit", needed);
+      return fail;
+   }
+
+   uint8_t* buf = new uint8_t[size];
+   mqtt_queued_message* tail = (mqtt_queued_message*)(buf + size) - count;
+
+   memcpy(buf, mq->mem_start, used);
+   memcpy((void*)tail, (void*)mq->queue_tail, count * sizeof(mqtt_queued_message));
+
+   for (size_t i = 0; i < count; i++)
+      tail[i].start = buf + (tail[i].start - (uint8_t*)mq->mem_start);
+
+   mq->mem_start = buf;
+   mq->mem_end = buf + size;
+   mq->curr = buf + used;
+   mq->queue_tail = tail;
+   mq->curr_sz = mqtt_mq_currsz(mq);
+
+   delete[] sendbuf;
+   sendbuf = buf;
+   sizeSendBuf = size;
+
+   MQTT_PAL_MUTEX_UNLOCK(&mqttClient->mutex);
+
+   tell(eloMqtt, "MQTT: Send buffer grown to %zu bytes", size);
+
+   return success;
+}
+
+//***************************************************************************
+// Grow Receive Buffer
+//   called by the refresh thread if a incoming message don't fit
+//***************************************************************************
+
+int Mqtt::growReceiveBuffer()
+{
+   size_t size = sizeReceiveBuf * 2;
+
+   if (size > maxBufferSize)
+   {
+      tell(eloAlways, "Error: MQTT: Incoming message exceeds the receive buffer limit");
+      return fail;
+   }
+
+   MQTT_PAL_MUTEX_LOCK(&mqttClient->mutex);
+
+   size_t used = mqttClient->recv_buffer.curr - mqttClient->recv_buffer.mem_start;
+   uint8_t* buf = new uint8_t[size];
+
+   memcpy(buf, mqttClient->recv_buffer.mem_start, used);
+
+   mqttClient->recv_buffer.mem_start = buf;
+   mqttClient->recv_buffer.mem_size = size;
+   mqttClient->recv_buffer.curr = buf + used;
+   mqttClient->recv_buffer.curr_sz = size - used;
+   mqttClient->error = MQTT_OK;
+
+   delete[] recvbuf;
+   recvbuf = buf;
+   sizeReceiveBuf = size;
+
+   MQTT_PAL_MUTEX_UNLOCK(&mqttClient->mutex);
+
+   tell(eloMqtt, "MQTT: Receive buffer grown to %zu bytes", size);
+
+   return success;
+}
+
 void Mqtt::appendMessage(mqtt_response_publish* published)
 {
    Mqtt::Message* msg = new Mqtt::Message();
@@ -93,7 +283,7 @@ void Mqtt::appendMessage(mqtt_response_publish* published)
 
    {
       cMyMutexLock lock(&readMutex);
-      receivedMessages.push(msg);
+      receivedMessages.push_back(msg);
    }
 
    readCond.Broadcast();
@@ -135,47 +325,48 @@ int Mqtt::connect(const char* aUrl, const char* user, const char* password)
    delete[] sendbuf;
    delete[] recvbuf;
 
-   sizeSendBuf = 1024 * 1024;
+   sizeSendBuf = initialBufferSize;
    sendbuf = new uint8_t[sizeSendBuf];
-   sizeReceiveBuf = 1024 * 1024;
+   sizeReceiveBuf = initialBufferSize;
    recvbuf = new uint8_t[sizeReceiveBuf];
 
-   // refresh thread
+   mqttClient->publish_response_callback_state = this;
+   lastResult = mqtt_init(mqttClient, sockfd, sendbuf, sizeSendBuf, recvbuf, sizeReceiveBuf, publishCallback, 0, 0);
 
-   if (pthread_create(&refreshThread, NULL, refreshFct, this))
+   if (lastResult != MQTT_OK)
    {
-      tell(eloAlways, "Error: Failed to start client daemon thread");
+      tell(eloAlways, "Error: Initializing client failed");
       close(sockfd);
       sockfd = -1;
       return fail;
    }
 
-   pthread_detach(refreshThread);
-
-   //
+   // #TODO - some connecting options needed?
 
-   mqttClient->publish_response_callback_state = this;
-   lastResult = mqtt_init(mqttClient, sockfd, sendbuf, sizeSendBuf, recvbuf, sizeReceiveBuf, publishCallback, refreshThread, SIGUSR2);
+   lastResult = mqtt_connect(mqttClient, "", NULL, NULL, 0, user, password, MQTT_CONNECT_RESERVED | MQTT_CONNECT_CLEAN_SESSION, heartBeat);
 
    if (lastResult != MQTT_OK)
    {
-      tell(eloAlways, "Error: Initializing client failed");
+      tell(eloAlways, "Error: Connecting to '%s:%d' failed with code (%ld)", hostname, port, lastResult);
+      close(sockfd);
+      sockfd = -1;
       return fail;
    }
 
-   // #TODO - some connecting options needed?
+   // refresh thread, started after init - it sends the queued CONNECT
 
-   lastResult = mqtt_connect(mqttClient, "", NULL, NULL, 0, user, password, MQTT_CONNECT_RESERVED | MQTT_CONNECT_CLEAN_SESSION, 400);
+   connected = true;
 
-   if (lastResult != MQTT_OK)
+   if (pthread_create(&refreshThread, NULL, refreshFct, this))
    {
-      tell(eloAlways, "Error: Connecting to '%s:%d' failed with code (%ld)", hostname, port, lastResult);
+      tell(eloAlways, "Error: Failed to start client daemon thread");
+      connected = false;
+      refreshThread = 0;
       close(sockfd);
+      sockfd = -1;
       return fail;
    }
 
-   connected = true;
-
    return success;
 }
 
@@ -187,12 +378,16 @@ int Mqtt::disconnect()
 {
    cMyMutexLock lock(&connectMutex);
 
-   if (!isConnected())
+   if (!refreshThread && sockfd == -1)
       return success;
 
    connected = false;
    tell(eloDebug, "Debug: Disconnecting from MQTT");
-   mqttClient->close_now = 1;
+
+   if (mqttClient->close_now != 2)
+      mqttClient->close_now = 1;
+
+   wakeup();
 
    time_t endWait = time(0) + 10;
 
@@ -204,7 +399,7 @@ int Mqtt::disconnect()
    tell(eloDebug, "Info: Stopping refresh thread for '%s' - '%s'", theTopic.c_str(),
         mqttClient->close_now == 2 ? "succeeded" : "aborted");
 
-   if (mqttClient->close_now == 2)
+   if (mqttClient->close_now == 2 && refreshThread)
       pthread_join(refreshThread, 0);
    else if (refreshThread)
       pthread_cancel(refreshThread);
@@ -246,6 +441,8 @@ int Mqtt::subscribe(const char* topic)
       return fail;
    }
 
+   wakeup();
+
    theTopic = topic;
    tell(eloMqtt, "Debug: Subscribing to topic '%s' succeeded", topic);
 
@@ -267,6 +464,8 @@ int Mqtt::unsubscribe(const char* topic)
       return fail;
    }
 
+   wakeup();
+
    tell(eloMqtt, "Debug: Unsubscribing from topic '%s' succeeded", topic);
 
    return success;
@@ -274,9 +473,10 @@ int Mqtt::unsubscribe(const char* topic)
 
 //***************************************************************************
 // Read
+//   the next message, or the next one of 'topic' (others stay queued)
 //***************************************************************************
 
-int Mqtt::read(MemoryStruct* message, int timeoutMs)
+int Mqtt::read(MemoryStruct* message, int timeoutMs, const char* topic)
 {
    uint64_t endAt = cTimeMs::Now() + timeoutMs;
    int tmoMs;
@@ -285,25 +485,34 @@ int Mqtt::read(MemoryStruct* message, int timeoutMs)
    message->clear();
    lastReadTopic.clear();
 
-   while (receivedMessages.empty())
+   while (true)
    {
-      if (timeoutMs && cTimeMs::Now() >= endAt)
-         return wrnTimeout;
-
-      if (!timeoutMs)
-         tmoMs = 10000;
-      else
-         tmoMs = std::max((int)(endAt-cTimeMs::Now()), 1);
-
-      readMutex.Lock();
-      readCond.TimedWait(readMutex, tmoMs);
-      readMutex.Unlock();
-   }
-
-   {
-      cMyMutexLock lock(&readMutex);
-      msg = receivedMessages.front();
-      receivedMessages.pop();
+      {
+         cMyMutexLock lock(&readMutex);
+
+         for (auto it = receivedMessages.begin(); it != receivedMessages.end(); ++it)
+         {
+            if (!topic || (*it)->topic == topic)
+            {
+               msg = *it;
+               receivedMessages.erase(it);
+               break;
+            }
+         }
+
+         if (msg)
+            break;
+
+         if (timeoutMs && cTimeMs::Now() >= endAt)
+            return wrnTimeout;
+
+         if (!timeoutMs)
+            tmoMs = 10000;
+         else
+            tmoMs = std::max((int)(endAt-cTimeMs::Now()), 1);
+
+         readCond.TimedWait(readMutex, tmoMs);
+      }
    }
 
    message->append(msg->payload.memory, msg->payload.size);
@@ -356,6 +565,11 @@ int Mqtt::write(const char* topic, const char* message, size_t len, uint8_t flag
 
    theTopic.clear();
 
+   // fixed header (max 5) + topic (2 + n) + packet id (2) + payload
+
+   if (growSendBuffer(5 + 2 + strlen(topic) + 2 + len + sizeof(mqtt_queued_message)) != success)
+      return fail;
+
    lastResult = mqtt_publish(mqttClient, topic, message, len, flags);
 
    if (lastResult != MQTT_OK)
@@ -366,6 +580,8 @@ int Mqtt::write(const char* topic, const char* message, size_t len, uint8_t flag
       return fail;
    }
 
+   wakeup();
+
    theTopic = topic;
    tell(eloMqtt, "-> (%s)[%s]", topic, message);
 
@@ -421,3 +637,214 @@ int Mqtt::openSocket(const char* addr, int port)
 
    return sockfd;
 }
+
+//***************************************************************************
+// Class cMqttTopicRouter
+//***************************************************************************
+
+cMqttTopicRouter::Node::~Node()
+{
+   for (auto& child : children)
+      delete child.second;
+
+   delete plus;
+   delete hash;
+   delete route;
+}
+
+void cMqttTopicRouter::clear()
+{
+   for (auto& child : root.children)
+      delete child.second;
+
+   root.children.clear();
+   delete root.plus;
+   delete root.hash;
+   delete root.route;
+   root.plus = root.hash = nullptr;
+   root.route = nullptr;
+}
+
+//***************************************************************************
+// Add
+//   an existing route of the same filter is replaced
+//***************************************************************************
+
+int cMqttTopicRouter::add(const char* filter, cHandler handler, const char* binding)
+{
+   if (isEmpty(filter) || !handler)
+      return fail;
+
+   Node* node {&root};
+   const char* level {filter};
+
+   while (level)
+   {
+      const char* end = strchr(level, '/');
+      std::string_view name(level, end ? end - level : strlen(level));
+
+      if (name == "#")
+      {
+         if (end)
+         {
+            tell(eloAlways, "Error: Invalid MQTT filter '%s', '#' has to be the last level", filter);
+            return fail;
+         }
+
+         if (!node->hash)
+            node->hash = new Node;
+
+         node = node->hash;
+      }
+      else if (name == "+")
+      {
+         if (!node->plus)
+            node->plus = new Node;
+
+         node = node->plus;
+      }
+      else if (name.find_first_of("+#") != std::string_view::npos)
+      {
+         tell(eloAlways, "Error: Invalid MQTT filter '%s', wildcards have to occupy a whole level", filter);
+         return fail;
+      }
+      else
+      {
+         auto it = node->children.find(name);
+
+         if (it == node->children.end())
+            it = node->children.emplace(std::string(name), new Node).first;
+
+         node = it->second;
+      }
+
+      level = end ? end + 1 : nullptr;
+   }
+
+   delete node->route;
+   node->route = new Route{handler, binding ? binding : ""};
+
+   return success;
+}
+
+//***************************************************************************
+// Remove
+//***************************************************************************
+
+int cMqttTopicRouter::remove(const char* filter)
+{
+   Node* node {&root};
+   const char* level {filter};
+
+   while (node && level)
+   {
+      const char* end = strchr(level, '/');
+      std::string_view name(level, end ? end - level : strlen(level));
+
+      if (name == "#")
+         node = node->hash;
+      else if (name == "+")
+         node = node->plus;
+      else
+      {
+         auto it = node->children.find(name);
+         node = it != node->children.end() ? it->second : nullptr;
+      }
+
+      level = end ? end + 1 : nullptr;
+   }
+
+   if (!node || !node->route)
+      return done;
+
+   delete node->route;
+   node->route = nullptr;
+
+   return success;
+}
+
+//***************************************************************************
+// Add Sender
+//   the first level of the filter is '+', the handler is called only if
+//   the first level of the topic is a '<sender>2mqtt', otherwise the
+//   message is not consumed and dispatch() returns ignore
+//***************************************************************************
+
+int cMqttTopicRouter::addSender(const char* filter, cHandler handler)
+{
+   if (!handler)
+      return fail;
+
+   return add(filter, [handler](const char* topic, const char* message)
+   {
+      return isSenderTopic(topic) ? handler(topic, message) : ignore;
+   });
+}
+
+bool cMqttTopicRouter::isSenderTopic(const char* topic)
+{
+   const char* suffix {"2mqtt"};
+   const char* end = strchr(topic, '/');
+   size_t len = end ? end - topic : strlen(topic);
+
+   return len > strlen(suffix) && strncmp(topic + len - strlen(suffix), suffix, strlen(suffix)) == 0;
+}
+
+//***************************************************************************
+// Match
+//   level points to the remaining topic, nullptr if all levels are consumed
+//   topics starting with '$' are not matched by a leading wildcard
+//***************************************************************************
+
+const cMqttTopicRouter::Route* cMqttTopicRouter::match(const Node* node, const char* level, bool first) const
+{
+   if (!level)
+   {
+      if (node->route)
+         return node->route;
+
+      // 'a/#' matches the parent 'a' as well
+
+      return node->hash ? node->hash->route : nullptr;
+   }
+
+   const char* end = strchr(level, '/');
+   std::string_view name(level, end ? end - level : strlen(level));
+   const char* next = end ? end + 1 : nullptr;
+   const Route* route {nullptr};
+
+   auto it = node->children.find(name);
+
+   if (it != node->children.end() && (route = match(it->second, next, false)))
+      return route;
+
+   if (first && *level == '$')
+      return nullptr;
+
+   if (node->plus && (route = match(node->plus, next, false)))
+      return route;
+
+   return node->hash ? node->hash->route : nullptr;
+}
+
+const cMqttTopicRouter::Route* cMqttTopicRouter::lookup(const char* topic) const
+{
+   if (!topic)
+      return nullptr;
+
+   return match(&root, topic, true);
+}
+
+//***************************************************************************
+// Dispatch
+//***************************************************************************
+
+int cMqttTopicRouter::dispatch(const char* topic, const char* message)
+{
+   const Route* route = lookup(topic);
+
+   if (!route)
+      return ignore;
+
+   return route->handler(topic, message);
+}
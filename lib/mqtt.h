@@ -9,7 +9,10 @@
 #ifndef _MQTT_CLIENT_H
 #define _MQTT_CLIENT_H
 
-#include <queue>
+#include <deque>
+#include <map>
+#include <string_view>
+#include <functional>
 
 #include "common.h"
 #include "thread.h"
@@ -19,6 +22,8 @@ struct mqtt_client;
 
 //***************************************************************************
 // MQTT Client
+//   one connection for publish and subscribe, the refresh thread sleeps in
+//   poll() on the socket and a eventfd which is signaled for outgoing data
 //***************************************************************************
 
 class Mqtt
@@ -31,6 +36,18 @@ class Mqtt
          wrnEmptyMessage
       };
 
+      enum Buffer
+      {
+         initialBufferSize = 16 * 1024,       // grown on demand
+         maxBufferSize = 16 * 1024 * 1024
+      };
+
+      enum Timeout
+      {
+         idleTimeout = 30000,                 // [ms] keep alive check if nothing is pending
+         ackTimeout = 1000                    // [ms] while waiting for a acknowledge
+      };
+
       Mqtt(int aHeartBeat = 400);
       virtual ~Mqtt();
 
@@ -49,7 +66,7 @@ class Mqtt
 
       // read / write
 
-      virtual int read(MemoryStruct* message, int aTimeout = 0);
+      virtual int read(MemoryStruct* message, int aTimeout = 0, const char* topic = nullptr);
       virtual int write(const char* topic, const char* message, int len = 0);
       virtual int writeRetained(const char* topic, const char* message);
 
@@ -80,6 +97,10 @@ class Mqtt
 
       int write(const char* topic, const char* message, size_t len, uint8_t flags);
       int openSocket(const char* addr, int port);
+      void wakeup();
+      int syncTimeout();
+      int growSendBuffer(size_t needed);
+      int growReceiveBuffer();
 
       static void* refreshFct(void* client);
       static void publishCallback(void** user, mqtt_response_publish* published);
@@ -92,8 +113,9 @@ class Mqtt
       int sockfd {-1};
       bool retained {false};                      // retained flag of last read
       pthread_t refreshThread {0};
+      int wakeupFd {-1};                          // eventfd to wakeup the refresh thread
 
-      std::queue<Message*> receivedMessages;
+      std::deque<Message*> receivedMessages;
       cMyMutex readMutex;
       cCondVar readCond;
       uint heartBeat {400};
@@ -103,8 +125,58 @@ class Mqtt
 
       size_t sizeSendBuf {0};
       size_t sizeReceiveBuf {0};
-      uint8_t* sendbuf {nullptr};   // sendbuf should be large enough to hold multiple whole mqtt messages
-      uint8_t* recvbuf {nullptr};   // recvbuf should be large enough any whole mqtt message expected to be received
+      uint8_t* sendbuf {nullptr};   // grown on demand by growSendBuffer()
+      uint8_t* recvbuf {nullptr};   // grown on demand by growReceiveBuffer()
+};
+
+//***************************************************************************
+// MQTT Topic Router
+//   trie over the topic levels, the filters may use the MQTT wildcards
+//   '+' (exactly one level) and '#' (this and all following levels).
+//   On dispatch an exact level is preferred over '+' and '+' over '#',
+//   a route may carry a binding (e.g. the sensor name of a command topic)
+//   A sender route only consumes the '<sender>2mqtt/...' topics of the
+//   services (w1mqtt, ioctrl, ...), the other first levels are ignored
+//***************************************************************************
+
+class cMqttTopicRouter
+{
+   public:
+
+      typedef std::function<int(const char* topic, const char* message)> cHandler;
+
+      struct Route
+      {
+         cHandler handler;
+         std::string binding;
+      };
+
+      ~cMqttTopicRouter()  { clear(); }
+
+      int add(const char* filter, cHandler handler, const char* binding = nullptr);
+      int addSender(const char* filter, cHandler handler);
+      int remove(const char* filter);
+      void clear();
+
+      const Route* lookup(const char* topic) const;
+      int dispatch(const char* topic, const char* message);   // ignore if no route matches
+
+   private:
+
+      struct Node
+      {
+         ~Node();
+
+         std::map<std::string,Node*,std::less<>> children;
+         Node* plus {nullptr};
+         Node* hash {nullptr};
+         Route* route {nullptr};
+      };
+
+      const Route* match(const Node* node, const char* level, bool first) const;
+      static bool isSenderTopic(const char* topic);
+
+      Node root;
 };
 
 //***************************************************************************
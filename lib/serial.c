@@ -18,6 +18,8 @@
 #include <stdio.h>
 #include <time.h>
 
+#include <algorithm>
+
 #include "serial.h"
 
 //***************************************************************************
@@ -37,6 +39,7 @@ Serial::Serial()
 Serial::~Serial()
 {
    close();
+   stopCapture();
 }
 
 //***************************************************************************
@@ -134,6 +137,8 @@ int Serial::close()
 {
    // restore the old settings and close
 
+   flushCapture();
+
    if (fdDevice)
    {
       tell(eloDetail, "Closing io device");
@@ -215,6 +220,12 @@ int Serial::write(void* line, int size)
    if (!line)
       return fail;
 
+   if (capture)
+   {
+      flushCapture();
+      capture->write(SerialCapture::dirTx, line, size);
+   }
+
    // #TODO: is a loop needed if write
    //        was interuppted by system or full buffer ??
 
@@ -246,7 +257,10 @@ int Serial::read(void* buf, size_t count, uint timeoutMs)
    while (nRead < count)
    {
       if (cTimeMs::Now() > start + timeoutMs)
+      {
+         flushCapture();          // a timeout terminates the rx frame
          return wrnTimeout;
+      }
 
       res = ::read(fdDevice, (char*)buf+nRead, count-nRead);
 
@@ -258,6 +272,13 @@ int Serial::read(void* buf, size_t count, uint timeoutMs)
 
       if (!res)
          usleep(2000);
+      else if (capture)
+      {
+         if (captureRx.empty())
+            captureRxTime = SerialCapture::nowUs();
+
+         captureRx.append((char*)buf+nRead, res);
+      }
 
       nRead += res;
    };
@@ -271,3 +292,376 @@ int Serial::read(void* buf, size_t count, uint timeoutMs)
    return nRead;
 }
 
+//***************************************************************************
+// Capture
+//***************************************************************************
+
+int Serial::startCapture(const char* file)
+{
+   stopCapture();
+
+   capture = new SerialCapture;
+
+   if (capture->create(file) != success)
+   {
+      delete capture;
+      capture = nullptr;
+      return fail;
+   }
+
+   tell(eloAlways, "Capturing serial traffic to '%s'", file);
+
+   return success;
+}
+
+int Serial::stopCapture()
+{
+   if (!capture)
+      return done;
+
+   flushCapture();
+   delete capture;
+   capture = nullptr;
+
+   return success;
+}
+
+int Serial::flushCapture()
+{
+   if (!capture || captureRx.empty())
+      return done;
+
+   capture->write(SerialCapture::dirRx, captureRx.c_str(), captureRx.size(), captureRxTime);
+   captureRx.clear();
+
+   return success;
+}
+
+//***************************************************************************
+// Class Serial Capture
+//***************************************************************************
+
+static const char* captureMagic = "P4CAP";
+
+uint64_t SerialCapture::nowUs()
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_REALTIME, &ts);
+
+   return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+int SerialCapture::create(const char* file)
+{
+   close();
+
+   if (!(fp = fopen(file, "a")))
+   {
+      tell(eloAlways, "Error: Can't open capture '%s', error was '%s'", file, strerror(errno));
+      return fail;
+   }
+
+   fseek(fp, 0, SEEK_END);
+
+   if (!ftell(fp))
+   {
+      fwrite(captureMagic, 1, strlen(captureMagic), fp);
+      fputc(version, fp);
+   }
+
+   lastTime = 0;
+
+   return write(dirSession, nullptr, 0);
+}
+
+int SerialCapture::open(const char* file)
+{
+   char magic[10] {};
+
+   close();
+
+   if (!(fp = fopen(file, "r")))
+   {
+      tell(eloAlways, "Error: Can't open capture '%s', error was '%s'", file, strerror(errno));
+      return fail;
+   }
+
+   if (fread(magic, 1, strlen(captureMagic), fp) != strlen(captureMagic) ||
+       strcmp(magic, captureMagic) != 0 || fgetc(fp) != version)
+   {
+      tell(eloAlways, "Error: '%s' isn't a capture of version %d", file, version);
+      close();
+      return fail;
+   }
+
+   lastTime = 0;
+
+   return success;
+}
+
+int SerialCapture::close()
+{
+   if (fp)
+      fclose(fp);
+
+   fp = nullptr;
+
+   return done;
+}
+
+//***************************************************************************
+// Write
+//***************************************************************************
+
+int SerialCapture::write(char direction, const void* data, size_t size, uint64_t time)
+{
+   if (!fp)
+      return fail;
+
+   if (!time)
+      time = nowUs();
+
+   if (direction == dirSession)
+      lastTime = 0;
+
+   fputc(direction, fp);
+   writeVarint(time >= lastTime ? time - lastTime : 0);
+   writeVarint(size);
+
+   if (size)
+      fwrite(data, 1, size, fp);
+
+   lastTime = std::max(time, lastTime);
+
+   return fflush(fp) == 0 ? success : fail;
+}
+
+//***************************************************************************
+// Read
+//***************************************************************************
+
+int SerialCapture::read(Frame& frame)
+{
+   uint64_t delta {0};
+   uint64_t size {0};
+   int c;
+
+   if (!fp)
+      return no;
+
+   while ((c = fgetc(fp)) != EOF)
+   {
+      if (readVarint(delta) != success || readVarint(size) != success)
+         break;
+
+      if (c == dirSession)
+      {
+         lastTime = delta;
+         continue;
+      }
+
+      frame.direction = c;
+      frame.time = (lastTime += delta);
+      frame.data.resize(size);
+
+      if (size && fread(&frame.data[0], 1, size, fp) != size)
+         break;
+
+      return yes;
+   }
+
+   if (c != EOF)
+      tell(eloAlways, "Warning: Capture truncated, ignoring the last record");
+
+   return no;
+}
+
+int SerialCapture::writeVarint(uint64_t value)
+{
+   do
+   {
+      byte b = value & 0x7f;
+      value >>= 7;
+      fputc(value ? b | 0x80 : b, fp);
+   } while (value);
+
+   return success;
+}
+
+int SerialCapture::readVarint(uint64_t& value)
+{
+   value = 0;
+
+   for (int shift = 0; shift < 64; shift += 7)
+   {
+      int c = fgetc(fp);
+
+      if (c == EOF)
+         return fail;
+
+      value |= (uint64_t)(c & 0x7f) << shift;
+
+      if (!(c & 0x80))
+         return success;
+   }
+
+   return fail;
+}
+
+//***************************************************************************
+// Class Serial Replay
+//***************************************************************************
+
+int SerialReplay::open(const char* file)
+{
+   if (!file)
+      file = deviceName;
+   else
+      snprintf(deviceName, sizeof(deviceName), "%s", file);
+
+   close();
+
+   if (replay.open(file) != success)
+      return fail;
+
+   opened = yes;
+   requests = mismatches = 0;
+   unread = 0;
+   captureStart = 0;
+
+   return success;
+}
+
+int SerialReplay::close()
+{
+   replay.close();
+   haveNext = false;
+   rx.clear();
+   rxPos = 0;
+   opened = no;
+
+   return success;
+}
+
+//***************************************************************************
+// Fetch - peek the next record, no at the end of the capture
+//***************************************************************************
+
+int SerialReplay::fetch()
+{
+   if (haveNext)
+      return yes;
+
+   if (!replay.read(next))
+      return no;
+
+   if (!captureStart)
+   {
+      captureStart = next.time;
+      wallStart = SerialCapture::nowUs();
+   }
+
+   haveNext = true;
+
+   return yes;
+}
+
+//***************************************************************************
+// Wait For - in realtime mode keep the recorded distance to the first record
+//***************************************************************************
+
+void SerialReplay::waitFor(uint64_t time)
+{
+   if (!realtime || time < captureStart)
+      return;
+
+   uint64_t due = wallStart + (time - captureStart);
+   uint64_t now = SerialCapture::nowUs();
+
+   if (due > now)
+      usleep(due - now);
+}
+
+//***************************************************************************
+// Next Request - the next recorded tx frame (without consuming it)
+//***************************************************************************
+
+const SerialCapture::Frame* SerialReplay::nextRequest()
+{
+   while (fetch())
+   {
+      if (next.direction == SerialCapture::dirTx)
+         return &next;
+
+      unread += next.data.size();     // rx without request (e.g. line noise)
+      haveNext = false;
+   }
+
+   return nullptr;
+}
+
+//***************************************************************************
+// Write - take the next request and provide its reply
+//***************************************************************************
+
+int SerialReplay::write(void* line, int size)
+{
+   if (!opened || !line)
+      return fail;
+
+   unread += rx.size() - rxPos;
+   rx.clear();
+   rxPos = 0;
+
+   if (!nextRequest())
+   {
+      tell(eloDebug, "Replay: End of capture reached");
+      return fail;
+   }
+
+   waitFor(next.time);
+
+   if (next.data.size() != (size_t)size || memcmp(next.data.c_str(), line, size) != 0)
+   {
+      mismatches++;
+      tell(eloDebug, "Replay: Request differs from the captured one");
+   }
+
+   requests++;
+   haveNext = false;
+
+   while (fetch() && next.direction == SerialCapture::dirRx)
+   {
+      waitFor(next.time);
+      rx += next.data;
+      haveNext = false;
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Look / Read
+//***************************************************************************
+
+int SerialReplay::look(byte& b, int timeoutMs)
+{
+   if (rxPos >= rx.size())
+      return wrnTimeout;
+
+   b = rx[rxPos++];
+
+   return success;
+}
+
+int SerialReplay::read(void* buf, size_t count, uint timeoutMs)
+{
+   if (rxPos + count > rx.size())
+      return wrnTimeout;
+
+   memcpy(buf, rx.c_str() + rxPos, count);
+   rxPos += count;
+
+   return count;
+}
@@ -13,9 +13,65 @@
 //***************************************************************************
 
 #include <termios.h>
+#include <stdio.h>
+
+#include <string>
 
 #include "common.h"
 
+//***************************************************************************
+// Serial Capture
+//   binary record of the line traffic, the file starts with "P4CAP" and a
+//   version byte followed by the records:
+//     direction (1 byte 'S', 'T' or 'R') | delta [us] (varint) | size (varint) | data
+//   a 'S' (session) record carries the absolute time and starts a new time
+//   base, therefore new sessions can be appended to an existing file
+//***************************************************************************
+
+class SerialCapture
+{
+   public:
+
+      enum Direction
+      {
+         dirSession = 'S',
+         dirTx      = 'T',
+         dirRx      = 'R'
+      };
+
+      enum Misc
+      {
+         version = 1
+      };
+
+      struct Frame
+      {
+         char direction {0};
+         uint64_t time {0};              // [us] since epoch
+         std::string data;
+      };
+
+      ~SerialCapture()  { close(); }
+
+      int create(const char* file);     // open for writing (append)
+      int open(const char* file);       // open for reading
+      int close();
+      int isOpen()                      { return fp != nullptr; }
+
+      int write(char direction, const void* data, size_t size, uint64_t time = 0);
+      int read(Frame& frame);           // yes if a frame was read, no at the end
+
+      static uint64_t nowUs();
+
+   private:
+
+      int writeVarint(uint64_t value);
+      int readVarint(uint64_t& value);
+
+      FILE* fp {nullptr};
+      uint64_t lastTime {0};
+};
+
 //***************************************************************************
 // IO Interface
 //***************************************************************************
@@ -55,8 +111,20 @@ class Serial
       virtual int setTimeout(int timeout);
       virtual int setWriteTimeout(int timeout);
 
+      // capture
+
+      int startCapture(const char* file);
+      int stopCapture();
+      int isCapturing()                 { return capture != nullptr; }
+
    protected:
 
+      int flushCapture();
+
+      SerialCapture* capture {nullptr};
+      std::string captureRx;            // bytes of the current (incomplete) rx frame
+      uint64_t captureRxTime {0};
+
       // data
 
       int opened;
@@ -67,3 +135,52 @@ class Serial
       int fdDevice;
       struct termios oldtio;
 };
+
+//***************************************************************************
+// Serial Replay
+//   plays a capture back instead of the line, each write() is answered by
+//   the rx frames recorded behind the matching tx frame
+//***************************************************************************
+
+class SerialReplay : public Serial
+{
+   public:
+
+      SerialReplay(bool aRealtime = false)  { realtime = aRealtime; }
+      virtual ~SerialReplay()               { close(); }
+
+      int open(const char* file = 0) override;
+      int close() override;
+      int isOpen() override                 { return opened; }
+      int flush() override                  { return done; }
+
+      int look(byte& b, int timeoutMs = 0) override;
+      int read(void* buf, size_t count, uint timeoutMs = 0) override;
+      int write(void* line, int size = 0) override;
+
+      const SerialCapture::Frame* nextRequest();
+
+      int getRequests()                     { return requests; }
+      int getMismatches()                   { return mismatches; }
+      size_t getUnread()                    { return unread; }
+
+   private:
+
+      int fetch();
+      void waitFor(uint64_t time);
+
+      SerialCapture replay;
+      SerialCapture::Frame next;
+      bool haveNext {false};
+
+      std::string rx;
+      size_t rxPos {0};
+
+      bool realtime {false};
+      uint64_t captureStart {0};
+      uint64_t wallStart {0};
+
+      int requests {0};
+      int mismatches {0};
+      size_t unread {0};
+};
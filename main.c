@@ -195,6 +195,7 @@ int main(int argc, char** argv)
 
    // int AFTER fork !!!
 
+   startLogThread();
    job = new CLASS();
 
    if (job->init() != success)
@@ -223,6 +224,7 @@ int main(int argc, char** argv)
    tell(eloAlways, "shutdown");
 
    delete job;
+   stopLogThread();
 
    return 0;
 }
@@ -0,0 +1,69 @@
+//
+// g++ -DTARGET='"p4d"' -Ilib mqttroutertest.c lib/mqtt.c lib/mqtt_c.c lib/mqtt_pal.c lib/common.c -lpthread -lcrypto -luuid -lz -o mqttroutertest
+//
+// checks the inbound routes of the daemon, the '<sender>2mqtt/...' topics
+//   are consumed by their route, all others are left to the sensor path
+//   (dispatchOther) like in Daemon::performMqttRequests()
+//
+
+#include "lib/common.h"
+#include "mqtt.h"
+
+static std::string handled;
+
+static int check(cMqttTopicRouter& router, const char* topic, const char* expected)
+{
+   handled = "";
+
+   if (router.dispatch(topic, "{}") == ignore)
+      handled = "other";
+
+   if (handled != expected)
+   {
+      printf("FAILED: '%s' dispatched to '%s' instead of '%s'\n", topic, handled.c_str(), expected);
+      return fail;
+   }
+
+   return success;
+}
+
+int main(int argc, const char** argv)
+{
+   cMqttTopicRouter router;
+   int failed {0};
+
+   logstdout = yes;
+
+   auto handler = [](const char* name)
+   {
+      return [name](const char* topic, const char* message) { handled = name; return success; };
+   };
+
+   router.addSender("+/ping", handler("ping"));
+   router.addSender("+/w1/#", handler("w1"));
+   router.addSender("+/arduino/out", handler("arduino"));
+   router.addSender("+/light/#", handler("light"));
+   router.addSender("+/command/#", handler("nodered"));
+   router.add(TARGET "2mqtt/light/kessel/set", handler("kessel"), "kessel");
+
+   failed += check(router, "w1mqtt2mqtt/w1", "w1") != success;
+   failed += check(router, "w1mqtt2mqtt/w1/28-0000", "w1") != success;
+   failed += check(router, "ioctrl2mqtt/arduino/out", "arduino") != success;
+   failed += check(router, TARGET "2mqtt/ping", "ping") != success;
+   failed += check(router, TARGET "2mqtt/light/kessel/set", "kessel") != success;
+   failed += check(router, TARGET "2mqtt/light/other/set", "light") != success;
+
+   // user topics with the same levels reach the sensor path
+
+   failed += check(router, "garden/w1/temp", "other") != success;
+   failed += check(router, "tasmota/ping", "other") != success;
+   failed += check(router, "zigbee/light/kitchen", "other") != success;
+   failed += check(router, "home/command/heater", "other") != success;
+   failed += check(router, "2mqtt/w1", "other") != success;
+   failed += check(router, "shellies/temperature", "other") != success;
+
+   if (!failed)
+      printf("OK: all topics dispatched as expected\n");
+
+   return failed ? 1 : 0;
+}
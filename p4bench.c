@@ -0,0 +1,791 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File p4bench.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 04.11.2010 - 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+//***************************************************************************
+// Benchmark
+//   runs the hot paths of the daemon (protocol, database, web socket and
+//   log) with synthetic data and writes throughput and latency percentiles
+//   as JSON, comparing the files of two commits shows regressions
+//***************************************************************************
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <math.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+
+#include "HISTORY.h"
+#include "lib/json.h"
+#include "specific.h"
+
+char* confDir = (char*)confDirDefault;
+
+// the database is a scratch one, all data of the used tables will be deleted!
+
+char dbHost[100+TB] = "localhost";
+int  dbPort;
+#ifdef USESQLITE
+char dbName[100+TB] = "/tmp/p4bench.sqlite";
+#else
+char dbName[100+TB] = "p4bench";
+#endif
+char dbUser[100+TB] = TARGET;
+char dbPass[100+TB] = TARGET;
+
+//***************************************************************************
+// Helper
+//***************************************************************************
+
+static double nsNow()
+{
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec * 1000000000.0 + ts.tv_nsec;
+}
+
+//***************************************************************************
+// Bench Serial
+//   loopback instead of the line, each request is answered by a synthetic
+//   'get value' reply (masked like the S-3200 does)
+//***************************************************************************
+
+class BenchSerial : public Serial
+{
+   public:
+
+      BenchSerial()                           { opened = yes; }
+
+      int open(const char* dev = 0) override  { opened = yes; return success; }
+      int close() override                    { opened = no; return success; }
+      int isOpen() override                   { return opened; }
+      int flush() override                    { return done; }
+
+      int look(byte& b, int timeoutMs = 0) override;
+      int read(void* buf, size_t count, uint timeoutMs = 0) override;
+      int write(void* line, int size = 0) override;
+
+      bool answer {false};
+
+   private:
+
+      std::string rx;
+      size_t rxPos {0};
+      word value {0};
+};
+
+int BenchSerial::write(void* line, int size)
+{
+   byte tmp[FroelingService::sizeMaxReply+TB];
+   int sizeNetto {0};
+
+   rx.clear();
+   rxPos = 0;
+
+   if (!answer)
+      return success;
+
+   // the value walks through all words to hit the masked bytes as well
+
+   value += 0x0107;
+
+   tmp[sizeNetto++] = FroelingService::commId >> 8;
+   tmp[sizeNetto++] = FroelingService::commId & 0xff;
+   tmp[sizeNetto++] = 0x00;
+   tmp[sizeNetto++] = 2 + FroelingService::sizeCrc;
+   tmp[sizeNetto++] = FroelingService::cmdGetValue;
+   tmp[sizeNetto++] = value >> 8;
+   tmp[sizeNetto++] = value & 0xff;
+   tmp[sizeNetto] = crc(tmp, sizeNetto);
+   sizeNetto++;
+
+   rx.append((char*)tmp, FroelingService::sizeId);
+
+   for (int i = FroelingService::posSize; i < sizeNetto; i++)
+   {
+      switch (tmp[i])
+      {
+         case 0x02:
+         case 0x2b:
+         case 0xfe: rx += (char)tmp[i]; rx += (char)0x00; break;
+         case 0x11: rx += (char)0xfe; rx += (char)0x12; break;
+         case 0x13: rx += (char)0xfe; rx += (char)0x14; break;
+         default:   rx += (char)tmp[i];                  break;
+      }
+   }
+
+   return success;
+}
+
+int BenchSerial::look(byte& b, int timeoutMs)
+{
+   if (rxPos >= rx.size())
+      return wrnTimeout;
+
+   b = rx[rxPos++];
+
+   return success;
+}
+
+int BenchSerial::read(void* buf, size_t count, uint timeoutMs)
+{
+   if (rxPos + count > rx.size())
+      return wrnTimeout;
+
+   memcpy(buf, rx.c_str() + rxPos, count);
+   rxPos += count;
+
+   return count;
+}
+
+//***************************************************************************
+// Class P4Bench
+//***************************************************************************
+
+class P4Bench : public P4d
+{
+   public:
+
+      int initBench();
+      int exitBench();
+      int run(const char* aFilter);
+      int report(FILE* fp);
+
+      int iterations {1000};
+      int sensorCount {100};
+      int rowCount {10000};
+      int clientCount {20};
+
+   private:
+
+      typedef std::function<int(int i)> cOperation;
+
+      struct Result
+      {
+         std::string name;
+         int items {1};                  // items processed by each operation (rows, sensors, clients)
+         int errors {0};
+         double seconds {0};
+         std::vector<double> us;         // duration of each operation
+      };
+
+      int measure(const char* name, int count, int items, cOperation operation);
+      bool selected(const char* name);
+
+      int benchFrames();
+      int benchTell();
+      int benchStore();
+      int benchPerformData();
+      int benchFanOut();
+      int benchChartData();
+
+      int createSensors();
+      int createChartRows(int sensors);
+
+      const char* filter {nullptr};
+      std::vector<Result> results;
+      time_t startedAt {0};
+};
+
+//***************************************************************************
+// Init / Exit
+//***************************************************************************
+
+int P4Bench::initBench()
+{
+   char* dictPath {nullptr};
+
+   startedAt = time(0);
+
+   asprintf(&dictPath, "%s/database.dat", confDir);
+
+   if (dbDict.in(dictPath) != success)
+   {
+      tell(eloAlways, "Fatal: Dictionary '%s' not loaded, aborting!", dictPath);
+      free(dictPath);
+      return fail;
+   }
+
+   free(dictPath);
+
+#ifdef USESQLITE
+   unlink(dbName);       // start with a fresh database
+#endif
+
+   if (initDb() != success)
+   {
+      tell(eloAlways, "Fatal: Can't open database '%s'", dbName);
+      return fail;
+   }
+
+   // clear the leftovers of the last run
+
+   tableSamples->deleteWhere("1 = 1");
+   tablePeaks->deleteWhere("1 = 1");
+   tableValueFacts->deleteWhere("1 = 1");
+
+   return createSensors();
+}
+
+int P4Bench::exitBench()
+{
+   exitDb();
+
+#ifdef USESQLITE
+   unlink(dbName);
+#endif
+
+   return done;
+}
+
+//***************************************************************************
+// Create Sensors
+//   'VA' sensors with their value facts, like the daemon knows them
+//   after the first value list update
+//***************************************************************************
+
+int P4Bench::createSensors()
+{
+   connection->startTransaction();
+
+   for (int addr = 1; addr <= sensorCount; addr++)
+   {
+      char* name {nullptr};
+      asprintf(&name, "Bench Sensor %d", addr);
+
+      tableValueFacts->clear();
+      tableValueFacts->setValue("ADDRESS", addr);
+      tableValueFacts->setValue("TYPE", "VA");
+      tableValueFacts->setValue("STATE", "A");
+      tableValueFacts->setValue("RECORD", "A");
+      tableValueFacts->setValue("UNIT", "°C");
+      tableValueFacts->setValue("FACTOR", 10);
+      tableValueFacts->setValue("NAME", name);
+      tableValueFacts->setValue("TITLE", name);
+      tableValueFacts->store();
+      free(name);
+
+      initSensorByFact("VA", addr);
+
+      SensorData* sensor = &sensors["VA"][addr];
+
+      sensor->value = 20.0 + addr % 50 / 10.0;
+      sensor->last = time(0);
+      sensor->valid = true;
+   }
+
+   connection->commit();
+
+   return success;
+}
+
+//***************************************************************************
+// Run
+//***************************************************************************
+
+int P4Bench::run(const char* aFilter)
+{
+   filter = aFilter;
+
+   benchFrames();
+   benchTell();
+   benchStore();
+   benchPerformData();
+   benchFanOut();
+   benchChartData();
+
+   return success;
+}
+
+bool P4Bench::selected(const char* name)
+{
+   return isEmpty(filter) || strncmp(name, filter, strlen(filter)) == 0;
+}
+
+//***************************************************************************
+// Measure
+//***************************************************************************
+
+int P4Bench::measure(const char* name, int count, int items, cOperation operation)
+{
+   Result result;
+
+   result.name = name;
+   result.items = items;
+   result.us.reserve(count);
+
+   tell(eloInfo, "Running '%s' (%d operations) ..", name, count);
+
+   double start = nsNow();
+
+   for (int i = 0; i < count; i++)
+   {
+      double begin = nsNow();
+
+      if (operation(i) == fail)
+         result.errors++;
+
+      result.us.push_back((nsNow() - begin) / 1000.0);
+   }
+
+   result.seconds = (nsNow() - start) / 1000000000.0;
+   results.push_back(std::move(result));
+
+   return success;
+}
+
+//***************************************************************************
+// P4Request - frame encode and decode
+//***************************************************************************
+
+int P4Bench::benchFrames()
+{
+   BenchSerial line;
+   P4Request request(&line);
+   int count = iterations * 10;
+
+   if (selected("frame.encode"))
+   {
+      measure("frame.encode", count, 1, [&](int i)
+      {
+         request.clear();
+         request.addAddress(i & 0xffff);
+         return request.request(cmdGetValue);
+      });
+   }
+
+   if (selected("frame.getValue"))
+   {
+      line.answer = true;
+
+      measure("frame.getValue", count, 1, [&](int i)
+      {
+         Value v(i % 0x100);
+         return request.getValue(&v);
+      });
+   }
+
+   return done;
+}
+
+//***************************************************************************
+// tell() - filtered, written synchronous and queued to the log thread
+//   the written messages go to /dev/null instead of the syslog
+//***************************************************************************
+
+int P4Bench::benchTell()
+{
+   int count = iterations * 10;
+
+   if (selected("tell.filtered"))
+   {
+      Eloquence elo = eloquence;
+      eloquence = eloAlways;
+
+      measure("tell.filtered", count, 1, [](int i)
+      {
+         tell(eloDebug, "Debug: Bench message %d of sensor '%s' with value %.2f", i, "VA:0x01", 21.5);
+         return success;
+      });
+
+      eloquence = elo;
+   }
+
+   if (!selected("tell.sync") && !selected("tell.queued"))
+      return done;
+
+   bool toStdout = logstdout;
+   int fdNull = ::open("/dev/null", O_WRONLY);
+   int fdStdout = dup(STDOUT_FILENO);
+
+   fflush(stdout);
+   dup2(fdNull, STDOUT_FILENO);
+   logstdout = true;
+
+   if (selected("tell.sync"))
+   {
+      measure("tell.sync", count, 1, [](int i)
+      {
+         tell(eloAlways, "Bench message %d of sensor '%s' with value %.2f", i, "VA:0x01", 21.5);
+         return success;
+      });
+   }
+
+   if (selected("tell.queued"))
+   {
+      startLogThread();
+
+      measure("tell.queued", count, 1, [](int i)
+      {
+         tell(eloAlways, "Bench message %d of sensor '%s' with value %.2f", i, "VA:0x01", 21.5);
+         return success;
+      });
+
+      stopLogThread();
+   }
+
+   fflush(stdout);
+   dup2(fdStdout, STDOUT_FILENO);
+   ::close(fdStdout);
+   ::close(fdNull);
+   logstdout = toStdout;
+
+   return done;
+}
+
+//***************************************************************************
+// cDbTable::store() - row by row vs. one transaction per sample cycle
+//   (like storeSamples() does), the rows are stored a year in the past to
+//   not mix them up with the chart data
+//***************************************************************************
+
+int P4Bench::benchStore()
+{
+   time_t base = startedAt - 365 * tmeSecondsPerDay;
+
+   if (selected("db.store"))
+   {
+      measure("db.store", iterations, 1, [&](int i)
+      {
+         const SensorData* sensor = &sensors["VA"][i % sensorCount + 1];
+         return store(base + (i / sensorCount) * 60, sensor);
+      });
+   }
+
+   if (selected("db.storeBatched"))
+   {
+      base += (iterations / sensorCount + 1) * 60;
+
+      measure("db.storeBatched", std::max(iterations / sensorCount, 1), sensorCount, [&](int i)
+      {
+         int status {success};
+
+         connection->startTransaction();
+
+         for (const auto& sensorIt : sensors["VA"])
+            status += store(base + i * 60, &sensorIt.second);
+
+         connection->commit();
+
+         return status == success ? success : fail;
+      });
+   }
+
+   return done;
+}
+
+//***************************************************************************
+// Daemon::performData() - JSON of all sensors (without web clients)
+//***************************************************************************
+
+int P4Bench::benchPerformData()
+{
+   if (!selected("daemon.performData"))
+      return done;
+
+   return measure("daemon.performData", std::max(iterations / 10, 1), sensorCount, [&](int i)
+   {
+      return performData(0, "update");
+   });
+}
+
+//***************************************************************************
+// json_dumps() + cWebSock::pushOutMessage() to all clients
+//   the fake clients are never served, the snapshot event 'init' replaces
+//   the queued one therefore the queues don't grow
+//***************************************************************************
+
+int P4Bench::benchFanOut()
+{
+   if (!selected("ws.fanOut"))
+      return done;
+
+   if (jsonSensorList.empty())
+      performData(0, "update");
+
+   for (int c = 1; c <= clientCount; c++)
+      webSock->setClientType((lws*)(long)c, cWebSock::ctActive);
+
+   json_t* oSensors = json_object();
+
+   for (auto& sj : jsonSensorList)
+      json_object_set(oSensors, sj.first.c_str(), sj.second);
+
+   json_t* oMessage = json_object();
+   addToJson(oMessage, "event", "init");
+   json_object_set_new(oMessage, "object", oSensors);
+
+   measure("ws.fanOut", iterations, clientCount, [&](int i)
+   {
+      char* p = json_dumps(oMessage, JSON_REAL_PRECISION(4));
+
+      if (!p)
+         return fail;
+
+      webSock->pushOutMessage(p, nullptr, "init");
+      free(p);
+
+      return success;
+   });
+
+   json_decref(oMessage);
+
+   return done;
+}
+
+//***************************************************************************
+// chartData2Json() - the select of performChartData() over rowCount rows
+//   for each of the chart sensors, executed by a db worker like the daemon
+//   does, the writer is reused for all runs
+//***************************************************************************
+
+int P4Bench::createChartRows(int chartSensors)
+{
+   time_t last = startedAt - startedAt % 60;
+
+   connection->startTransaction();
+
+   for (int addr = 1; addr <= chartSensors; addr++)
+   {
+      for (int r = 0; r < rowCount; r++)
+      {
+         tableSamples->clear();
+         tableSamples->setValue("TIME", last - r * 60);
+         tableSamples->setValue("ADDRESS", addr);
+         tableSamples->setValue("TYPE", "VA");
+         tableSamples->setValue("AGGREGATE", "S");
+         tableSamples->setValue("SAMPLES", 1);
+         tableSamples->setValue("VALUE", 20.0 + (r % 600) / 10.0);
+         tableSamples->insert();
+      }
+   }
+
+   connection->commit();
+
+   return success;
+}
+
+int P4Bench::benchChartData()
+{
+   if (!selected("chart.data"))
+      return done;
+
+   const int chartSensors = std::min(4, sensorCount);
+   std::vector<std::string> sList;
+
+   createChartRows(chartSensors);
+
+   for (int addr = 1; addr <= chartSensors; addr++)
+   {
+      char* id {nullptr};
+      asprintf(&id, "VA:0x%02x", addr);
+      sList.push_back(id);
+      free(id);
+   }
+
+   double range = ceil(rowCount * 60.0 / tmeSecondsPerDay);
+   time_t rangeStart = startedAt - range * tmeSecondsPerDay;
+
+   cDbWorker worker(0);
+   cJsonWriter json(cWebSock::sizeLwsPreFrame);
+   worker.Start(yes);
+
+   worker.post([&](cDbWorker* w)
+   {
+      return measure("chart.data", std::max(iterations / 100, 5), chartSensors * rowCount, [&](int i)
+      {
+         json.clear();
+         beginMessage(&json, "chartdata");
+
+         if (chartData2Json(w, &json, sList, rangeStart, range, false, 5, "chart") != success)
+            return fail;
+
+         return json.endObject().isComplete() ? success : fail;
+      });
+   });
+
+   while (worker.getPending())
+      usleep(10000);
+
+   worker.stop();
+
+   return done;
+}
+
+//***************************************************************************
+// Report
+//***************************************************************************
+
+int P4Bench::report(FILE* fp)
+{
+   char started[50+TB];
+   struct tm tm;
+
+   localtime_r(&startedAt, &tm);
+   strftime(started, sizeof(started), "%Y-%m-%dT%H:%M:%S", &tm);
+
+   json_t* oJson = json_object();
+
+   json_object_set_new(oJson, "version", json_string(VERSION));
+   json_object_set_new(oJson, "started", json_string(started));
+#ifdef USESQLITE
+   json_object_set_new(oJson, "database", json_string("sqlite"));
+#else
+   json_object_set_new(oJson, "database", json_string("mariadb"));
+#endif
+
+   json_t* oParameters = json_object();
+   json_object_set_new(oJson, "parameters", oParameters);
+   json_object_set_new(oParameters, "iterations", json_integer(iterations));
+   json_object_set_new(oParameters, "sensors", json_integer(sensorCount));
+   json_object_set_new(oParameters, "rows", json_integer(rowCount));
+   json_object_set_new(oParameters, "clients", json_integer(clientCount));
+
+   json_t* oResults = json_array();
+   json_object_set_new(oJson, "results", oResults);
+
+   for (auto& r : results)
+   {
+      if (r.us.empty())
+         continue;
+
+      std::sort(r.us.begin(), r.us.end());
+
+      size_t count = r.us.size();
+      double sum {0};
+
+      for (auto us : r.us)
+         sum += us;
+
+      auto percentile = [&](double p) { return r.us[std::min(count - 1, (size_t)(p * count))]; };
+
+      json_t* oResult = json_object();
+      json_array_append_new(oResults, oResult);
+
+      json_object_set_new(oResult, "name", json_string(r.name.c_str()));
+      json_object_set_new(oResult, "operations", json_integer(count));
+      json_object_set_new(oResult, "items", json_integer(r.items));
+      json_object_set_new(oResult, "errors", json_integer(r.errors));
+      json_object_set_new(oResult, "seconds", json_real(r.seconds));
+      json_object_set_new(oResult, "opsPerSec", json_real(r.seconds > 0 ? count / r.seconds : 0));
+      json_object_set_new(oResult, "itemsPerSec", json_real(r.seconds > 0 ? count * r.items / r.seconds : 0));
+
+      json_t* oLatency = json_object();
+      json_object_set_new(oResult, "latencyUs", oLatency);
+      json_object_set_new(oLatency, "min", json_real(r.us.front()));
+      json_object_set_new(oLatency, "mean", json_real(sum / count));
+      json_object_set_new(oLatency, "p50", json_real(percentile(0.50)));
+      json_object_set_new(oLatency, "p90", json_real(percentile(0.90)));
+      json_object_set_new(oLatency, "p99", json_real(percentile(0.99)));
+      json_object_set_new(oLatency, "max", json_real(r.us.back()));
+   }
+
+   json_dumpf(oJson, fp, JSON_INDENT(2) | JSON_REAL_PRECISION(6));
+   fprintf(fp, "\n");
+   json_decref(oJson);
+
+   return success;
+}
+
+//***************************************************************************
+// Usage
+//***************************************************************************
+
+void showUsage(const char* bin)
+{
+   printf("Usage: %s [-c <config-dir>] [-d <database>] [-n <count>] [-s <count>] [-r <count>] [-w <count>] [-b <name>] [-o <file>] [-t] [-l <log-level>]\n", bin);
+   printf("\n");
+   printf("  options:\n");
+   printf("     -c <config-dir>  directory of the dictionary database.dat (default %s)\n", confDirDefault);
+   printf("     -d <database>    scratch database (SQLite: file), ALL DATA OF THE USED TABLES WILL BE DELETED (default %s)\n", dbName);
+   printf("     -n <count>       iterations (default 1000)\n");
+   printf("     -s <count>       number of sensors (default 100)\n");
+   printf("     -r <count>       chart rows per sensor (default 10000)\n");
+   printf("     -w <count>       number of web socket clients (default 20)\n");
+   printf("     -b <name>        only run the benchmarks starting with <name> (e.g. 'db.')\n");
+   printf("     -o <file>        write the result to <file> instead of stdout\n");
+   printf("     -t               log to stdout\n");
+   printf("     -l <log-level>   set log level\n");
+}
+
+//***************************************************************************
+// Main
+//***************************************************************************
+
+int main(int argc, char** argv)
+{
+   const char* filter {nullptr};
+   const char* output {nullptr};
+   int iterations {1000};
+   int sensorCount {100};
+   int rowCount {10000};
+   int clientCount {20};
+   FILE* fp {stdout};
+
+   eloquence = eloAlways;
+   logstdout = false;
+
+   for (int i = 1; argv[i]; i++)
+   {
+      if (argv[i][0] != '-' || strlen(argv[i]) != 2)
+      {
+         showUsage(argv[0]);
+         return 1;
+      }
+
+      switch (argv[i][1])
+      {
+         case 'c': if (argv[i+1]) confDir = argv[++i];                                 break;
+         case 'd': if (argv[i+1]) sstrcpy(dbName, argv[++i], sizeof(dbName));          break;
+         case 'n': if (argv[i+1]) iterations = std::max(atoi(argv[++i]), 1);           break;
+         case 's': if (argv[i+1]) sensorCount = std::max(atoi(argv[++i]), 1);          break;
+         case 'r': if (argv[i+1]) rowCount = std::max(atoi(argv[++i]), 1);             break;
+         case 'w': if (argv[i+1]) clientCount = std::max(atoi(argv[++i]), 1);          break;
+         case 'b': if (argv[i+1]) filter = argv[++i];                                  break;
+         case 'o': if (argv[i+1]) output = argv[++i];                                  break;
+         case 't': logstdout = true;                                                   break;
+         case 'l': if (argv[i+1]) eloquence = (Eloquence)strtol(argv[++i], nullptr, 0); break;
+         default: showUsage(argv[0]); return 0;
+      }
+   }
+
+   if (output && !(fp = fopen(output, "w")))
+   {
+      tell(eloAlways, "Error: Can't open '%s', %s", output, strerror(errno));
+      return 1;
+   }
+
+   // construct after parsing, the daemon takes the database settings in its constructor
+
+   P4Bench* bench = new P4Bench;
+
+   bench->iterations = iterations;
+   bench->sensorCount = sensorCount;
+   bench->rowCount = rowCount;
+   bench->clientCount = clientCount;
+
+   int status = bench->initBench();
+
+   if (status == success)
+   {
+      bench->run(filter);
+      bench->report(fp);
+   }
+
+   bench->exitBench();
+   delete bench;
+
+   if (fp != stdout)
+      fclose(fp);
+
+   return status == success ? 0 : 1;
+}
@@ -57,12 +57,13 @@ enum UserCommand
    ucGetAo,
    ucUser,
 //   ucShowW1,
-   ucUnkonownList
+   ucUnkonownList,
+   ucReplay
 };
 
 void showUsage(const char* bin)
 {
-   printf("Usage: %s <command> [-a <address> [-v <value>]] [-o <offset>] [-l <log-level>] [-d <device>]\n", bin);
+   printf("Usage: %s <command> [-a <address> [-v <value>]] [-o <offset>] [-l <log-level>] [-d <device>] [-c <capture>]\n", bin);
    printf("\n");
    printf("  options:\n");
    printf("     -a <address>    address of parameter or value\n");
@@ -70,6 +71,9 @@ void showUsage(const char* bin)
    printf("     -l <log-level>  set log level\n");
    printf("     -d <device>     serial device file (defaults to /dev/ttyUSB0)\n");
    printf("     -o <offset>     optional offset for time sync in seconds\n");
+   printf("     -c <capture>    record the serial traffic to the capture file\n");
+   printf("     -f <capture>    capture file to replay\n");
+   printf("     -r              replay in real time (default: full speed)\n");
 
    printf("\n");
    printf("  commands:\n");
@@ -84,9 +88,210 @@ void showUsage(const char* bin)
    printf("     times    get time ranges of <addr>\n");
    printf("     getdo    show digital output at <addr>\n");
    printf("     getao    show analog output at <addr>\n");
+   printf("     replay   decode the requests of capture <file> and show the results\n");
 //   printf("     w1       show data of all connected one wire sensors\n");
 }
 
+//***************************************************************************
+// Unmask Frame
+//   undo the masking of all bytes behind the id (see P4Request::prepareRequest)
+//***************************************************************************
+
+std::string unmaskFrame(const std::string& frame)
+{
+   std::string raw = frame.substr(0, Fs::sizeId);
+
+   for (size_t i = Fs::sizeId; i < frame.size(); i++)
+   {
+      byte b = frame[i];
+      byte next = i+1 < frame.size() ? frame[i+1] : 0;
+
+      if (b == 0xfe && next == 0x12)
+         b = 0x11;
+      else if (b == 0xfe && next == 0x14)
+         b = 0x13;
+
+      if (b == 0x02 || b == 0x2b || b == 0xfe || b == 0x11 || b == 0x13)
+         i++;
+
+      raw += (char)b;
+   }
+
+   return raw;
+}
+
+//***************************************************************************
+// Replay Request
+//***************************************************************************
+
+int replayRequest(P4Request& request, byte command, word address)
+{
+   int status {fail};
+
+   switch (command)
+   {
+      case Fs::cmdCheck:
+      {
+         status = request.check();
+         tell(eloAlways, "check: %s", status == success ? "success" : "failed");
+         break;
+      }
+      case Fs::cmdGetState:
+      {
+         Fs::Status s;
+
+         if ((status = request.getStatus(&s)) == success)
+            tell(eloAlways, "state: %s; %s; %d - %s; %d - %s", s.version,
+                 l2pTime(s.time).c_str(), s.mode, s.modeinfo, s.state, s.stateinfo);
+         break;
+      }
+      case Fs::cmdGetValue:
+      {
+         Fs::Value v(address);
+
+         if ((status = request.getValue(&v)) == success)
+            tell(eloAlways, "value 0x%04x: %d", v.address, v.value);
+         break;
+      }
+      case Fs::cmdGetValueListFirst:
+      case Fs::cmdGetValueListNext:
+      {
+         Fs::ValueSpec v;
+
+         status = command == Fs::cmdGetValueListFirst ? request.getFirstValueSpec(&v) : request.getNextValueSpec(&v);
+
+         if (status == success)
+            tell(eloAlways, "value spec 0x%04x: %d '%s' (%04d) '%s'", v.address, v.factor, v.unit, v.type, v.description);
+         break;
+      }
+      case Fs::cmdGetMenuListFirst:
+      case Fs::cmdGetMenuListNext:
+      {
+         Fs::MenuItem m;
+
+         status = command == Fs::cmdGetMenuListFirst ? request.getFirstMenuItem(&m) : request.getNextMenuItem(&m);
+
+         if (status == success)
+            tell(eloAlways, "menu 0x%04x: type 0x%02x, parent 0x%04x, child 0x%04x '%s'",
+                 m.address, m.type, m.parent, m.child, m.description);
+         break;
+      }
+      case Fs::cmdGetParameter:
+      {
+         Fs::ConfigParameter p(address);
+
+         if ((status = request.getParameter(&p)) == success)
+            tell(eloAlways, "parameter 0x%04x: %.*f%s (%.*f - %.*f, default %.*f)",
+                 p.address, p.digits, p.rValue, p.unit, p.digits, p.rMin, p.digits, p.rMax, p.digits, p.rDefault);
+         break;
+      }
+      case Fs::cmdGetTimesFirst:
+      case Fs::cmdGetTimesNext:
+      {
+         Fs::TimeRanges t;
+
+         status = command == Fs::cmdGetTimesFirst ? request.getFirstTimeRanges(&t) : request.getNextTimeRanges(&t);
+
+         if (status == success)
+         {
+            std::string ranges;
+
+            for (int n = 0; n < 4; n++)
+               ranges += std::string(n ? ", " : "") + t.getTimeRange(n);
+
+            tell(eloAlways, "times 0x%02x: %s", t.address, ranges.c_str());
+         }
+         break;
+      }
+      case Fs::cmdGetDigOut:
+      case Fs::cmdGetDigIn:
+      case Fs::cmdGetAnlOut:
+      {
+         Fs::IoValue v(address);
+
+         if (command == Fs::cmdGetDigOut)
+            status = request.getDigitalOut(&v);
+         else if (command == Fs::cmdGetDigIn)
+            status = request.getDigitalIn(&v);
+         else
+            status = request.getAnalogOut(&v);
+
+         if (status == success)
+            tell(eloAlways, "io 0x%02x/0x%04x: mode %d, state %d", command, v.address, v.mode, v.state);
+         break;
+      }
+      case Fs::cmdGetErrorFirst:
+      case Fs::cmdGetErrorNext:
+      {
+         Fs::ErrorInfo e;
+
+         status = command == Fs::cmdGetErrorFirst ? request.getFirstError(&e) : request.getNextError(&e);
+
+         if (status == success)
+            tell(eloAlways, "error %03d/%03d: %s '%s' - %s", e.number, e.info,
+                 l2pTime(e.time).c_str(), e.text, Fs::errState2Text(e.state));
+         break;
+      }
+      default:
+      {
+         // set requests and unknown commands, only the reply frame is read
+
+         status = request.getUser(command);
+         tell(eloAlways, "command 0x%02x: %s", command, status == success ? "success" : "failed");
+         break;
+      }
+   }
+
+   if (status != success && status != Fs::wrnLast)
+      tell(eloAlways, "command 0x%02x (0x%04x): failed with %d", command, address, status);
+
+   return status;
+}
+
+//***************************************************************************
+// Replay
+//   drive the decoder by the requests of a capture, the output allows to
+//   check that changes of the protocol code don't change the decoded values
+//***************************************************************************
+
+int replay(const char* file, bool realtime)
+{
+   SerialReplay serial(realtime);
+   P4Request request(&serial);
+   int decoded {0};
+
+   if (serial.open(file) != success)
+      return fail;
+
+   uint64_t start = SerialCapture::nowUs();
+
+   while (const SerialCapture::Frame* frame = serial.nextRequest())
+   {
+      std::string raw = unmaskFrame(frame->data);
+      size_t posPayload = sizeof(Fs::Header);
+
+      if (raw.size() <= posPayload)
+         break;
+
+      byte command = raw[posPayload-1];
+      word address = raw.size() > posPayload+2 ? ((byte)raw[posPayload] << 8 | (byte)raw[posPayload+1]) : 0;
+
+      if (replayRequest(request, command, address) == success)
+         decoded++;
+   }
+
+   double ms = (SerialCapture::nowUs() - start) / 1000.0;
+
+   tell(eloAlways, "Replayed %d requests (%d decoded) in %.3f ms, %.0f requests/s; "
+        "%d requests differ from the capture, %zu bytes not read",
+        serial.getRequests(), decoded, ms, ms > 0 ? serial.getRequests() * 1000.0 / ms : 0.0,
+        serial.getMismatches(), serial.getUnread());
+
+   serial.close();
+
+   return success;
+}
+
 //***************************************************************************
 // Main
 //***************************************************************************
@@ -101,6 +306,9 @@ int main(int argc, char** argv)
    const char* value {nullptr};
    UserCommand cmd = ucUnknown;
    const char* device = "/dev/ttyUSB0";
+   const char* captureFile {nullptr};
+   const char* replayFile {nullptr};
+   bool realtime {false};
 
 //    {
 //       md5Buf defaultPwd;
@@ -157,6 +365,8 @@ int main(int argc, char** argv)
       cmd = ucUser;
    else if (strcasecmp(argv[1], "list") == 0)
       cmd = ucUnkonownList;
+   else if (strcasecmp(argv[1], "replay") == 0)
+      cmd = ucReplay;
    else
    {
       showUsage(argv[0]);
@@ -190,6 +400,9 @@ int main(int argc, char** argv)
          case 'v': if (argv[i+1]) value = argv[++i];                   break;
       case 'l': if (argv[i+1]) eloquence = (Eloquence)atoi(argv[++i]); break;
          case 'd': if (argv[i+1]) device = argv[++i];                  break;
+         case 'c': if (argv[i+1]) captureFile = argv[++i];             break;
+         case 'f': if (argv[i+1]) replayFile = argv[++i];              break;
+         case 'r': realtime = true;                                    break;
       }
    }
 
@@ -199,6 +412,17 @@ int main(int argc, char** argv)
    if (eloquence != eloAlways)
       logstamp = true;
 
+   if (cmd == ucReplay)
+   {
+      if (!replayFile)
+      {
+         tell(eloAlways, "Missing capture file (-f), aborting");
+         return 1;
+      }
+
+      return replay(replayFile, realtime) == success ? 0 : 1;
+   }
+
    int debugMode = strcmp(device, "-") == 0;
 
    P4Request request(&serial);
@@ -210,6 +434,9 @@ int main(int argc, char** argv)
       if (serial.open(device) != success)
          return 1;
 
+      if (captureFile && serial.startCapture(captureFile) != success)
+         return 1;
+
       while (serial.look(b, 100) == success)
          tell(eloDebug, "-> 0x%2.2x", b);
 
@@ -328,7 +555,7 @@ int main(int argc, char** argv)
       {
          Fs::TimeRanges t;
 
-         for (status = request.getFirstTimeRanges(&t); status != Fs::wrnLast; status = request.getNextTimeRanges(&t))
+         for (status = request.getFirstTimeRanges(&t); status == success; status = request.getNextTimeRanges(&t))
          {
             for (int n = 0; n < 4; n++)
                tell(eloAlways, "  Range %d: %s [0x%02x]", n+1, t.getTimeRange(n), t.address);
@@ -336,6 +563,9 @@ int main(int argc, char** argv)
             tell(eloAlways, "-------------------");
          }
 
+         if (status != Fs::wrnLast)
+            tell(eloAlways, "Aborting on error, status was %d", status);
+
          break;
       }
       case ucSetTimeRanges:
@@ -197,12 +197,38 @@ int P4Request::readWord(sword& v, int decode, int tms)
    return success;
 }
 
+//***************************************************************************
+// Read CRC
+//   the last byte of each reply, checked against the bytes read since the
+//   header (the CRC is independent of the byte order)
+//***************************************************************************
+
+int P4Request::readCrc()
+{
+   byte expected = crc(decoded, sizeDecodedContent);
+   byte b;
+   int status;
+
+   if ((status = readByte(b)) != success)
+      return status;
+
+   if (b != expected)
+   {
+      tell(eloAlways, "Error: CRC check of reply 0x%02x failed, got 0x%02x, expected 0x%02x", header.command, b, expected);
+      show("<- ", eloAlways);
+      return failed(fail);
+   }
+
+   return success;
+}
+
 //***************************************************************************
 // Read Request
 //***************************************************************************
 
 int P4Request::request(byte command)
 {
+   lastCommand = command;
    header.id = htons(commId);
    header.command = command;
 
@@ -235,31 +261,74 @@ int P4Request::readHeader(int tms)
    if ((status = readWord(header.id, no, tms)) != success)
    {
       tell(eloAlways, "Read word failed, aborting");
-      return status;
+      return failed(status);
    }
 
    if (header.id != commId)
    {
       tell(eloAlways, "Got wrong communication id %4.4x "
            "expected %4.4x", header.id, commId);
-      return fail;
+      return failed(fail);
    }
 
    if ((status = readWord(header.size, yes, tms)) != success)
    {
       tell(eloAlways, "Read size failed, status was %d", status);
-      return status;
+      return failed(status);
    }
 
    if ((status = readByte(header.command, yes, tms)) != success)
    {
       tell(eloAlways, "Read command failed, status was %d", status);
-      return status;
+      return failed(status);
    }
 
    return success;
 }
 
+//***************************************************************************
+// Failed - count the failed replies per command
+//***************************************************************************
+
+int P4Request::failed(int status)
+{
+   cMetricCounter* counter = errorCounters[lastCommand].load();
+
+   if (!counter)
+   {
+      char label[10+TB];
+
+      sprintf(label, "0x%02x", lastCommand);
+      counter = cMetrics::counter("serial_errors_total", label);
+      errorCounters[lastCommand].store(counter);
+   }
+
+   counter->inc();
+
+   return status;
+}
+
+//***************************************************************************
+// Request Histogram
+//   of the command, the registry lookup is done once per command
+//***************************************************************************
+
+cMetricHistogram* P4Request::requestHistogram(byte command)
+{
+   cMetricHistogram* histogram = requestHistograms[command].load();
+
+   if (!histogram)
+   {
+      char label[10+TB];
+
+      sprintf(label, "0x%02x", command);
+      histogram = cMetrics::histogram("serial_request_seconds", label);
+      requestHistograms[command].store(histogram);
+   }
+
+   return histogram;
+}
+
 //***************************************************************************
 // Read Time
 //***************************************************************************
@@ -420,7 +489,7 @@ int P4Request::readText(char*& s, int size)
    }
 
    tmp[p] = 0;
-   s = (char*)malloc(2*size);
+   s = (char*)malloc(2*size+TB);     // toUTF8() terminates behind outMax
 
    if (toUTF8(s, 2*size, tmp) != success)
    {
@@ -445,7 +514,6 @@ int P4Request::check()
 
    int status = fail;
    char* s = 0;
-   byte b;
 
    cMyMutexLock lock(&mutex);
 
@@ -456,7 +524,7 @@ int P4Request::check()
    if (readHeader() == success)
    {
       if (readText(s, getHeader()->size - sizeCrc) == success)
-         if (readByte(b) == success)   // read crc ..
+         if (readCrc() == success)
             status = success;
 
       free(s);
@@ -498,9 +566,9 @@ int P4Request::getStatus(Status* s)
       size--;
 
       status += readText(text, size-sizeCrc);
-      status += readByte(b);
+      status += readCrc();
 
-      if ((p = strchr(text, ';')))
+      if (status == success && text && (p = strchr(text, ';')))
       {
          *p = 0;
 
@@ -515,6 +583,7 @@ int P4Request::getStatus(Status* s)
          s->stateinfo = strdup("Communication error");
          tell(eloAlways, "Communication error while reading state, got size %d, status was %d", size, status);
 
+         free(text);
          status = fail;
          show("<- ", eloAlways);
       }
@@ -550,9 +619,13 @@ int P4Request::getStatus(Status* s)
 
       int max = 0;
 
-      while (size-- > 0 && max++ < 10)
+      while (size > sizeCrc && max++ < 10)
+      {
          status += readByte(b);
+         size--;
+      }
 
+      status += readCrc();
       show("<- ");
    }
 
@@ -601,7 +674,7 @@ int P4Request::syncTime(int offset)
       if (b != 0)
          status = fail;
 
-      status += readByte(b); // crc
+      status += readCrc();
    }
 
    show("<- ");
@@ -656,7 +729,7 @@ int P4Request::getParameter(ConfigParameter* p)
          + readWord(p->uw1)           // unknown word
          + readByte(p->ub3)           // unknown byte 3
 
-         + readByte(b);               // crc
+         + readCrc();
 
       if (status == success)
       {
@@ -689,7 +762,6 @@ int P4Request::getParameter(ConfigParameter* p)
 int P4Request::setParameter(ConfigParameter* p)
 {
    RequestClean clean(this);
-   byte crc;
 
    if (!p || p->address == addrUnknown)
       return errWrongAddress;
@@ -719,7 +791,7 @@ int P4Request::setParameter(ConfigParameter* p)
    if (request(cmdSetParameter) != success)
       return errRequestFailed;
 
-   if (readHeader() + readWord(p->address) + readWord(p->value) + readByte(crc) != success)
+   if (readHeader() + readWord(p->address) + readWord(p->value) + readCrc() != success)
       return fail;
 
    show("<- ");
@@ -727,7 +799,7 @@ int P4Request::setParameter(ConfigParameter* p)
    if (p->value == pActual.value)
       return errTransmissionFailed;
 
-   if (readHeader() + readWord(p->address) + readWord(p->value) + readByte(crc) != success)
+   if (readHeader() + readWord(p->address) + readWord(p->value) + readCrc() != success)
       return fail;
 
    show("<- ");
@@ -762,7 +834,6 @@ int P4Request::getTimeRanges(TimeRanges* t, int first)
 
    if ((status = readHeader()) == success)
    {
-      byte crc;
       sword w;
 
       status = readWord(w)            // what ever (always 01 00 ?)
@@ -774,7 +845,7 @@ int P4Request::getTimeRanges(TimeRanges* t, int first)
          return fail;
       }
 
-      for (int n = 0; n < 4; n++)
+      for (int n = 0; n < 4 && status == success; n++)
       {
          // read time range 'n'
 
@@ -782,9 +853,9 @@ int P4Request::getTimeRanges(TimeRanges* t, int first)
             + readByte(t->timesTo[n]);
       }
 
-      if ((status = readByte(crc)) != success)
+      if (status != success || (status = readCrc()) != success)
       {
-         tell(eloAlways, "Error: Reading CRC failed;");
+         tell(eloAlways, "Error: Reading time ranges failed");
          return fail;
       }
 
@@ -804,7 +875,6 @@ int P4Request::setTimeRanges(TimeRanges* t)
 {
    RequestClean clean(this);
    int status;
-   byte crc;
    byte tmp;
    sword addr;
 
@@ -849,7 +919,7 @@ int P4Request::setTimeRanges(TimeRanges* t)
       status += readByte(t->timesTo[n]);
    }
 
-   status += readByte(crc);
+   status += readCrc();
 
    if (status != success)
      return errTransmissionFailed;
@@ -867,7 +937,6 @@ int P4Request::getValue(Value* v)
 {
    RequestClean clean(this);
    int status = fail;
-   byte rCrc;
 
    if (!v || v->address == addrUnknown)
       return errWrongAddress;
@@ -880,27 +949,7 @@ int P4Request::getValue(Value* v)
    if (readHeader() == success)
    {
       status = readWord(v->value)
-         + readByte(rCrc);
-
-      // CRC check
-      {
-         int sizeNetto {0};
-         byte tmp[sizeof(Header)+100+TB];
-
-         memcpy(tmp+sizeNetto, &header, sizeof(Header));
-         sizeNetto += sizeof(Header);
-         memcpy(tmp+sizeNetto, &v->value, 2);
-         sizeNetto += 2;
-
-         byte bCrc = crc(tmp, sizeNetto);
-
-         if (bCrc != rCrc)
-         {
-            show("<- ");
-            tell(eloAlways, "Error: CRC check failed, got %c, expected %c", bCrc, rCrc);
-            return fail;
-         }
-      }
+         + readCrc();
 
       show("<- ");
    }
@@ -916,7 +965,6 @@ int P4Request::getDigitalOut(IoValue* v)
 {
    RequestClean clean(this);
    int status = fail;
-   byte crc;
 
    if (!v || v->address == addrUnknown)
       return errWrongAddress;
@@ -930,7 +978,7 @@ int P4Request::getDigitalOut(IoValue* v)
    {
       status = readByte(v->mode)
          + readByte(v->state)
-         + readByte(crc);
+         + readCrc();
 
       show("<- ");
    }
@@ -946,7 +994,6 @@ int P4Request::getDigitalIn(IoValue* v)
 {
    RequestClean clean(this);
    int status = fail;
-   byte crc;
 
    if (!v || v->address == addrUnknown)
       return errWrongAddress;
@@ -960,7 +1007,7 @@ int P4Request::getDigitalIn(IoValue* v)
    {
       status = readByte(v->mode)
          + readByte(v->state)
-         + readByte(crc);
+         + readCrc();
 
       show("<- ");
    }
@@ -976,7 +1023,6 @@ int P4Request::getAnalogOut(IoValue* v)
 {
    RequestClean clean(this);
    int status = fail;
-   byte crc;
 
    if (!v || v->address == addrUnknown)
       return errWrongAddress;
@@ -990,7 +1036,7 @@ int P4Request::getAnalogOut(IoValue* v)
    {
       status = readByte(v->mode)
          + readByte(v->state)
-         + readByte(crc);
+         + readCrc();
 
       show("<- ");
    }
@@ -1007,7 +1053,6 @@ int P4Request::getError(ErrorInfo* e, int first)
    RequestClean clean(this);
    int status = success;
    int size = 0;
-   byte crc;
    byte more;
 
    if (!e)
@@ -1027,7 +1072,7 @@ int P4Request::getError(ErrorInfo* e, int first)
 
    if (!more)
    {
-      readByte(crc);
+      readCrc();
       show("<- ");
       tell(eloDebug, "Got 'end of list'");
 
@@ -1045,10 +1090,13 @@ int P4Request::getError(ErrorInfo* e, int first)
    status += readText(e->text, size-sizeCrc);
    size -= size-sizeCrc;
 
-   status += readByte(crc);
+   status += readCrc();
    show("<- ");
 
-   return status;
+   if (status != success || !e->text)
+      return fail;
+
+   return success;
 }
 
 //***************************************************************************
@@ -1062,7 +1110,7 @@ int P4Request::getValueSpec(ValueSpec* v, int first)
    RequestClean clean(this);
    int status = success;
    int size = 0;
-   byte crc, tb, b;
+   byte tb, b;
    byte more;
 
    cMyMutexLock lock(&mutex);
@@ -1079,7 +1127,7 @@ int P4Request::getValueSpec(ValueSpec* v, int first)
 
    if (!more)
    {
-      readByte(crc);
+      readCrc();
       show("<- ");
       tell(eloDebug, "Got 'end of list'");
 
@@ -1108,9 +1156,12 @@ int P4Request::getValueSpec(ValueSpec* v, int first)
    status += readByte(tb);  // termination byte
    size--;
 
-   status += readByte(crc);
+   status += readCrc();
    show("<- ");
 
+   if (status != success || !v->description)
+      return fail;
+
    // create sensor name
 
    std::string name = v->description;
@@ -1159,7 +1210,7 @@ int P4Request::getMenuItem(MenuItem* m, int first)
    RequestClean clean(this);
    int status;
    int size = 0;
-   byte crc, tb, b;
+   byte tb, b;
    byte more;
 
    cMyMutexLock lock(&mutex);
@@ -1179,7 +1230,7 @@ int P4Request::getMenuItem(MenuItem* m, int first)
 
    if (!more)
    {
-      readByte(crc);
+      readCrc();
       show("<- ");
 
       tell(eloDebug, "Got 'end of list'");
@@ -1286,10 +1337,9 @@ int P4Request::getMenuItem(MenuItem* m, int first)
 
    size--;
 
-   if ((status = readByte(crc)) != success)
+   if ((status = readCrc()) != success)
    {
-      tell(eloAlways, "Missing at least %d bytes at reading crc", size);
-      show("<- ");
+      tell(eloAlways, "Reading crc failed, status was %d", status);
       return status;
    }
 
@@ -1315,14 +1365,14 @@ int P4Request::getItem(int first)
    }
 
    int size = getHeader()->size;
-   byte b, crc;
+   byte b;
 
    readByte(more);
    size--;
 
    if (!more)
    {
-      readByte(crc);
+      readCrc();
       show("<- ");
       tell(eloDebug, "Got 'end of list'");
 
@@ -17,6 +17,7 @@
 #include <vector>
 
 #include "lib/serial.h"
+#include "lib/metrics.h"
 
 #include "service.h"
 
@@ -38,6 +39,7 @@ class P4Request : public FroelingService
             RequestClean(P4Request* aReq)
             {
                req = aReq;
+               start = cMetrics::nowUs();
             }
 
             ~RequestClean()
@@ -53,11 +55,16 @@ class P4Request : public FroelingService
                   tell(eloAlways, "Got %d unexpected bytes", count);
                   req->show("<- ");
                }
+
+               // duration of the whole request, per command
+
+               req->requestHistogram(req->lastCommand)->record(cMetrics::nowUs() - start);
             }
 
          private:
 
             P4Request* req;
+            double start {0};
       };
 
       int clear()
@@ -199,10 +206,16 @@ class P4Request : public FroelingService
       int readTimeDate(time_t& t);     // 6 byte
       int readTimeDateExt(time_t& t);  // 7 byte
       int readText(char*& s, int size);
+      int readCrc();
+      int failed(int status);
+      cMetricHistogram* requestHistogram(byte command);
 
       // data
 
       Header header;
+      byte lastCommand {0};               // command of the last request
+      std::atomic<cMetricHistogram*> requestHistograms[256] {};   // per command, looked up on first use
+      std::atomic<cMetricCounter*> errorCounters[256] {};
       cMyMutex mutex;
       char* text {nullptr};
       word addresses[maxAddresses];
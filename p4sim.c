@@ -0,0 +1,1052 @@
+//***************************************************************************
+// p4d / Linux - Heizungs Manager
+// File p4sim.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 04.11.2010 - 19.10.2026  Jörg Wendel
+//***************************************************************************
+
+//***************************************************************************
+// S-3200 Simulator
+//   speaks the service protocol of the Fröling S-3200 on a pseudo terminal,
+//   the daemon and p4 can be pointed to the (linked) slave device
+//***************************************************************************
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <math.h>
+#include <termios.h>
+
+#include <vector>
+#include <map>
+#include <string>
+#include <random>
+
+#include "lib/common.h"
+#include "service.h"
+
+typedef std::vector<byte> Payload;
+
+static bool shutdownRequested {false};
+
+void downF(int aSignal)
+{
+   shutdownRequested = true;
+}
+
+//***************************************************************************
+// Class P4Simulator
+//***************************************************************************
+
+class P4Simulator : public FroelingService
+{
+   public:
+
+      ~P4Simulator()  { close(); }
+
+      int open(const char* aLink);
+      int close();
+      int loop();
+
+      // settings
+
+      int latency {0};                // ms before each reply
+      int baud {0};                   // 0 for 'as fast as possible'
+      int crcErrorRate {0};           // percent of replies with corrupted CRC
+      int truncateRate {0};           // percent of replies cut off
+      int valueCount {0};             // additional generated values
+      uint seed {0};
+
+   private:
+
+      struct SimValue
+      {
+         word address;
+         word factor;
+         word type;
+         const char* unit;
+         std::string description;
+         double base;
+         double amplitude;
+      };
+
+      struct SimParameter
+      {
+         word address;
+         const char* unit;
+         byte digits;
+         byte factor;
+         sword value;
+         sword min;
+         sword max;
+         sword def;
+         std::string description;
+      };
+
+      struct SimIo
+      {
+         word address;
+         byte type;                   // mstDigOut, mstAnlOut or mstDigIn
+         byte mode;
+         byte state;
+         std::string description;
+      };
+
+      struct SimError
+      {
+         word number;
+         byte info;
+         byte state;
+         time_t time;
+         std::string text;
+      };
+
+      void initModel();
+
+      int look(byte& b, int tms);
+      int readByte(byte& b, int decode = yes, int tms = 1000);
+      int readRequest(byte& command, Payload& payload);
+      int reply(byte command, const Payload& payload);
+      int writePaced(const byte* data, int size);
+      int dispatch(byte command, const Payload& payload);
+
+      int onCheck(const Payload& payload);
+      int onGetState();
+      int onGetVersion();
+      int onSetDateTime(const Payload& payload);
+      int onGetValue(const Payload& payload);
+      int onGetValueSpec(byte command, int first);
+      int onGetMenuItem(byte command, int first);
+      int onGetParameter(byte command, const Payload& payload);
+      int onSetParameter(const Payload& payload);
+      int onGetTimeRanges(byte command, int first);
+      int onSetTimeRanges(const Payload& payload);
+      int onGetIo(byte command, const Payload& payload);
+      int onGetError(byte command, int first);
+
+      sword valueOf(const SimValue* v);
+      time_t simTime()  { return time(0) + timeOffset; }
+      bool chance(int percent)  { return percent > 0 && (int)(rng() % 100) < percent; }
+
+      static word wordAt(const Payload& payload, size_t pos);
+      static void addWord(Payload& payload, word w);
+      static void addText(Payload& payload, const std::string& text, size_t size = 0);
+      static void addTime(Payload& payload, time_t t, int ext);
+
+      int master {-1};
+      int slave {-1};                 // kept open to avoid EIO on the master after a client closed
+      std::string link;
+      std::string slaveName;
+
+      byte input[512];
+      int inputSize {0};
+      int inputPos {0};
+
+      std::vector<SimValue> values;
+      std::vector<SimParameter> parameters;
+      std::vector<SimIo> ios;
+      std::vector<SimError> errors;
+      std::map<byte,TimeRanges> timeRanges;
+
+      size_t valueIndex {0};
+      size_t menuIndex {0};
+      size_t errorIndex {0};
+      std::map<byte,TimeRanges>::iterator timesIt;
+
+      byte mode {1};
+      byte state {3};
+      time_t timeOffset {0};
+      std::minstd_rand rng;
+};
+
+//***************************************************************************
+// Init Model
+//***************************************************************************
+
+void P4Simulator::initModel()
+{
+   values =
+   {
+      { 0x00, 2,  mstMesswert, "°C", "Kesseltemperatur",         72.0,  4.0 },
+      { 0x01, 1,  mstMesswert, "°C", "Abgastemperatur",         140.0, 25.0 },
+      { 0x02, 1,  mstMesswert, "°C", "Abgastemp. S.Wert",       150.0,  0.0 },
+      { 0x03, 1,  mstMesswert, "%",  "Kesselsteuergrösse",       80.0, 20.0 },
+      { 0x04, 1,  mstMesswert, "%",  "Saugzug - Ansteuerung",    65.0, 10.0 },
+      { 0x05, 10, mstMesswert, "%",  "Restsauerstoffgehalt",      8.0,  2.5 },
+      { 0x0c, 2,  mstMesswert, "°C", "Aussentemperatur",          6.0,  5.0 },
+      { 0x14, 2,  mstMesswert, "°C", "Puffertemperatur oben",    68.0,  6.0 },
+      { 0x15, 2,  mstMesswert, "°C", "Puffertemperatur unten",   45.0,  8.0 },
+      { 0x1d, 2,  mstMesswert, "°C", "Vorlauftemperatur HK1",    42.0,  3.0 },
+      { 0x1e, 2,  mstMesswert, "°C", "Vorlauf-Solltemp. HK1",    43.0,  0.0 }
+   };
+
+   for (int i = 0; i < valueCount; i++)
+   {
+      SimValue v {(word)(0x100 + i), 2, mstMesswert, "°C", "Simulierter Fühler " + std::to_string(i+1), 20.0 + i % 60, 5.0};
+      values.push_back(v);
+   }
+
+   parameters =
+   {
+      { 0x0000, "°", 0, 1, 75,  70, 90,  75, "Kessel-Solltemperatur" },
+      { 0x0001, "°", 0, 1, 65,  40, 85,  65, "Pufferladung ab Kesseltemperatur" },
+      { 0x0002, "°", 1, 2, 40,  20, 80,  40, "Heizkreispumpe ein ab Puffertemperatur" },
+      { 0x0003, "%", 0, 1, 50,  0,  100, 50, "Saugzug Mindestdrehzahl" },
+      { 0x0004, "°", 0, 1, 18,  -10, 30, 18, "Heizgrenze Aussentemperatur" },
+      { 0x0005, "m", 0, 1, 30,  0,  120, 30, "Nachlaufzeit Pumpe" }
+   };
+
+   ios =
+   {
+      { 0x00, mstDigOut, 'A', 1,   "Kesselpumpe" },
+      { 0x01, mstDigOut, 'A', 0,   "Heizkreispumpe 1" },
+      { 0x02, mstDigOut, 'A', 1,   "Saugzug" },
+      { 0x00, mstAnlOut, 0xff, 65, "Saugzuggebläse" },
+      { 0x01, mstAnlOut, 0xff, 40, "Mischer HK1" },
+      { 0x00, mstDigIn,  'A', 1,   "Kesseltür" },
+      { 0x01, mstDigIn,  'A', 0,   "STB" }
+   };
+
+   errors =
+   {
+      { 0x16, 0x01, 2, time(0) - 3 * tmeSecondsPerDay, "Kesseltür offen" },
+      { 0x1c, 0x00, 4, time(0) - 2 * tmeSecondsPerDay, "Fühler 1 Fehler" },
+      { 0x2a, 0x02, 1, time(0) - tmeSecondsPerHour,    "Feuerraumtemperatur zu niedrig" }
+   };
+
+   for (byte addr = 0x00; addr < 0x10; addr++)
+   {
+      TimeRanges t(addr);
+
+      for (int n = 0; n < 4; n++)
+         t.timesFrom[n] = t.timesTo[n] = 0xff;
+
+      t.timesFrom[0] = 60;             // 06:00
+      t.timesTo[0] = 220;              // 22:00
+      timeRanges[addr] = t;
+   }
+
+   TimeRanges last(0xdf);
+
+   for (int n = 0; n < 4; n++)
+      last.timesFrom[n] = last.timesTo[n] = 0xff;
+
+   timeRanges[0xdf] = last;
+   timesIt = timeRanges.end();
+}
+
+//***************************************************************************
+// Open / Close
+//***************************************************************************
+
+int P4Simulator::open(const char* aLink)
+{
+   struct termios tio;
+
+   initModel();
+   rng.seed(seed ? seed : time(0));
+
+   if ((master = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+   {
+      tell(eloAlways, "Error: Creating pseudo terminal failed, errno was (%d) '%s'", errno, strerror(errno));
+      return fail;
+   }
+
+   slaveName = ptsname(master);
+
+   if ((slave = ::open(slaveName.c_str(), O_RDWR | O_NOCTTY)) < 0)
+   {
+      tell(eloAlways, "Error: Opening '%s' failed, errno was (%d) '%s'", slaveName.c_str(), errno, strerror(errno));
+      return fail;
+   }
+
+   tcgetattr(slave, &tio);
+   cfmakeraw(&tio);
+   tcsetattr(slave, TCSANOW, &tio);
+
+   if (!isEmpty(aLink))
+   {
+      link = aLink;
+      unlink(link.c_str());
+
+      if (symlink(slaveName.c_str(), link.c_str()) != 0)
+      {
+         tell(eloAlways, "Error: Creating link '%s' failed, errno was (%d) '%s'", aLink, errno, strerror(errno));
+         return fail;
+      }
+   }
+
+   tell(eloAlways, "Simulating S-3200 on '%s'%s%s", slaveName.c_str(),
+        link.empty() ? "" : " linked to ", link.c_str());
+
+   return success;
+}
+
+int P4Simulator::close()
+{
+   if (!link.empty())
+      unlink(link.c_str());
+
+   if (slave >= 0)
+      ::close(slave);
+
+   if (master >= 0)
+      ::close(master);
+
+   link.clear();
+   slave = master = -1;
+
+   return success;
+}
+
+//***************************************************************************
+// Look - next raw byte from the master side
+//***************************************************************************
+
+int P4Simulator::look(byte& b, int tms)
+{
+   if (inputPos >= inputSize)
+   {
+      struct pollfd fds {master, POLLIN, 0};
+
+      int res = poll(&fds, 1, tms);
+
+      if (res == 0)
+         return wrnTimeout;
+
+      if (res < 0 || (inputSize = ::read(master, input, sizeof(input))) <= 0)
+      {
+         inputSize = 0;
+         return errno == EINTR ? (int)wrnTimeout : fail;
+      }
+
+      inputPos = 0;
+   }
+
+   b = input[inputPos++];
+
+   return success;
+}
+
+//***************************************************************************
+// Read Byte (decode the masking like P4Request::readByte)
+//***************************************************************************
+
+int P4Simulator::readByte(byte& b, int decode, int tms)
+{
+   byte b1;
+   int status;
+
+   if ((status = look(b, tms)) != success)
+      return status;
+
+   if (!decode || (b != 0x02 && b != 0x2b && b != 0xfe))
+      return success;
+
+   if ((status = look(b1, tms)) != success)
+      return status;
+
+   if (b == 0xfe && b1 == 0x12)
+      b = 0x11;
+   else if (b == 0xfe && b1 == 0x14)
+      b = 0x13;
+   else if (b1 != 0x00)
+      return fail;
+
+   return success;
+}
+
+//***************************************************************************
+// Read Request
+//***************************************************************************
+
+int P4Simulator::readRequest(byte& command, Payload& payload)
+{
+   byte frame[sizeMaxRequest+TB];
+   byte b {0};
+   byte last {0};
+   int status;
+   word size;
+
+   payload.clear();
+
+   // sync to the communication id
+
+   while (true)
+   {
+      if ((status = look(b, 100)) != success)
+         return status;
+
+      if (last == (commId >> 8) && b == (commId & 0xff))
+         break;
+
+      last = b;
+   }
+
+   frame[0] = commId >> 8;
+   frame[1] = commId & 0xff;
+
+   for (int i = posSize; i < (int)sizeof(Header); i++)
+   {
+      if ((status = readByte(frame[i])) != success)
+         return status;
+   }
+
+   size = frame[posSize] << 8 | frame[posSize+1];
+   command = frame[sizeof(Header)-1];
+
+   if (size < sizeCrc || size > sizeDataMax + sizeCrc)
+   {
+      tell(eloAlways, "Error: Got request 0x%2.2x with invalid size %d, ignoring", command, size);
+      return fail;
+   }
+
+   for (int i = 0; i < size; i++)
+   {
+      if ((status = readByte(frame[sizeof(Header)+i])) != success)
+         return status;
+   }
+
+   int sizeNetto = sizeof(Header) + size - sizeCrc;
+
+   if (crc(frame, sizeNetto) != frame[sizeNetto])
+   {
+      tell(eloAlways, "Error: CRC check of request 0x%2.2x failed, ignoring", command);
+      return fail;
+   }
+
+   payload.assign(frame + sizeof(Header), frame + sizeNetto);
+
+   return success;
+}
+
+//***************************************************************************
+// Reply
+//***************************************************************************
+
+int P4Simulator::reply(byte command, const Payload& payload)
+{
+   byte tmp[sizeMaxReply+TB];
+   byte frame[2*sizeMaxReply+TB];
+   int sizeNetto {0};
+   int size {0};
+
+   if (payload.size() > sizeDataMax)
+      return fail;
+
+   tmp[sizeNetto++] = commId >> 8;
+   tmp[sizeNetto++] = commId & 0xff;
+   tmp[sizeNetto++] = (payload.size() + sizeCrc) >> 8;
+   tmp[sizeNetto++] = (payload.size() + sizeCrc) & 0xff;
+   tmp[sizeNetto++] = command;
+
+   for (auto b : payload)
+      tmp[sizeNetto++] = b;
+
+   tmp[sizeNetto] = crc(tmp, sizeNetto);
+
+   if (chance(crcErrorRate))
+   {
+      tell(eloAlways, "Fault: corrupting CRC of reply 0x%2.2x", command);
+      tmp[sizeNetto] ^= 0x5a;
+   }
+
+   sizeNetto++;
+
+   // mask all bytes behind the id like P4Request::prepareRequest()
+
+   frame[size++] = tmp[0];
+   frame[size++] = tmp[1];
+
+   for (int i = posSize; i < sizeNetto; i++)
+   {
+      switch (tmp[i])
+      {
+         case 0x02:
+         case 0x2b:
+         case 0xfe: frame[size++] = tmp[i]; frame[size++] = 0x00; break;
+         case 0x11: frame[size++] = 0xfe;   frame[size++] = 0x12; break;
+         case 0x13: frame[size++] = 0xfe;   frame[size++] = 0x14; break;
+         default:   frame[size++] = tmp[i];
+      }
+   }
+
+   if (chance(truncateRate))
+   {
+      size = sizeId + rng() % (size - sizeId);
+      tell(eloAlways, "Fault: truncating reply 0x%2.2x to %d bytes", command, size);
+   }
+
+   if (latency > 0)
+      usleep(latency * 1000);
+
+   return writePaced(frame, size);
+}
+
+//***************************************************************************
+// Write Paced
+//   emulate the transfer time of the line, 10 bits per byte (8N1)
+//***************************************************************************
+
+int P4Simulator::writePaced(const byte* data, int size)
+{
+   int pos {0};
+   uint64_t start = cTimeMs::Now() * 1000;
+
+   while (pos < size)
+   {
+      int count = size - pos;
+
+      if (baud > 0)
+      {
+         uint64_t now = cTimeMs::Now() * 1000;
+         int due = ((now - start) * baud / 10) / 1000000 + 1;
+         count = std::min(due - pos, size - pos);
+
+         if (count <= 0)
+         {
+            usleep(std::max(10000000 / baud, 100));
+            continue;
+         }
+      }
+
+      int res = ::write(master, data + pos, count);
+
+      if (res < 0)
+      {
+         if (errno == EINTR || errno == EAGAIN)
+            continue;
+
+         tell(eloAlways, "Error: Write failed, errno was (%d) '%s'", errno, strerror(errno));
+         return fail;
+      }
+
+      pos += res;
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Loop
+//***************************************************************************
+
+int P4Simulator::loop()
+{
+   byte command;
+   Payload payload;
+
+   while (!shutdownRequested)
+   {
+      int status = readRequest(command, payload);
+
+      if (status == wrnTimeout)
+         continue;
+
+      if (status != success)
+      {
+         inputPos = inputSize = 0;   // drop the rest of a broken request
+         continue;
+      }
+
+      tell(eloDebug, "<- request 0x%2.2x with %zu bytes payload", command, payload.size());
+      dispatch(command, payload);
+   }
+
+   return done;
+}
+
+//***************************************************************************
+// Dispatch
+//***************************************************************************
+
+int P4Simulator::dispatch(byte command, const Payload& payload)
+{
+   switch (command)
+   {
+      case cmdCheck:             return onCheck(payload);
+      case cmdGetState:          return onGetState();
+      case cmdGetVersion:        return onGetVersion();
+      case cmdSetDateTime:       return onSetDateTime(payload);
+      case cmdGetValue:          return onGetValue(payload);
+      case cmdGetValueListFirst: return onGetValueSpec(command, yes);
+      case cmdGetValueListNext:  return onGetValueSpec(command, no);
+      case cmdGetMenuListFirst:  return onGetMenuItem(command, yes);
+      case cmdGetMenuListNext:   return onGetMenuItem(command, no);
+      case cmdGetParameter:      return onGetParameter(command, payload);
+      case cmdSetParameter:      return onSetParameter(payload);
+      case cmdGetTimesFirst:     return onGetTimeRanges(command, yes);
+      case cmdGetTimesNext:      return onGetTimeRanges(command, no);
+      case cmdSetTimes:          return onSetTimeRanges(payload);
+      case cmdGetDigOut:
+      case cmdGetAnlOut:
+      case cmdGetDigIn:          return onGetIo(command, payload);
+      case cmdGetErrorFirst:     return onGetError(command, yes);
+      case cmdGetErrorNext:      return onGetError(command, no);
+
+      case cmdGetUnknownFirst:
+      case cmdGetUnknownNext:    return reply(command, {0x00});   // end of list
+   }
+
+   tell(eloAlways, "Info: Command 0x%2.2x not simulated, sending empty reply", command);
+
+   return reply(command, {});
+}
+
+//***************************************************************************
+// Commands
+//***************************************************************************
+
+int P4Simulator::onCheck(const Payload& payload)
+{
+   return reply(cmdCheck, payload);
+}
+
+int P4Simulator::onGetState()
+{
+   Payload payload {mode, state};
+
+   addText(payload, std::string(mode == 1 ? "Automatik" : "Sommerbetr") + ";" + toTitle(state));
+
+   return reply(cmdGetState, payload);
+}
+
+int P4Simulator::onGetVersion()
+{
+   Payload payload {0x50, 0x04, 0x05, 0x12};
+
+   addTime(payload, simTime(), yes);
+
+   return reply(cmdGetVersion, payload);
+}
+
+int P4Simulator::onSetDateTime(const Payload& payload)
+{
+   struct tm tm {};
+
+   if (payload.size() < 7)
+      return reply(cmdSetDateTime, {0x01});
+
+   tm.tm_sec = payload[0];
+   tm.tm_min = payload[1];
+   tm.tm_hour = payload[2];
+   tm.tm_mday = payload[3];
+   tm.tm_mon = payload[4] - 1;
+   tm.tm_year = payload[6] + 100;
+   tm.tm_isdst = -1;
+
+   timeOffset = mktime(&tm) - time(0);
+   tell(eloDetail, "Time set to '%s'", l2pTime(simTime()).c_str());
+
+   return reply(cmdSetDateTime, {0x00});
+}
+
+int P4Simulator::onGetValue(const Payload& payload)
+{
+   word address = wordAt(payload, 0);
+   sword value {0};
+
+   for (const auto& v : values)
+   {
+      if (v.address == address)
+      {
+         value = valueOf(&v);
+         break;
+      }
+   }
+
+   Payload answer;
+   addWord(answer, value);
+
+   return reply(cmdGetValue, answer);
+}
+
+int P4Simulator::onGetValueSpec(byte command, int first)
+{
+   Payload payload;
+
+   if (first)
+      valueIndex = 0;
+
+   if (valueIndex >= values.size())
+      return reply(command, {0x00});
+
+   const SimValue& v = values[valueIndex++];
+
+   payload.push_back(0x01);
+   addWord(payload, v.factor);
+   addWord(payload, v.type);
+   addText(payload, v.unit, 2);
+   addWord(payload, v.address);
+   addText(payload, v.description);
+   payload.push_back(0x00);           // termination byte
+
+   return reply(command, payload);
+}
+
+//***************************************************************************
+// Menu Item
+//   the menu is a flat list below one group: values, parameters and IOs
+//***************************************************************************
+
+int P4Simulator::onGetMenuItem(byte command, int first)
+{
+   Payload payload;
+   byte type {0};
+   word address {0};
+   std::string description;
+
+   if (first)
+      menuIndex = 0;
+
+   size_t index = menuIndex++;
+
+   if (index == 0)
+   {
+      type = mstMenuMain;
+      description = "Simulator";
+   }
+   else if (--index < values.size())
+   {
+      type = mstMesswert;
+      address = values[index].address;
+      description = values[index].description;
+   }
+   else if ((index -= values.size()) < parameters.size())
+   {
+      type = mstPar;
+      address = parameters[index].address;
+      description = parameters[index].description;
+   }
+   else if ((index -= parameters.size()) < ios.size())
+   {
+      type = ios[index].type;
+      address = ios[index].address;
+      description = ios[index].description;
+   }
+   else
+   {
+      return reply(command, {0x00});
+   }
+
+   payload.push_back(0x01);
+   payload.push_back(type);
+   payload.push_back(0x00);           // unknown1
+   addWord(payload, type == mstMenuMain ? 0x0000 : 0x0001);   // parent
+   addWord(payload, type == mstMenuMain ? 0x0001 : 0x0000);   // child
+   payload.insert(payload.end(), 18, 0x00);
+   addWord(payload, address);
+   addWord(payload, 0x0000);          // unknown2
+   addText(payload, description);
+   payload.push_back(0x00);           // termination byte
+
+   return reply(command, payload);
+}
+
+//***************************************************************************
+// Parameter
+//***************************************************************************
+
+int P4Simulator::onGetParameter(byte command, const Payload& payload)
+{
+   word address = wordAt(payload, 0);
+   Payload answer;
+
+   for (const auto& p : parameters)
+   {
+      if (p.address != address)
+         continue;
+
+      answer.push_back(0x00);         // ub1
+      addWord(answer, p.address);
+      addText(answer, p.unit, 1);
+      answer.push_back(p.digits);
+      answer.push_back(0x00);         // ub2
+      answer.push_back(p.factor);
+      addWord(answer, p.value);
+      addWord(answer, p.min);
+      addWord(answer, p.max);
+      addWord(answer, p.def);
+      addWord(answer, 0x0000);        // uw1
+      answer.push_back(0x00);         // ub3
+
+      return reply(command, answer);
+   }
+
+   // unknown address, answer with the address only
+
+   addWord(answer, address);
+
+   return reply(command, answer);
+}
+
+int P4Simulator::onSetParameter(const Payload& payload)
+{
+   word address = wordAt(payload, 0);
+   sword value = wordAt(payload, 2);
+   Payload answer;
+
+   for (auto& p : parameters)
+   {
+      if (p.address == address && value >= p.min && value <= p.max)
+      {
+         p.value = value;
+         break;
+      }
+   }
+
+   addWord(answer, address);
+   addWord(answer, value);
+
+   // the S-3200 acknowledges the request and confirms the stored value
+
+   if (reply(cmdSetParameter, answer) != success)
+      return fail;
+
+   return reply(cmdSetParameter, answer);
+}
+
+//***************************************************************************
+// Time Ranges
+//***************************************************************************
+
+int P4Simulator::onGetTimeRanges(byte command, int first)
+{
+   Payload payload {0x01, 0x00};
+
+   if (first)
+      timesIt = timeRanges.begin();
+   else if (timesIt != timeRanges.end())
+      ++timesIt;
+
+   if (timesIt == timeRanges.end())
+      timesIt = std::prev(timeRanges.end());    // keep answering the last one
+
+   payload.push_back(timesIt->second.address);
+
+   for (int n = 0; n < 4; n++)
+   {
+      payload.push_back(timesIt->second.timesFrom[n]);
+      payload.push_back(timesIt->second.timesTo[n]);
+   }
+
+   return reply(command, payload);
+}
+
+int P4Simulator::onSetTimeRanges(const Payload& payload)
+{
+   byte address = wordAt(payload, 0);
+   TimeRanges& t = timeRanges[address];
+   Payload answer {0x00};
+
+   t.address = address;
+
+   for (int n = 0; n < 4; n++)
+   {
+      word w = wordAt(payload, 2 + 2*n);
+      t.timesFrom[n] = w >> 8;
+      t.timesTo[n] = w & 0xff;
+   }
+
+   addWord(answer, address);
+
+   for (int n = 0; n < 4; n++)
+   {
+      answer.push_back(t.timesFrom[n]);
+      answer.push_back(t.timesTo[n]);
+   }
+
+   return reply(cmdSetTimes, answer);
+}
+
+//***************************************************************************
+// Digital / Analog IO
+//***************************************************************************
+
+int P4Simulator::onGetIo(byte command, const Payload& payload)
+{
+   word address = wordAt(payload, 0);
+   byte type = command == cmdGetDigOut ? mstDigOut : command == cmdGetAnlOut ? mstAnlOut : mstDigIn;
+
+   for (const auto& io : ios)
+   {
+      if (io.type == type && io.address == address)
+         return reply(command, {io.mode, io.state});
+   }
+
+   return reply(command, {0x00, 0x00});
+}
+
+//***************************************************************************
+// Error Buffer
+//***************************************************************************
+
+int P4Simulator::onGetError(byte command, int first)
+{
+   Payload payload {0x01};
+
+   if (first)
+      errorIndex = 0;
+
+   if (errorIndex >= errors.size())
+      return reply(command, {0x00});
+
+   const SimError& e = errors[errorIndex++];
+
+   addWord(payload, e.number);
+   payload.push_back(e.info);
+   payload.push_back(e.state);
+   addTime(payload, e.time, no);
+   addText(payload, e.text);
+
+   return reply(command, payload);
+}
+
+//***************************************************************************
+// Value Of - slow sinus around the base value
+//***************************************************************************
+
+sword P4Simulator::valueOf(const SimValue* v)
+{
+   double value = v->base + v->amplitude * sin((simTime() % 3600) * 2 * M_PI / 3600.0 + v->address);
+
+   return (sword)lround(value * v->factor);
+}
+
+//***************************************************************************
+// Payload Helpers
+//***************************************************************************
+
+word P4Simulator::wordAt(const Payload& payload, size_t pos)
+{
+   if (payload.size() < pos + 2)
+      return 0;
+
+   return payload[pos] << 8 | payload[pos+1];
+}
+
+void P4Simulator::addWord(Payload& payload, word w)
+{
+   payload.push_back(w >> 8);
+   payload.push_back(w & 0xff);
+}
+
+//***************************************************************************
+// Add Text
+//   the S-3200 talks ISO8859-1, size pads or cuts the text to a fixed size
+//***************************************************************************
+
+void P4Simulator::addText(Payload& payload, const std::string& text, size_t size)
+{
+   char out[500] {};
+   char* in = (char*)text.c_str();
+   char* outPtr = out;
+   size_t inLen = text.length();
+   size_t outLen = sizeof(out) - 1;
+   iconv_t cd = iconv_open("ISO8859-1//TRANSLIT", "UTF-8");
+
+   if (cd == (iconv_t)-1 || iconv(cd, &in, &inLen, &outPtr, &outLen) == (size_t)-1)
+      strncpy(out, text.c_str(), sizeof(out) - 1);
+
+   if (cd != (iconv_t)-1)
+      iconv_close(cd);
+
+   size_t len = size ? size : strlen(out);
+
+   for (size_t i = 0; i < len; i++)
+      payload.push_back(i < strlen(out) ? (byte)out[i] : ' ');
+}
+
+//***************************************************************************
+// Add Time
+//   time (s, m, h) followed by the date (d, m, [dow,] y)
+//***************************************************************************
+
+void P4Simulator::addTime(Payload& payload, time_t t, int ext)
+{
+   struct tm tm;
+
+   localtime_r(&t, &tm);
+
+   payload.push_back(tm.tm_sec);
+   payload.push_back(tm.tm_min);
+   payload.push_back(tm.tm_hour);
+   payload.push_back(tm.tm_mday);
+   payload.push_back(tm.tm_mon + 1);
+
+   if (ext)
+      payload.push_back(tm.tm_wday);
+
+   payload.push_back(tm.tm_year - 100);
+}
+
+//***************************************************************************
+// Usage
+//***************************************************************************
+
+void showUsage(const char* bin)
+{
+   printf("Usage: %s [-d <link>] [-w <ms>] [-b <baud>] [-c <percent>] [-t <percent>] [-n <count>] [-s <seed>] [-l <log-level>]\n", bin);
+   printf("\n");
+   printf("  options:\n");
+   printf("     -d <link>       create a symlink to the pty slave (e.g. /tmp/ttyP4), use it as device of p4d or p4\n");
+   printf("     -w <ms>         latency before each reply\n");
+   printf("     -b <baud>       emulate the transfer time of the given baud rate (default: no delay)\n");
+   printf("     -c <percent>    percentage of replies with corrupted CRC\n");
+   printf("     -t <percent>    percentage of truncated replies\n");
+   printf("     -n <count>      number of additional simulated values\n");
+   printf("     -s <seed>       seed of the fault injection (for reproducible runs)\n");
+   printf("     -l <log-level>  set log level\n");
+}
+
+//***************************************************************************
+// Main
+//***************************************************************************
+
+int main(int argc, char** argv)
+{
+   P4Simulator sim;
+   const char* link {nullptr};
+
+   eloquence = eloAlways;
+   logstdout = true;
+
+   for (int i = 1; argv[i]; i++)
+   {
+      if (argv[i][0] != '-' || strlen(argv[i]) != 2)
+      {
+         showUsage(argv[0]);
+         return 1;
+      }
+
+      switch (argv[i][1])
+      {
+         case 'd': if (argv[i+1]) link = argv[++i];                                  break;
+         case 'w': if (argv[i+1]) sim.latency = atoi(argv[++i]);                     break;
+         case 'b': if (argv[i+1]) sim.baud = atoi(argv[++i]);                        break;
+         case 'c': if (argv[i+1]) sim.crcErrorRate = atoi(argv[++i]);                break;
+         case 't': if (argv[i+1]) sim.truncateRate = atoi(argv[++i]);                break;
+         case 'n': if (argv[i+1]) sim.valueCount = atoi(argv[++i]);                  break;
+         case 's': if (argv[i+1]) sim.seed = strtoul(argv[++i], nullptr, 0);         break;
+         case 'l': if (argv[i+1]) eloquence = (Eloquence)strtol(argv[++i], nullptr, 0); break;
+         default: showUsage(argv[0]); return 0;
+      }
+   }
+
+   if (eloquence != eloAlways)
+      logstamp = true;
+
+   ::signal(SIGINT, downF);
+   ::signal(SIGTERM, downF);
+
+   if (sim.open(link) != success)
+      return 1;
+
+   sim.loop();
+   sim.close();
+
+   return 0;
+}
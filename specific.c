@@ -35,7 +35,8 @@ std::list<Daemon::ConfigItemDef> P4d::configuration
    { "webPort",                   ctInteger, "1111", false, "Daemon", "Port des Web Interfaces", "" },
    { "stateCheckInterval",        ctInteger, "10",   false, "Daemon", "Intervall der Status Prüfung", "Intervall der Status Prüfung [s]" },
    { "arduinoInterval",           ctInteger, "10",   false, "Daemon", "Intervall der Arduino Messungen", "[s]" },
-   { "ttyDevice",                 ctString,  "/dev/ttyUSB0", false, "Daemon", "TTY Device zur S-3200", "Beispiel: '/dev/ttyUsb0'" },
+   { "ttyDevice",                 ctString,  "/dev/ttyUSB0", false, "Daemon", "TTY Device zur S-3200", "Beispiel: '/dev/ttyUsb0', bei einer Kaskade Komma getrennt je S-3200 (z.B. '/dev/ttyUSB0,/dev/ttyUSB1'), Änderung der Anzahl erfordert Neustart" },
+   { "serialCapture",             ctString,  "",             false, "Daemon", " Mitschnitt der Kommunikation", "Datei für den binären Mitschnitt (auswerten mit 'p4 replay -f &lt;datei&gt;'), leer -&gt; aus" },
    { "eloquence",                 ctBitSelect, "1",          false, "Daemon", "Log Eloquence", "" },
 
    { "tsync",                     ctBool,    "0",    false, "Daemon", "Zeitsynchronisation", "täglich 3:00" },
@@ -43,16 +44,26 @@ std::list<Daemon::ConfigItemDef> P4d::configuration
 
    { "aggregateHistory",          ctInteger, "1",    false, "Daemon", "Historie [Tage]", "history for aggregation in days (default 0 days -&gt; aggegation turned OFF)" },
    { "aggregateInterval",         ctInteger, "15",   false, "Daemon", " danach aggregieren über", "aggregation interval in minutes - 'one sample per interval will be build'" },
+   { "archiveAfter",              ctInteger, "0",    false, "Daemon", "Archivieren nach [Tage]", "Messwerte älter als n Tage komprimiert archivieren (0 -&gt; aus)" },
+   { "w1Local",                   ctBool,    "0",    false, "Daemon", "One Wire Sensoren direkt lesen", "lokale One-Wire Sensoren im Daemon lesen statt über w1mqtt, Änderung erfordert Neustart" },
+   { "w1Resolution",              ctString,  "",     false, "Daemon", " Auflösung", "z.B. '11' oder '28-0316a279b9ff:12,10' (wie w1mqtt -r)" },
+   { "dbWorkers",                 ctInteger, "2",    false, "Daemon", "Datenbank Worker", "Anzahl der Threads für die Abfragen des Web Interfaces (Charts, Fehler, ...), Änderung erfordert Neustart" },
    { "peakResetAt",               ctString,  "",     true,  "Daemon", "", "" },
 
    { "consumptionPerHour",        ctNum,     "4",    false, "Daemon", "Pellet Verbrauch / Stoker Stunde", "" },
 
    { "openWeatherApiKey",         ctString,  "",             false, "Daemon", "Openweathermap API Key", "" },
+   { "httpProxy",                 ctString,  "",             false, "Daemon", "HTTP Proxy", "Proxy der HTTP Anfragen (deCONZ, Openweathermap), Beispiel: 'http://proxy:3128', leer -&gt; ohne Proxy bzw. 'http_proxy' der Umgebung" },
 
    // web
 
    { "webUrl",                    ctString,  "",             false, "WEB Interface", "URL der Visualisierung", "kann mit %weburl% in die Mails eingefügt werden" },
    { "webSSL",                    ctBool,    "",             false, "WEB Interface", "Use SSL for WebInterface" },
+   { "webCompression",            ctInteger, "1",            false, "WEB Interface", "WebSocket Kompression", "permessage-deflate Level 1-9 (0 -&gt; aus), Änderung erfordert Neustart" },
+   { "webCompressionMemLevel",    ctInteger, "8",            false, "WEB Interface", " Speicher Level", "zlib memLevel 1-9 je Verbindung" },
+   { "webCompressionWindowBits",  ctInteger, "15",           false, "WEB Interface", " Fenster Größe", "zlib window bits 8-15 je Verbindung" },
+   { "webDataApi",                ctBool,    "0",            false, "WEB Interface", "HTTP Daten API", "Lesender Zugriff auf /data/... ohne Anmeldung, Änderung erfordert Neustart" },
+   { "webMetricsApi",             ctBool,    "0",            false, "WEB Interface", "Prometheus Metriken", "/metrics für Abfragen vom lokalen Host, Änderung erfordert Neustart" },
    { "haUrl",                     ctString,  "",             false, "WEB Interface", "URL der Hausautomatisierung", "Zur Anzeige des Menüs als Link" },
 
    { "heatingType",               ctChoice,  "",             false, "WEB Interface", "Typ der Heizung", "" },
@@ -100,17 +111,20 @@ P4d::P4d()
 {
    webPort = 1111;
 
-   sem = new Sem(0x3da00001);
-   serial = new Serial;
-   request = new P4Request(serial);
+   controllers.push_back(new P4Controller(0));
+
+   sem = controllers[0]->getSem();
+   serial = controllers[0]->getSerial();
+   request = controllers[0]->getRequest();
 }
 
 P4d::~P4d()
 {
    free(stateMailAtStates);
-   delete serial;
-   delete request;
-   delete sem;
+   free(serialCapture);
+
+   for (auto controller : controllers)
+      delete controller;
 }
 
 //***************************************************************************
@@ -121,6 +135,10 @@ int P4d::init()
 {
    int status = Daemon::init();
 
+   cMetrics::describe("serial_request_seconds", "command", "Duration of the requests to the S-3200 by command");
+   cMetrics::describe("serial_errors_total", "command", "Failed replies of the S-3200 by command");
+   cMetrics::describe("controller_poll_seconds", "device", "Duration of polling the values of a S-3200");
+
    getConfigItem("knownStates", knownStates, "");
 
    if (!isEmpty(knownStates))
@@ -132,16 +150,24 @@ int P4d::init()
       tell(eloAlways, "Loaded (%zu) states [%s]", stateDurations.size(), knownStates);
    }
 
-   sem->p();
-   serial->open(ttyDevice);
-   sem->v();
+   for (auto controller : controllers)
+   {
+      controller->open();
+
+      if (!controller->Start())
+         tell(eloAlways, "Error: Starting thread of controller %u failed", controller->getId());
+   }
 
    return status;
 }
 
 int P4d::exit()
 {
-   serial->close();
+   for (auto controller : controllers)
+   {
+      controller->stop();
+      controller->close();
+   }
 
    return Daemon::exit();
 }
@@ -201,24 +227,6 @@ int P4d::initDb()
 
    status += selectMenuItemsByChild->prepare();
 
-   // ------------------
-   // select min(value), time from samples
-   //    where address = ? type = ?
-   //     and time > ?
-
-   minValue.setField(&minValueDef);
-   selectStokerHours = new cDbStatement(tableSamples);
-
-   selectStokerHours->build("select ");
-   selectStokerHours->bindTextFree("min(value)", &minValue, "", cDBS::bndOut);
-   selectStokerHours->bind("TIME", cDBS::bndOut, ", ");
-   selectStokerHours->build(" from %s where ", tableSamples->TableName());
-   selectStokerHours->bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
-   selectStokerHours->bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
-   selectStokerHours->bindCmp(0, "TIME", 0, ">", " and ");
-
-   status += selectStokerHours->prepare();
-
    // ------------------
    // state duration
    // select value, text, min(time)
@@ -248,18 +256,6 @@ int P4d::initDb()
 
    status += selectStateDuration->prepare();
 
-   // ------------------
-   // all errors
-
-   selectAllErrors = new cDbStatement(tableErrors);
-
-   selectAllErrors->build("select ");
-   selectAllErrors->bindAllOut();
-   selectAllErrors->build(" from %s",  tableErrors->TableName());
-   selectAllErrors->build(" order by time1 desc");
-
-   status += selectAllErrors->prepare();
-
    // ------------------
    // pending errors
 
@@ -275,16 +271,6 @@ int P4d::initDb()
 
    status += selectPendingErrors->prepare();
 
-   // ------------------
-   // select all pellets
-
-   selectAllPellets = new cDbStatement(tablePellets);
-   selectAllPellets->build("select ");
-   selectAllPellets->bindAllOut();
-   selectAllPellets->build(" from %s", tablePellets->TableName());
-   selectAllPellets->build(" order by time");
-   status += selectAllPellets->prepare();
-
    return status;
 
 }
@@ -299,11 +285,8 @@ int P4d::exitDb()
    delete selectAllMenuItems;         selectAllMenuItems = nullptr;
    delete selectMenuItemsByParent;    selectMenuItemsByParent = nullptr;
    delete selectMenuItemsByChild;     selectMenuItemsByChild = nullptr;
-   delete selectAllErrors;            selectAllErrors = nullptr;
    delete selectPendingErrors;        selectPendingErrors = nullptr;
 
-   delete selectAllPellets;           selectAllPellets = nullptr;
-   delete selectStokerHours;          selectStokerHours = nullptr;
    delete selectStateDuration;        selectStateDuration = nullptr;
 
    return Daemon::exitDb();
@@ -326,6 +309,22 @@ int P4d::readConfiguration(bool initial)
 
    getConfigItem("stateCheckInterval", stateCheckInterval, 10);
    getConfigItem("ttyDevice", ttyDevice, "/dev/ttyUSB0");
+   initControllers(initial);
+
+   std::string lastCapture = serialCapture ? serialCapture : "";
+   getConfigItem("serialCapture", serialCapture, "");
+
+   if (lastCapture != (serialCapture ? serialCapture : ""))
+   {
+      sem->p();                                 // not while a request is running
+
+      if (isEmpty(serialCapture))
+         serial->stopCapture();
+      else
+         serial->startCapture(serialCapture);   // a new session is appended
+
+      sem->v();
+   }
 
    getConfigItem("tsync", tSync, no);
    getConfigItem("maxTimeLeak", maxTimeLeak, 10);
@@ -347,6 +346,49 @@ int P4d::readConfiguration(bool initial)
    return done;
 }
 
+//***************************************************************************
+// Init Controllers
+//   one controller for each configured tty device, the first one is also
+//   used for the menu, parameters, errors and the time sync
+//***************************************************************************
+
+int P4d::initControllers(bool initial)
+{
+   std::vector<std::string> devices;
+
+   // split() trims the entries, skip the empty ones ("/dev/ttyUSB0, ,/dev/ttyUSB1")
+
+   for (const auto& device : split(ttyDevice, ','))
+   {
+      if (!device.empty())
+         devices.push_back(device);
+   }
+
+   if (devices.empty())
+      devices.push_back("/dev/ttyUSB0");
+
+   if (!initial && devices.size() != controllers.size())
+      tell(eloAlways, "Info: Changed number of tty devices takes effect after restart");
+
+   for (size_t i = 0; i < devices.size(); i++)
+   {
+      if (i >= controllers.size())
+      {
+         if (!initial)
+            break;
+
+         controllers.push_back(new P4Controller(i));
+      }
+
+      controllers[i]->setDevice(devices[i].c_str());
+   }
+
+   if (controllers.size() > 1)
+      tell(eloDetail, "Using %zu controllers", controllers.size());
+
+   return done;
+}
+
 int P4d::atMeanwhile()
 {
    return done;
@@ -370,6 +412,19 @@ int P4d::applyConfigurationSpecials()
    sensors["UD"][udMode].record = true;
    sensors["UD"][udTime].record = true;
 
+   // ... and of the further controllers of a cascade
+
+   for (size_t id = 1; id < controllers.size(); id++)
+   {
+      for (uint address : { udState, udMode, udTime })
+      {
+         auto it = sensors["UD"].find(P4Controller::toAddress(id, address));
+
+         if (it != sensors["UD"].end())
+            it->second.record = true;
+      }
+   }
+
    return done;
 }
 
@@ -380,34 +435,71 @@ int P4d::applyConfigurationSpecials()
 int P4d::updateSensors()
 {
    time_t now = time(0);
-   sem->p();
+   std::vector<std::vector<P4Controller::Item>> items(controllers.size());
+
+   // the values of the S-3200 are polled by the threads of the controllers in parallel
 
-   // check serial connection
+   for (const auto& typeSensorsIt : sensors)
+   {
+      const std::string& type = typeSensorsIt.first;
 
-   int status = request->check();
+      if (type != "VA" && type != "DO" && type != "DI" && type != "AO")
+         continue;
 
-   if (status != success)
+      for (const auto& sensorIt : typeSensorsIt.second)
+      {
+         uint id = P4Controller::controllerOf(sensorIt.first);
+
+         if (id >= controllers.size())
+            continue;
+
+         P4Controller::Item item;
+         item.type = type;
+         item.key = sensorIt.first;
+
+         if (type == "VA")
+         {
+            cDbRow* row = valueFactOf("VA", item.key);
+            item.dataType = row ? row->getIntValue("SUBTYPE") : 0;
+         }
+
+         items[id].push_back(item);
+      }
+   }
+
+   for (auto controller : controllers)
+      controller->startCycle(items[controller->getId()], controller->getId() > 0);
+
+   int status {success};
+
+   for (auto controller : controllers)
    {
-      serial->close();
-      tell(eloAlways, "Error reading serial interface, reopen now");
-      serial->open(ttyDevice);
+      uint id = controller->getId();
 
-      if (request->check() != success)
+      if (controller->waitCycle(items[id], interval * 1000) != success)
       {
-         sem->v();
-         return fail;
+         if (id == 0)
+            status = fail;
+
+         continue;
       }
+
+      for (const auto& item : items[id])
+         applyPolledItem(item, now);
+
+      if (id > 0)
+         updateControllerState(controller, now);
    }
 
+   if (status != success)
+      return fail;
+
    for (const auto& typeSensorsIt : sensors)
    {
       for (const auto& sensorIt : typeSensorsIt.second)
       {
-         int status {success};
          const SensorData* sensor = &sensorIt.second;
 
-         cDbRow* row = valueFactOf(sensor->type.c_str(), sensor->address);
-
          if (sensor->type == "SD")   // state duration
          {
             const auto it = stateDurations.find(sensor->address);
@@ -424,7 +516,7 @@ int P4d::updateSensors()
                sensors[sensor->type][sensor->address].last = now;
             }
          }
-         else if (sensor->type == "UD")
+         else if (sensor->type == "UD" && P4Controller::controllerOf(sensor->address) == 0)
          {
             std::string oldText = sensors[sensor->type][sensor->address].text;
             double oldValue = sensors[sensor->type][sensor->address].value;
@@ -451,91 +543,96 @@ int P4d::updateSensors()
             if (sensors[sensor->type][sensor->address].text != oldText || sensors[sensor->type][sensor->address].value != oldValue)
                sensors[sensor->type][sensor->address].last = now;
          }
-         else if (sensor->type == "DO")
-         {
-            Fs::IoValue v(sensor->address);
-
-            if ((status = request->getDigitalOut(&v)) != success)
-            {
-               tell(eloAlways, "Error: Getting digital out 0x%04x failed, error %d", sensor->address, status);
-               continue;
-            }
-
-            if (sensors[sensor->type][sensor->address].state != (bool)v.state)
-            {
-               sensors[sensor->type][sensor->address].state = v.state;
-               sensors[sensor->type][sensor->address].valid = true;
-               sensors[sensor->type][sensor->address].last = now;
-            }
-         }
-         else if (sensor->type == "DI")
-         {
-            Fs::IoValue v(sensor->address);
 
-            if ((status = request->getDigitalIn(&v)) != success)
-            {
-               tell(eloAlways, "Error: Getting digital in 0x%04x failed, error %d", sensor->address, status);
-               continue;
-            }
+         // publish to HA always - we like to draw charts ...
 
-            if (sensors[sensor->type][sensor->address].state != (bool)v.state)
-            {
-               sensors[sensor->type][sensor->address].state = v.state;
-               sensors[sensor->type][sensor->address].valid = true;
-               sensors[sensor->type][sensor->address].last = now;
-            }
-         }
-         else if (sensor->type == "AO")
-         {
-            Fs::IoValue v(sensor->address);
+         mqttHaPublish(sensors[sensor->type][sensor->address]);
 
-            if ((status = request->getAnalogOut(&v)) != success)
-            {
-               tell(eloAlways, "Error: Getting analog out 0x%04x failed, error %d", sensor->address, status);
-               continue;
-            }
+         if (sensors[sensor->type][sensor->address].last == now || sensor->type == "UD")
+            mqttNodeRedPublishSensor(sensors[sensor->type][sensor->address]);
+      }
+   }
 
-            if (sensors[sensor->type][sensor->address].state != (bool)v.state)
-            {
-               sensors[sensor->type][sensor->address].value = v.state;
-               sensors[sensor->type][sensor->address].valid = true;
-               sensors[sensor->type][sensor->address].last = now;
-            }
-         }
-         else if (sensor->type == "VA")
-         {
-            Value v(sensor->address);
+   selectActiveValueFacts->freeResult();
 
-            if ((status = request->getValue(&v)) != success)
-            {
-               tell(eloAlways, "Error: Getting value 0x%04x failed, error %d", sensor->address, status);
-               continue;
-            }
+   return done;
+}
 
-            int dataType = row->getIntValue("SUBTYPE");
-            int value = dataType == 1 ? (word)v.value : (sword)v.value;
-            double theValue = value / (double)sensor->factor;
+//***************************************************************************
+// Apply Polled Item
+//***************************************************************************
 
-            if (sensors[sensor->type][sensor->address].value != theValue)
-            {
-               sensors[sensor->type][sensor->address].kind = "value";
-               sensors[sensor->type][sensor->address].value = theValue;
-               sensors[sensor->type][sensor->address].valid = true;
-               sensors[sensor->type][sensor->address].last = now;
-            }
-         }
+void P4d::applyPolledItem(const P4Controller::Item& item, time_t now)
+{
+   SensorData* sensor = &sensors[item.type][item.key];
 
-         // publish to HA always - we like to draw charts ...
+   if (item.status != success)
+   {
+      tell(eloAlways, "Error: Getting %s 0x%04x failed, error %d", item.type.c_str(), item.key, item.status);
+      return;
+   }
 
-         mqttHaPublish(sensors[sensor->type][sensor->address]);
+   if (item.type == "VA")
+   {
+      int value = item.dataType == 1 ? (word)item.value : (sword)item.value;
+      double theValue = value / (double)sensor->factor;
 
-         if (sensors[sensor->type][sensor->address].last == now || sensor->type == "UD")
-            mqttNodeRedPublishSensor(sensors[sensor->type][sensor->address]);
+      if (sensor->value != theValue)
+      {
+         sensor->kind = "value";
+         sensor->value = theValue;
+         sensor->valid = true;
+         sensor->last = now;
       }
    }
+   else if (item.type == "AO")
+   {
+      if (sensor->value != item.value)
+      {
+         sensor->value = item.value;
+         sensor->valid = true;
+         sensor->last = now;
+      }
+   }
+   else if (sensor->state != (bool)item.value)
+   {
+      sensor->state = item.value;
+      sensor->valid = true;
+      sensor->last = now;
+   }
+}
 
-   sem->v();
-   selectActiveValueFacts->freeResult();
+//***************************************************************************
+// Update Controller State
+//   the state of the further controllers of a cascade, the state of the
+//   first one is checked by updateState()
+//***************************************************************************
+
+int P4d::updateControllerState(P4Controller* controller, time_t now)
+{
+   Fs::Status state;
+
+   if (controller->getState(&state) != success)
+      return fail;
+
+   auto update = [&](uint address, double value, const std::string& text)
+   {
+      auto it = sensors["UD"].find(P4Controller::toAddress(controller->getId(), address));
+
+      if (it == sensors["UD"].end())
+         return;
+
+      if (it->second.value != value || it->second.text != text)
+         it->second.last = now;
+
+      it->second.value = value;
+      it->second.text = text;
+      it->second.valid = true;
+   };
+
+   update(udState, state.state, state.stateinfo);
+   update(udMode, state.mode, state.modeinfo);
+   update(udTime, state.time, l2pTime(state.time, "%A, %d. %b. %Y %H:%M:%S"));
 
    return done;
 }
@@ -567,7 +664,7 @@ int P4d::doLoop()
       sem->p();
       serial->close();
       tell(eloAlways, "Error reading serial interface, reopen now!");
-      status = serial->open(ttyDevice);
+      status = serial->open(controllers[0]->getDevice());
       sem->v();
 
       if (status != success)
@@ -599,6 +696,7 @@ int P4d::doLoop()
 
 int P4d::updateState()
 {
+   cMetricTimer timer("loop_phase_seconds", "updateState");
    static time_t nextReportAt = 0;
 
    int status;
@@ -1414,26 +1512,70 @@ bool P4d::onCheckRights(long client, Event event, uint rights)
 //***************************************************************************
 
 int P4d::performPellets(json_t* oObject, long client)
+{
+   double stokerHours = sensors["VA"][0xad].value;
+
+   return postAsyncJson("pellets", client, [this, stokerHours](cDbWorker* worker, cJsonWriter* json)
+   {
+      return pellets2Json(worker, json, stokerHours);
+   });
+}
+
+//***************************************************************************
+// Pellets 2 Json - called in context of a db worker
+//***************************************************************************
+
+int P4d::pellets2Json(cDbWorker* worker, cJsonWriter* json, double stokerHours)
 {
    uint stokerHhLast {0};
    time_t timeLast {0};
    double tAmount {0.0};
    double tPrice {0.0};
-   json_t* oJson = json_array();
    double consumptionHLast {0.0};
 
+   cDbTable* tablePellets = worker->getTable("pellets");
+   cDbTable* tableSamples = worker->getTable("samples");
+
+   if (!tablePellets || !tableSamples)
+      return fail;
+
+   cDbStatement selectAllPellets(tablePellets);
+
+   selectAllPellets.build("select ");
+   selectAllPellets.bindAllOut();
+   selectAllPellets.build(" from %s", tablePellets->TableName());
+   selectAllPellets.build(" order by time");
+
+   // select min(value), time from samples
+   //    where address = ? type = ?
+   //     and time > ?
+
+   cDbValue minValue(&minValueDef);
+   cDbStatement selectStokerHours(tableSamples);
+
+   selectStokerHours.build("select ");
+   selectStokerHours.bindTextFree("min(value)", &minValue, "", cDBS::bndOut);
+   selectStokerHours.bind("TIME", cDBS::bndOut, ", ");
+   selectStokerHours.build(" from %s where ", tableSamples->TableName());
+   selectStokerHours.bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
+   selectStokerHours.bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
+   selectStokerHours.bindCmp(0, "TIME", 0, ">", " and ");
+
+   if (selectAllPellets.prepare() != success || selectStokerHours.prepare() != success)
+      return fail;
+
+   json->beginArray();
+
    tablePellets->clear();
 
-   for (int f = selectAllPellets->find(); f; f = selectAllPellets->fetch())
+   for (int f = selectAllPellets.find(); f; f = selectAllPellets.fetch())
    {
-      json_t* oData = json_object();
-      json_array_append_new(oJson, oData);
-
-      json_object_set_new(oData, "id", json_integer(tablePellets->getIntValue("ID")));
-      json_object_set_new(oData, "time", json_integer(tablePellets->getTimeValue("TIME")));
-      json_object_set_new(oData, "amount", json_integer(tablePellets->getIntValue("AMOUNT")));
-      json_object_set_new(oData, "price", json_real(tablePellets->getFloatValue("PRICE")));
-      json_object_set_new(oData, "comment", json_string(tablePellets->getStrValue("COMMENT")));
+      json->beginObject();
+      json->add("id", tablePellets->getIntValue("ID"));
+      json->add("time", tablePellets->getTimeValue("TIME"));
+      json->add("amount", tablePellets->getIntValue("AMOUNT"));
+      json->add("price", tablePellets->getFloatValue("PRICE"));
+      json->add("comment", tablePellets->getStrValue("COMMENT"));
 
       double amount = tablePellets->getIntValue("AMOUNT");
       tAmount += tablePellets->getIntValue("AMOUNT");
@@ -1447,16 +1589,17 @@ int P4d::performPellets(json_t* oObject, long client)
       tableSamples->setValue("ADDRESS", 0xad);
       tableSamples->setValue("TIME", tablePellets->getTimeValue("TIME"));
 
-      if (!selectStokerHours->find())
+      if (!selectStokerHours.find())
       {
          tell(eloAlways, "Info: Sample for stoker hours not found!");
+         json->endObject();
          continue;
       }
 
       if (timeLast)
       {
          uint durationDays = (tablePellets->getTimeValue("TIME") - timeLast) / tmeSecondsPerDay;
-         json_object_set_new(oData, "duration", json_integer(durationDays));
+         json->add("duration", durationDays);
       }
 
       uint stokerHh = minValue.getIntValue();   // is bound as int !!
@@ -1468,38 +1611,40 @@ int P4d::performPellets(json_t* oObject, long client)
       if (stokerHhLast && stokerHh-stokerHhLast > 0)
       {
          tell(eloAlways, "stokerHh delta => %d", stokerHh - stokerHhLast);
-         json_object_set_new(oData, "stokerHours", json_integer(stokerHh - stokerHhLast));
+         json->add("stokerHours", stokerHh - stokerHhLast);
          consumptionHLast = amount/(stokerHh-stokerHhLast);
-         json_object_set_new(oData, "consumptionH", json_real(consumptionHLast));
+         json->add("consumptionH", consumptionHLast);
       }
 
+      json->endObject();
+
       timeLast = tablePellets->getTimeValue("TIME");
       stokerHhLast = stokerHh;
    }
 
-   selectAllPellets->freeResult();
+   selectAllPellets.freeResult();
 
    double consumptionH = consumptionPerHour ? consumptionPerHour : consumptionHLast;
    char* hint;
    asprintf(&hint, "consumption sice tankering by %.2f kg / stoker hour", consumptionH);
    tell(eloAlways, "Calculating %s", hint);
 
-   json_t* oData = json_object();
-   json_array_append_new(oJson, oData);
-
-   json_object_set_new(oData, "id", json_integer(-1));
-   json_object_set_new(oData, "sum", json_boolean(true));
-   json_object_set_new(oData, "time", json_integer(time(0)));
-   json_object_set_new(oData, "amount", json_integer(tAmount));
-   json_object_set_new(oData, "price", json_real(tPrice));
-   json_object_set_new(oData, "comment", json_string("Total"));
-   json_object_set_new(oData, "consumptionHint", json_string(hint));
-   json_object_set_new(oData, "stokerHours", json_integer(sensors["VA"][0xad].value - stokerHhLast));
-   json_object_set_new(oData, "consumptionDelta", json_integer(consumptionH * (sensors["VA"][0xad].value-stokerHhLast)));
+   json->beginObject();
+   json->add("id", -1);
+   json->add("sum", true);
+   json->add("time", time(0));
+   json->add("amount", (long long)tAmount);
+   json->add("price", tPrice);
+   json->add("comment", "Total");
+   json->add("consumptionHint", hint);
+   json->add("stokerHours", (long long)(stokerHours - stokerHhLast));
+   json->add("consumptionDelta", (long long)(consumptionH * (stokerHours-stokerHhLast)));
+   json->endObject();
+   json->endArray();
 
    free(hint);
 
-   return pushOutMessage(oJson, "pellets", client);
+   return success;
 }
 
 //***************************************************************************
@@ -1601,15 +1746,38 @@ int P4d::performErrors(long client)
    if (client == 0)
       return done;
 
-   json_t* oJson = json_array();
+   return postAsyncJson("errors", client, [this](cDbWorker* worker, cJsonWriter* json)
+   {
+      return errors2Json(worker, json);
+   });
+}
+
+//***************************************************************************
+// Errors 2 Json - called in context of a db worker
+//***************************************************************************
+
+int P4d::errors2Json(cDbWorker* worker, cJsonWriter* json)
+{
+   cDbTable* tableErrors = worker->getTable("errors");
+
+   if (!tableErrors)
+      return fail;
+
+   cDbStatement selectAllErrors(tableErrors);
+
+   selectAllErrors.build("select ");
+   selectAllErrors.bindAllOut();
+   selectAllErrors.build(" from %s",  tableErrors->TableName());
+   selectAllErrors.build(" order by time1 desc");
+
+   if (selectAllErrors.prepare() != success)
+      return fail;
 
+   json->beginArray();
    tableErrors->clear();
 
-   for (int f = selectAllErrors->find(); f; f = selectAllErrors->fetch())
+   for (int f = selectAllErrors.find(); f; f = selectAllErrors.fetch())
    {
-      json_t* oData = json_object();
-      json_array_append_new(oJson, oData);
-
       time_t t = std::max(std::max(tableErrors->getTimeValue("TIME1"), tableErrors->getTimeValue("TIME4")), tableErrors->getTimeValue("TIME2"));
       std::string strTime = l2pTime(t);
       uint duration {0};
@@ -1619,17 +1787,18 @@ int P4d::performErrors(long client)
       else
          duration = tableErrors->getTimeValue("TIME2") - tableErrors->getTimeValue("TIME1");
 
-      json_object_set_new(oData, "state", json_string(tableErrors->getStrValue("STATE")));
-      json_object_set_new(oData, "text", json_string(tableErrors->getStrValue("TEXT")));
-      json_object_set_new(oData, "duration", json_integer(duration));
-      json_object_set_new(oData, "time", json_string(strTime.c_str()));
+      json->beginObject();
+      json->add("state", tableErrors->getStrValue("STATE"));
+      json->add("text", tableErrors->getStrValue("TEXT"));
+      json->add("duration", duration);
+      json->add("time", strTime);
+      json->endObject();
    }
 
-   selectAllErrors->freeResult();
-
-   pushOutMessage(oJson, "errors", client);
+   json->endArray();
+   selectAllErrors.freeResult();
 
-   return done;
+   return success;
 }
 
 //***************************************************************************
@@ -1913,8 +2082,11 @@ int P4d::performMenu(json_t* oObject, long client)
    if (oObject)
       parent = getIntFromJson(oObject, "parent", 1);
 
-   json_t* oJson = json_object();
-   json_t* oArray = json_array();
+   cJsonWriter json(cWebSock::sizeLwsPreFrame);
+
+   beginMessage(&json, "menu");
+   json.beginObject();
+   json.beginArray("items");
 
    tableMenu->clear();
    tableMenu->setValue("CHILD", parent);
@@ -1964,28 +2136,27 @@ int P4d::performMenu(json_t* oObject, long client)
 
       if (!timeGroup)
       {
-         json_t* oData = json_object();
-         json_array_append_new(oArray, oData);
-
-         json_object_set_new(oData, "id", json_integer(tableMenu->getIntValue("ID")));
-         json_object_set_new(oData, "parent", json_integer(tableMenu->getIntValue("PARENT")));
-         json_object_set_new(oData, "child", json_integer(child));
-         json_object_set_new(oData, "type", json_integer(type));
-         json_object_set_new(oData, "address", json_integer(address));
-         json_object_set_new(oData, "title", json_string(title));
-         json_object_set_new(oData, "unit", json_string(tableMenu->getStrValue("UNIT")));
-         json_object_set_new(oData, "range", json_integer(na));
-         json_object_set_new(oData, "parent", json_integer(parent));
-         json_object_set_new(oData, "digits", json_integer(digits));
+         json.beginObject();
+         json.add("id", tableMenu->getIntValue("ID"));
+         json.add("parent", parent);
+         json.add("child", child);
+         json.add("type", type);
+         json.add("address", address);
+         json.add("title", title);
+         json.add("unit", tableMenu->getStrValue("UNIT"));
+         json.add("range", na);
+         json.add("digits", digits);
 
          if (type == mstMesswert || type == mstMesswert1)
-            json_object_set_new(oData, "value", json_real(sensors["VA"][address].value));
+            json.add("value", sensors["VA"][address].value);
          else
-            json_object_set_new(oData, "value", json_string(tableMenu->getStrValue("VALUE")));
+            json.add("value", tableMenu->getStrValue("VALUE"));
 
          if (type == mstPar || type == mstParSet || type == mstParSet1 || type == mstParSet2 ||
              type == mstParDig || type == mstParZeit)
-            json_object_set_new(oData, "editable", json_boolean(true));
+            json.add("editable", true);
+
+         json.endObject();
       }
 
       else
@@ -2012,17 +2183,15 @@ int P4d::performMenu(json_t* oObject, long client)
             tableTimeRanges->clear();
             tableTimeRanges->setValue("ADDRESS", trAddr);
 
-            json_t* oData = json_object();
-            json_array_append_new(oArray, oData);
-
-            json_object_set_new(oData, "id", json_integer(0));
-            json_object_set_new(oData, "parent", json_integer(0));
-            json_object_set_new(oData, "child", json_integer(0));
-            json_object_set_new(oData, "type", json_integer(0));
-            json_object_set_new(oData, "address", json_integer(0));
-            json_object_set_new(oData, "title", json_string(dayTitle));
-            json_object_set_new(oData, "unit", json_string(""));
-            json_object_set_new(oData, "parent", json_integer(parent));
+            json.beginObject();
+            json.add("id", 0);
+            json.add("parent", parent);
+            json.add("child", 0);
+            json.add("type", 0);
+            json.add("address", 0);
+            json.add("title", dayTitle);
+            json.add("unit", "");
+            json.endObject();
 
             free(dayTitle);
 
@@ -2040,20 +2209,18 @@ int P4d::performMenu(json_t* oObject, long client)
                   asprintf(&to, "to%d", n);
                   asprintf(&value, "%s - %s", tableTimeRanges->getStrValue(from), tableTimeRanges->getStrValue(to));
 
-                  json_t* oData = json_object();
-                  json_array_append_new(oArray, oData);
-
-                  json_object_set_new(oData, "id", json_integer(0));
-                  json_object_set_new(oData, "range", json_integer(n));
-                  json_object_set_new(oData, "parent", json_integer(0));
-                  json_object_set_new(oData, "child", json_integer(0));
-                  json_object_set_new(oData, "type", json_integer(0));
-                  json_object_set_new(oData, "address", json_integer(trAddr));
-                  json_object_set_new(oData, "title", json_string(rTitle));
-                  json_object_set_new(oData, "unit", json_string(""));
-                  json_object_set_new(oData, "value", json_string(value));
-                  json_object_set_new(oData, "editable", json_boolean(true));
-                  json_object_set_new(oData, "parent", json_integer(parent));
+                  json.beginObject();
+                  json.add("id", 0);
+                  json.add("range", n);
+                  json.add("parent", parent);
+                  json.add("child", 0);
+                  json.add("type", 0);
+                  json.add("address", trAddr);
+                  json.add("title", rTitle);
+                  json.add("unit", "");
+                  json.add("value", value);
+                  json.add("editable", true);
+                  json.endObject();
 
                   free(rTitle);
                   free(value);
@@ -2071,24 +2238,35 @@ int P4d::performMenu(json_t* oObject, long client)
 
    selectMenuItemsByParent->freeResult();
 
-   json_object_set_new(oJson, "items", oArray);
-   json_object_set_new(oJson, "parent", json_integer(parent));
-   json_object_set_new(oJson, "last", json_integer(last));
-   json_object_set_new(oJson, "title", json_string(title));
+   json.endArray();
+   json.add("parent", parent);
+   json.add("last", last);
+   json.add("title", title);
+   json.endObject();
 
-   pushOutMessage(oJson, "menu", client);
+   free(title);
 
-   return done;
+   return pushOutMessage(&json, "menu", client);
 }
 
 //***************************************************************************
 // Update Value Facts
 //***************************************************************************
 
+static const char* ioTypeOf(int structType)
+{
+   switch (structType)
+   {
+      case Fs::mstDigOut: return "DO";
+      case Fs::mstDigIn:  return "DI";
+      case Fs::mstAnlOut: return "AO";
+   }
+
+   return nullptr;
+}
+
 int P4d::initValueFacts(bool truncate)
 {
-   int status {success};
-   Fs::ValueSpec v;
    int count {0};
    int added {0};
    int modified {0};
@@ -2107,139 +2285,193 @@ int P4d::initValueFacts(bool truncate)
       tableValueFacts->truncate();
 
    // ---------------------------------
-   // Add the sensor definitions delivered by the S 3200
+   // Add the sensor definitions delivered by the S 3200 (each of the cascade)
 
-   for (status = request->getFirstValueSpec(&v); status != Fs::wrnLast; status = request->getNextValueSpec(&v))
+   for (auto controller : controllers)
    {
-      if (status != success)
-         continue;
+      if (initControllerValueFacts(controller) != success && controller->getId() == 0)
+         return fail;
+   }
 
-      tell(eloDebug, "%3d) 0x%04x '%s' %d '%s' (%04d) '%s'",
-           count, v.address, v.name, v.factor, v.unit, v.type, v.description);
+   // ---------------------------------
+   // add default for digital outputs (of the first controller, the lines of
+   //   the further ones are added by initControllerValueFacts())
 
-      int res = addValueFact(v.address, "VA", v.factor, v.name,
-                             strcmp(v.unit, "°") == 0 ? "°C" : v.unit,
-                             v.description);
+   for (int f = selectAllMenuItems->find(); f; f = selectAllMenuItems->fetch())
+   {
+      char* name {nullptr};
+      const char* type = ioTypeOf(tableMenu->getIntValue("TYPE"));
+      std::string sname = tableMenu->getStrValue("TITLE");
 
-      // set special value SUBTYPE for valuefact
+      if (!type)
+         continue;
 
-      tableValueFacts->clear();
-      tableValueFacts->setValue("ADDRESS", v.address);
-      tableValueFacts->setValue("TYPE", "VA");
+      removeCharsExcept(sname, nameChars);
+      asprintf(&name, "%s_0x%x", sname.c_str(), (int)tableMenu->getIntValue("ADDRESS"));
 
-      tableValueFacts->find();
-      tableValueFacts->setValue("SUBTYPE", v.type);
-      tableValueFacts->store();
+      const char* unit = tableMenu->getStrValue("UNIT");
 
-      count++;
+      if (isEmpty(unit) && strcmp(type, "AO") == 0)
+         unit = "%";
+
+      int res = addValueFact(tableMenu->getIntValue("ADDRESS"), type, 1, name, unit,
+                             tableMenu->getStrValue("TITLE"));
 
       if (res == 1)
          added++;
       else if (res == 2)
          modified++;
+
+      free(name);
+      count++;
    }
 
-   tell(eloAlways, "Read %d value facts, modified %d and added %d", count, modified, added);
+   selectAllMenuItems->freeResult();
+   tell(eloAlways, "Checked %d digital lines, added %d, modified %d", count, added, modified);
 
-   // count = 0;
-   // tell(eloAlways, "Update example value of table valuefacts");
+   invalidateInitPayload("valuefacts");
 
-   // for (int f = selectAllValueFacts->find(); f; f = selectAllValueFacts->fetch())
-   // {
-   //    if (!tableValueFacts->hasValue("TYPE", "VA"))
-   //       continue;
+   return success;
+}
 
-   //    Value v(tableValueFacts->getIntValue("ADDRESS"));
+//***************************************************************************
+// Init Controller Value Facts
+//   the values and the user defined state facts of one S-3200, the facts
+//   of the further controllers of a cascade get the number of the
+//   controller in name and title
+//***************************************************************************
 
-   //    if ((status = request->getValue(&v)) != success)
-   //    {
-   //       tell(eloAlways, "Getting value 0x%04x failed, error %d", v.address, status);
-   //       continue;
-   //    }
+int P4d::initControllerValueFacts(P4Controller* controller)
+{
+   int status {success};
+   Fs::ValueSpec v;
+   int count {0};
+   int added {0};
+   int modified {0};
+   uint id = controller->getId();
+   P4Request* req = controller->getRequest();
 
-   //    double factor = tableValueFacts->getIntValue("FACTOR");
-   //    int dataType = tableValueFacts->getIntValue("SUBTYPE");
-   //    int value = dataType == 1 ? (word)v.value : (sword)v.value;
-   //    double theValue = value / factor;
-   //    tableValueFacts->setValue("VALUE", theValue);
-   //    tableValueFacts->update();
-   //    count++;
-   // }
+   auto nameOf = [id](const char* name) -> std::string
+   {
+      return id ? "K" + std::to_string(id+1) + "_" + name : name;
+   };
 
-   // selectAllValueFacts->freeResult();
-   // tell(eloAlways, "Updated %d example values", count);
+   auto titleOf = [id](const char* title) -> std::string
+   {
+      return id ? std::string(title) + " (Kessel " + std::to_string(id+1) + ")" : title;
+   };
 
-   // ---------------------------------
-   // add default for digital outputs
+   auto findFact = [this, id](uint address, const char* type)
+   {
+      tableValueFacts->clear();
+      tableValueFacts->setValue("ADDRESS", (int)P4Controller::toAddress(id, address));
+      tableValueFacts->setValue("TYPE", type);
+      tableValueFacts->find();
+      tableValueFacts->setValue("CONTROLLER", (int)id);
+   };
 
-   added = 0;
-   count = 0;
-   modified = 0;
+   controller->getSem()->p();
 
-   for (int f = selectAllMenuItems->find(); f; f = selectAllMenuItems->fetch())
+   if (id && req->check() != success)
    {
-      char* name {nullptr};
-      const char* type {nullptr};
-      int structType = tableMenu->getIntValue("TYPE");
-      std::string sname = tableMenu->getStrValue("TITLE");
-
-      switch (structType)
-      {
-         case mstDigOut: type = "DO"; break;
-         case mstDigIn:  type = "DI"; break;
-         case mstAnlOut: type = "AO"; break;
-      }
+      tell(eloAlways, "Error: Controller %u at '%s' not responding, skipping its value facts", id, controller->getDevice());
+      controller->getSem()->v();
+      return fail;
+   }
 
-      if (!type)
+   for (status = req->getFirstValueSpec(&v); status != Fs::wrnLast; status = req->getNextValueSpec(&v))
+   {
+      if (status != success)
          continue;
 
-      removeCharsExcept(sname, nameChars);
-      asprintf(&name, "%s_0x%x", sname.c_str(), (int)tableMenu->getIntValue("ADDRESS"));
+      tell(eloDebug, "%3d) 0x%04x '%s' %d '%s' (%04d) '%s'",
+           count, v.address, v.name, v.factor, v.unit, v.type, v.description);
 
-      const char* unit = tableMenu->getStrValue("UNIT");
+      int res = addValueFact(P4Controller::toAddress(id, v.address), "VA", v.factor, nameOf(v.name).c_str(),
+                             strcmp(v.unit, "°") == 0 ? "°C" : v.unit,
+                             titleOf(v.description).c_str());
 
-      if (isEmpty(unit) && strcmp(type, "AO") == 0)
-         unit = "%";
+      // set special value SUBTYPE for valuefact
 
-      int res = addValueFact(tableMenu->getIntValue("ADDRESS"), type, 1, name, unit,
-                             tableMenu->getStrValue("TITLE"));
+      findFact(v.address, "VA");
+      tableValueFacts->setValue("SUBTYPE", v.type);
+      tableValueFacts->store();
+
+      count++;
 
       if (res == 1)
          added++;
       else if (res == 2)
          modified++;
+   }
 
-      free(name);
-      count++;
+   tell(eloAlways, "Read %d value facts of controller %u, modified %d and added %d", count, id, modified, added);
+
+   // the digital lines of the further controllers from their menu, the menu
+   //   table holds only the one of the first controller
+
+   if (id)
+   {
+      Fs::MenuItem m;
+
+      count = added = modified = 0;
+
+      for (status = req->getFirstMenuItem(&m); status != Fs::wrnLast && !doShutDown(); status = req->getNextMenuItem(&m))
+      {
+         if (status == wrnSkip)
+            continue;
+
+         if (status != success)
+            break;
+
+         const char* type = ioTypeOf(m.type);
+
+         if (!type)
+            continue;
+
+         char* name {nullptr};
+         const char* title = !isEmpty(m.description) ? m.description : "";
+         const char* unit = !isEmpty(m.unit) ? m.unit : m.type == mstAnlOut ? "%" : "";
+         std::string sname = title;
+
+         removeCharsExcept(sname, nameChars);
+         asprintf(&name, "%s_0x%x", sname.c_str(), m.address);
+
+         int res = addValueFact(P4Controller::toAddress(id, m.address), type, 1, nameOf(name).c_str(),
+                                unit, titleOf(title).c_str());
+
+         findFact(m.address, type);
+         tableValueFacts->store();
+
+         if (res == 1)
+            added++;
+         else if (res == 2)
+            modified++;
+
+         free(name);
+         count++;
+      }
+
+      tell(eloAlways, "Checked %d digital lines of controller %u, added %d, modified %d", count, id, added, modified);
    }
 
-   selectAllMenuItems->freeResult();
-   tell(eloAlways, "Checked %d digital lines, added %d, modified %d", count, added, modified);
+   controller->getSem()->v();
 
    // ---------------------------------
    // add value definitions for special data
 
-   addValueFact(udState, "UD", 1, "Status", "zst", "Heizungsstatus");
-   tableValueFacts->clear();
-   tableValueFacts->setValue("ADDRESS", udState);      // 1  -> Kessel Status
-   tableValueFacts->setValue("TYPE", "UD");            // UD -> User Defined
-   tableValueFacts->find();
+   addValueFact(P4Controller::toAddress(id, udState), "UD", 1, nameOf("Status").c_str(), "zst", titleOf("Heizungsstatus").c_str());
+   findFact(udState, "UD");                   // 1  -> Kessel Status
    tableValueFacts->setValue("STATE", "A");
    tableValueFacts->store();
 
-   addValueFact(udMode, "UD", 1, "Betriebsmodus", "txt", "Betriebsmodus");
-   tableValueFacts->clear();
-   tableValueFacts->setValue("ADDRESS", udMode);       // 2  -> Kessel Mode
-   tableValueFacts->setValue("TYPE", "UD");            // UD -> User Defined
-   tableValueFacts->find();
+   addValueFact(P4Controller::toAddress(id, udMode), "UD", 1, nameOf("Betriebsmodus").c_str(), "txt", titleOf("Betriebsmodus").c_str());
+   findFact(udMode, "UD");                    // 2  -> Kessel Mode
    tableValueFacts->setValue("STATE", "A");
    tableValueFacts->store();
 
-   addValueFact(udTime, "UD", 1, "Uhrzeit", "txt", "Datum Uhrzeit der Heizung");
-   tableValueFacts->clear();
-   tableValueFacts->setValue("ADDRESS", udTime);       // 3  -> Kessel Zeit
-   tableValueFacts->setValue("TYPE", "UD");            // UD -> User Defined
-   tableValueFacts->find();
+   addValueFact(P4Controller::toAddress(id, udTime), "UD", 1, nameOf("Uhrzeit").c_str(), "txt", titleOf("Datum Uhrzeit der Heizung").c_str());
+   findFact(udTime, "UD");                    // 3  -> Kessel Zeit
    tableValueFacts->setValue("STATE", "A");
    tableValueFacts->store();
 
@@ -9,7 +9,7 @@
 #pragma once
 
 #include "daemon.h"
-#include "p4io.h"
+#include "controller.h"
 
 //***************************************************************************
 // Class P4d
@@ -50,6 +50,8 @@ class P4d : public Daemon, public FroelingService
       int atMeanwhile() override;
 
       int updateSensors() override;
+      void applyPolledItem(const P4Controller::Item& item, time_t now);
+      int updateControllerState(P4Controller* controller, time_t now);
       void afterUpdate() override;
       int updateErrors();
       int doLoop() override;
@@ -72,7 +74,9 @@ class P4d : public Daemon, public FroelingService
       int updateParameter(cDbTable* tableMenu);
       int calcStateDuration();
 
+      int initControllers(bool initial);
       int initValueFacts(bool truncate = false);
+      int initControllerValueFacts(P4Controller* controller);
       const char* getTextImage(const char* key, const char* text) override;
 
       // WS request
@@ -82,9 +86,11 @@ class P4d : public Daemon, public FroelingService
    // int performInitTables(json_t* oObject, long client);
    // int performUpdateTimeRanges(json_t* array, long client);
       int performPellets(json_t* array, long client);
+      int pellets2Json(cDbWorker* worker, cJsonWriter* json, double stokerHours);
       int performPelletsAdd(json_t* array, long client);
       int performCommand(json_t* obj, long client) override;
       int performErrors(long client);
+      int errors2Json(cDbWorker* worker, cJsonWriter* json);
       int performMenu(json_t* oObject, long client);
       int performParEditRequest(json_t* oObject, long client);
       int performTimeParEditRequest(json_t* oObject, long client);
@@ -99,6 +105,7 @@ class P4d : public Daemon, public FroelingService
 
       int stateCheckInterval {10};
       char* ttyDevice {nullptr};
+      char* serialCapture {nullptr};
 
       int tSync {no};
       int maxTimeLeak {10};
@@ -114,20 +121,17 @@ class P4d : public Daemon, public FroelingService
       cDbTable* tableErrors {nullptr};
       cDbTable* tableTimeRanges {nullptr};
 
-      cDbValue minValue;
       cDbValue endTime;
 
       cDbStatement* selectAllMenuItems {nullptr};
       cDbStatement* selectMenuItemsByParent {nullptr};
       cDbStatement* selectMenuItemsByChild {nullptr};
-      cDbStatement* selectAllErrors {nullptr};
       cDbStatement* selectPendingErrors {nullptr};
 
-      cDbStatement* selectAllPellets {nullptr};
-      cDbStatement* selectStokerHours {nullptr};
       cDbStatement* selectStateDuration {nullptr};
 
-      Sem* sem {nullptr};
+      std::vector<P4Controller*> controllers;   // the S-3200 of the cascade
+      Sem* sem {nullptr};                       // sem, request and serial of the first controller
       P4Request* request {nullptr};
       Serial* serial {nullptr};
       Status currentState;
@@ -6,7 +6,6 @@
 // Date 04.11.2010 - 07.02.2014  Jörg Wendel
 //***************************************************************************
 
-#include <signal.h>
 #include <dirent.h>
 #include <vector>
 #include <numeric>
@@ -78,148 +77,356 @@ int W1::scan()
          tell(eloAlways, "One Wire Sensor '%s' attached", dp->d_name);
          sensors[dp->d_name].value = 0;
          sensors[dp->d_name].active = true;
+         applyResolution(dp->d_name);
       }
       else if (!sensors[dp->d_name].active)
       {
          tell(eloAlways, "One Wire Sensor '%s' activated again", dp->d_name);
          sensors[dp->d_name].value = 0;
          sensors[dp->d_name].active = true;
+         applyResolution(dp->d_name);
       }
    }
 
    closedir(dir);
 
+   scanMasters();
+
    return done;
 }
 
 //***************************************************************************
-// Action
+// Scan Masters
+//   the bus masters and which sensor is attached to which master
 //***************************************************************************
 
-int W1::loop()
+int W1::scanMasters()
 {
-   const int updateCycle {10};   // seconds
+   DIR* dir {nullptr};
+   dirent* dp {nullptr};
 
-   while (!doShutDown())
+   if (!(dir = opendir(w1Path)))
+      return fail;
+
+   while ((dp = readdir(dir)))
    {
-      time_t nextAt = time(0) + updateCycle;
-      update();
+      if (!strstr(dp->d_name, "w1_bus_master"))
+         continue;
 
-      while (!doShutDown() && time(0) < nextAt)
-         sleep(1);
+      char* path {nullptr};
+      asprintf(&path, "%s/%s/therm_bulk_read", w1Path, dp->d_name);
+      bool bulk = fileExists(path);
+      free(path);
+
+      if (masters.find(dp->d_name) == masters.end())
+         tell(eloAlways, "One Wire bus master '%s' found, bulk conversion %ssupported", dp->d_name, bulk ? "" : "not ");
+
+      masters[dp->d_name] = bulk;
+
+      // the slaves of the master are listed in w1_master_slaves
+
+      std::vector<std::string> slaves;
+
+      asprintf(&path, "%s/%s/w1_master_slaves", w1Path, dp->d_name);
+      loadLinesFromFile(path, slaves);
+      free(path);
+
+      for (const auto& slave : slaves)
+      {
+         if (sensors.find(slave) != sensors.end())
+            sensors[slave].master = dp->d_name;
+      }
    }
 
+   closedir(dir);
+
    return done;
 }
 
 //***************************************************************************
-// Update
+// Set Resolutions
+//   comma separated list of '<sensor>:<bits>', a entry without sensor is
+//   taken for all sensors - e.g. '10' or '28-0316a279b9ff:12,11'
 //***************************************************************************
 
-int W1::update()
+int W1::setResolutions(const char* spec)
 {
-   tell(eloDetail, "Updating ...");
+   for (const auto& entry : split(spec, ','))
+   {
+      std::string e = strReplace(" ", "", entry);
+      size_t pos = e.find(':');
+      int bits = atoi(pos == std::string::npos ? e.c_str() : e.c_str() + pos + 1);
 
-   scan();
+      if (bits < 9 || bits > 12)
+      {
+         tell(eloAlways, "Warning: Ignoring invalid resolution '%s', expected 9-12 bit", e.c_str());
+         continue;
+      }
 
-   uint count {0};
-   json_t* oJson = json_array();
+      if (pos == std::string::npos)
+         defaultResolution = bits;
+      else
+         resolutions[e.substr(0, pos)] = bits;
+   }
 
-   for (auto it = sensors.begin(); it != sensors.end(); it++)
+   return done;
+}
+
+//***************************************************************************
+// Apply Resolution
+//***************************************************************************
+
+int W1::applyResolution(const char* name)
+{
+   auto it = resolutions.find(name);
+   int bits = it != resolutions.end() ? it->second : defaultResolution;
+
+   if (bits == na)
+      return done;
+
+   char* path {nullptr};
+   asprintf(&path, "%s/%s/resolution", w1Path, name);
+
+   FILE* out = fopen(path, "w");
+
+   if (!out || fprintf(out, "%d\n", bits) < 0 || fclose(out) != 0)
    {
-      char line[100+TB];
-      FILE* in {nullptr};
-      char* path {nullptr};
+      tell(eloAlways, "Error: Setting resolution of '%s' to %d bit failed, error was '%s'", name, bits, strerror(errno));
+      free(path);
+      return fail;
+   }
 
-      if (!it->second.active)
+   tell(eloAlways, "Resolution of One Wire Sensor '%s' set to %d bit", name, bits);
+   free(path);
+
+   return success;
+}
+
+//***************************************************************************
+// Trigger Bulk Conversion
+//   start the conversion of all sensors of the masters supporting it and
+//   wait until they are done, the following reads return the values
+//   without starting a own conversion
+//***************************************************************************
+
+int W1::triggerBulkConversion()
+{
+   const int maxConversionTime {1000};   // [ms] 750ms for 12 bit
+   std::vector<std::string> triggered;
+
+   for (const auto& m : masters)
+   {
+      if (!m.second)
          continue;
 
-      asprintf(&path, "%s/%s/w1_slave", w1Path, it->first.c_str());
+      char* path {nullptr};
+      asprintf(&path, "%s/%s/therm_bulk_read", w1Path, m.first.c_str());
+
+      FILE* out = fopen(path, "w");
+
+      if (out && fputs("trigger\n", out) >= 0 && fclose(out) == 0)
+         triggered.push_back(path);
+      else
+         tell(eloAlways, "Error: Triggering bulk conversion at '%s' failed, error was '%s'", path, strerror(errno));
 
-      tell(eloDetail, "Query '%s'", it->first.c_str());
+      free(path);
+   }
+
+   // therm_bulk_read is -1 while a conversion is in progress
 
-      if (!(in = fopen(path, "r")))
+   for (const auto& path : triggered)
+   {
+      for (int ms = 0; ms < maxConversionTime; ms += 50)
       {
-         tell(eloAlways, "Error: Opening '%s' failed, error was '%s'", path, strerror(errno));
-         tell(eloAlways, "One Wire Sensor '%s' seems to be detached, removing it", path);
-         it->second.active = false;
-         free(path);
-         continue;
+         int state {0};
+         FILE* in = fopen(path.c_str(), "r");
+
+         if (in && fscanf(in, "%d", &state) != 1)
+            state = 0;
+
+         if (in)
+            fclose(in);
+
+         if (state != -1)
+            break;
+
+         usleep(50000);
       }
+   }
 
-      while (fgets(line, 100, in))
-      {
-         char* p;
-         line[strlen(line)-1] = 0;
+   return triggered.empty() ? done : success;
+}
+
+//***************************************************************************
+// Read Sensor
+//***************************************************************************
+
+int W1::readSensor(const char* name, double& value)
+{
+   char line[100+TB];
+   FILE* in {nullptr};
+   char* path {nullptr};
+   int status {fail};
+
+   asprintf(&path, "%s/%s/w1_slave", w1Path, name);
+
+   tell(eloDetail, "Query '%s'", name);
 
-         if (strstr(line, " crc="))
+   if (!(in = fopen(path, "r")))
+   {
+      tell(eloAlways, "Error: Opening '%s' failed, error was '%s'", path, strerror(errno));
+      tell(eloAlways, "One Wire Sensor '%s' seems to be detached, removing it", path);
+      sensors[name].active = false;
+      free(path);
+      return fail;
+   }
+
+   while (fgets(line, 100, in))
+   {
+      char* p;
+      line[strlen(line)-1] = 0;
+
+      if (strstr(line, " crc="))
+      {
+         if (!strstr(line, " YES"))
          {
-            if (!strstr(line, " YES"))
-            {
-               tell(eloAlways, "Error: CRC check for '%s' failed in [%s], skipping sample", it->first.c_str(), line);
-               break;
-            }
+            tell(eloAlways, "Error: CRC check for '%s' failed in [%s], skipping sample", name, line);
+            break;
          }
+      }
 
-         else if ((p = strstr(line, " t=")))
+      else if ((p = strstr(line, " t=")))
+      {
+         value = atoi(p+3) / 1000.0;
+
+         if (value == 85 || value == -85)
          {
-            double value = atoi(p+3) / 1000.0;
+            // at error we get sometimes +85 or -85 from the sensor
 
-            if (value == 85 || value == -85)
-            {
-               // at error we get sometimes +85 or -85 from the sensor
+            tell(eloAlways, "Error: Ignoring invalid value (%0.2f) of w1 sensor '%s'", value, name);
+            break;
+         }
 
-               tell(eloAlways, "Error: Ignoring invalid value (%0.2f) of w1 sensor '%s'", value, it->first.c_str());
-               break;
-            }
+         status = success;
+      }
+   }
+
+   fclose(in);
+   free(path);
+
+   return status;
+}
+
+//***************************************************************************
+// Action
+//***************************************************************************
+
+int W1::loop()
+{
+   const int updateCycle {10};   // seconds
+
+   while (!doShutDown())
+   {
+      time_t nextAt = time(0) + updateCycle;
+      update();
+
+      while (!doShutDown() && time(0) < nextAt)
+         sleep(1);
+   }
+
+   return done;
+}
 
-            if (sensors[it->first].values.size() >= 3)
-            {
-               double sum = std::accumulate(sensors[it->first].values.cbegin(), sensors[it->first].values.cend(), 0);
-               double average = sum / sensors[it->first].values.size();
-               double delta = std::abs(average - value);
+//***************************************************************************
+// Read
+//   scan the bus and read all active sensors
+//***************************************************************************
 
-               tell(eloDetail, "Info: %s : %0.2f, the average of the last %zd samples is %0.2f (delta is %0.2f)",
-                    it->first.c_str(), value, sensors[it->first].values.size(), average, average - value);
+int W1::read(SampleList& samples)
+{
+   scan();
 
-               if (delta > 5)
-                  tell(eloDetail, "Warning: delta %0.2f", delta);
-            }
+   // with bulk conversion all sensors of a master convert at once,
+   //   otherwise each read starts its own conversion
 
-            if (sensors[it->first].values.size() >= 3)
-               sensors[it->first].values.erase(sensors[it->first].values.begin());
+   triggerBulkConversion();
 
-            sensors[it->first].values.push_back(value);
-            sensors[it->first].value = value;
+   for (auto it = sensors.begin(); it != sensors.end(); it++)
+   {
+      double value {0};
 
-            json_t* ojData = json_object();
-            json_array_append_new(oJson, ojData);
-            count++;
+      if (!it->second.active)
+         continue;
+
+      bool bulk = masters.find(it->second.master) != masters.end() && masters[it->second.master];
+
+      if (readSensor(it->first.c_str(), value) == success)
+      {
+         if (it->second.values.size() >= 3)
+         {
+            double sum = std::accumulate(it->second.values.cbegin(), it->second.values.cend(), 0);
+            double average = sum / it->second.values.size();
+            double delta = std::abs(average - value);
 
-            json_object_set_new(ojData, "name", json_string(it->first.c_str()));
-            json_object_set_new(ojData, "value", json_real(value));
-            json_object_set_new(ojData, "time", json_integer(time(0)));
+            tell(eloDetail, "Info: %s : %0.2f, the average of the last %zd samples is %0.2f (delta is %0.2f)",
+                 it->first.c_str(), value, it->second.values.size(), average, average - value);
 
-            tell(eloDebug, "%s : %0.2f", it->first.c_str(), value);
+            if (delta > 5)
+               tell(eloDetail, "Warning: delta %0.2f", delta);
          }
-      }
 
-      fclose(in);
-      free(path);
+         if (it->second.values.size() >= 3)
+            it->second.values.erase(it->second.values.begin());
+
+         it->second.values.push_back(value);
+         it->second.value = value;
+
+         samples.push_back({it->first, value, time(0)});
+
+         tell(eloDebug, "%s : %0.2f", it->first.c_str(), value);
+      }
 
       // take a breath .. due to a forum post we wait 1 second:
       //   -> "jede Lesung am Bus zieht die Leitungen runter und da alle Sensoren am selben Bus hängen, deswegen min. 1s zwischen den Lesungen"
+      // not needed after a bulk conversion, then we only read the scratchpad
 
-      sleep(1);
+      if (!bulk)
+         sleep(1);
    }
 
+   return done;
+}
+
+//***************************************************************************
+// Update
+//***************************************************************************
+
+int W1::update()
+{
+   tell(eloDetail, "Updating ...");
+
+   SampleList samples;
+   read(samples);
+
    if (mqttConnection() != success)
       return fail;
 
+   json_t* oJson = json_array();
+
+   for (const auto& sample : samples)
+   {
+      json_t* ojData = json_object();
+      json_array_append_new(oJson, ojData);
+
+      json_object_set_new(ojData, "name", json_string(sample.name.c_str()));
+      json_object_set_new(ojData, "value", json_real(sample.value));
+      json_object_set_new(ojData, "time", json_integer(sample.time));
+   }
+
    char* p = json_dumps(oJson, JSON_REAL_PRECISION(4));
    json_decref(oJson);
 
-   if (count)
+   if (samples.size())
       mqttW1Writer->writeRetained(mqttTopic, p);
    else
       mqttW1Writer->write(mqttPingTopic, "{\"ping\" : true }");
@@ -255,93 +462,62 @@ int W1::mqttConnection()
 }
 
 //***************************************************************************
-// Main
+// Class cW1Reader
 //***************************************************************************
 
-int main(int argc, char** argv)
+cW1Reader::cW1Reader(const char* aResolutions)
+   : cThread("w1-reader")
 {
-   W1* job;
-   int nofork = no;
-   int pid;
-   int _stdout = na;
-   Eloquence _eloquence {eloAlways};
-   const char* url = "tcp://localhost:1883";
-
-   logstdout = yes;
-
-   // Usage ..
+   if (!isEmpty(aResolutions))
+      w1.setResolutions(aResolutions);
+}
 
-   if (argc > 1 && (argv[1][0] == '?' || (strcmp(argv[1], "-h") == 0) || (strcmp(argv[1], "--help") == 0)))
-   {
-      // showUsage(argv[0]);  // to be implemented!
-      return 0;
-   }
+cW1Reader::~cW1Reader()
+{
+   stop();
+}
 
-   // Parse command line
+int cW1Reader::stop()
+{
+   Cancel(5);
 
-   for (int i = 0; argv[i]; i++)
-   {
-      if (argv[i][0] != '-' || strlen(argv[i]) != 2)
-         continue;
+   return done;
+}
 
-      switch (argv[i][1])
-      {
-         case 'u': url = argv[i+1];                         break;
-         case 'l': if (argv[i+1]) _eloquence = (Eloquence)atoi(argv[i+1]); break;
-         case 't': _stdout = yes;                           break;
-         case 'n': nofork = yes;                            break;
-      }
-   }
+//***************************************************************************
+// Fetch - take over the samples read since the last call
+//***************************************************************************
 
-   if (_stdout != na)
-      logstdout = _stdout;
-   else
-      logstdout = no;
+int cW1Reader::fetch(W1::SampleList& samples)
+{
+   cMyMutexLock lock(&mutex);
 
-   // read configuration ..
+   if (pending.empty())
+      return no;
 
-   // if (readConfig() != success)
-   //    return 1;
+   samples.swap(pending);
+   pending.clear();
 
-   eloquence = _eloquence;
+   return yes;
+}
 
-   job = new W1(url);
+//***************************************************************************
+// Action
+//***************************************************************************
 
-   if (job->init() != success)
+void cW1Reader::action()
+{
+   while (Running())
    {
-      printf("Initialization failed, see syslog for details\n");
-      delete job;
-      return 1;
-   }
+      W1::SampleList samples;
+      time_t nextAt = time(0) + updateCycle;
 
-   // fork daemon
+      w1.read(samples);
 
-   if (!nofork)
-   {
-      if ((pid = fork()) < 0)
-      {
-         printf("Can't fork daemon, %s\n", strerror(errno));
-         return 1;
-      }
+      cMyMutexLock lock(&mutex);
+      pending.insert(pending.end(), samples.begin(), samples.end());
 
-      if (pid != 0)
-         return 0;
+      while (Running() && time(0) < nextAt)
+         waitCondition.TimedWait(mutex, 1000);
    }
-
-   // register SIGINT
-
-   ::signal(SIGINT, W1::downF);
-   ::signal(SIGTERM, W1::downF);
-
-   // do work ...
-
-   job->loop();
-
-   // shutdown
-
-   tell(eloAlways, "shutdown");
-
-   delete job;
-
-   return 0;
 }
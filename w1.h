@@ -13,6 +13,7 @@
 #include <limits>
 
 #include "lib/common.h"
+#include "lib/thread.h"
 #include "lib/mqtt.h"
 
 // #define W1_UDEF std::numeric_limits<double>::max()
@@ -30,19 +31,30 @@ class W1
          double value;
          std::vector<double> values;
          bool active {false};
+         std::string master;             // bus master the sensor is attached to
+      };
+
+      struct Sample
+      {
+         std::string name;
+         double value {0};
+         time_t time {0};
       };
 
       typedef std::map<std::string, SensorData> SensorList;
+      typedef std::vector<Sample> SampleList;
 
-      W1(const char* aUrl);
+      W1(const char* aUrl = nullptr);
       ~W1();
 
       static void downF(int aSignal) { shutdown = true; }
 
       int init() { return success; }
+      int setResolutions(const char* spec);
       int loop();
       int show();
       int scan();
+      int read(SampleList& samples);
       int update();
       bool doShutDown() { return shutdown; }
 
@@ -52,9 +64,16 @@ class W1
    protected:
 
       int mqttConnection();
+      int scanMasters();
+      int triggerBulkConversion();
+      int applyResolution(const char* name);
+      int readSensor(const char* name, double& value);
 
       char* w1Path {nullptr};
       SensorList sensors;
+      std::map<std::string,bool> masters;            // bus master -> supports therm_bulk_read
+      std::map<std::string,int> resolutions;         // sensor -> resolution [bit]
+      int defaultResolution {na};
       const char* mqttUrl {nullptr};
       const char* mqttTopic {nullptr};
       const char* mqttPingTopic {nullptr};
@@ -62,3 +81,32 @@ class W1
 
       static bool shutdown;
 };
+
+//***************************************************************************
+// Class cW1Reader
+//   reads the local one wire sensors in a own thread, used by the daemon
+//   as alternative to the detour w1mqtt -> MQTT -> daemon
+//***************************************************************************
+
+class cW1Reader : public cThread
+{
+   public:
+
+      cW1Reader(const char* aResolutions = nullptr);
+      virtual ~cW1Reader();
+
+      int stop();
+      int fetch(W1::SampleList& samples);
+
+   protected:
+
+      void action() override;
+
+      enum Misc
+      {
+         updateCycle = 10        // seconds
+      };
+
+      W1 w1;
+      W1::SampleList pending;    // protected by cThread::mutex
+};
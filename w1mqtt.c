@@ -0,0 +1,108 @@
+//***************************************************************************
+// Automation Control
+// File w1mqtt.c
+// This code is distributed under the terms and conditions of the
+// GNU GENERAL PUBLIC LICENSE. See the file LICENSE for details.
+// Date 04.11.2010 - 07.02.2014  Jörg Wendel
+//***************************************************************************
+
+#include <signal.h>
+
+#include "w1.h"
+
+//***************************************************************************
+// Main
+//***************************************************************************
+
+int main(int argc, char** argv)
+{
+   W1* job;
+   int nofork = no;
+   int pid;
+   int _stdout = na;
+   Eloquence _eloquence {eloAlways};
+   const char* url = "tcp://localhost:1883";
+   const char* resolution {nullptr};
+
+   logstdout = yes;
+
+   // Usage ..
+
+   if (argc > 1 && (argv[1][0] == '?' || (strcmp(argv[1], "-h") == 0) || (strcmp(argv[1], "--help") == 0)))
+   {
+      // showUsage(argv[0]);  // to be implemented!
+      return 0;
+   }
+
+   // Parse command line
+
+   for (int i = 0; argv[i]; i++)
+   {
+      if (argv[i][0] != '-' || strlen(argv[i]) != 2)
+         continue;
+
+      switch (argv[i][1])
+      {
+         case 'u': url = argv[i+1];                         break;
+         case 'r': if (argv[i+1]) resolution = argv[i+1];   break;
+         case 'l': if (argv[i+1]) _eloquence = (Eloquence)atoi(argv[i+1]); break;
+         case 't': _stdout = yes;                           break;
+         case 'n': nofork = yes;                            break;
+      }
+   }
+
+   if (_stdout != na)
+      logstdout = _stdout;
+   else
+      logstdout = no;
+
+   // read configuration ..
+
+   // if (readConfig() != success)
+   //    return 1;
+
+   eloquence = _eloquence;
+
+   job = new W1(url);
+
+   if (resolution)
+      job->setResolutions(resolution);
+
+   if (job->init() != success)
+   {
+      printf("Initialization failed, see syslog for details\n");
+      delete job;
+      return 1;
+   }
+
+   // fork daemon
+
+   if (!nofork)
+   {
+      if ((pid = fork()) < 0)
+      {
+         printf("Can't fork daemon, %s\n", strerror(errno));
+         return 1;
+      }
+
+      if (pid != 0)
+         return 0;
+   }
+
+   // register SIGINT
+
+   ::signal(SIGINT, W1::downF);
+   ::signal(SIGTERM, W1::downF);
+
+   // do work ...
+
+   job->loop();
+
+   // shutdown
+
+   tell(eloAlways, "shutdown");
+
+   delete job;
+
+   return 0;
+}
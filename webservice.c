@@ -50,6 +50,8 @@ const char* cWebService::events[] =
    "imageconfig",
    "schema",
    "storeschema",
+   "subscribe",
+   "metrics",
 
    "errors",
    "menu",
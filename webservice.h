@@ -52,6 +52,8 @@ class cWebService
          evImageConfig,
          evSchema,
          evStoreSchema,
+         evSubscribe,
+         evMetrics,
 
          evErrors,
          evMenu,
@@ -12,6 +12,7 @@
 #include <dirent.h>
 
 #include "lib/json.h"
+#include "lib/metrics.h"
 
 #include "websock.h"
 
@@ -26,6 +27,18 @@ std::map<void*,cWebSock::Client> cWebSock::clients;
 std::map<std::string, std::string> cWebSock::htmlTemplates;
 cMyMutex cWebSock::clientsMutex;
 char* cWebSock::httpPath {nullptr};
+std::string cWebSock::cacheControl;
+std::map<std::string,cWebSock::FileTag> cWebSock::fileTags;
+std::map<void*,cWebSock::HttpRequest> cWebSock::httpRequests;
+cMyMutex cWebSock::httpRequestsMutex;
+std::map<std::string,json_t*> cWebSock::sensorSnapshots;
+std::string cWebSock::sensorsSnapshot;
+cMyMutex cWebSock::snapshotMutex;
+bool cWebSock::dataApi {false};
+bool cWebSock::metricsApi {false};
+int cWebSock::deflateLevel {1};
+int cWebSock::deflateMemLevel {8};
+int cWebSock::deflateWindowBits {15};
 
 cWebInterface* cWebSock::singleton {nullptr};
 
@@ -45,6 +58,53 @@ cWebSock::~cWebSock()
    free(certFile);
    free(certKeyFile);
    free(httpPath);
+
+   for (auto& s : sensorSnapshots)
+      json_decref(s.second);
+
+   sensorSnapshots.clear();
+}
+
+//***************************************************************************
+// Set Compression
+//   permessage-deflate parameters, level 0 disables the extension
+//***************************************************************************
+
+void cWebSock::setCompression(int level, int memLevel, int windowBits)
+{
+   deflateLevel = std::max(0, std::min(level, 9));
+   deflateMemLevel = std::max(1, std::min(memLevel, 9));
+   deflateWindowBits = std::max(8, std::min(windowBits, 15));
+}
+
+//***************************************************************************
+// Set Data Api
+//   the /data/ api has no login, therefore it is served only if enabled
+//***************************************************************************
+
+void cWebSock::setDataApi(bool enable)
+{
+   dataApi = enable;
+}
+
+//***************************************************************************
+// Set Metrics Api
+//   /metrics is served only if enabled and only to local peers (e.g. a
+//   prometheus or exporter on the same host)
+//***************************************************************************
+
+void cWebSock::setMetricsApi(bool enable)
+{
+   metricsApi = enable;
+}
+
+bool cWebSock::isLocalPeer(lws* wsi)
+{
+   char peer[100+TB] {};
+
+   lws_get_peer_simple(wsi, peer, sizeof(peer));
+
+   return strncmp(peer, "127.", 4) == 0 || strcmp(peer, "::1") == 0 || strncmp(peer, "::ffff:127.", 11) == 0;
 }
 
 int cWebSock::init(int aPort, int aTimeout, const char* confDir, bool ssl)
@@ -83,7 +143,7 @@ int cWebSock::init(int aPort, int aTimeout, const char* confDir, bool ssl)
    mount.mountpoint = "/";
    mount.origin = httpPath;
    mount.mountpoint_len = 1;
-   mount.cache_max_age = noStore ? 0 : 86400;
+   mount.cache_max_age = noStore ? 0 : cacheMaxAge;
    mount.cache_reusable = !noStore;       // 0 => no-store
    mount.cache_revalidate = 1;
    mount.cache_intermediaries = 1;
@@ -95,6 +155,26 @@ int cWebSock::init(int aPort, int aTimeout, const char* confDir, bool ssl)
    mount.basic_auth_login_file = nullptr;
    mounts[0] = mount;
 
+   // the files of serveFile() get the cache policy of the mount
+
+   if (!mount.cache_reusable)
+      cacheControl = "no-store";
+   else
+      cacheControl = std::string(mount.cache_intermediaries ? "public" : "private")
+         + ", max-age=" + std::to_string(mount.cache_max_age)
+         + (mount.cache_revalidate ? ", must-revalidate" : "");
+
+   // websocket extensions
+
+   memset(extensions, 0, sizeof(extensions));
+
+   if (deflateLevel > 0)
+   {
+      extensions[0].name = "permessage-deflate";
+      extensions[0].callback = lws_extension_callback_pm_deflate;
+      extensions[0].client_offer = "permessage-deflate; client_max_window_bits";
+   }
+
    // setup websocket context info
 
    memset(&info, 0, sizeof(info));
@@ -104,6 +184,7 @@ int cWebSock::init(int aPort, int aTimeout, const char* confDir, bool ssl)
    info.uid = -1;
    info.port = port;
    info.protocols = protocols;
+   info.extensions = deflateLevel > 0 ? extensions : nullptr;
 #if defined (LWS_LIBRARY_VERSION_MAJOR) && (LWS_LIBRARY_VERSION_MAJOR < 4)
    info.iface = nullptr;
 #endif
@@ -224,6 +305,7 @@ int cWebSock::service(ThreadControl* threadCtl)
 #endif
 
    threadCtl->webSock->performData(cWebSock::mtData);
+   performHttpRequests();
 
    if (nextWebSocketPing < time(0))
    {
@@ -248,7 +330,7 @@ int cWebSock::performData(MsgType type)
 
    for (auto it = clients.begin(); it != clients.end(); ++it)
    {
-      if (!it->second.messagesOut.empty())
+      if (!it->second.messagesOut.empty() || it->second.dropPending)
          count++;
    }
 
@@ -329,6 +411,36 @@ int cWebSock::callbackHttp(lws* wsi, lws_callback_reasons reason, void* user, vo
 
          if (!sessionData->dataPending)
          {
+            // answer of a data request ready?
+
+            HttpRequest request;
+            bool found {false};
+
+            {
+               cMyMutexLock lock(&httpRequestsMutex);
+               auto it = httpRequests.find(wsi);
+
+               if (it != httpRequests.end())
+               {
+                  if (!it->second.ready)
+                     return 0;
+
+                  request = it->second;
+                  httpRequests.erase(it);
+                  found = true;
+               }
+            }
+
+            if (found)
+            {
+               res = replyJson(wsi, sessionData, request.status, request.response, request.ifNoneMatch.c_str());
+
+               if (res < 0 || (res > 0 && lws_http_transaction_completed(wsi)))
+                  return -1;
+
+               break;
+            }
+
             tell(eloDebugWebSock, "Info: No more session data pending");
             return -1;
          }
@@ -343,7 +455,7 @@ int cWebSock::callbackHttp(lws* wsi, lws_callback_reasons reason, void* user, vo
             tell(eloDebugWebSock, "All fine, peer can handle %d bytes", m);
 
          res = lws_write(wsi, (unsigned char*)sessionData->buffer+sizeLwsPreFrame,
-                         sessionData->payloadSize, LWS_WRITE_HTTP);
+                         sessionData->payloadSize, LWS_WRITE_HTTP_FINAL);
 
          if (res < 0)
             tell(eloAlways, "Failed writing '%s'", sessionData->buffer+sizeLwsPreFrame);
@@ -375,8 +487,23 @@ int cWebSock::callbackHttp(lws* wsi, lws_callback_reasons reason, void* user, vo
          {
             // data request
 
-            tell(eloAlways, "Got unexpected HTTP request!");
-            res = dispatchDataRequest(wsi, sessionData, url);
+            if (dataApi)
+               res = dispatchDataRequest(wsi, sessionData, url);
+            else
+               res = replyJson(wsi, sessionData, HTTP_STATUS_FORBIDDEN, "{\"error\":\"data api disabled\"}", nullptr);
+
+            if (res < 0 || (res > 0 && lws_http_transaction_completed(wsi)))
+               return -1;
+         }
+         else if (strcmp(url, "/metrics") == 0)
+         {
+            // metrics in the prometheus text format
+
+            if (metricsApi && isLocalPeer(wsi))
+               res = replyContent(wsi, sessionData, HTTP_STATUS_OK, "text/plain; version=0.0.4",
+                                  cMetrics::toPrometheus(TARGET "_"), nullptr);
+            else
+               res = replyContent(wsi, sessionData, HTTP_STATUS_FORBIDDEN, "text/plain", "forbidden\n", nullptr);
 
             if (res < 0 || (res > 0 && lws_http_transaction_completed(wsi)))
                return -1;
@@ -414,10 +541,25 @@ int cWebSock::callbackHttp(lws* wsi, lws_callback_reasons reason, void* user, vo
          break;
       }
 
+      case LWS_CALLBACK_CLOSED_HTTP:
+      {
+         // a pending data request is answered into the void
+
+         cMyMutexLock lock(&httpRequestsMutex);
+         httpRequests.erase(wsi);
+
+         if (sessionData && sessionData->dataPending)
+         {
+            free(sessionData->buffer);
+            memset(sessionData, 0, sizeof(SessionData));
+         }
+
+         break;
+      }
+
       case LWS_CALLBACK_PROTOCOL_INIT:
       case LWS_CALLBACK_SERVER_NEW_CLIENT_INSTANTIATED:
       case LWS_CALLBACK_FILTER_HTTP_CONNECTION:
-      case LWS_CALLBACK_CLOSED_HTTP:
       case LWS_CALLBACK_WSI_CREATE:
       case LWS_CALLBACK_FILTER_NETWORK_CONNECTION:
       case LWS_CALLBACK_ADD_POLL_FD:
@@ -447,6 +589,170 @@ int cWebSock::callbackHttp(lws* wsi, lws_callback_reasons reason, void* user, vo
    return 0;
 }
 
+//***************************************************************************
+// ETag Of
+//   md5 of the file content, cached until mtime or size changes
+//***************************************************************************
+
+const char* cWebSock::etagOf(const char* path, const struct stat* st)
+{
+   FileTag& tag = fileTags[path];
+
+   if (tag.etag.empty() || tag.mtime != st->st_mtime || tag.size != st->st_size)
+   {
+      md5Buf md5 {};
+      std::string dir = path;
+      std::string name;
+      size_t pos = dir.rfind('/');
+
+      tag.etag.clear();
+
+      if (pos == std::string::npos)
+         return nullptr;
+
+      name = dir.substr(pos+1);
+      dir.erase(pos);
+
+      if (createMd5OfFile(dir.c_str(), name.c_str(), md5) != success)
+         return nullptr;
+
+      tag.mtime = st->st_mtime;
+      tag.size = st->st_size;
+      tag.etag = "\"" + std::string(md5) + "\"";
+   }
+
+   return tag.etag.c_str();
+}
+
+//***************************************************************************
+// Encoding Quality
+//   q-value of the content-coding in the Accept-Encoding header, '*' applies
+//   to the codings which are not listed, 0 -> not acceptable
+//***************************************************************************
+
+static double qValue(const char* p)    // locale independent, "0.8" -> 0.8
+{
+   double q = *p == '1' ? 1 : 0;
+
+   if (*p == '0' || *p == '1')
+      p++;
+
+   if (*p == '.')
+   {
+      double f {0.1};
+
+      for (p++; isdigit(*p); p++, f /= 10)
+         q += (*p - '0') * f;
+   }
+
+   return q;
+}
+
+static double encodingQuality(const std::string& accept, const char* coding)
+{
+   double wildcard {0};
+   size_t pos {0};
+
+   while (pos < accept.length())
+   {
+      size_t end = accept.find(',', pos);
+
+      if (end == std::string::npos)
+         end = accept.length();
+
+      std::string token = accept.substr(pos, end - pos);
+      size_t semicolon = token.find(';');
+      double q {1};
+
+      pos = end + 1;
+
+      if (semicolon != std::string::npos)
+      {
+         const char* param = token.c_str() + semicolon + 1;
+
+         while (isspace(*param))
+            param++;
+
+         if (tolower(param[0]) == 'q' && param[1] == '=')
+            q = qValue(param + 2);
+
+         token.erase(semicolon);
+      }
+
+      size_t first = token.find_first_not_of(" \t");
+      size_t last = token.find_last_not_of(" \t");
+
+      if (first == std::string::npos)
+         continue;
+
+      token = token.substr(first, last - first + 1);
+
+      if (strcasecmp(token.c_str(), coding) == 0)
+         return q;
+
+      if (token == "*")
+         wildcard = q;
+   }
+
+   return wildcard;
+}
+
+//***************************************************************************
+// Encoded Sibling
+//   pre-compressed variant (file.br / file.gz) which is accepted by the
+//   client and not older than the file itself, returns its content-encoding
+//***************************************************************************
+
+const char* cWebSock::encodedSibling(lws* wsi, const char* path, const struct stat* st, std::string& sibling)
+{
+   static const struct { const char* suffix; const char* encoding; } encodings[] =
+   {
+      { ".br", "br" },
+      { ".gz", "gzip" },
+      { nullptr, nullptr }
+   };
+
+   int len = lws_hdr_total_length(wsi, WSI_TOKEN_HTTP_ACCEPT_ENCODING);
+
+   if (len <= 0)
+      return nullptr;
+
+   std::string accept(len + 1, '\0');
+
+   if (lws_hdr_copy(wsi, &accept[0], len + 1, WSI_TOKEN_HTTP_ACCEPT_ENCODING) <= 0)
+      return nullptr;
+
+   accept.resize(len);
+
+   // the best accepted variant which exists, on equal q-values the first of the list
+
+   const char* encoding {nullptr};
+   double best {0};
+
+   for (int i = 0; encodings[i].suffix; i++)
+   {
+      struct stat sst;
+      double q = encodingQuality(accept, encodings[i].encoding);
+
+      if (q <= best)
+         continue;
+
+      std::string name = std::string(path) + encodings[i].suffix;
+
+      if (stat(name.c_str(), &sst) == 0 && S_ISREG(sst.st_mode) && sst.st_mtime >= st->st_mtime)
+      {
+         sibling = name;
+         encoding = encodings[i].encoding;
+         best = q;
+      }
+   }
+
+   if (!encoding)
+      sibling.clear();
+
+   return encoding;
+}
+
 //***************************************************************************
 // Serve File
 //***************************************************************************
@@ -455,9 +761,13 @@ int cWebSock::serveFile(lws* wsi, const char* path)
 {
    const char* suffix = suffixOf(path ? path : "");
    const char* mime = "text/plain";
+   struct stat st;
 
    // LogDuration ld("serveFile", 1);
 
+   if (!path || stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+      return lws_serve_http_file(wsi, path, mime, 0, 0);    // let lws answer with 404
+
    // choose mime type based on the file extension
 
    if (!isEmpty(suffix))
@@ -473,9 +783,64 @@ int cWebSock::serveFile(lws* wsi, const char* path)
       else if (strcmp(suffix, "map") == 0)   mime = "application/json";
    }
 
-   // printf("serve file '%s' with mime type '%s'\n", path, mime);
+   // pre-compressed sibling, the etag belongs to the representation we send
+
+   std::string sibling;
+   const char* encoding = encodedSibling(wsi, path, &st, sibling);
+   const char* file = encoding ? sibling.c_str() : path;
+   struct stat fst;
+
+   if (stat(file, &fst) != 0)
+      return -1;
 
-   return lws_serve_http_file(wsi, path, mime, 0, 0);
+   const char* etag = etagOf(file, &fst);
+
+   // response headers
+
+   unsigned char headers[512];
+   unsigned char* p = headers;
+   unsigned char* end = headers + sizeof(headers) - 1;
+
+   if (lws_add_http_header_by_name(wsi, (const unsigned char*)"cache-control:", (const unsigned char*)cacheControl.c_str(),
+                                   cacheControl.length(), &p, end)
+       || lws_add_http_header_by_name(wsi, (const unsigned char*)"vary:", (const unsigned char*)"Accept-Encoding", 15, &p, end))
+      return -1;
+
+   if (etag && lws_add_http_header_by_name(wsi, (const unsigned char*)"etag:", (const unsigned char*)etag, strlen(etag), &p, end))
+      return -1;
+
+   // not modified?
+
+   char ifNoneMatch[100] {};
+
+   if (etag && lws_hdr_copy(wsi, ifNoneMatch, sizeof(ifNoneMatch), WSI_TOKEN_HTTP_IF_NONE_MATCH) > 0
+       && strstr(ifNoneMatch, etag))
+   {
+      unsigned char buffer[LWS_PRE + 512];
+      unsigned char* start = buffer + LWS_PRE;
+      unsigned char* h = start;
+
+      tell(eloDebugWebSock, "HTTP: '%s' not modified", path);
+
+      if (lws_add_http_header_status(wsi, HTTP_STATUS_NOT_MODIFIED, &h, buffer + sizeof(buffer) - 1))
+         return -1;
+
+      memcpy(h, headers, p - headers);
+      h += p - headers;
+
+      if (lws_finalize_write_http_header(wsi, start, &h, buffer + sizeof(buffer) - 1))
+         return -1;
+
+      return lws_http_transaction_completed(wsi) ? -1 : 0;
+   }
+
+   if (encoding && lws_add_http_header_by_name(wsi, (const unsigned char*)"content-encoding:",
+                                               (const unsigned char*)encoding, strlen(encoding), &p, end))
+      return -1;
+
+   // printf("serve file '%s' with mime type '%s'\n", file, mime);
+
+   return lws_serve_http_file(wsi, file, mime, (const char*)headers, p - headers);
 }
 
 //***************************************************************************
@@ -517,8 +882,12 @@ int cWebSock::callbackWs(lws* wsi, lws_callback_reasons reason, void* user, void
 
          else if (msgType == mtData)
          {
+            if (clients[wsi].dropPending)
+               return -1;                                  // close connection
+
             if (!clients[wsi].msgBufferDataPending() && clients[wsi].messagesOut.empty())
                return 0;
+
             if (lws_send_pipe_choked(wsi))
                return 0;
 
@@ -526,39 +895,33 @@ int cWebSock::callbackWs(lws* wsi, lws_callback_reasons reason, void* user, void
             {
                cMyMutexLock clock(&clientsMutex);
                cMyMutexLock lock(&clients[wsi].messagesOutMutex);
-               const char* msg = clients[wsi].messagesOut.front().c_str();
-               int msgSize = clients[wsi].messagesOut.front().length();
-               int neededSize = sizeLwsFrame + msgSize;
-               unsigned char* newBuffer {nullptr};
-
-               if (neededSize > clients[wsi].msgBufferSize)
-               {
-                  // tell(eloDebugWebSock, "Debug: re-allocate buffer to %d bytes", neededSize);
+               OutMessage& out = clients[wsi].messagesOut.front();
+               int msgSize = out.message.length() - sizeLwsPreFrame;
+               double latency = (usNow() - out.queuedAt) / 1000;
+               bool logPayload = out.event != "syslog";   // don't feed a followed log with itself
 
-                  if (!(newBuffer = (unsigned char*)realloc(clients[wsi].msgBuffer, neededSize)))
-                  {
-                     tell(eloDebugWebSock, "Fatal: Can't allocate memory!");
-                     return -1;
-                  }
-
-                  clients[wsi].msgBuffer = newBuffer;
-                  clients[wsi].msgBufferSize = neededSize;
-               }
+               // the message already has the LWS padding in front, take it over without a copy
 
-               strncpy((char*)clients[wsi].msgBuffer + sizeLwsPreFrame, msg, msgSize);
+               clients[wsi].msgBuffer.swap(out.message);
                clients[wsi].msgBufferPayloadSize = msgSize;
                clients[wsi].msgBufferSendOffset = 0;
-               clients[wsi].messagesOut.pop();  // remove sent message
+               clients[wsi].messagesOutBytes -= msgSize;
+               clients[wsi].messagesOut.pop_front();  // remove sent message
 
-               tell(eloWebSock, "=> (%d) %.*s -> to '%s' (%p)", msgSize, msgSize,
-                    clients[wsi].msgBuffer+sizeLwsPreFrame, clientInfo.c_str(), (void*)wsi);
+               clients[wsi].messagesSent++;
+               clients[wsi].sumLatency += latency;
+               clients[wsi].maxLatency = std::max(clients[wsi].maxLatency, latency);
+
+               if (logPayload)
+                  tell(eloWebSock, "=> (%d) %.*s -> to '%s' (%p)", msgSize, msgSize,
+                       clients[wsi].msgBuffer.c_str()+sizeLwsPreFrame, clientInfo.c_str(), (void*)wsi);
             }
 
             enum { maxChunk = 10*1024 };
 
             if (clients[wsi].msgBufferPayloadSize)
             {
-               unsigned char* p = clients[wsi].msgBuffer + sizeLwsPreFrame + clients[wsi].msgBufferSendOffset;
+               unsigned char* p = (unsigned char*)clients[wsi].msgBuffer.data() + sizeLwsPreFrame + clients[wsi].msgBufferSendOffset;
                int pending = clients[wsi].msgBufferPayloadSize - clients[wsi].msgBufferSendOffset;
                int chunkSize = pending > maxChunk ? maxChunk : pending;
                int flags = lws_write_ws_flags(LWS_WRITE_TEXT, !clients[wsi].msgBufferSendOffset, pending <= maxChunk);
@@ -571,6 +934,7 @@ int cWebSock::callbackWs(lws* wsi, lws_callback_reasons reason, void* user, void
                }
 
                clients[wsi].msgBufferSendOffset += chunkSize;
+               clients[wsi].bytesSent += chunkSize;
 
                if (clients[wsi].msgBufferSendOffset >= clients[wsi].msgBufferPayloadSize)
                {
@@ -579,6 +943,12 @@ int cWebSock::callbackWs(lws* wsi, lws_callback_reasons reason, void* user, void
                }
                else
                   lws_callback_on_writable(wsi);
+
+               // the peer takes data, restart the stall timer if more is pending
+
+               cMyMutexLock lock(&clients[wsi].messagesOutMutex);
+               bool more = clients[wsi].msgBufferDataPending() || !clients[wsi].messagesOut.empty();
+               clients[wsi].stalledSince = more ? time(0) : 0;
             }
          }
 
@@ -667,6 +1037,16 @@ int cWebSock::callbackWs(lws* wsi, lws_callback_reasons reason, void* user, void
       case LWS_CALLBACK_ESTABLISHED:                       // someone connecting
       {
          tell(eloWebSock, "Client '%s' connected (%p), ping time set to (%d)", clientInfo.c_str(), (void*)wsi, timeout);
+
+         if (deflateLevel > 0)
+         {
+            // tune the deflate stream of this connection (ignored if the client didn't negotiate it)
+
+            lws_set_extension_option(wsi, "permessage-deflate", "compression_level", std::to_string(deflateLevel).c_str());
+            lws_set_extension_option(wsi, "permessage-deflate", "mem_level", std::to_string(deflateMemLevel).c_str());
+            lws_set_extension_option(wsi, "permessage-deflate", "server_max_window_bits", std::to_string(deflateWindowBits).c_str());
+         }
+
          clients[wsi].wsi = wsi;
          clients[wsi].type = ctActive;
          clients[wsi].tftprio = 100;
@@ -742,6 +1122,12 @@ void cWebSock::atLogout(lws* wsi, const char* message, const char* clientInfo)
    if (it == clients.end())
       return ;
 
+   const Client& client = it->second;
+
+   tell(eloWebSock, "Client (%p) sent %lu messages with %lu bytes, coalesced %lu, dropped %lu, latency avg %.1fms max %.1fms",
+        (void*)wsi, client.messagesSent, client.bytesSent, client.messagesCoalesced, client.messagesDropped,
+        client.messagesSent ? client.sumLatency / client.messagesSent : 0.0, client.maxLatency);
+
    json_t* object = json_object();
    addToJson(object, "client", (long)wsi);
 
@@ -790,21 +1176,222 @@ void cWebSock::setClientType(lws* wsi, ClientType type)
 // Push Message
 //***************************************************************************
 
-void cWebSock::pushOutMessage(const char* message, lws* wsi)
+void cWebSock::pushOutMessage(const char* message, lws* wsi, const char* event)
 {
+   std::string frame(sizeLwsPreFrame, '\0');
+
+   frame += message;
+   pushOutFrame(std::move(frame), wsi, event);
+}
+
+//***************************************************************************
+// Object Of Frame
+//   the HTTP api replies only the 'object' of the message, it is the last
+//   member of each message (see Daemon::pushOutMessage() and beginMessage())
+//***************************************************************************
+
+bool cWebSock::objectOfFrame(const std::string& frame, std::string& object)
+{
+   size_t begin = frame.find("\"object\"", sizeLwsPreFrame);
+   size_t end = frame.find_last_of('}');
+
+   if (begin == std::string::npos || end == std::string::npos)
+      return false;
+
+   begin = frame.find_first_not_of(" :", begin + strlen("\"object\""));
+
+   while (end > begin && isspace(frame[end-1]))
+      end--;
+
+   if (begin == std::string::npos || begin >= end)
+      return false;
+
+   object.assign(frame, begin, end - begin);
+
+   return true;
+}
+
+//***************************************************************************
+// Push Frame
+//   the message with sizeLwsPreFrame bytes padding in front (see cJsonWriter),
+//   is queued for a single client without a copy
+//***************************************************************************
+
+void cWebSock::pushOutFrame(std::string&& frame, lws* wsi, const char* event)
+{
+   // answer of a HTTP data request?
+
+   if (wsi)
+   {
+      cMyMutexLock lock(&httpRequestsMutex);
+      auto it = httpRequests.find(wsi);
+
+      if (it != httpRequests.end())
+      {
+         if (!objectOfFrame(frame, it->second.response))
+            it->second.response = "null";
+
+         it->second.ready = true;
+         lws_cancel_service(context);
+
+         return;
+      }
+   }
+
    cMyMutexLock lock(&clientsMutex);
 
    if (wsi)
    {
       if (clients.find(wsi) != clients.end())
-         clients[wsi].pushMessage(message);
+         clients[wsi].pushMessage(std::move(frame), event);
       else if ((ulong)wsi != (ulong)-1)
          tell(eloAlways, "client %ld not found!", (ulong)wsi);
    }
    else
    {
+      UpdateMerger merger;
+
       for (auto it = clients.begin(); it != clients.end(); ++it)
-         it->second.pushMessage(message);
+         it->second.pushMessage(std::next(it) == clients.end() ? std::move(frame) : frame, event, &merger);
+   }
+}
+
+//***************************************************************************
+// Client - Push Message
+//   'update' messages carry only the changed sensors, a pending one is merged
+//   with the new one; of the snapshot events only the newest is kept
+//***************************************************************************
+
+static bool isSnapshotEvent(const std::string& event)
+{
+   static const char* snapshots[] = { "init", "daemonstate", "config", "valuetypes", "valuefacts",
+                                      "dashboards", "images", "grouplist", "system", nullptr };
+
+   for (int i = 0; snapshots[i]; i++)
+      if (event == snapshots[i])
+         return true;
+
+   return false;
+}
+
+int cWebSock::UpdateMerger::merge(std::string& pending, const std::string& frame)
+{
+   auto it = merged.find(pending);
+
+   if (it != merged.end())
+   {
+      pending = it->second;
+      return success;
+   }
+
+   if (!oSource)
+   {
+      json_t* oMessage = json_loads(frame.c_str() + sizeLwsPreFrame, 0, nullptr);
+
+      oSource = json_incref(json_object_get(oMessage, "object"));
+      json_decref(oMessage);
+   }
+
+   json_t* oPending = json_loads(pending.c_str() + sizeLwsPreFrame, 0, nullptr);
+   json_t* oTarget = json_object_get(oPending, "object");
+   int status {fail};
+
+   if (json_is_object(oTarget) && json_is_object(oSource))
+   {
+      json_object_update(oTarget, oSource);
+
+      if (char* p = json_dumps(oPending, JSON_REAL_PRECISION(4)))
+      {
+         std::string& result = merged[pending];
+
+         result.assign(pending, 0, sizeLwsPreFrame);
+         result += p;
+         pending = result;
+         free(p);
+         status = success;
+      }
+   }
+
+   json_decref(oPending);
+
+   return status;
+}
+
+void cWebSock::Client::pushMessage(std::string frame, const char* event, UpdateMerger* merger)
+{
+   cMyMutexLock lock(&messagesOutMutex);
+
+   if (dropPending)
+      return;
+
+   std::string ev = event ? event : "";
+   bool merged {false};
+
+   if (ev == "update")
+   {
+      UpdateMerger ownMerger;
+
+      if (!merger)
+         merger = &ownMerger;
+
+      for (auto it = messagesOut.rbegin(); it != messagesOut.rend(); ++it)
+      {
+         if (it->event == "init")          // don't merge across a full snapshot
+            break;
+
+         if (it->event != ev)
+            continue;
+
+         size_t size = it->message.length();
+
+         if (merger->merge(it->message, frame) == success)
+         {
+            messagesOutBytes += it->message.length() - size;
+            messagesCoalesced++;
+            merged = true;
+         }
+
+         break;
+      }
+   }
+   else if (!ev.empty() && isSnapshotEvent(ev))
+   {
+      for (auto it = messagesOut.begin(); it != messagesOut.end(); )
+      {
+         if (it->event == ev)
+         {
+            messagesOutBytes -= it->message.length() - sizeLwsPreFrame;
+            it = messagesOut.erase(it);
+            messagesCoalesced++;
+         }
+         else
+            ++it;
+      }
+   }
+
+   if (!merged)
+   {
+      messagesOut.push_back({ev, std::move(frame), usNow()});
+      messagesOutBytes += messagesOut.back().message.length() - sizeLwsPreFrame;
+   }
+
+   // backpressure, drop clients which don't read their messages, a stalled peer
+   // never gets writeable therefore the time is tracked from the queue side
+
+   if (!stalledSince)
+      stalledSince = time(0);
+
+   bool stalled = stalledSince < time(0) - maxStalledTime;
+
+   if (messagesOutBytes > maxQueueBytes || stalled)
+   {
+      tell(eloAlways, "Warning: Client (%p) %s, dropping %zu pending messages (%zu bytes) and closing connection",
+           wsi, stalled ? "stalled" : "queue overflow", messagesOut.size(), messagesOutBytes);
+
+      messagesDropped += messagesOut.size();
+      messagesOut.clear();
+      messagesOutBytes = 0;
+      dropPending = true;
    }
 }
 
@@ -848,16 +1435,249 @@ const char* cWebSock::methodOf(const char* url)
 
 //***************************************************************************
 // Dispatch Data Request
+//   read only json api, live values are served from the snapshot of the
+//   sensors, everything which needs the database is passed to the daemon
+//
+//   /data/sensors
+//   /data/sensor?key=VA:0x01
+//   /data/chart?sensors=VA:0x01,VA:0x02&range=1.5&start=<unix time>&interval=<minutes>
+//   /data/errors
 //***************************************************************************
 
 int cWebSock::dispatchDataRequest(lws* wsi, SessionData* sessionData, const char* url)
 {
-   int statusCode = HTTP_STATUS_NOT_FOUND;
+   const char* method = methodOf(url);
+   char ifNoneMatch[100] {};
+
+   lws_hdr_copy(wsi, ifNoneMatch, sizeof(ifNoneMatch), WSI_TOKEN_HTTP_IF_NONE_MATCH);
+
+   if (strcmp(method, "sensors") == 0)
+   {
+      std::string json;
+
+      {
+         cMyMutexLock lock(&snapshotMutex);
+
+         if (sensorsSnapshot.empty())
+         {
+            json_t* oJson = json_object();
+
+            for (const auto& s : sensorSnapshots)
+               json_object_set(oJson, s.first.c_str(), s.second);
+
+            char* p = json_dumps(oJson, JSON_REAL_PRECISION(4));
+            sensorsSnapshot = p ? p : "{}";
+            free(p);
+            json_decref(oJson);
+         }
+
+         json = sensorsSnapshot;
+      }
+
+      return replyJson(wsi, sessionData, HTTP_STATUS_OK, json, ifNoneMatch);
+   }
+
+   if (strcmp(method, "sensor") == 0)
+   {
+      std::string key = getStrParameter(wsi, "key=", "");
+      std::string json;
+
+      {
+         cMyMutexLock lock(&snapshotMutex);
+         auto it = sensorSnapshots.find(key);
+
+         if (it != sensorSnapshots.end())
+         {
+            char* p = json_dumps(it->second, JSON_REAL_PRECISION(4));
+            json = p ? p : "";
+            free(p);
+         }
+      }
+
+      if (json.empty())
+         return replyJson(wsi, sessionData, HTTP_STATUS_NOT_FOUND, "{\"error\":\"unknown sensor\"}", nullptr);
+
+      return replyJson(wsi, sessionData, HTTP_STATUS_OK, json, ifNoneMatch);
+   }
+
+   if (strcmp(method, "chart") == 0)
+   {
+      json_t* oObject = json_object();
+
+      json_object_set_new(oObject, "id", json_string("api"));
+      json_object_set_new(oObject, "sensors", json_string(getStrParameter(wsi, "sensors=", "")));
+      json_object_set_new(oObject, "range", json_real(atof(getStrParameter(wsi, "range=", "1"))));
+      json_object_set_new(oObject, "start", json_integer(atol(getStrParameter(wsi, "start=", "0"))));
+      json_object_set_new(oObject, "interval", json_integer(getIntParameter(wsi, "interval=", 60)));
+
+      return postDataRequest(wsi, "chartdata", oObject);
+   }
+
+   if (strcmp(method, "errors") == 0)
+      return postDataRequest(wsi, "errors", json_object());
+
+   return replyJson(wsi, sessionData, HTTP_STATUS_NOT_FOUND, "{\"error\":\"unknown method\"}", nullptr);
+}
+
+//***************************************************************************
+// Post Data Request
+//   pass the request to the daemon, the answer arrives by pushOutMessage()
+//***************************************************************************
+
+int cWebSock::postDataRequest(lws* wsi, const char* event, json_t* oObject)
+{
+   char ifNoneMatch[100] {};
+
+   lws_hdr_copy(wsi, ifNoneMatch, sizeof(ifNoneMatch), WSI_TOKEN_HTTP_IF_NONE_MATCH);
 
-   // const char* method = methodOf(url);
+   {
+      cMyMutexLock lock(&httpRequestsMutex);
+
+      HttpRequest& request = httpRequests[wsi];
+      request = HttpRequest();
+      request.startedAt = time(0);
+      request.ifNoneMatch = ifNoneMatch;
+   }
+
+   json_t* oData = json_object();
+   json_object_set_new(oData, "event", json_string(event));
+   json_object_set_new(oData, "object", oObject);
+   json_object_set_new(oData, "client", json_integer((long)wsi));
+
+   char* p = json_dumps(oData, 0);
+   singleton->pushInMessage(p);
+   free(p);
+   json_decref(oData);
+
+   return 0;
+}
+
+//***************************************************************************
+// Reply Content
+//   with content md5 as ETag and content-length to keep the connection alive,
+//   returns 1 if the transaction is done, 0 if the body is pending
+//***************************************************************************
+
+int cWebSock::replyContent(lws* wsi, SessionData* sessionData, int status, const char* contentType,
+                           const std::string& content, const char* ifNoneMatch)
+{
+   unsigned char buffer[LWS_PRE + 1024];
+   unsigned char* start = buffer + LWS_PRE;
+   unsigned char* p = start;
+   unsigned char* end = buffer + sizeof(buffer) - 1;
+   char etag[sizeMd5+3] {};
+   bool notModified {false};
+
+   if (status == HTTP_STATUS_OK)
+   {
+      md5Buf md5 {};
+      createMd5(content.c_str(), md5);
+      sprintf(etag, "\"%s\"", md5);
+      notModified = !isEmpty(ifNoneMatch) && strstr(ifNoneMatch, etag);
+   }
 
-   // if (strcmp(method, "getenv") == 0)
-   //    statusCode = doEnvironment(wsi, sessionData);
+   if (notModified)
+   {
+      if (lws_add_http_header_status(wsi, HTTP_STATUS_NOT_MODIFIED, &p, end))
+         return -1;
+   }
+   else if (lws_add_http_common_headers(wsi, status, contentType, content.length(), &p, end))
+      return -1;
+
+   if (!isEmpty(etag) && lws_add_http_header_by_name(wsi, (const unsigned char*)"etag:", (const unsigned char*)etag,
+                                                     strlen(etag), &p, end))
+      return -1;
+
+   if (lws_add_http_header_by_name(wsi, (const unsigned char*)"cache-control:", (const unsigned char*)"no-cache", 8, &p, end))
+      return -1;
+
+   if (lws_finalize_write_http_header(wsi, start, &p, end))
+      return -1;
+
+   if (notModified)
+      return 1;
+
+   // body is written by LWS_CALLBACK_HTTP_WRITEABLE
+
+   sessionData->bufferSize = sizeLwsFrame + content.length();
+   sessionData->buffer = (char*)malloc(sessionData->bufferSize);
+   sessionData->payloadSize = content.length();
+   sessionData->dataPending = true;
+   memcpy(sessionData->buffer + sizeLwsPreFrame, content.c_str(), content.length());
+
+   lws_callback_on_writable(wsi);
+
+   return 0;
+}
+
+//***************************************************************************
+// Perform Http Requests
+//   called in the service thread, wake the connections with a ready answer
+//***************************************************************************
+
+int cWebSock::performHttpRequests()
+{
+   cMyMutexLock lock(&httpRequestsMutex);
+
+   for (auto& r : httpRequests)
+   {
+      if (!r.second.ready && r.second.startedAt < time(0) - maxHttpRequestTime)
+      {
+         tell(eloAlways, "Warning: HTTP data request of (%p) timed out", r.first);
+         r.second.status = HTTP_STATUS_SERVICE_UNAVAILABLE;
+         r.second.response = "{\"error\":\"timeout\"}";
+         r.second.ready = true;
+      }
+
+      if (r.second.ready)
+         lws_callback_on_writable((lws*)r.first);
+   }
+
+   return done;
+}
+
+bool cWebSock::isHttpRequest(lws* wsi)
+{
+   cMyMutexLock lock(&httpRequestsMutex);
+
+   return httpRequests.find(wsi) != httpRequests.end();
+}
+
+//***************************************************************************
+// Fail Http Request
+//   the daemon can't answer the data request, false if wsi isn't one
+//***************************************************************************
+
+bool cWebSock::failHttpRequest(lws* wsi, const char* error)
+{
+   cMyMutexLock lock(&httpRequestsMutex);
+   auto it = httpRequests.find(wsi);
+
+   if (it == httpRequests.end())
+      return false;
+
+   it->second.status = HTTP_STATUS_SERVICE_UNAVAILABLE;
+   it->second.response = "{\"error\":\"" + std::string(error) + "\"}";
+   it->second.ready = true;
+   lws_cancel_service(context);
+
+   return true;
+}
+
+//***************************************************************************
+// Set Sensor Snapshot
+//   merge the (maybe partial) json of the sensor into its snapshot
+//***************************************************************************
+
+void cWebSock::setSensorSnapshot(const char* key, json_t* oSensor)
+{
+   cMyMutexLock lock(&snapshotMutex);
+   auto it = sensorSnapshots.find(key);
+
+   if (it == sensorSnapshots.end())
+      sensorSnapshots[key] = json_deep_copy(oSensor);
+   else
+      json_object_update(it->second, oSensor);
 
-   return statusCode;
+   sensorsSnapshot.clear();
 }
@@ -8,7 +8,11 @@
 
 #pragma once
 
+#include <sys/stat.h>
+
 #include <queue>
+#include <deque>
+#include <unordered_map>
 #include <jansson.h>
 #include <libwebsockets.h>
 
@@ -56,31 +60,92 @@ class cWebSock : public cWebService
          int dataPending;
       };
 
-      struct Client
+      enum HttpCache
+      {
+         cacheMaxAge = 86400                // [s] for the static files of httpPath
+      };
+
+      struct FileTag
       {
-         ~Client() { free(msgBuffer); }
+         time_t mtime {0};
+         off_t size {0};
+         std::string etag;
+      };
+
+      struct HttpRequest                   // data request answered by the daemon
+      {
+         time_t startedAt {0};
+         std::string ifNoneMatch;
+         std::string response;
+         int status {HTTP_STATUS_OK};
+         bool ready {false};
+      };
+
+      enum HttpLimits
+      {
+         maxHttpRequestTime = 30            // [s] until a pending data request fails
+      };
+
+      enum QueueLimits
+      {
+         maxQueueBytes = 4 * 1024 * 1024,   // pending bytes per client before it is dropped
+         maxStalledTime = 30                // [s] a client which doesn't take data for longer is dropped
+      };
+
+      struct OutMessage
+      {
+         std::string event;                 // used for coalescing, empty if unknown
+         std::string message;               // sizeLwsPreFrame bytes padding followed by the payload
+         double queuedAt {0};               // [us]
+      };
+
+      // merges a broadcasted 'update' into the pending updates of the clients,
+      // each distinct pending update is merged only once
 
+      class UpdateMerger
+      {
+         public:
+
+            ~UpdateMerger() { json_decref(oSource); }
+
+            int merge(std::string& pending, const std::string& frame);
+
+         private:
+
+            json_t* oSource {nullptr};      // 'object' of the update, parsed on first use
+            std::unordered_map<std::string,std::string> merged;
+      };
+
+      struct Client
+      {
          ClientType type;
          int tftprio;
-         std::queue<std::string> messagesOut;
+         std::deque<OutMessage> messagesOut;
+         size_t messagesOutBytes {0};
          cMyMutex messagesOutMutex;
          void* wsi;
 
-         // buffer to send the payload in chunks
+         // statistics / backpressure
 
-         unsigned char* msgBuffer {nullptr};
-         int msgBufferSize {0};
+         ulong messagesSent {0};
+         ulong bytesSent {0};
+         ulong messagesCoalesced {0};
+         ulong messagesDropped {0};
+         double maxLatency {0};             // [ms] time from queue to write
+         double sumLatency {0};             // [ms]
+         time_t stalledSince {0};           // messages pending but nothing written since
+         bool dropPending {false};          // queue overflow or stalled too long -> close connection
+
+         // the message which is sent in chunks, taken over from the queue
+
+         std::string msgBuffer;
          int msgBufferPayloadSize {0};
          int msgBufferSendOffset {0};
          bool msgBufferDataPending() { return msgBufferSendOffset < msgBufferPayloadSize; }
 
          // push next message
 
-         void pushMessage(const char* p)
-         {
-            cMyMutexLock lock(&messagesOutMutex);
-            messagesOut.push(p);
-         }
+         void pushMessage(std::string frame, const char* event = nullptr, UpdateMerger* merger = nullptr);
 
          void cleanupMessageQueue()
          {
@@ -90,8 +155,8 @@ class cWebSock : public cWebService
 
             tell(eloAlways, "Info: Flushing (%zu) old 'wasted' messages of client (%p)", messagesOut.size(), wsi);
 
-            while (!messagesOut.empty())
-               messagesOut.pop();
+            messagesOut.clear();
+            messagesOutBytes = 0;
          }
 
          std::string buffer;   // for chunked messages
@@ -101,14 +166,21 @@ class cWebSock : public cWebService
       virtual ~cWebSock();
 
       int init(int aPort, int aTimeout, const char* confDir, bool ssl = false);
+      void setCompression(int level, int memLevel, int windowBits);
+      void setDataApi(bool enable);
+      void setMetricsApi(bool enable);
       int exit();
 
       int performData(MsgType type);
 
       // static interface
 
-      void pushOutMessage(const char* p, lws* wsi = 0);
+      void pushOutMessage(const char* p, lws* wsi = 0, const char* event = nullptr);
+      void pushOutFrame(std::string&& frame, lws* wsi = 0, const char* event = nullptr);
       void setClientType(lws* wsi, ClientType type);
+      void setSensorSnapshot(const char* key, json_t* oSensor);
+      bool isHttpRequest(lws* wsi);
+      bool failHttpRequest(lws* wsi, const char* error);
 
    private:
 
@@ -126,7 +198,16 @@ class cWebSock : public cWebService
       static void writeLog(int level, const char* line);
 
       static int serveFile(lws* wsi, const char* path);
+      static const char* etagOf(const char* path, const struct stat* st);
+      static const char* encodedSibling(lws* wsi, const char* path, const struct stat* st, std::string& sibling);
       static int dispatchDataRequest(lws* wsi, SessionData* sessionData, const char* url);
+      static int postDataRequest(lws* wsi, const char* event, json_t* oObject);
+      static int replyContent(lws* wsi, SessionData* sessionData, int status, const char* contentType, const std::string& content, const char* ifNoneMatch);
+      static int replyJson(lws* wsi, SessionData* sessionData, int status, const std::string& json, const char* ifNoneMatch)
+         { return replyContent(wsi, sessionData, status, "application/json", json, ifNoneMatch); }
+      static int performHttpRequests();
+      static bool objectOfFrame(const std::string& frame, std::string& object);
+      static bool isLocalPeer(lws* wsi);
 
       static const char* methodOf(const char* url);
       static const char* getStrParameter(lws* wsi, const char* name, const char* def = 0);
@@ -139,6 +220,7 @@ class cWebSock : public cWebService
       char* certKeyFile {nullptr};
       lws_protocols protocols[3];
       lws_http_mount mounts[1];
+      lws_extension extensions[2];
 #if defined (LWS_LIBRARY_VERSION_MAJOR) && (LWS_LIBRARY_VERSION_MAJOR >= 4)
       lws_retry_bo_t retry;
 #endif
@@ -164,10 +246,28 @@ class cWebSock : public cWebService
       static lws_context* context;
       static cWebInterface* singleton;
       static char* httpPath;
+      static std::string cacheControl;   // of the files of httpPath, like the '/' mount
       static char* epgImagePath;
       static int timeout;
       static std::map<void*,Client> clients;
       static cMyMutex clientsMutex;
       static MsgType msgType;
       static std::map<std::string, std::string> htmlTemplates;
+      static std::map<std::string,FileTag> fileTags;
+
+      // data api
+
+      static std::map<void*,HttpRequest> httpRequests;
+      static cMyMutex httpRequestsMutex;
+      static std::map<std::string,json_t*> sensorSnapshots;
+      static std::string sensorsSnapshot;  // serialized sensorSnapshots, empty if outdated
+      static cMyMutex snapshotMutex;
+      static bool dataApi;              // serve the /data/ api (it has no login)
+      static bool metricsApi;           // serve /metrics to local peers
+
+      // permessage-deflate (level 0 -> off)
+
+      static int deflateLevel;
+      static int deflateMemLevel;
+      static int deflateWindowBits;
 };
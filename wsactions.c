@@ -80,6 +80,8 @@ int Daemon::dispatchClientRequest()
             case evImageConfig:         status = performImageConfig(oObject, client);  break;
             case evSchema:            status = performSchema(oObject, client);         break;
             case evStoreSchema:       status = storeSchema(oObject, client);           break;
+            case evSubscribe:         status = performSubscribe(oObject, client);      break;
+            case evMetrics:           status = performMetrics(client);                 break;
 
             default:
             {
@@ -122,6 +124,7 @@ bool Daemon::checkRights(long client, Event event, json_t* oObject)
       case evData:                return true;
       case evInit:                return true;
       case evPageChange:          return true;
+      case evSubscribe:           return true;
       case evToggleIoNext:        return rights & urControl;
       case evToggleMode:          return rights & urFullControl;
       case evStoreConfig:         return rights & urSettings;
@@ -146,6 +149,7 @@ bool Daemon::checkRights(long client, Event event, json_t* oObject)
       case evImageConfig:         return rights & urSettings;
 
       case evSchema:              return rights & urView;
+      case evMetrics:             return rights & urAdmin;
       case evStoreSchema:         return rights & urSettings;
 
       default: break;
@@ -250,6 +254,8 @@ int Daemon::performLogin(json_t* oObject)
 
    wsClients[(void*)client].user = user;
    wsClients[(void*)client].page = page;
+   wsClients[(void*)client].subscribed = false;
+   wsClients[(void*)client].subscription.clear();
 
    tell(eloDebugWebSock, "Now %zu clients in list", wsClients.size());
 
@@ -277,43 +283,108 @@ int Daemon::performLogin(json_t* oObject)
 
    //
 
-   json_t* oJson = json_object();
-   config2Json(oJson);
-   pushOutMessage(oJson, "config", client);
-
-   oJson = json_object();
-   widgetTypes2Json(oJson);
-   pushOutMessage(oJson, "widgettypes", client);
+   pushInitPayload("config", client);
+   pushInitPayload("widgettypes", client);
 
-   oJson = json_object();
+   json_t* oJson = json_object();
    daemonState2Json(oJson);
    pushOutMessage(oJson, "daemonstate", client);
 
-   oJson = json_array();
-   valueTypes2Json(oJson);
-   pushOutMessage(oJson, "valuetypes", client);
+   pushInitPayload("valuetypes", client);
+   pushInitPayload("valuefacts", client);
+   pushInitPayload("dashboards", client);
+   pushInitPayload("images", client);
+   pushInitPayload("grouplist", client);
+   pushInitPayload("commands", client);
 
-   oJson = json_object();
-   valueFacts2Json(oJson, false);
-   pushOutMessage(oJson, "valuefacts", client);
+   performData(client, "init");
 
-   oJson = json_object();
-   dashboards2Json(oJson);
-   pushOutMessage(oJson, "dashboards", client);
+   return done;
+}
 
-   oJson = json_array();
-   images2Json(oJson);
-   pushOutMessage(oJson, "images", client);
+//***************************************************************************
+// Push Init Payload
+//   the message is serialized once and reused until the data is changed
+//***************************************************************************
 
-   oJson = json_array();
-   groups2Json(oJson);
-   pushOutMessage(oJson, "grouplist", client);
+int Daemon::pushInitPayload(const char* event, long client)
+{
+   InitPayload& payload = initPayloads[event];
 
-   oJson = json_array();
-   commands2Json(oJson);
-   pushOutMessage(oJson, "commands", client);
+   if (!payload.valid && strcmp(event, "valuefacts") == 0)
+   {
+      // the biggest one, streamed by the writer
 
-   performData(client, "init");
+      cJsonWriter json(cWebSock::sizeLwsPreFrame, payload.message.length());
+
+      beginMessage(&json, event);
+      valueFacts2Json(&json, false);
+
+      if (!json.endObject().isComplete())
+      {
+         tell(eloAlways, "Error: Incomplete json message for event '%s'", event);
+         return fail;
+      }
+
+      payload.message.swap(json.buffer());
+      payload.valid = true;
+   }
+
+   else if (!payload.valid)
+   {
+      json_t* oJson {nullptr};
+
+      if (strcmp(event, "config") == 0)
+         config2Json(oJson = json_object());
+      else if (strcmp(event, "widgettypes") == 0)
+         widgetTypes2Json(oJson = json_object());
+      else if (strcmp(event, "valuetypes") == 0)
+         valueTypes2Json(oJson = json_array());
+      else if (strcmp(event, "dashboards") == 0)
+         dashboards2Json(oJson = json_object());
+      else if (strcmp(event, "images") == 0)
+         images2Json(oJson = json_array());
+      else if (strcmp(event, "grouplist") == 0)
+         groups2Json(oJson = json_array());
+      else if (strcmp(event, "commands") == 0)
+         commands2Json(oJson = json_array());
+      else
+         return fail;
+
+      json_t* obj = json_object();
+      addToJson(obj, "event", event);
+      json_object_set_new(obj, "object", oJson);
+
+      char* p = json_dumps(obj, JSON_REAL_PRECISION(4));
+      json_decref(obj);
+
+      if (!p)
+      {
+         tell(eloAlways, "Error: Dumping json message for event '%s' failed", event);
+         return fail;
+      }
+
+      payload.message.assign(cWebSock::sizeLwsPreFrame, '\0');
+      payload.message += p;
+      payload.valid = true;
+      free(p);
+   }
+
+   tell(eloDebugWebSock, "Push init payload '%s' version %u with %zu bytes",
+        event, payload.version, payload.message.length() - cWebSock::sizeLwsPreFrame);
+
+   webSock->pushOutFrame(std::string(payload.message), (lws*)client, event);
+   webSock->performData(cWebSock::mtData);
+
+   return done;
+}
+
+int Daemon::invalidateInitPayload(const char* event)
+{
+   InitPayload& payload = initPayloads[event];
+
+   payload.valid = false;
+   payload.version++;
 
    return done;
 }
@@ -324,6 +395,8 @@ int Daemon::performLogin(json_t* oObject)
 
 int Daemon::performData(long client, const char* event)
 {
+   cMetricTimer timer("loop_phase_seconds", "performData");
+
    for (auto sj : jsonSensorList)
       json_decref(sj.second);
 
@@ -408,6 +481,10 @@ int Daemon::performPageChange(json_t* oObject, long client)
    std::string page = getStringFromJson(oObject, "page", "");
 
    wsClients[(void*)client].page = page;
+   wsClients[(void*)client].subscribed = false;      // all sensors until the page subscribes
+   wsClients[(void*)client].subscription.clear();
+   wsClients[(void*)client].followLog.clear();
+   wsClients[(void*)client].followActive = false;
 
    if (page == "list")
    {
@@ -419,6 +496,57 @@ int Daemon::performPageChange(json_t* oObject, long client)
    return done;
 }
 
+//***************************************************************************
+// Perform Subscribe
+//   { "sensors" : [ "VA:0x01", ... ] } or { "dashboard" : 5 } or {} for all
+//***************************************************************************
+
+int Daemon::performSubscribe(json_t* oObject, long client)
+{
+   WsClient& cl = wsClients[(void*)client];
+   json_t* jSensors = json_object_get(oObject, "sensors");
+
+   cl.subscribed = false;
+   cl.subscription.clear();
+
+   if (json_is_array(jSensors))
+   {
+      size_t index {0};
+      json_t* jKey {nullptr};
+
+      json_array_foreach(jSensors, index, jKey)
+      {
+         if (json_is_string(jKey))
+            cl.subscription.insert(json_string_value(jKey));
+      }
+
+      cl.subscribed = true;
+   }
+   else if (json_object_get(oObject, "dashboard"))
+   {
+      tableDashboardWidgets->clear();
+      tableDashboardWidgets->setValue("DASHBOARDID", getLongFromJson(oObject, "dashboard"));
+
+      for (int f = selectDashboardWidgetsFor->find(); f; f = selectDashboardWidgetsFor->fetch())
+      {
+         char* key {nullptr};
+         asprintf(&key, "%s:0x%02lx", tableDashboardWidgets->getStrValue("TYPE"), tableDashboardWidgets->getIntValue("ADDRESS"));
+         cl.subscription.insert(key);
+         free(key);
+      }
+
+      selectDashboardWidgetsFor->freeResult();
+      cl.subscribed = true;
+   }
+
+   tell(eloDebugWebSock, "Client 0x%x subscribed to %s", (unsigned int)client,
+        cl.subscribed ? (std::to_string(cl.subscription.size()) + " sensors").c_str() : "all sensors");
+
+   // current values of the subscribed sensors
+
+   return performData(client);
+}
+
 int Daemon::performLogout(json_t* oObject)
 {
    long client = getLongFromJson(oObject, "client");
@@ -660,25 +788,30 @@ int Daemon::storeAlerts(json_t* oObject, long client)
 
 int Daemon::performSystem(json_t* oObject, long client)
 {
-   tableTableStatistics->clear();
-   tableTableStatistics->setValue("SCHEMA", connection->getName());
-
    json_t* jObject = json_object();
    json_t* jArray = json_array();
    json_object_set_new(jObject, "tables", jArray);
 
-   for (int f = selectTableStatistic->find(); f; f = selectTableStatistic->fetch())
+   // no table statistic with the SQLite backend
+
+   if (selectTableStatistic)
    {
-      json_t* jItem = json_object();
-      json_array_append_new(jArray, jItem);
+      tableTableStatistics->clear();
+      tableTableStatistics->setValue("SCHEMA", connection->getName());
 
-      json_object_set_new(jItem, "name", json_string(tableTableStatistics->getStrValue("NAME")));
-      json_object_set_new(jItem, "tblsize", json_string(bytesPretty(tableTableStatistics->getIntValue("DATASZ"), 2)));
-      json_object_set_new(jItem, "idxsize", json_string(bytesPretty(tableTableStatistics->getIntValue("INDEXSZ"), 2)));
-      json_object_set_new(jItem, "rows", json_integer(tableTableStatistics->getIntValue("ROWS")));
-   }
+      for (int f = selectTableStatistic->find(); f; f = selectTableStatistic->fetch())
+      {
+         json_t* jItem = json_object();
+         json_array_append_new(jArray, jItem);
 
-   selectTableStatistic->freeResult();
+         json_object_set_new(jItem, "name", json_string(tableTableStatistics->getStrValue("NAME")));
+         json_object_set_new(jItem, "tblsize", json_string(bytesPretty(tableTableStatistics->getIntValue("DATASZ"), 2)));
+         json_object_set_new(jItem, "idxsize", json_string(bytesPretty(tableTableStatistics->getIntValue("INDEXSZ"), 2)));
+         json_object_set_new(jItem, "rows", json_integer(tableTableStatistics->getIntValue("ROWS")));
+      }
+
+      selectTableStatistic->freeResult();
+   }
 
    FsStat stat;
 
@@ -706,38 +839,157 @@ int Daemon::performSystem(json_t* oObject, long client)
 
 int Daemon::performSyslog(json_t* oObject, long client)
 {
-   const char* name {"/var/log/" TARGET ".log"};
+   std::string name {"/var/log/" TARGET ".log"};
 
    if (client == 0)
       return done;
 
    const char* log = getStringFromJson(oObject, "log");
-   json_t* oJson = json_object();
-   std::vector<std::string> lines;
-   std::string result;
 
    if (!isEmpty(log))
       name = log;
 
-   if (loadLinesFromFile(name, lines, false) == success)
+   // stream the new lines to the client while it stays on the page,
+   //   the tail is read up to the position of the follower, the lines written
+   //   meanwhile are sent when the tail is pushed -> no line twice or missing
+
+   off_t until {na};
+   AsyncDone onPushed;
+
+   wsClients[(void*)client].followLog.clear();
+   wsClients[(void*)client].followActive = false;
+
+   if (getBoolFromJson(oObject, "follow"))
    {
-      const int maxLines {150};
-      int count {0};
+      if (logFollowers.find(name) == logFollowers.end())
+      {
+         cFileFollower* follower = new cFileFollower(name.c_str());
 
-      for (auto it = lines.rbegin(); it != lines.rend(); ++it)
+         if (follower->start() == success)
+            logFollowers[name] = follower;
+         else
+            delete follower;
+      }
+
+      if (logFollowers.find(name) != logFollowers.end())
       {
-         if (count++ >= maxLines)
+         wsClients[(void*)client].followLog = name;     // keeps the follower until the tail is sent
+         until = logFollowers[name]->linesEnd();
+
+         onPushed = [this, client, name, until]()
          {
-            result += "...\n...\n";
-            break;
-         }
+            auto cl = wsClients.find((void*)client);
+            auto follower = logFollowers.find(name);
+
+            if (cl == wsClients.end() || cl->second.followLog != name || follower == logFollowers.end())
+               return;
 
-         result += *it;
+            std::string lines;
+            cl->second.followActive = true;
+
+            if (follower->second->readFrom(until, lines))
+            {
+               json_t* oJson = json_object();
+               json_object_set_new(oJson, "lines", json_string(lines.c_str()));
+               json_object_set_new(oJson, "append", json_true());
+               pushOutMessage(oJson, "syslog", client);
+            }
+         };
       }
    }
 
-   json_object_set_new(oJson, "lines", json_string(result.c_str()));
-   pushOutMessage(oJson, "syslog", client);
+   // reading the tail of the (maybe huge) file is done by a worker thread
+
+   return postAsync("syslog", client, [name, until](cDbWorker* worker)
+   {
+      const size_t maxLines {150};
+      json_t* oJson = json_object();
+      std::vector<std::string> lines;
+      std::string result;
+
+      if (loadTailFromFile(name.c_str(), maxLines+1, lines, until) == success)
+      {
+         size_t count {0};
+
+         for (auto it = lines.rbegin(); it != lines.rend(); ++it)
+         {
+            if (count++ >= maxLines)
+            {
+               result += "...\n...\n";
+               break;
+            }
+
+            result += *it;
+         }
+      }
+
+      json_object_set_new(oJson, "lines", json_string(result.c_str()));
+
+      return oJson;
+   }, onPushed);
+}
+
+//***************************************************************************
+// Perform Metrics Request
+//***************************************************************************
+
+int Daemon::performMetrics(long client)
+{
+   if (client == 0)
+      return done;
+
+   json_t* oJson = json_object();
+   cMetrics::toJson(oJson);
+
+   return pushOutMessage(oJson, "metrics", client);
+}
+
+//***************************************************************************
+// Perform Log Follow
+//   push the new lines of the followed logs to the clients, called by meanwhile()
+//***************************************************************************
+
+int Daemon::performLogFollow()
+{
+   for (auto it = logFollowers.begin(); it != logFollowers.end(); )
+   {
+      std::vector<long> clients;
+      bool pending {false};              // a client waits for the tail
+
+      for (const auto& cl : wsClients)
+      {
+         if (cl.second.followLog != it->first)
+            continue;
+
+         if (cl.second.followActive)
+            clients.push_back((long)cl.first);
+         else
+            pending = true;
+      }
+
+      if (clients.empty() && !pending)
+      {
+         tell(eloDebug, "Stop following '%s'", it->first.c_str());
+         delete it->second;
+         it = logFollowers.erase(it);
+         continue;
+      }
+
+      std::string lines;
+
+      if (it->second->read(lines))
+      {
+         for (auto client : clients)
+         {
+            json_t* oJson = json_object();
+            json_object_set_new(oJson, "lines", json_string(lines.c_str()));
+            json_object_set_new(oJson, "append", json_true());
+            pushOutMessage(oJson, "syslog", client);
+         }
+      }
+
+      ++it;
+   }
 
    return done;
 }
@@ -863,22 +1115,29 @@ int Daemon::performChartData(json_t* oObject, long client)
    const char* sensors = getStringFromJson(oObject, "sensors");    // Kommata getrennte Liste der Sensoren
    const char* id = getStringFromJson(oObject, "id", "");
 
-   // the id is one of {"chart" "chartwidget" "chartdialog"}
+   // the id is one of {"chart" "chartwidget" "chartdialog" "api"}
 
    bool widget = strcmp(id, "chart") != 0;
-   cDbStatement* select = widget ? selectSamplesRange60 : selectSamplesRange;
+
+   // one sample avg / 5 minutes, for dashboard widget one sample avg / 60 minutes,
+   //   the interval has to be a divider of 60 due to the 'group by'
+
+   int minutes = getIntFromJson(oObject, "interval", widget ? 60 : 5);
+
+   if (minutes < 1 || minutes > 60 || 60 % minutes)
+      minutes = widget ? 60 : 5;
 
    if (!widget)
       performChartbookmarks(client);
 
    if (strcmp(id, "chart") == 0)
    {
-      setConfigItem("chartRange", range);
+      deferConfigItem("chartRange", range);
 
       if (!isEmpty(sensors))
       {
          tell(eloDebugWebSock, "Storing sensors '%s' for chart", sensors);
-         setConfigItem("chartSensors", sensors);
+         deferConfigItem("chartSensors", sensors);
       }
    }
 
@@ -889,114 +1148,230 @@ int Daemon::performChartData(json_t* oObject, long client)
    if (sensors)
       sList = split(sensors, ',');
 
-   json_t* oMain = json_object();
-   json_t* oJson = json_array();
-
    if (!rangeStart)
       rangeStart = time(0) - (range*tmeSecondsPerDay);
 
-   rangeFrom.setValue(rangeStart);
-   rangeTo.setValue(rangeStart + (int)(range*tmeSecondsPerDay));
+   // the selects are done by a db worker to not block the main loop
 
-   tableValueFacts->clear();
+   std::string sId = id;
 
-   json_t* aAvailableSensors {nullptr};
+   return postAsyncJson("chartdata", client, [this, sList, rangeStart, range, widget, minutes, sId](cDbWorker* worker, cJsonWriter* json)
+   {
+      return chartData2Json(worker, json, sList, rangeStart, range, widget, minutes, sId);
+   });
+}
 
-   if (!widget)
-      aAvailableSensors = json_array();
+//***************************************************************************
+// Chart Data 2 Json
+//   called in context of a db worker, only use the tables of the worker!
+//   The rows are streamed to the writer while fetching them
+//***************************************************************************
+
+extern cDbFieldDef xmlTimeDef;
+extern cDbFieldDef rangeFromDef;
+extern cDbFieldDef rangeToDef;
+extern cDbFieldDef avgValueDef;
+extern cDbFieldDef maxValueDef;
+
+int Daemon::chartData2Json(cDbWorker* worker, cJsonWriter* json, std::vector<std::string> sList, time_t rangeStart,
+                           double range, bool widget, int minutes, std::string id)
+{
+   cDbTable* samples = worker->getTable("samples");
+   cDbTable* valueFacts = worker->getTable("valuefacts");
+   cDbTable* archive = worker->getTable("samplearchive");    // optional
+
+   if (!samples || !valueFacts)
+      return fail;
+
+   cDbValue from(&rangeFromDef);
+   cDbValue to(&rangeToDef);
+   cDbValue xmlTime(&xmlTimeDef);
+   cDbValue avgValue(&avgValueDef);
+   cDbValue maxValue(&maxValueDef);
+
+   cDbStatement selectFacts(valueFacts);
+
+   selectFacts.build("select ");
+   selectFacts.bindAllOut();
+   selectFacts.build(" from %s where ", valueFacts->TableName());
+   selectFacts.build("state = 'A' or record = 'A'");
+
+   if (selectFacts.prepare() != success)
+      return fail;
+
+   cDbStatement select(samples);
+
+   select.build("select ");
+   select.bind("ADDRESS", cDBS::bndOut);
+   select.bind("TYPE", cDBS::bndOut, ", ");
+   select.bindTextFree("date_format(time, '%Y-%m-%dT%H:%i')", &xmlTime, ", ", cDBS::bndOut);
+   select.bindTextFree("avg(value)", &avgValue, ", ", cDBS::bndOut);
+   select.bindTextFree("max(value)", &maxValue, ", ", cDBS::bndOut);
+   select.build(" from %s where ", samples->TableName());
+   select.bind("ADDRESS", cDBS::bndIn | cDBS::bndSet);
+   select.bind("TYPE", cDBS::bndIn | cDBS::bndSet, " and ");
+   select.bindCmp(0, "TIME", &from, ">=", " and ");
+   select.bindCmp(0, "TIME", &to, "<=", " and ");
+   select.build(" group by date(time), ((60/%d) * hour(time) + floor(minute(time)/%d))", minutes, minutes);
+   select.build(" order by time");
+   select.setStreaming();
+
+   if (select.prepare() != success)
+      return fail;
+
+   struct AvailableSensor
+   {
+      std::string id;
+      std::string title;
+      bool active {false};
+   };
+
+   std::vector<AvailableSensor> availableSensors;
+
+   json->beginObject();
+   json->beginArray("rows");
+
+   from.setValue(rangeStart);
+   to.setValue(rangeStart + (int)(range*tmeSecondsPerDay));
+
+   valueFacts->clear();
 
-   for (int f = selectActiveValueFacts->find(); f; f = selectActiveValueFacts->fetch())
+   for (int f = selectFacts.find(); f; f = selectFacts.fetch())
    {
-      if (!tableValueFacts->hasValue("RECORD", "A"))
+      if (!valueFacts->hasValue("RECORD", "A"))
          continue;
 
       char* id {nullptr};
-      asprintf(&id, "%s:0x%02lx", tableValueFacts->getStrValue("TYPE"), tableValueFacts->getIntValue("ADDRESS"));
+      asprintf(&id, "%s:0x%02lx", valueFacts->getStrValue("TYPE"), valueFacts->getIntValue("ADDRESS"));
 
       bool active = std::find(sList.begin(), sList.end(), id) != sList.end();  // #PORT
-      const char* usrtitle = tableValueFacts->getStrValue("USRTITLE");
-      const char* title = tableValueFacts->getStrValue("TITLE");
+      const char* usrtitle = valueFacts->getStrValue("USRTITLE");
+      const char* title = valueFacts->getStrValue("TITLE");
 
       if (!isEmpty(usrtitle))
          title = usrtitle;
 
       if (!widget)
-      {
-         json_t* oSensor = json_object();
-         json_object_set_new(oSensor, "id", json_string(id));
-         json_object_set_new(oSensor, "title", json_string(title));
-         json_object_set_new(oSensor, "active", json_integer(active));
-         json_array_append_new(aAvailableSensors, oSensor);
-      }
-
-      free(id);
+         availableSensors.push_back({id, title ? title : "", active});
 
       if (!active)
+      {
+         free(id);
          continue;
-
-      json_t* oSample = json_object();
-      json_array_append_new(oJson, oSample);
+      }
 
       char* sensor {nullptr};
-      asprintf(&sensor, "%s%lu", tableValueFacts->getStrValue("TYPE"), tableValueFacts->getIntValue("ADDRESS"));
-      json_object_set_new(oSample, "title", json_string(title));
+      asprintf(&sensor, "%s%lu", valueFacts->getStrValue("TYPE"), valueFacts->getIntValue("ADDRESS"));
 
-      char* key {nullptr};
-      asprintf(&key, "%s:0x%02lx", tableValueFacts->getStrValue("TYPE"), tableValueFacts->getIntValue("ADDRESS"));
-      json_object_set_new(oSample, "key", json_string(key));
-      free(key);
+      json->beginObject();
+      json->add("title", title);
+      json->add("key", id);
+      json->add("sensor", sensor);
+      json->beginArray("data");
 
-      json_object_set_new(oSample, "sensor", json_string(sensor));
-      json_t* oData = json_array();
-      json_object_set_new(oSample, "data", oData);
       free(sensor);
+      free(id);
 
-      tableSamples->clear();
-      tableSamples->setValue("TYPE", tableValueFacts->getStrValue("TYPE"));
-      tableSamples->setValue("ADDRESS", tableValueFacts->getIntValue("ADDRESS"));
+      samples->clear();
+      samples->setValue("TYPE", valueFacts->getStrValue("TYPE"));
+      samples->setValue("ADDRESS", valueFacts->getIntValue("ADDRESS"));
 
       tell(eloDebugWebSock, " selecting '%s - %s' for '%s:0x%02lx'",
-           l2pTime(rangeFrom.getTimeValue()).c_str(),
-           l2pTime(rangeTo.getTimeValue()).c_str(),
-           tableValueFacts->getStrValue("TYPE"), tableValueFacts->getIntValue("ADDRESS"));
+           l2pTime(from.getTimeValue()).c_str(),
+           l2pTime(to.getTimeValue()).c_str(),
+           valueFacts->getStrValue("TYPE"), valueFacts->getIntValue("ADDRESS"));
 
       uint count {0};
+      bool isDO = valueFacts->hasValue("TYPE", "DO");
 
-      for (int f = select->find(); f; f = select->fetch())
+      auto addRow = [&](const char* x, double avg, long max)
       {
-         // tell(eloDebugWebSock, "0x%x: '%s' : %0.2f", (uint)tableSamples->getStrValue("ADDRESS"),
-         //      xmlTime.getStrValue(), tableSamples->getFloatValue("VALUE"));
+         json->beginObject();
+         json->add("x", x);
 
-         json_t* oRow = json_object();
-         json_array_append_new(oData, oRow);
+         if (isDO)
+            json->add("y", max*10);
+         else
+            json->add("y", avg);
+
+         json->endObject();
+         count++;
+      };
 
-         json_object_set_new(oRow, "x", json_string(xmlTime.getStrValue()));
+      // archived days first - they are always older than the rows in 'samples',
+      //   bucket them like the 'group by' of the select below
 
-         if (tableValueFacts->hasValue("TYPE", "DO"))
-            json_object_set_new(oRow, "y", json_integer(maxValue.getIntValue()*10));
-         else
+      if (archive)
+      {
+         long key {-1};
+         char x[20] {};
+         double sum {0};
+         double max {0};
+         int n {0};
+
+         cSampleArchive(archive).read(valueFacts->getIntValue("ADDRESS"), valueFacts->getStrValue("TYPE"),
+                                      from.getTimeValue(), to.getTimeValue(), [&](time_t time, double value)
          {
-            // double avg = avgValue.getFloatValue();
-            // avg = std::llround(avg*20) / 20.0;                  // round to .05
-            json_object_set_new(oRow, "y", json_real(avgValue.getFloatValue()));
-         }
-         count++;
+            struct tm tm {};
+            localtime_r(&time, &tm);
+            long k = ((tm.tm_year * 366L + tm.tm_yday) * 24*60 + tm.tm_hour * 60 + tm.tm_min) / minutes;
+
+            if (k != key)
+            {
+               if (n)
+                  addRow(x, sum / n, (long)max);
+
+               key = k;
+               strftime(x, sizeof(x), "%Y-%m-%dT%H:%M", &tm);
+               sum = 0;
+               max = value;
+               n = 0;
+            }
+
+            sum += value;
+            max = std::max(max, value);
+            n++;
+         });
+
+         if (n)
+            addRow(x, sum / n, (long)max);
       }
 
+      for (int f = select.find(); f; f = select.fetch())
+         addRow(xmlTime.getStrValue(), avgValue.getFloatValue(), maxValue.getIntValue());
+
+      json->endArray();
+      json->endObject();
+
       tell(eloDebugWebSock, " collected %d samples'", count);
-      select->freeResult();
+      select.freeResult();
    }
 
+   json->endArray();
+
    if (!widget)
-      json_object_set_new(oMain, "sensors", aAvailableSensors);
+   {
+      json->beginArray("sensors");
+
+      for (const auto& sensor : availableSensors)
+      {
+         json->beginObject();
+         json->add("id", sensor.id);
+         json->add("title", sensor.title);
+         json->add("active", (int)sensor.active);
+         json->endObject();
+      }
+
+      json->endArray();
+   }
 
-   json_object_set_new(oMain, "rows", oJson);
-   json_object_set_new(oMain, "id", json_string(id));
-   selectActiveValueFacts->freeResult();
+   json->add("id", id);
+   json->endObject();
+
+   selectFacts.freeResult();
    tell(eloDebugWebSock, ".. done");
-   pushOutMessage(oMain, "chartdata", client);
 
-   return done;
+   return success;
 }
 
 //***************************************************************************
@@ -1313,9 +1688,7 @@ int Daemon::storeConfig(json_t* obj, long client)
 
    readConfiguration(false);
 
-   json_t* oJson = json_object();
-   config2Json(oJson);
-   pushOutMessage(oJson, "config", client);
+   pushInitPayload("config", client);
 
    if (oldWebPort != webPort)
       replyResult(success, "Konfiguration gespeichert. Web Port geändert, bitte " TARGET " neu Starten!", client);
@@ -1337,6 +1710,8 @@ int Daemon::storeDashboards(json_t* obj, long client)
 {
    const char* action = getStringFromJson(obj, "action", "");
 
+   invalidateInitPayload("dashboards");
+
    if (strcmp(action, "order") == 0)              // reorder dashboards
    {
       // {"action": "order", "order": ["16", "25", "14", "27"]},
@@ -1386,9 +1761,7 @@ int Daemon::storeDashboards(json_t* obj, long client)
       tableDashboardWidgets->setValue("WIDGETOPTS", options.c_str());
       tableDashboardWidgets->insert();
 
-      json_t* oJson = json_object();
-      dashboards2Json(oJson);
-      pushOutMessage(oJson, "dashboards", client);
+      pushInitPayload("dashboards", client);
    }
    else
    {
@@ -1519,9 +1892,7 @@ int Daemon::storeDashboards(json_t* obj, long client)
 
 int Daemon::performForceRefresh(json_t* obj, long client)
 {
-   json_t* oJson = json_object();
-   dashboards2Json(oJson);
-   pushOutMessage(oJson, "dashboards", client);
+   pushInitPayload("dashboards", client);
 
    performData(client, "init");
 
@@ -1572,9 +1943,8 @@ int Daemon::storeIoSetup(json_t* array, long client)
       }
    }
 
-   json_t* oJson = json_object();
-   valueFacts2Json(oJson, false);
-   pushOutMessage(oJson, "valuefacts", client);
+   invalidateInitPayload("valuefacts");
+   pushInitPayload("valuefacts", client);
    updateSchemaConfTable();
 
    return replyResult(success, "Konfiguration gespeichert", client);
@@ -1647,6 +2017,11 @@ int Daemon::storeGroups(json_t* oObject, long client)
       }
    }
 
+   // the group names are part of the valuefacts as well
+
+   invalidateInitPayload("grouplist");
+   invalidateInitPayload("valuefacts");
+
    performGroups(client);
 
    return replyResult(success, "Konfiguration gespeichert", client);
@@ -1708,9 +2083,8 @@ int Daemon::performImageConfig(json_t* obj, long client)
       return done;
    }
 
-   json_t* oJson = json_array();
-   images2Json(oJson);
-   pushOutMessage(oJson, "images", client);
+   invalidateInitPayload("images");
+   pushInitPayload("images", client);
 
    return done;
 }
@@ -1723,6 +2097,14 @@ int Daemon::config2Json(json_t* obj)
 {
    for (const auto& it : *getConfiguration())
    {
+      auto pending = pendingConfigItems.find(it.name);
+
+      if (pending != pendingConfigItems.end())
+      {
+         json_object_set_new(obj, it.name.c_str(), json_string(pending->second.c_str()));
+         continue;
+      }
+
       tableConfig->clear();
       tableConfig->setValue("OWNER", myName());
       tableConfig->setValue("NAME", it.name.c_str());
@@ -1937,8 +2319,18 @@ int Daemon::valueTypes2Json(json_t* obj)
 // Value Facts 2 Json
 //***************************************************************************
 
-int Daemon::valueFacts2Json(json_t* obj, bool filterActive)
+int Daemon::valueFacts2Json(cJsonWriter* json, bool filterActive)
 {
+   std::map<long,std::string> groupNames;
+
+   tableGroups->clear();
+
+   for (int f = selectAllGroups->find(); f; f = selectAllGroups->fetch())
+      groupNames[tableGroups->getIntValue("ID")] = tableGroups->getStrValue("NAME");
+
+   selectAllGroups->freeResult();
+
+   json->beginObject();
    tableValueFacts->clear();
 
    for (int f = selectAllValueFacts->find(); f; f = selectAllValueFacts->fetch())
@@ -1946,51 +2338,48 @@ int Daemon::valueFacts2Json(json_t* obj, bool filterActive)
       if (filterActive && !tableValueFacts->hasValue("STATE", "A"))
          continue;
 
-      char* key {nullptr};
+      char key[100+TB];
       std::string type = tableValueFacts->getStrValue("TYPE");
-      asprintf(&key, "%s:0x%02lx", type.c_str(), tableValueFacts->getIntValue("ADDRESS"));
-      json_t* oData = json_object();
-      json_object_set_new(obj, key, oData);
-      free(key);
-
-      json_object_set_new(oData, "address", json_integer((ulong)tableValueFacts->getIntValue("ADDRESS")));
-      json_object_set_new(oData, "type", json_string(type.c_str()));
-      json_object_set_new(oData, "state", json_boolean(tableValueFacts->hasValue("STATE", "A")));
-      json_object_set_new(oData, "record", json_boolean(tableValueFacts->hasValue("RECORD", "A")));
-      json_object_set_new(oData, "name", json_string(tableValueFacts->getStrValue("NAME")));
-      json_object_set_new(oData, "title", json_string(tableValueFacts->getStrValue("TITLE")));
-      json_object_set_new(oData, "usrtitle", json_string(tableValueFacts->getStrValue("USRTITLE")));
-      json_object_set_new(oData, "unit", json_string(tableValueFacts->getStrValue("UNIT")));
-      json_object_set_new(oData, "rights", json_integer(tableValueFacts->getIntValue("RIGHTS")));
-      json_object_set_new(oData, "options", json_integer(tableValueFacts->getIntValue("OPTIONS")));
+      snprintf(key, sizeof(key), "%s:0x%02lx", type.c_str(), tableValueFacts->getIntValue("ADDRESS"));
+
+      json->beginObject(key);
+      json->add("address", (ulong)tableValueFacts->getIntValue("ADDRESS"));
+      json->add("type", type);
+      json->add("state", tableValueFacts->hasValue("STATE", "A"));
+      json->add("record", tableValueFacts->hasValue("RECORD", "A"));
+      json->add("name", tableValueFacts->getStrValue("NAME"));
+      json->add("title", tableValueFacts->getStrValue("TITLE"));
+      json->add("usrtitle", tableValueFacts->getStrValue("USRTITLE"));
+      json->add("unit", tableValueFacts->getStrValue("UNIT"));
+      json->add("rights", tableValueFacts->getIntValue("RIGHTS"));
+      json->add("options", tableValueFacts->getIntValue("OPTIONS"));
       // #TODO check actor properties if dimmable ...
-      json_object_set_new(oData, "dim", json_boolean(type == "DZL" || type == "HMB"));
+      json->add("dim", type == "DZL" || type == "HMB");
 
       if (!tableValueFacts->getValue("CHOICES")->isNull())
-         json_object_set_new(oData, "choices", json_string(tableValueFacts->getStrValue("CHOICES")));
+         json->add("choices", tableValueFacts->getStrValue("CHOICES"));
 
       // widget in valuefacts only used or list view!
 
-      json_t* jDefaults = json_object();
-      widgetDefaults2Json(jDefaults, type.c_str(),
+      json->beginObject("widget");
+      widgetDefaults2Json(json, type.c_str(),
                           tableValueFacts->getStrValue("UNIT"),
                           tableValueFacts->getStrValue("NAME"),
                           tableValueFacts->getIntValue("ADDRESS"));
+      json->endObject();
 
-      json_object_set_new(oData, "widget", jDefaults);
+      auto group = groupNames.find(tableValueFacts->getIntValue("GROUPID"));
 
-      tableGroups->clear();
-      tableGroups->setValue("ID", tableValueFacts->getIntValue("GROUPID"));
-
-      if (tableGroups->find())
+      if (group != groupNames.end())
       {
-         json_object_set_new(oData, "groupid", json_integer(tableGroups->getIntValue("ID")));
-         json_object_set_new(oData, "group", json_string(tableGroups->getStrValue("NAME")));
+         json->add("groupid", group->first);
+         json->add("group", group->second);
       }
 
-      tableGroups->reset();
+      json->endObject();
    }
 
+   json->endObject();
    selectAllValueFacts->freeResult();
 
    return done;
@@ -2095,10 +2484,7 @@ int Daemon::performCommand(json_t* obj, long client)
    {
       tablePeaks->truncate();
       setConfigItem("peakResetAt", l2pTime(time(0)).c_str());
-
-      json_t* oJson = json_object();
-      config2Json(oJson);
-      pushOutMessage(oJson, "config", client);
+      pushInitPayload("config", client);
    }
    else if (what == "testmail")
    {